@@ -30,6 +30,11 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef HAVE_SPAWN_H
+#include <spawn.h>
+#endif
 #ifdef HAVE_TIME_H
 #include <time.h>
 #endif 
@@ -56,6 +61,7 @@
 #include "codegen.h"
 #include "allocate.h"
 #include "cccsp.h"
+#include "compcache.h"
 #include "parsepriv.h"
 
 /*}}}*/
@@ -260,6 +266,20 @@ typedef struct TAG_cccsp_etypehook {
 	char *name;				/* e.g. "gte_foo" */
 } cccsp_etypehook_t;
 
+typedef struct TAG_cccsp_ccjob {
+	pid_t pid;				/* running C compiler */
+	char *src;				/* what it is compiling */
+	char *obj;				/* and what it should produce */
+} cccsp_ccjob_t;
+
+typedef struct TAG_cccsp_ccpart {
+	int isdata;				/* data definition, rather than a function */
+	size_t start, end;			/* definition in the generated C, end is after its last line */
+	int skip;				/* leading "static inline " dropped from a helper when shared out */
+	int declen;				/* length of the signature line or data declarator at 'start' */
+	int unit;				/* translation unit it gets compiled in */
+} cccsp_ccpart_t;
+
 typedef struct TAG_cccsp_indexhook {
 	int indir;				/* desired indirection on arraysub/recordsub */
 	tnode_t *type;				/* underlying type */
@@ -278,8 +298,24 @@ static int cccsp_bepass = 0;
 static char *cccsp_cc_opts = NULL;			/* extra flags that can be passed to the C compiler */
 static int cccsp_show_sfi = 0;				/* whether or not to dump the SFI table (after recompile) */
 static int cccsp_force_librecompile = 0;		/* force [standard/built-in] libraries to be recompiled */
+static int cccsp_cc_jobs = 1;				/* number of C compilers that may run at once */
+static int cccsp_cc_nosplit = 0;			/* compile the generated C as a single unit, even with several jobs */
+static int cccsp_sfi_exact = 0;				/* always get stack usage from gcc, rather than estimating it */
+static char *cccsp_sfi_calib = NULL;			/* calibration file for stack usage estimates */
+static int cccsp_cc_deferred = 0;			/* first C compile put off, in the hope stack usage estimates will do */
+static int cccsp_sfi_estimated = 0;			/* stack usage estimated, so check against gcc's after compiling */
+static int cccsp_cc_stopat = 0;				/* stop-point for the first C compile */
 static cccsp_subtarget_e cccsp_subtarget = CCCSP_SUBTARGET_DEFAULT;
 
+STATICDYNARRAY (cccsp_ccjob_t *, cccsp_ccjobs);		/* C compilers currently running */
+#define CCCSP_CC_POLLUS 2000				/* microseconds between polls for finished C compilers */
+#define CCCSP_CC_MINUNIT 32768				/* bytes of generated functions worth a C compiler of their own */
+#define CCCSP_EST_WSWORDS 16				/* process words CIF adds in WORKSPACE_SIZE(), generously */
+
+#ifdef HAVE_SPAWN_H
+extern char **environ;
+#endif
+
 static chook_t *cccsp_ctypestr = NULL;
 static int cccsp_coder_inparamlist = 0;
 
@@ -384,6 +420,27 @@ static int cccsp_opthandler_setflag (cmd_option_t *opt, char ***argwalk, int *ar
 	return 0;
 }
 /*}}}*/
+/*{{{  static int cccsp_opthandler_setjobs (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	option handler for the number of C compilers to run at once
+ *	this must be specified as "--cccsp-cc-jobs=...", since options may not be visible initially
+ *	returns 0 on success, non-zero on failure
+ */
+static int cccsp_opthandler_setjobs (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	int *iptr = (int *)(opt->arg);
+	char *ch;
+	int n;
+
+	for (ch=**argwalk; (*ch != '\0') && (*ch != '='); ch++);
+	if ((*ch == '\0') || (sscanf (ch + 1, "%d", &n) != 1) || (n < 1) || (n > 64)) {
+		nocc_error ("bad number of C compiler jobs in [%s], expected 1 to 64", **argwalk);
+		return -1;
+	}
+	*iptr = n;
+	return 0;
+}
+/*}}}*/
 /*{{{  static int cccsp_opthandler_setsubtarget (cmd_option_t *opt, char ***argwalk, int *argleft)*/
 /*
  *	option handler for cccsp subtarget setting
@@ -452,6 +509,10 @@ static int cccsp_target_init_options (void)
 	opts_add ("cccsp-subtarget", '\0', cccsp_opthandler_setsubtarget, NULL, "1set CCCSP sub-target (default/x86, EV3)");
 	opts_add ("cccsp-kroc", '\0', cccsp_opthandler_setkrocpath, NULL, "1specify path to kroc for CCCSP back-end");
 	opts_add ("cccsp-force-libcomp", '\0', cccsp_opthandler_setflag, (void *)&cccsp_force_librecompile, "1force recompilation of standard libraries");
+	opts_add ("cccsp-cc-jobs", '\0', cccsp_opthandler_setjobs, (void *)&cccsp_cc_jobs, "1number of C compilers to run at once (default 1)");
+	opts_add ("cccsp-cc-nosplit", '\0', cccsp_opthandler_setflag, (void *)&cccsp_cc_nosplit, "1do not split generated C into units for parallel compilation");
+	opts_add ("cccsp-sfi-exact", '\0', cccsp_opthandler_setflag, (void *)&cccsp_sfi_exact, "1always compile twice for exact stack usage, do not estimate");
+	opts_add ("cccsp-sfi-calib", '\0', cccsp_opthandler_setstring, (void *)&cccsp_sfi_calib, "1calibration file for stack usage estimates");
 	return 0;
 }
 /*}}}*/
@@ -1503,9 +1564,9 @@ static int cccsp_prewalktree_preallocate (tnode_t *node, void *data)
 	cccsp_preallocate_t *cpa = (cccsp_preallocate_t *)data;
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_LPREALLOCATE)) {
-		r = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_LPREALLOCATE, 2, node, cpa);
+		r = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_LPREALLOCATE, node, cpa);
 	} else if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_PREALLOCATE)) {
-		r = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_PREALLOCATE, 2, node, cpa->target);
+		r = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_PREALLOCATE, node, cpa->target);
 	}
 
 	return r;
@@ -1533,9 +1594,9 @@ static int cccsp_prewalktree_codegen (tnode_t *node, void *data)
 	/*}}}*/
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_LCODEGEN)) {
-		i = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_LCODEGEN, 2, node, cgen);
+		i = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_LCODEGEN, node, cgen);
 	} else if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_CODEGEN)) {
-		i = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_CODEGEN, 2, node, cgen);
+		i = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_CODEGEN, node, cgen);
 	}
 
 	/*{{{  if finalisers, do subnodes then finalisers*/
@@ -1572,9 +1633,9 @@ static int cccsp_modprewalktree_namemap (tnode_t **nodep, void *data)
 	int i = 1;
 
 	if ((*nodep)->tag->ndef->ops && tnode_hascompop_i ((*nodep)->tag->ndef->ops, (int)COPS_LNAMEMAP)) {
-		i = tnode_callcompop_i ((*nodep)->tag->ndef->ops, (int)COPS_LNAMEMAP, 2, nodep, map);
+		i = tnode_callcompop_i2 ((*nodep)->tag->ndef->ops, (int)COPS_LNAMEMAP, nodep, map);
 	} else if ((*nodep)->tag->ndef->ops && tnode_hascompop_i ((*nodep)->tag->ndef->ops, (int)COPS_NAMEMAP)) {
-		i = tnode_callcompop_i ((*nodep)->tag->ndef->ops, (int)COPS_NAMEMAP, 2, nodep, map);
+		i = tnode_callcompop_i2 ((*nodep)->tag->ndef->ops, (int)COPS_NAMEMAP, nodep, map);
 	}
 
 	return i;
@@ -1591,9 +1652,9 @@ static int cccsp_modprewalktree_precode (tnode_t **nodep, void *data)
 	int i = 1;
 
 	if ((*nodep)->tag->ndef->ops && tnode_hascompop_i ((*nodep)->tag->ndef->ops, (int)COPS_LPRECODE)) {
-		i = tnode_callcompop_i ((*nodep)->tag->ndef->ops, (int)COPS_LPRECODE, 2, nodep, cgen);
+		i = tnode_callcompop_i2 ((*nodep)->tag->ndef->ops, (int)COPS_LPRECODE, nodep, cgen);
 	} else if ((*nodep)->tag->ndef->ops && tnode_hascompop_i ((*nodep)->tag->ndef->ops, (int)COPS_PRECODE)) {
-		i = tnode_callcompop_i ((*nodep)->tag->ndef->ops, (int)COPS_PRECODE, 2, nodep, cgen);
+		i = tnode_callcompop_i2 ((*nodep)->tag->ndef->ops, (int)COPS_PRECODE, nodep, cgen);
 	}
 
 	return i;
@@ -1609,7 +1670,7 @@ static int cccsp_modprewalktree_betrans (tnode_t **tptr, void *arg)
 	int i = 1;
 
 	if (*tptr && (*tptr)->tag->ndef->ops && tnode_hascompop_i ((*tptr)->tag->ndef->ops, (int)COPS_BETRANS)) {
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_BETRANS, 2, tptr, (betrans_t *)arg);
+		i = tnode_callcompop_i2 ((*tptr)->tag->ndef->ops, (int)COPS_BETRANS, tptr, (betrans_t *)arg);
 	}
 	return i;
 }
@@ -1624,6 +1685,10 @@ static int cccsp_prewalktree_cccspdcg (tnode_t *node, void *data)
 	int r = 1;
 	cccsp_dcg_t *dcg = (cccsp_dcg_t *)data;
 
+	if (dcg->thisfcn && (dcg->thisfcn->estlocals == -1)) {
+		/* inside one of ours, start counting for a stack usage estimate */
+		dcg->thisfcn->estlocals = 0;
+	}
 	if (node->tag->ndef->ops && tnode_hascompop (node->tag->ndef->ops, "cccsp:dcg")) {
 		r = tnode_callcompop (node->tag->ndef->ops, "cccsp:dcg", 2, node, dcg);
 	}
@@ -2455,6 +2520,48 @@ static int cccsp_lcodegen_name (compops_t *cops, tnode_t *name, codegen_t *cgen)
 	return 0;
 }
 /*}}}*/
+/*{{{  static int cccsp_cc_wordsize (void)*/
+/*
+ *	returns the word (pointer) size for what the C compiler targets, not necessarily the slot size here
+ */
+static int cccsp_cc_wordsize (void)
+{
+	if (cccsp_subtarget == CCCSP_SUBTARGET_EV3) {
+		return 4;
+	}
+	/* otherwise building for the host */
+	return (int)sizeof (void *);
+}
+/*}}}*/
+/*{{{  static int cccsp_estbytes_name (tnode_t *node, target_t *target)*/
+/*
+ *	estimates the stack space a back-end name takes as a C local, as generated on the first pass
+ *	returns bytes on success, < 0 if unknown
+ */
+static int cccsp_estbytes_name (tnode_t *node, target_t *target)
+{
+	cccsp_priv_t *kpriv = (cccsp_priv_t *)target->priv;
+	cccsp_namehook_t *nh = (cccsp_namehook_t *)tnode_nthhookof (node, 0);
+	tnode_t *src = tnode_nthsubof (node, 0);
+	int wsize = cccsp_cc_wordsize ();
+
+	if (src->tag == kpriv->tag_WORKSPACE) {
+		cccsp_workspacehook_t *whook = (cccsp_workspacehook_t *)tnode_nthhookof (src, 0);
+
+		if (whook->isdyn) {
+			/* just the pointer */
+			return wsize;
+		}
+		/* WORKSPACE_SIZE(1,1) */
+		return (2 + CCCSP_EST_WSWORDS) * wsize;
+	} else if (nh->indir > 0) {
+		return wsize;
+	} else if (nh->typesize > 0) {
+		return (nh->typesize + (wsize - 1)) & ~(wsize - 1);
+	}
+	return -1;
+}
+/*}}}*/
 /*{{{  static int cccsp_cccspdcg_name (compops_t *cops, tnode_t *node, cccsp_dcg_t *dcg)*/
 /*
  *	does direct-call-graph building for a name -- looks at the initialiser mostly
@@ -2464,6 +2571,12 @@ static int cccsp_cccspdcg_name (compops_t *cops, tnode_t *node, cccsp_dcg_t *dcg
 {
 	cccsp_namehook_t *nh = (cccsp_namehook_t *)tnode_nthhookof (node, 0);
 
+	if (dcg->thisfcn && (dcg->thisfcn->estlocals >= 0)) {
+		/* local in one of ours, count towards the stack usage estimate */
+		int bytes = cccsp_estbytes_name (node, dcg->target);
+
+		dcg->thisfcn->estlocals = (bytes < 0) ? -2 : (dcg->thisfcn->estlocals + bytes);
+	}
 	if (nh->initialiser) {
 		cccsp_cccspdcg_subtree (nh->initialiser, dcg);
 	}
@@ -3063,6 +3176,7 @@ int cccsp_init (void)
 	/* setup local stuff */
 	codegeninithook = codegen_getcodegeninithook ();
 	codegenfinalhook = codegen_getcodegenfinalhook ();
+	dynarray_init (cccsp_ccjobs);
 
 	if (tnode_newcompop ("cccsp:dcg", COPS_INVALID, 2, INTERNAL_ORIGIN) < 0) {
 		nocc_serious ("cccsp_init(): failed to add \"cccsp:dcg\" compiler operation");
@@ -3097,25 +3211,25 @@ int cccsp_shutdown (void)
 		nocc_error ("cccsp_shutdown(): failed to unregister target!");
 		return 1;
 	}
+	dynarray_trash (cccsp_ccjobs);
 
 	return 0;
 }
 /*}}}*/
 
-/*{{{  static int cccsp_run_cc (char *cmd)*/
+/*{{{  static pid_t cccsp_cc_spawn (char *cmd)*/
 /*
- *	runs the C compiler to build something -- mostly a wrapper around fork/exec here
- *	returns 0 on success, non-zero on failure
+ *	starts the C compiler running in a child process, with posix_spawn where we have it, fork/exec otherwise
+ *	returns process ID on success, -1 on failure
  */
-static int cccsp_run_cc (char *cmd)
+static pid_t cccsp_cc_spawn (char *cmd)
 {
 	char **bits;
-	int fres;
-	int rval = 0;
+	pid_t pid;
 	int i;
 
 	if (compopts.verbose > 1) {
-		nocc_message ("cccsp_run_cc(): running compiler: %s", cmd);
+		nocc_message ("cccsp_cc_spawn(): running compiler: %s", cmd);
 	}
 	bits = split_string (cmd, 1);
 #if 0
@@ -3125,53 +3239,564 @@ static int cccsp_run_cc (char *cmd)
 		if (compopts.verbose) {
 			nocc_warning ("cannot execute compiler [%s]", bits[0]);
 		}
-		rval = -1;
+		pid = -1;
 		goto out_free;
 	}
 #endif
 
-	fres = fork ();
-	if (fres < 0) {
-		nocc_error ("cannot execute compiler [%s], fork() failed: %s", bits[0], strerror (errno));
-		rval = -1;
-		goto out_free;
+#ifdef HAVE_SPAWN_H
+	i = posix_spawnp (&pid, bits[0], NULL, NULL, bits, environ);
+	if (i) {
+		nocc_error ("cannot execute compiler [%s], posix_spawnp() failed: %s", bits[0], strerror (i));
+		pid = -1;
 	}
-
-	if (fres == 0) {
+#else
+	pid = fork ();
+	if (pid < 0) {
+		nocc_error ("cannot execute compiler [%s], fork() failed: %s", bits[0], strerror (errno));
+	} else if (!pid) {
 		/* we are the child */
 		execvp (bits[0], bits);
 		_exit (1);			/* failed if we get this far */
-	} else {
-		pid_t wres;
-		int status = 0;
+	}
+#endif
 
-		wres = waitpid (fres, &status, 0);
-		if (wres < 0) {
-			nocc_serious ("cccsp_run_cc(): wait() failed: %s", strerror (errno));
-			rval = -1;
-			goto out_free;
-		} else if (!WIFEXITED (status)) {
-			nocc_serious ("cccsp_run_cc(): child process wait()ed, but didn't exit normally?, status = 0x%8.8x", (unsigned int)status);
+	for (i=0; bits[i]; i++) {
+		sfree (bits[i]);
+		bits[i] = NULL;
+	}
+	sfree (bits);
+
+	return pid;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_status (pid_t pid, int status)*/
+/*
+ *	checks how a C compiler child process finished, given its wait() status
+ *	returns 0 if it succeeded, non-zero otherwise
+ */
+static int cccsp_cc_status (pid_t pid, int status)
+{
+	if (!WIFEXITED (status)) {
+		nocc_serious ("cccsp_cc_status(): child process %d wait()ed, but didn't exit normally?, status = 0x%8.8x", (int)pid, (unsigned int)status);
+		return -1;
+	} else if (WEXITSTATUS (status)) {
+		/* bad, so return error */
+		return -1;
+	}
+	/* else, assume all was good */
+	return 0;
+}
+/*}}}*/
+/*{{{  static int cccsp_run_cc (char *cmd)*/
+/*
+ *	runs the C compiler to build something and waits for it
+ *	returns 0 on success, non-zero on failure
+ */
+static int cccsp_run_cc (char *cmd)
+{
+	pid_t pid, wres;
+	int status = 0;
+
+	pid = cccsp_cc_spawn (cmd);
+	if (pid < 0) {
+		return -1;
+	}
+
+	wres = waitpid (pid, &status, 0);
+	if (wres < 0) {
+		nocc_serious ("cccsp_run_cc(): wait() failed: %s", strerror (errno));
+		return -1;
+	}
+	return cccsp_cc_status (pid, status);
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_maxjobs (void)*/
+/*
+ *	returns the number of C compilers that may run at once (as many as --cccsp-cc-jobs)
+ */
+static int cccsp_cc_maxjobs (void)
+{
+	return cccsp_cc_jobs;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_reap (int block)*/
+/*
+ *	collects any C compilers that have finished, checking that each produced its output.
+ *	if 'block' is set, polls until at least one has finished (if any are running).
+ *	returns 0 if those collected succeeded, non-zero if any failed
+ */
+static int cccsp_cc_reap (int block)
+{
+	int rval = 0;
+	int nreaped = 0;
+
+	for (;;) {
+		int i;
+
+		for (i=0; i<DA_CUR (cccsp_ccjobs); i++) {
+			cccsp_ccjob_t *job = DA_NTHITEM (cccsp_ccjobs, i);
+			int status = 0;
+			pid_t wres;
+
+			wres = waitpid (job->pid, &status, WNOHANG);
+			if (!wres) {
+				/* still running */
+				continue;
+			}
+			if (wres < 0) {
+				nocc_serious ("cccsp_cc_reap(): wait() failed: %s", strerror (errno));
+				rval = -1;
+			} else if (cccsp_cc_status (job->pid, status)) {
+				nocc_error ("failed to compile [%s] to [%s]", job->src, job->obj);
+				rval = -1;
+			} else if (fhandle_access (job->obj, R_OK)) {
+				nocc_error ("failed to generate something when compiling [%s] to [%s]", job->src, job->obj);
+				rval = -1;
+			}
+
+			dynarray_delitem (cccsp_ccjobs, i);
+			i--;
+			sfree (job->src);
+			sfree (job->obj);
+			sfree (job);
+			nreaped++;
+		}
+
+		if (nreaped || !block || !DA_CUR (cccsp_ccjobs)) {
+			break;
+		}
+		usleep (CCCSP_CC_POLLUS);
+	}
+
+	return rval;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_start (char *cmd, const char *src, const char *obj)*/
+/*
+ *	starts the C compiler building 'obj' from 'src' without waiting for it, once there is room for another.
+ *	returns 0 on success, non-zero on failure (of this or of one collected while waiting)
+ */
+static int cccsp_cc_start (char *cmd, const char *src, const char *obj)
+{
+	cccsp_ccjob_t *job;
+	pid_t pid;
+	int rval = 0;
+
+	while (DA_CUR (cccsp_ccjobs) >= cccsp_cc_maxjobs ()) {
+		if (cccsp_cc_reap (1)) {
 			rval = -1;
-			goto out_free;
-		} else if (WEXITSTATUS (status)) {
-			/* bad, so return error */
+		}
+	}
+
+	pid = cccsp_cc_spawn (cmd);
+	if (pid < 0) {
+		return -1;
+	}
+
+	job = (cccsp_ccjob_t *)smalloc (sizeof (cccsp_ccjob_t));
+	job->pid = pid;
+	job->src = string_dup (src);
+	job->obj = string_dup (obj);
+	dynarray_add (cccsp_ccjobs, job);
+
+	return rval;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_waitall (void)*/
+/*
+ *	waits for all running C compilers to finish
+ *	returns 0 if they all succeeded, non-zero otherwise
+ */
+static int cccsp_cc_waitall (void)
+{
+	int rval = 0;
+
+	while (DA_CUR (cccsp_ccjobs)) {
+		if (cccsp_cc_reap (1)) {
 			rval = -1;
+		}
+	}
+	return rval;
+}
+/*}}}*/
+/*{{{  static size_t cccsp_cc_nextline (const char *buf, size_t size, size_t offs)*/
+/*
+ *	returns the offset of the line after the one at 'offs' in 'buf', 'size' if none
+ */
+static size_t cccsp_cc_nextline (const char *buf, size_t size, size_t offs)
+{
+	while ((offs < size) && (buf[offs] != '\n')) {
+		offs++;
+	}
+	return (offs < size) ? offs + 1 : size;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_isline (const char *buf, size_t size, size_t offs, const char *str)*/
+/*
+ *	tests whether the line at 'offs' in 'buf' is exactly 'str'
+ *	returns non-zero if so
+ */
+static int cccsp_cc_isline (const char *buf, size_t size, size_t offs, const char *str)
+{
+	int slen = strlen (str);
+
+	if ((offs + slen) > size) {
+		return 0;
+	}
+	return !strncmp (buf + offs, str, slen) && (((offs + slen) == size) || (buf[offs + slen] == '\n'));
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_signature (const char *buf, size_t offs, size_t next)*/
+/*
+ *	tests whether the line between 'offs' and 'next' looks like the start of a function definition
+ *	we generated: something at the left margin ending in a close-bracket, that isn't a declaration.
+ *	returns length of the signature if so, 0 otherwise
+ */
+static int cccsp_cc_signature (const char *buf, size_t offs, size_t next)
+{
+	int len = (int)(next - offs);
+
+	while ((len > 0) && ((buf[offs + len - 1] == '\n') || (buf[offs + len - 1] == '\r'))) {
+		len--;
+	}
+	if ((len < 4) || (buf[offs + len - 1] != ')')) {
+		return 0;
+	}
+	if (!(((buf[offs] >= 'a') && (buf[offs] <= 'z')) || ((buf[offs] >= 'A') && (buf[offs] <= 'Z')) || (buf[offs] == '_'))) {
+		return 0;
+	}
+	if (!strncmp (buf + offs, "extern ", 7) || !strncmp (buf + offs, "typedef ", 8)) {
+		return 0;
+	}
+	return len;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_datadecl (const char *buf, size_t size, size_t offs, size_t *endp)*/
+/*
+ *	tests whether the statement starting at 'offs' looks like a data definition at the top-level of the
+ *	generated C, e.g. "const int FOO = 42;".  types, externals and prototypes (anything bracketed before
+ *	an initialiser) are not.  sets '*endp' to the offset after the statement's last line.
+ *	returns length of the declarator (up to any initialiser) if so, 0 otherwise
+ */
+static int cccsp_cc_datadecl (const char *buf, size_t size, size_t offs, size_t *endp)
+{
+	static const char *notdata[] = {"typedef ", "extern ", "struct ", "union ", "enum ", NULL};
+	size_t end;
+	int len, i, instr;
+
+	if (!(((buf[offs] >= 'a') && (buf[offs] <= 'z')) || ((buf[offs] >= 'A') && (buf[offs] <= 'Z')) || (buf[offs] == '_'))) {
+		return 0;
+	}
+	for (i=0; notdata[i]; i++) {
+		if (!strncmp (buf + offs, notdata[i], strlen (notdata[i]))) {
+			return 0;
+		}
+	}
+	for (end = offs; (end < size) && (buf[end] != ';') && (buf[end] != '=') && (buf[end] != '(') && (buf[end] != '{'); end++);
+	if ((end == size) || (buf[end] == '(') || (buf[end] == '{')) {
+		return 0;
+	}
+	for (len = (int)(end - offs); (len > 0) && ((buf[offs + len - 1] == ' ') || (buf[offs + len - 1] == '\t')); len--);
+
+	/* the statement runs up to the first semicolon outside a string */
+	for (instr = 0; (end < size) && (instr || (buf[end] != ';')); end++) {
+		if (buf[end] == '\\') {
+			end++;
+		} else if (buf[end] == '"') {
+			instr = !instr;
+		}
+	}
+	end = cccsp_cc_nextline (buf, size, end);
+	*endp = end;
+	return len;
+}
+/*}}}*/
+/*{{{  static int cccsp_cc_splitunits (const char *ccodefile, const char *ubase, int maxunits)*/
+/*
+ *	splits generated C into a common header ('ubase'.uh.h) and up to 'maxunits' translation units ('ubase'.uN.c)
+ *	of whole function definitions, so that these can be compiled in parallel.  the header only declares
+ *	things: the verb-header, types and externals stay, data definitions become extern declarations and
+ *	prototypes for the functions follow.  functions are shared out between units by size and data is defined
+ *	in the first unit.  static inline helpers (from the verb-header) are shared out as ordinary functions:
+ *	a copy in every unit would be inlined far more eagerly than in the whole, costing more to compile than
+ *	splitting saves.  static data or plain static functions can't be shared out, so generated C that has
+ *	any isn't split.  each unit costs
+ *	a C compiler start-up and a pass over the header, so units get at least CCCSP_CC_MINUNIT bytes of functions.
+ *	returns number of units written, 0 if not worth splitting, < 0 on error
+ */
+static int cccsp_cc_splitunits (const char *ccodefile, const char *ubase, int maxunits)
+{
+	struct stat stbuf;
+	fhandle_t *fhan, *ufhan;
+	char *buf, *fname;
+	const char *hname;
+	size_t size, offs, prev;
+	size_t *usize = NULL;
+	size_t fcnbytes = 0;
+	DYNARRAY (cccsp_ccpart_t *, parts);
+	int nfcns = 0;
+	int nosplit = 0;
+	int depth = 0;
+	int nunits = 0;
+	int i, u;
+
+	if (fhandle_stat (ccodefile, &stbuf)) {
+		nocc_error ("cccsp_cc_splitunits(): failed to stat [%s]", ccodefile);
+		return -1;
+	}
+	size = (size_t)stbuf.st_size;
+	if (!size) {
+		return 0;
+	}
+	fhan = fhandle_open (ccodefile, O_RDONLY, 0);
+	if (!fhan) {
+		nocc_error ("cccsp_cc_splitunits(): failed to open [%s]", ccodefile);
+		return -1;
+	}
+	buf = (char *)fhandle_mapfile (fhan, 0, size);
+	if (!buf) {
+		nocc_error ("cccsp_cc_splitunits(): failed to map [%s]", ccodefile);
+		fhandle_close (fhan);
+		return -1;
+	}
+
+	/*{{{  find definitions: functions (signature and body braces at the left margin) and data*/
+	dynarray_init (parts);
+	for (offs = 0; (offs < size) && !nosplit;) {
+		size_t next = cccsp_cc_nextline (buf, size, offs);
+		size_t end;
+		int siglen, declen;
+
+		if (buf[offs] == '#') {
+			/* anything conditional stays in the header, as long as it only declares */
+			if (!strncmp (buf + offs, "#if", 3)) {
+				depth++;
+			} else if (!strncmp (buf + offs, "#endif", 6)) {
+				depth--;
+			}
+			offs = next;
+		} else if ((siglen = cccsp_cc_signature (buf, offs, next)) && cccsp_cc_isline (buf, size, next, "{")) {
+			int isstatic = !strncmp (buf + offs, "static ", 7);
+			int isinline = !strncmp (buf + offs, "static inline ", 14);
+			cccsp_ccpart_t *part;
+
+			end = cccsp_cc_nextline (buf, size, next);
+			while ((end < size) && !cccsp_cc_isline (buf, size, end, "}")) {
+				end = cccsp_cc_nextline (buf, size, end);
+			}
+			if (end == size) {
+				/* unterminated, leave the rest where it is */
+				break;
+			}
+			end = cccsp_cc_nextline (buf, size, end);
+			if (depth && isinline) {
+				offs = end;
+				continue;
+			} else if (depth || (isstatic && !isinline)) {
+				nosplit = 1;
+				break;
+			}
+
+			part = (cccsp_ccpart_t *)smalloc (sizeof (cccsp_ccpart_t));
+			part->isdata = 0;
+			part->start = offs;
+			part->end = end;
+			part->skip = isinline ? 14 : 0;
+			part->declen = siglen - part->skip;
+			part->unit = -1;
+			dynarray_add (parts, part);
+			nfcns++;
+			fcnbytes += (end - offs);
+
+			offs = end;
+		} else if ((declen = cccsp_cc_datadecl (buf, size, offs, &end))) {
+			cccsp_ccpart_t *part;
+
+			if (depth || !strncmp (buf + offs, "static ", 7)) {
+				nosplit = 1;
+				break;
+			}
+			part = (cccsp_ccpart_t *)smalloc (sizeof (cccsp_ccpart_t));
+			part->isdata = 1;
+			part->start = offs;
+			part->end = end;
+			part->skip = 0;
+			part->declen = declen;
+			part->unit = 0;
+			dynarray_add (parts, part);
+
+			offs = end;
+		} else {
+			offs = next;
+		}
+	}
+
+	/*}}}*/
+	if (!nosplit) {
+		nunits = (int)(fcnbytes / CCCSP_CC_MINUNIT);
+		if (nunits > maxunits) {
+			nunits = maxunits;
+		}
+		if (nunits > nfcns) {
+			nunits = nfcns;
+		}
+	}
+	if (nunits < 2) {
+		nunits = 0;
+		goto out_free;
+	}
+	/*{{{  share out functions, each to the smallest unit so far*/
+	usize = (size_t *)scalloc (nunits, sizeof (size_t));
+	for (i=0; i<DA_CUR (parts); i++) {
+		cccsp_ccpart_t *part = DA_NTHITEM (parts, i);
+		int best = 0;
+
+		if (part->isdata) {
+			continue;
+		}
+		for (u=1; u<nunits; u++) {
+			if (usize[u] < usize[best]) {
+				best = u;
+			}
+		}
+		part->unit = best;
+		usize[best] += (part->end - part->start);
+	}
+
+	/*}}}*/
+	/*{{{  write the common header*/
+	fname = string_fmt ("%s.uh.h", ubase);
+	ufhan = fhandle_fopen (fname, "w");
+	if (!ufhan) {
+		nocc_error ("cccsp_cc_splitunits(): failed to open [%s] for writing", fname);
+		sfree (fname);
+		nunits = -1;
+		goto out_free;
+	}
+	sfree (fname);
+
+	prev = 0;
+	for (i=0; i<DA_CUR (parts); i++) {
+		cccsp_ccpart_t *part = DA_NTHITEM (parts, i);
+
+		fhandle_write (ufhan, (unsigned char *)buf + prev, (int)(part->start - prev));
+		if (part->isdata) {
+			fhandle_printf (ufhan, "extern %.*s;\n", part->declen, buf + part->start);
+		}
+		prev = part->end;
+	}
+	fhandle_write (ufhan, (unsigned char *)buf + prev, (int)(size - prev));
+
+	fhandle_printf (ufhan, "\n/* functions split out from %s */\n", ccodefile);
+	for (i=0; i<DA_CUR (parts); i++) {
+		cccsp_ccpart_t *part = DA_NTHITEM (parts, i);
+
+		if (!part->isdata && strncmp (buf + part->start, "int main ", 9)) {
+			fhandle_printf (ufhan, "extern %.*s;\n", part->declen, buf + part->start + part->skip);
+		}
+	}
+	fhandle_close (ufhan);
+
+	/*}}}*/
+	/*{{{  write the units, data first*/
+	for (hname = ubase + strlen (ubase); (hname > ubase) && (hname[-1] != '/'); hname--);
+	for (u=0; u<nunits; u++) {
+		fname = string_fmt ("%s.u%d.c", ubase, u);
+		ufhan = fhandle_fopen (fname, "w");
+		if (!ufhan) {
+			nocc_error ("cccsp_cc_splitunits(): failed to open [%s] for writing", fname);
+			sfree (fname);
+			nunits = -1;
 			goto out_free;
 		}
-		/* else, assume all was good */
+		sfree (fname);
+
+		fhandle_printf (ufhan, "/* unit %d of %d split from %s */\n#include \"%s.uh.h\"\n\n", u, nunits, ccodefile, hname);
+		for (i=0; i<DA_CUR (parts); i++) {
+			cccsp_ccpart_t *part = DA_NTHITEM (parts, i);
+
+			if (part->isdata && (part->unit == u)) {
+				fhandle_write (ufhan, (unsigned char *)buf + part->start, (int)(part->end - part->start));
+			}
+		}
+		for (i=0; i<DA_CUR (parts); i++) {
+			cccsp_ccpart_t *part = DA_NTHITEM (parts, i);
+
+			if (!part->isdata && (part->unit == u)) {
+				fhandle_write (ufhan, (unsigned char *)buf + part->start + part->skip, (int)(part->end - part->start - part->skip));
+			}
+		}
+		fhandle_close (ufhan);
 	}
 
+	/*}}}*/
+
 out_free:
-	for (i=0; bits[i]; i++) {
-		if (bits[i]) {
-			sfree (bits[i]);
-			bits[i] = NULL;
+	for (i=0; i<DA_CUR (parts); i++) {
+		sfree (DA_NTHITEM (parts, i));
+	}
+	dynarray_trash (parts);
+	if (usize) {
+		sfree (usize);
+	}
+	fhandle_unmapfile (fhan, (unsigned char *)buf, 0, size);
+	fhandle_close (fhan);
+
+	return nunits;
+}
+/*}}}*/
+/*{{{  static void cccsp_cc_cleanunits (const char *ubase, int nunits, const char *sfifname)*/
+/*
+ *	removes the files left by compiling split units, gathering up their stack-usage into 'sfifname' first
+ *	(if non-NULL)
+ */
+static void cccsp_cc_cleanunits (const char *ubase, int nunits, const char *sfifname)
+{
+	fhandle_t *sfifhan = NULL;
+	char *fname;
+	int u;
+
+	if (sfifname) {
+		sfifhan = fhandle_fopen (sfifname, "w");
+		if (!sfifhan) {
+			nocc_error ("cccsp_cc_cleanunits(): failed to open [%s] for writing", sfifname);
 		}
 	}
-	sfree (bits);
 
-	return rval;
+	for (u=0; u<nunits; u++) {
+		fname = string_fmt ("%s.u%d.su", ubase, u);
+		if (sfifhan) {
+			fhandle_t *fhan = fhandle_fopen (fname, "r");
+
+			if (fhan) {
+				char rbuf[1024];
+				int n;
+
+				while ((n = fhandle_gets (fhan, rbuf, 1024)) > 0) {
+					fhandle_write (sfifhan, (unsigned char *)rbuf, n);
+				}
+				fhandle_close (fhan);
+			}
+		}
+		unlink (fname);
+		sfree (fname);
+
+		fname = string_fmt ("%s.u%d.o", ubase, u);
+		unlink (fname);
+		sfree (fname);
+		fname = string_fmt ("%s.u%d.c", ubase, u);
+		unlink (fname);
+		sfree (fname);
+	}
+	fname = string_fmt ("%s.uh.h", ubase);
+	unlink (fname);
+	sfree (fname);
+
+	if (sfifhan) {
+		fhandle_close (sfifhan);
+	}
+	return;
 }
 /*}}}*/
 /*{{{  static int cccsp_cc_compile_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t *target)*/
@@ -3184,16 +3809,25 @@ static int cccsp_cc_compile_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t
 	cccsp_priv_t *kpriv = (cccsp_priv_t *)target->priv;
 	char *ccodefile;
 	char *objfname, *sfifname, *ch;
-	char *ccmd, *eincl;
+	char *ccmd = NULL;
+	char *eincl = NULL;
 	char *langlib = NULL;
 	char *sfifiles = NULL;
 	char *sfimove = NULL;
+	char *ubase = NULL;
+	char *ccsrcs = NULL;
+	int nunits = 0;
+	int ccfail = 0;
+	int rval = -1;
+	int i;
+	DYNARRAY (char *, libsfis);
 
 	ccodefile = (char *)tnode_getchook (*treeptr, cccspoutfilehook);
 	if (!ccodefile) {
 		nocc_error ("cccsp_cc_compile_cpass(): did not find cccsp:outfile hook at top-level [%s]", (*treeptr)->tag->name);
 		return -1;
 	}
+	dynarray_init (libsfis);
 
 	/*{{{  sort out output file-name and .su file-name*/
 	for (ch = ccodefile + (strlen (ccodefile) - 1); (ch > ccodefile) && (ch[-1] != '.'); ch--);
@@ -3229,6 +3863,18 @@ static int cccsp_cc_compile_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t
 		}
 	}
 
+	/*}}}*/
+	/*{{{  see whether this compile can wait until after re-generation*/
+	if (cccsp_cc_deferred == 2) {
+		/* stack usage could not be estimated after all, so compiling now */
+		cccsp_cc_deferred = 0;
+	} else if (!cccsp_bepass && !cccsp_sfi_exact && (compopts.stoppoint != cccsp_cc_stopat)) {
+		/* stack usage can probably be estimated, only need library bits for now */
+		cccsp_cc_deferred = 1;
+	} else {
+		cccsp_cc_deferred = 0;
+	}
+
 	/*}}}*/
 	/*{{{  find out where verb-header.h lives*/
 	if (!DA_CUR (compopts.epath)) {
@@ -3236,7 +3882,6 @@ static int cccsp_cc_compile_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t
 	} else {
 		int i;
 
-		eincl = NULL;
 		for (i=0; !eincl && (i<DA_CUR (compopts.epath)); i++) {
 			/* look for where cccsp/verb-header.h lives */
 			char *tmpstr = string_fmt ("%s/cccsp/verb-header.h", DA_NTHITEM (compopts.epath, i));
@@ -3249,24 +3894,23 @@ static int cccsp_cc_compile_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t
 		}
 		if (!eincl) {
 			nocc_serious ("cccsp_cc_compile_cpass(): failed to find where cccsp/verb-header.h lives, giving up..");
-			return -1;
+			goto out_free;
 		}
 	}
 
 	/*}}}*/
-	/*{{{  find out where language libraries are*/
+	/*{{{  find out where language libraries are, starting to build any that are missing or old*/
 	/* Note: if we're building an executable, need to figure out where language-specific library parts might be */
 	if (!compopts.notmainmodule) {
-		int i;
 		char **langlibs_obj;
 		char **langlibs_src;
 
 		if (!srclf->parser) {
 			nocc_error ("cccsp_cc_compile_cpass(): did not find a parser structure for src [%s]", srclf->fnptr);
-			return -1;
+			goto out_free;
 		} else if (!srclf->parser->getlanglibs) {
 			nocc_error ("cccsp_cc_compile_cpass(): expected to find language libraries, but unsupported by parser");
-			return -1;
+			goto out_free;
 		}
 
 		langlibs_obj = srclf->parser->getlanglibs (target, 0);
@@ -3405,37 +4049,36 @@ fhandle_printf (FHAN_STDERR, "here: found_src=[%s] found_obj=[%s] found_sfi=[%s]
 				xcmd = string_fmt ("%s -fstack-usage %s -c %s %s %s -o %s %s", kpriv->cc_path,
 						cccsp_cc_opts ?: "", kpriv->cc_incpath, kpriv->cc_flags,
 						eincl, found_obj, found_src);
-				/* attempt to build object from source */
+				/* attempt to build object from source, alongside anything else */
 #if 0
 fhandle_printf (FHAN_STDERR, "here: want to build library object with [%s]\n", xcmd);
 #endif
-				if (cccsp_run_cc (xcmd)) {
-					nocc_error ("failed to compile [%s] to [%s]", found_src, found_obj);
-					return -1;
-				} else if (fhandle_access (found_obj, R_OK)) {
-					nocc_error ("failed to generate something when compiling [%s] to [%s]", found_src, found_obj);
-					return -1;
+				if (cccsp_cc_start (xcmd, found_src, found_obj)) {
+					cccsp_cc_waitall ();
+					sfree (xcmd);
+					sfree (found_src);
+					sfree (found_obj);
+					if (found_sfi) {
+						sfree (found_sfi);
+					}
+					goto out_free;
 				}
 
-				/* else, we should have compiled it okay! */
+				/* checked for when collected */
 				if (compopts.verbose) {
 					nocc_message ("cccsp generated library file %s", langlibs_obj[i]);
 				}
 				sfree (xcmd);
 			}
+			if (found_obj) {
+				/* linked in by the C compiler, so the build cache does not see it otherwise */
+				compcache_adddep (found_obj);
+			}
 
-			if (!fhandle_access (found_sfi, R_OK)) {
-#if 0
-fhandle_printf (FHAN_STDERR, "here: want to consume stack-info in [%s]\n", found_sfi);
-#endif
-				if (!sfifiles) {
-					sfifiles = string_dup (found_sfi);
-				} else {
-					char *tmpstr = string_fmt ("%s %s", sfifiles, found_sfi);
-
-					sfree (sfifiles);
-					sfifiles = tmpstr;
-				}
+			if (found_sfi) {
+				/* may still be being generated, so look for it later */
+				dynarray_add (libsfis, found_sfi);
+				found_sfi = NULL;
 			}
 
 			/* assert: here found_obj is sensible */
@@ -3466,31 +4109,112 @@ fhandle_printf (FHAN_STDERR, "here: want to consume stack-info in [%s]\n", found
 
 		if (!langlib) {
 			nocc_serious ("cccsp_cc_compile_cpass(): failed to find language libraries, giving up..");
-			return -1;
+			cccsp_cc_waitall ();
+			goto out_free;
 		}
 	}
 	/*}}}*/
+	/*{{{  if running parallel jobs, split the generated C up and compile the pieces alongside the libraries*/
+	if ((cccsp_cc_maxjobs () > 1) && !cccsp_cc_nosplit && !cccsp_cc_deferred) {
+		char *dh;
+
+		/* only a '.' in the last path component starts an extension */
+		for (dh = ccodefile + strlen (ccodefile); (dh > ccodefile) && (dh[-1] != '/'); dh--);
+		for (ch = ccodefile + (strlen (ccodefile) - 1); (ch > dh) && (ch[-1] != '.'); ch--);
+		ubase = (ch > dh) ? string_ndup (ccodefile, (int)(ch - ccodefile) - 1) : string_dup (ccodefile);
+
+		nunits = cccsp_cc_splitunits (ccodefile, ubase, 2 * cccsp_cc_maxjobs ());
+		if (nunits < 0) {
+			cccsp_cc_waitall ();
+			cccsp_cc_cleanunits (ubase, 2 * cccsp_cc_maxjobs (), NULL);
+			goto out_free;
+		}
+	}
+	for (i=0; (i<nunits) && !ccfail; i++) {
+		char *usrc = string_fmt ("%s.u%d.c", ubase, i);
+		char *uobj = string_fmt ("%s.u%d.o", ubase, i);
+		char *xcmd = string_fmt ("%s -fstack-usage %s -c %s %s %s -o %s %s", kpriv->cc_path,
+				cccsp_cc_opts ?: "", kpriv->cc_incpath, kpriv->cc_flags, eincl, uobj, usrc);
+
+		if (cccsp_cc_start (xcmd, usrc, uobj)) {
+			ccfail = 1;
+		}
+		sfree (xcmd);
+		sfree (usrc);
+		if (ccsrcs) {
+			char *tmpstr = string_fmt ("%s %s", ccsrcs, uobj);
+
+			sfree (ccsrcs);
+			sfree (uobj);
+			ccsrcs = tmpstr;
+		} else {
+			ccsrcs = uobj;
+		}
+	}
+	if (cccsp_cc_waitall () || ccfail) {
+		if (nunits) {
+			cccsp_cc_cleanunits (ubase, nunits, NULL);
+		}
+		goto out_free;
+	}
+	if (!ccsrcs) {
+		ccsrcs = string_dup (ccodefile);
+	}
+
+	for (i=0; i<DA_CUR (libsfis); i++) {
+		char *found_sfi = DA_NTHITEM (libsfis, i);
+
+		if (!fhandle_access (found_sfi, R_OK)) {
+#if 0
+fhandle_printf (FHAN_STDERR, "here: want to consume stack-info in [%s]\n", found_sfi);
+#endif
+			if (!sfifiles) {
+				sfifiles = string_dup (found_sfi);
+			} else {
+				char *tmpstr = string_fmt ("%s %s", sfifiles, found_sfi);
+
+				sfree (sfifiles);
+				sfifiles = tmpstr;
+			}
+		}
+		sfree (found_sfi);
+	}
+	dynarray_trash (libsfis);
+	/*}}}*/
+
+	if (cccsp_cc_deferred) {
+		/* just the libraries for now */
+		if (sfifiles) {
+			tnode_setchook (*treeptr, cccspsfifilehook, (void *)sfifiles);
+			sfifiles = NULL;
+		}
+		rval = 0;
+		goto out_free;
+	}
 
 #if 0
 fhandle_printf (FHAN_STDERR, "cccsp_cc_compile_cpass(): ccodefile=[%s] objfname=[%s]\n", ccodefile, objfname);
 #endif
 
-	if (compopts.notmainmodule) {
+	if (compopts.notmainmodule && nunits) {
+		/* combine split units into one object */
+		ccmd = string_fmt ("%s %s -r -nostdlib -o %s %s", kpriv->cc_path, cccsp_cc_opts ?: "", objfname, ccsrcs);
+	} else if (compopts.notmainmodule) {
 		/* compile to object */
 		ccmd = string_fmt ("%s -fstack-usage %s -c %s %s %s -o %s %s", kpriv->cc_path, cccsp_cc_opts ?: "",
-				kpriv->cc_incpath, kpriv->cc_flags, eincl, objfname, ccodefile);
+				kpriv->cc_incpath, kpriv->cc_flags, eincl, objfname, ccsrcs);
 	} else {
 		/* build executable */
 		switch (cccsp_subtarget) {
 		case CCCSP_SUBTARGET_DEFAULT:
 			ccmd = string_fmt ("%s -fstack-usage %s %s %s %s -o %s %s %s %s -lccsp %s", kpriv->cc_path,
 					cccsp_cc_opts ?: "", kpriv->cc_incpath, kpriv->cc_flags, eincl,
-					objfname, ccodefile, kpriv->cc_libpath, kpriv->cc_ldflags, langlib);
+					objfname, ccsrcs, kpriv->cc_libpath, kpriv->cc_ldflags, langlib);
 			break;
 		case CCCSP_SUBTARGET_EV3:
 			ccmd = string_fmt ("%s -fstack-usage %s %s %s %s -o %s %s %s %s %s", kpriv->cc_path,
 					cccsp_cc_opts ?: "", kpriv->cc_incpath, kpriv->cc_flags, eincl,
-					objfname, ccodefile, kpriv->cc_libpath, kpriv->cc_ldflags, langlib);
+					objfname, ccsrcs, kpriv->cc_libpath, kpriv->cc_ldflags, langlib);
 			break;
 		}
 	}
@@ -3503,7 +4227,15 @@ fhandle_printf (FHAN_STDERR, "cccsp_cc_compile_cpass(): ccodefile=[%s] objfname=
 	/* do it! */
 	if (cccsp_run_cc (ccmd)) {
 		nocc_error ("failed to compile object/executable [%s]", objfname);
-		return -1;
+		if (nunits) {
+			cccsp_cc_cleanunits (ubase, nunits, NULL);
+		}
+		goto out_free;
+	}
+	compcache_addoutput (objfname);
+	if (nunits) {
+		/* stack usage came from the units, not this */
+		cccsp_cc_cleanunits (ubase, nunits, sfifname);
 	}
 
 	if (sfimove && !fhandle_access (sfimove, R_OK)) {
@@ -3516,6 +4248,7 @@ fhandle_printf (FHAN_STDERR, "cccsp_cc_compile_cpass(): ccodefile=[%s] objfname=
 	}
 	if (!fhandle_access (sfifname, R_OK)) {
 		/* got the stack-usage file too, so add to list */
+		compcache_addoutput (sfifname);
 		if (sfifiles) {
 			char *tmpstr = string_fmt ("%s %s", sfifiles, sfifname);
 
@@ -3534,17 +4267,38 @@ fhandle_printf (FHAN_STDERR, "cccsp_cc_compile_cpass(): sfifiles=[%s]\n", sfifil
 		tnode_setchook (*treeptr, cccspsfifilehook, (void*)sfifiles);
 		sfifiles = NULL;
 	}
+	rval = 0;
+
+out_free:
+	for (i=0; i<DA_CUR (libsfis); i++) {
+		sfree (DA_NTHITEM (libsfis, i));
+	}
+	dynarray_trash (libsfis);
+	if (sfifiles) {
+		sfree (sfifiles);
+	}
 	if (langlib) {
 		sfree (langlib);
 	}
-	if (sfifname) {
-		sfree (sfifname);
+	if (sfimove) {
+		sfree (sfimove);
+	}
+	if (ubase) {
+		sfree (ubase);
+	}
+	if (ccsrcs) {
+		sfree (ccsrcs);
+	}
+	if (ccmd) {
+		sfree (ccmd);
+	}
+	if (eincl) {
+		sfree (eincl);
 	}
+	sfree (sfifname);
 	sfree (objfname);
-	sfree (eincl);
-	sfree (ccmd);
 
-	return 0;
+	return rval;
 }
 /*}}}*/
 /*{{{  static int cccsp_cc_sfi_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t *target)*/
@@ -3554,12 +4308,13 @@ fhandle_printf (FHAN_STDERR, "cccsp_cc_compile_cpass(): sfifiles=[%s]\n", sfifil
  */
 static int cccsp_cc_sfi_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t *target)
 {
-	int i;
+	int i, calib;
 	char *apif = NULL;
 	char *sfifiles = (char *)tnode_getchook (*treeptr, cccspsfifilehook);
 	cccsp_dcg_t *dcg;
 
 	cccsp_sfi_init ();
+	cccsp_sfi_estimated = 0;
 
 	/*{{{  find where the api-call-chain file lives and load it*/
 	for (i=0; !apif && (i<DA_CUR (compopts.epath)); i++) {
@@ -3608,6 +4363,53 @@ static int cccsp_cc_sfi_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t *ta
 		sfree (bits);
 	}
 
+	/*}}}*/
+	/*{{{  if the first C compile was put off, estimate stack usage, or compile now if that won't do*/
+	calib = 1;
+	if (cccsp_sfi_calib) {
+		calib = cccsp_sfi_loadcalib (cccsp_sfi_calib);
+		if (calib < 0) {
+			return -1;
+		}
+	}
+	if (cccsp_cc_deferred) {
+		if (cccsp_sfi_canestimate () && (!cccsp_sfi_calib || !calib)) {
+			if (compopts.verbose) {
+				nocc_message ("using estimated stack usage, compiling C once");
+			}
+			cccsp_sfi_useestimates (cccsp_cc_wordsize ());
+			cccsp_sfi_estimated = 1;
+		} else {
+			if (compopts.verbose) {
+				nocc_message ("cannot estimate stack usage%s, compiling C twice", cccsp_sfi_calib ? " (or no calibration yet)" : "");
+			}
+			if (sfifiles) {
+				/* frees it */
+				tnode_setchook (*treeptr, cccspsfifilehook, NULL);
+			}
+			cccsp_cc_deferred = 2;
+			if (cccsp_cc_compile_cpass (treeptr, srclf, target)) {
+				return -1;
+			}
+
+			sfifiles = (char *)tnode_getchook (*treeptr, cccspsfifilehook);
+			if (sfifiles) {
+				char **bits = split_string (sfifiles, 1);
+				int j;
+
+				for (j=0; bits[j]; j++) {
+					cccsp_sfi_loadusage (bits[j]);
+					sfree (bits[j]);
+				}
+				sfree (bits);
+			}
+		}
+	}
+	if (!cccsp_cc_deferred && cccsp_sfi_calib) {
+		/* have gcc's figures, so learn from them */
+		cccsp_sfi_savecalib (cccsp_sfi_calib, cccsp_cc_wordsize ());
+	}
+
 	/*}}}*/
 	/*{{{  calculate required allocations*/
 	if (cccsp_sfi_calc_alloc ()) {
@@ -3670,6 +4472,61 @@ static int cccsp_recodegen_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t
 	return r;
 }
 /*}}}*/
+/*{{{  static int cccsp_cc_checkestimates (tnode_t **treeptr, lexfile_t *srclf, target_t *target)*/
+/*
+ *	after compiling with estimated stack usage, checks gcc's figures against the estimates.  if any
+ *	function needs more than was allowed for, does allocation again from gcc's figures, then re-generates
+ *	and re-compiles (what the two-pass build would have done).
+ *	returns 0 on success, non-zero on failure
+ */
+static int cccsp_cc_checkestimates (tnode_t **treeptr, lexfile_t *srclf, target_t *target)
+{
+	char *sfifiles = (char *)tnode_getchook (*treeptr, cccspsfifilehook);
+	char **bits;
+	int j, nshort;
+
+	if (!sfifiles) {
+		nocc_warning ("no stack usage from the C compiler, cannot check estimates");
+		return 0;
+	}
+	cccsp_sfi_startcheck ();
+	bits = split_string (sfifiles, 1);
+	for (j=0; bits[j]; j++) {
+		cccsp_sfi_loadusage (bits[j]);
+		sfree (bits[j]);
+	}
+	sfree (bits);
+	nshort = cccsp_sfi_endcheck ();
+
+	if (cccsp_sfi_calib) {
+		/* have gcc's figures now, so learn from them */
+		cccsp_sfi_savecalib (cccsp_sfi_calib, cccsp_cc_wordsize ());
+	}
+	if (!nshort) {
+		return 0;
+	}
+
+	if (compopts.verbose) {
+		nocc_message ("estimated stack usage short for %d function%s, compiling C again", nshort, (nshort == 1) ? "" : "s");
+	}
+	tnode_setchook (*treeptr, cccspsfifilehook, NULL);		/* frees it */
+
+	if (cccsp_sfi_calc_alloc ()) {
+		nocc_error ("failed to calculate allocations, giving up..");
+		cccsp_sfi_dumptable (FHAN_STDERR);
+		return -1;
+	}
+	tnode_prewalktree (*treeptr, cccsp_prewalktree_cccspdcgfix, NULL);
+	if (cccsp_sfi_geterror ()) {
+		return -1;
+	}
+
+	if (cccsp_reallocate_cpass (treeptr, srclf, target) || cccsp_recodegen_cpass (treeptr, srclf, target)) {
+		return -1;
+	}
+	return cccsp_cc_compile_cpass (treeptr, srclf, target);
+}
+/*}}}*/
 /*{{{  static int cccsp_cc_recompile_cpass (tnode_t **treeptr, lexfile_t *srclf, target_t *target)*/
 /*
  *	does the re-compile pass -- re-compiles code
@@ -3680,6 +4537,10 @@ static int cccsp_cc_recompile_cpass (tnode_t **treeptr, lexfile_t *srclf, target
 	int r;
 
 	r = cccsp_cc_compile_cpass (treeptr, srclf, target);
+	if (!r && cccsp_sfi_estimated) {
+		cccsp_sfi_estimated = 0;
+		r = cccsp_cc_checkestimates (treeptr, srclf, target);
+	}
 
 	if (cccsp_show_sfi) {
 		/* this will be the version used *to* compile the above, not what results from it */
@@ -3933,6 +4794,7 @@ for (vi=0; vi<DA_CUR (compopts.cccsp_kroc); vi++) {
 
 		stopat = nocc_laststopat() + 1;
 		opts_add ("stop-cc-compile", '\0', cccsp_opthandler_stopat, (void *)stopat, "1stop after CC compile pass");
+		cccsp_cc_stopat = stopat;
 		if (nocc_addcompilerpass ("cc-compile", INTERNAL_ORIGIN, "codegen", 0, (int (*)(void *))cccsp_cc_compile_cpass,
 				CPASS_TREEPTR | CPASS_LEXFILE | CPASS_TARGET, stopat, NULL)) {
 			nocc_serious ("cccsp_target_init(): failed to add \"cc-compile\" compiler pass");
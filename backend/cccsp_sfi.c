@@ -59,12 +59,31 @@
 #include "cccsp.h"
 #include "parsepriv.h"
 
+/*}}}*/
+/*{{{  private types*/
+
+typedef struct TAG_cccsp_sfi_calibsave {
+	fhandle_t *fhan;			/* where it's going */
+	int wordsize;				/* for working out estimates */
+} cccsp_sfi_calibsave_t;
+
+typedef struct TAG_cccsp_sfi_scc {
+	int index;				/* next visit index */
+	DYNARRAY (cccsp_sfi_entry_t *, visiting);	/* depth-first path */
+	DYNARRAY (cccsp_sfi_entry_t *, stack);	/* entries not yet assigned to a component */
+	int err;				/* number of recursion cycles found */
+} cccsp_sfi_scc_t;
+
 /*}}}*/
 /*{{{  private data*/
 
 static cccsp_sfi_t *sfitable = NULL;
 static int sfierror = 0;
 
+/* stack-usage estimates, in words, on top of the locals counted */
+#define SFI_EST_BASEWORDS (16)			/* return address, frame pointer, callee-saved registers, spilled parameters */
+#define SFI_EST_CALLWORDS (4)			/* for each distinct callee: stacked arguments, temporaries around the call */
+
 /*}}}*/
 /*{{{  global data*/
 
@@ -84,6 +103,14 @@ static cccsp_sfi_entry_t *cccsp_sfi_newentry (void)
 	dynarray_init (sfient->children);
 	sfient->framesize = 0;
 	sfient->allocsize = 0;
+	sfient->estlocals = -1;
+	sfient->calest = -1;
+	sfient->calsize = -1;
+	sfient->estframe = -1;
+	sfient->usedsize = 0;
+	sfient->sccindex = -1;
+	sfient->scclow = -1;
+	sfient->sccnext = 0;
 
 	sfient->parfixup = 0;
 
@@ -136,46 +163,119 @@ static void cccsp_sfi_dumptable_walk (cccsp_sfi_entry_t *sfient, char *name, fha
 static void cccsp_sfi_clearalloc_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)
 {
 	sfient->allocsize = -1;
+	sfient->sccindex = -1;
+	sfient->scclow = -1;
+	sfient->sccnext = 0;
 	return;
 }
 /*}}}*/
-/*{{{  static void cccsp_sfi_calcalloc_entry (cccsp_sfi_entry_t *sfient)*/
+/*{{{  static void cccsp_sfi_calcalloc_component (cccsp_sfi_scc_t *scc, cccsp_sfi_entry_t *root)*/
 /*
- *	recursively works out the allocation size for a single entry
+ *	takes the strongly connected component rooted at 'root' off the stack and sets allocation sizes for it.
+ *	everything called from outside the component has been done already (components complete callees first).
+ *	a component of more than one entry, or one that calls itself, is recursion: reported, and given
+ *	the sum of its framesizes so that the rest can carry on.
  */
-static void cccsp_sfi_calcalloc_entry (cccsp_sfi_entry_t *sfient)
+static void cccsp_sfi_calcalloc_component (cccsp_sfi_scc_t *scc, cccsp_sfi_entry_t *root)
 {
-	int i;
+	int first, i, j;
 	int submax = 0;
+	int framesum = 0;
+	int recursive = 0;
 
-	if (sfient->allocsize >= 0) {
-		return;			/* done already */
-	}
-	if (sfient->allocsize == -2) {
-		nocc_internal ("cccsp_sfi_calcalloc_entry(): stuck in a loop..\n");
-		return;
+	for (first = DA_CUR (scc->stack) - 1; DA_NTHITEM (scc->stack, first) != root; first--);
+
+	for (i=first; i<DA_CUR (scc->stack); i++) {
+		cccsp_sfi_entry_t *sfient = DA_NTHITEM (scc->stack, i);
+
+		framesum += sfient->framesize;
+		for (j=0; j<DA_CUR (sfient->children); j++) {
+			cccsp_sfi_entry_t *child = DA_NTHITEM (sfient->children, j);
+
+			if (child->allocsize == -2) {
+				/* in this component */
+				recursive = 1;
+			} else if (child->allocsize > submax) {
+				submax = child->allocsize;
+			}
+		}
 	}
-	sfient->allocsize = -2;		/* make note that we're doing it now */
 
-	for (i=0; i<DA_CUR (sfient->children); i++) {
-		cccsp_sfi_entry_t *child = DA_NTHITEM (sfient->children, i);
+	if (recursive) {
+		char *path = string_dup (root->name);
+
+		for (i=DA_CUR (scc->stack) - 1; i>first; i--) {
+			char *tmpstr = string_fmt ("%s, %s", path, DA_NTHITEM (scc->stack, i)->name);
 
-		cccsp_sfi_calcalloc_entry (child);
-		if (child->allocsize > submax) {
-			submax = child->allocsize;
+			sfree (path);
+			path = tmpstr;
 		}
+		nocc_error ("recursion in call graph, cannot bound stack usage of: %s", path);
+		sfree (path);
+		scc->err++;
 	}
-	sfient->allocsize = sfient->framesize + submax;
+
+	while (DA_CUR (scc->stack) > first) {
+		cccsp_sfi_entry_t *sfient = DA_NTHITEM (scc->stack, DA_CUR (scc->stack) - 1);
+
+		sfient->allocsize = (recursive ? framesum : sfient->framesize) + submax;
+		dynarray_delitem (scc->stack, DA_CUR (scc->stack) - 1);
+	}
+
 	return;
 }
 /*}}}*/
-/*{{{  static void cccsp_sfi_calcalloc_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)*/
+/*{{{  static void cccsp_sfi_calcalloc_walk (cccsp_sfi_entry_t *sfient, char *name, cccsp_sfi_scc_t *scc)*/
 /*
- *	calculates the allocation size for a particular entry
+ *	works out allocation sizes for everything reachable from an entry not yet done: depth-first search
+ *	for strongly connected components (Tarjan), iterative so that deep call chains are fine.
+ *	while an entry is on the component stack, its allocsize is -2.
  */
-static void cccsp_sfi_calcalloc_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)
+static void cccsp_sfi_calcalloc_walk (cccsp_sfi_entry_t *sfient, char *name, cccsp_sfi_scc_t *scc)
 {
-	cccsp_sfi_calcalloc_entry (sfient);
+	if (sfient->sccindex >= 0) {
+		return;			/* done already */
+	}
+
+	sfient->sccindex = sfient->scclow = scc->index++;
+	sfient->sccnext = 0;
+	sfient->allocsize = -2;
+	dynarray_add (scc->visiting, sfient);
+	dynarray_add (scc->stack, sfient);
+
+	while (DA_CUR (scc->visiting)) {
+		cccsp_sfi_entry_t *ent = DA_NTHITEM (scc->visiting, DA_CUR (scc->visiting) - 1);
+
+		if (ent->sccnext < DA_CUR (ent->children)) {
+			cccsp_sfi_entry_t *child = DA_NTHITEM (ent->children, ent->sccnext);
+
+			ent->sccnext++;
+			if (child->sccindex < 0) {
+				/* not seen yet, descend */
+				child->sccindex = child->scclow = scc->index++;
+				child->sccnext = 0;
+				child->allocsize = -2;
+				dynarray_add (scc->visiting, child);
+				dynarray_add (scc->stack, child);
+			} else if ((child->allocsize == -2) && (child->sccindex < ent->scclow)) {
+				/* on the stack, so in the same component */
+				ent->scclow = child->sccindex;
+			}
+		} else {
+			/* all children visited */
+			dynarray_delitem (scc->visiting, DA_CUR (scc->visiting) - 1);
+			if (DA_CUR (scc->visiting)) {
+				cccsp_sfi_entry_t *parent = DA_NTHITEM (scc->visiting, DA_CUR (scc->visiting) - 1);
+
+				if (ent->scclow < parent->scclow) {
+					parent->scclow = ent->scclow;
+				}
+			}
+			if (ent->scclow == ent->sccindex) {
+				cccsp_sfi_calcalloc_component (scc, ent);
+			}
+		}
+	}
 	return;
 }
 /*}}}*/
@@ -190,6 +290,136 @@ static void cccsp_sfi_checkalloc_walk (cccsp_sfi_entry_t *sfient, char *name, in
 	}
 }
 /*}}}*/
+/*{{{  static int cccsp_sfi_estimate_entry (cccsp_sfi_entry_t *sfient, int wordsize)*/
+/*
+ *	works out a conservative framesize for one of our functions from what was counted during
+ *	direct-call-graph generation (uncalibrated)
+ *	returns estimate in bytes, < 0 if there is none
+ */
+static int cccsp_sfi_estimate_entry (cccsp_sfi_entry_t *sfient, int wordsize)
+{
+	int est;
+
+	if (sfient->estlocals < 0) {
+		return -1;
+	}
+	est = sfient->estlocals + ((SFI_EST_BASEWORDS + (SFI_EST_CALLWORDS * DA_CUR (sfient->children))) * wordsize);
+
+	/* frames are kept aligned to two words */
+	est = (est + ((2 * wordsize) - 1)) & ~((2 * wordsize) - 1);
+
+	return est;
+}
+/*}}}*/
+/*{{{  static void cccsp_sfi_canestimate_walk (cccsp_sfi_entry_t *sfient, char *name, int *err)*/
+/*
+ *	checks that an entry can be estimated if it needs to be
+ */
+static void cccsp_sfi_canestimate_walk (cccsp_sfi_entry_t *sfient, char *name, int *err)
+{
+	if (sfient->estlocals == -2) {
+		*err = 1;
+	}
+}
+/*}}}*/
+/*{{{  static void cccsp_sfi_useestimates_walk (cccsp_sfi_entry_t *sfient, char *name, int *wordsize)*/
+/*
+ *	sets the framesize of one of our functions from its estimate, calibrated.  the same estimate
+ *	does not mean the same code, so the margin is always added.
+ */
+static void cccsp_sfi_useestimates_walk (cccsp_sfi_entry_t *sfient, char *name, int *wordsize)
+{
+	int est = cccsp_sfi_estimate_entry (sfient, *wordsize);
+
+	if (est < 0) {
+		return;
+	}
+	sfient->framesize = est + sfitable->calmargin;
+	sfient->estframe = sfient->framesize;
+}
+/*}}}*/
+/*{{{  static void cccsp_sfi_startcheck_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)*/
+/*
+ *	remembers the framesize an estimated entry was compiled with, and clears it for gcc's
+ */
+static void cccsp_sfi_startcheck_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)
+{
+	if (sfient->estframe < 0) {
+		return;
+	}
+	sfient->usedsize = sfient->framesize;
+	sfient->framesize = 0;
+}
+/*}}}*/
+/*{{{  static void cccsp_sfi_endcheck_walk (cccsp_sfi_entry_t *sfient, char *name, int *nshort)*/
+/*
+ *	compares gcc's framesize for an estimated entry with what it was compiled with.  reallocation
+ *	added PAR space to the latter, and that is in gcc's figure too, so it is taken off both to get
+ *	something comparable with the estimate (for calibration, and for allocating again).
+ */
+static void cccsp_sfi_endcheck_walk (cccsp_sfi_entry_t *sfient, char *name, int *nshort)
+{
+	int actual;
+
+	if (sfient->estframe < 0) {
+		return;
+	}
+	if (sfient->framesize <= 0) {
+		/* no figure from gcc (dropped or inlined), so nothing learned */
+		sfient->framesize = sfient->usedsize;
+		sfient->usedsize = -1;
+		return;
+	}
+
+	actual = sfient->framesize - (sfient->usedsize - sfient->estframe);
+	if (actual < 0) {
+		actual = 0;
+	}
+	sfient->calest = sfient->estframe - sfitable->calmargin;
+	sfient->calsize = actual;
+
+	if (sfient->framesize > sfient->usedsize) {
+		(*nshort)++;
+	}
+	/* reset to the estimate for now; cccsp_sfi_endcheck() swaps in gcc's figures if some were short */
+	sfient->framesize = sfient->usedsize;
+}
+/*}}}*/
+/*{{{  static void cccsp_sfi_useactual_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)*/
+/*
+ *	sets the framesize of an estimated entry from gcc's figure, ready for allocating again
+ */
+static void cccsp_sfi_useactual_walk (cccsp_sfi_entry_t *sfient, char *name, void *arg)
+{
+	if (sfient->estframe < 0) {
+		return;
+	}
+	if (sfient->usedsize < 0) {
+		/* nothing from gcc, keep the estimate */
+		sfient->framesize = sfient->estframe;
+	} else {
+		sfient->framesize = sfient->calsize;
+	}
+	sfient->estframe = -1;
+}
+/*}}}*/
+/*{{{  static void cccsp_sfi_savecalib_walk (cccsp_sfi_entry_t *sfient, char *name, cccsp_sfi_calibsave_t *csave)*/
+/*
+ *	writes out the calibration line for an entry, if it has one
+ */
+static void cccsp_sfi_savecalib_walk (cccsp_sfi_entry_t *sfient, char *name, cccsp_sfi_calibsave_t *csave)
+{
+	int est = cccsp_sfi_estimate_entry (sfient, csave->wordsize);
+
+	if ((est >= 0) && (sfient->estframe < 0) && (sfient->framesize > 0)) {
+		/* estimated and measured this time */
+		fhandle_printf (csave->fhan, "%s\t%d\t%d\n", sfient->name, est, sfient->framesize);
+	} else if (sfient->calest >= 0) {
+		/* keep what we had before */
+		fhandle_printf (csave->fhan, "%s\t%d\t%d\n", sfient->name, sfient->calest, sfient->calsize);
+	}
+}
+/*}}}*/
 /*{{{  static void cccsp_sfi_entrychook_dumptree (tnode_t *node, void *hook, int indent, fhandle_t *stream)*/
 /*
  *	dump-tree for a cccsp:sfi:entry compiler hook
@@ -214,6 +444,8 @@ int cccsp_sfi_init (void)
 {
 	sfitable = (cccsp_sfi_t *)smalloc (sizeof (cccsp_sfi_t));
 	stringhash_init (sfitable->entries, SFIENTRIES_BITSIZE);
+	sfitable->calcount = 0;
+	sfitable->calmargin = 0;
 
 	cccsp_sfi_entrychook = tnode_lookupornewchook ("cccsp:sfi:entry");
 	cccsp_sfi_entrychook->chook_dumptree = cccsp_sfi_entrychook_dumptree;
@@ -491,6 +723,7 @@ out_cleanup:
  */
 int cccsp_sfi_calc_alloc (void)
 {
+	cccsp_sfi_scc_t scc;
 	int err = 0;
 
 	if (!sfitable) {
@@ -498,10 +731,165 @@ int cccsp_sfi_calc_alloc (void)
 		return -1;
 	}
 	stringhash_walk (sfitable->entries, cccsp_sfi_clearalloc_walk, NULL);
-	stringhash_walk (sfitable->entries, cccsp_sfi_calcalloc_walk, NULL);
+
+	scc.index = 0;
+	dynarray_init (scc.visiting);
+	dynarray_init (scc.stack);
+	scc.err = 0;
+	stringhash_walk (sfitable->entries, cccsp_sfi_calcalloc_walk, &scc);
+	dynarray_trash (scc.visiting);
+	dynarray_trash (scc.stack);
+
 	stringhash_walk (sfitable->entries, cccsp_sfi_checkalloc_walk, &err);
 
-	return err;
+	return (err || scc.err);
+}
+/*}}}*/
+/*{{{  int cccsp_sfi_canestimate (void)*/
+/*
+ *	determines whether the framesizes of our functions can be estimated, rather than needing gcc's
+ *	returns non-zero if so
+ */
+int cccsp_sfi_canestimate (void)
+{
+	int err = 0;
+
+	if (!sfitable) {
+		return 0;
+	}
+	stringhash_walk (sfitable->entries, cccsp_sfi_canestimate_walk, &err);
+
+	return !err;
+}
+/*}}}*/
+/*{{{  void cccsp_sfi_useestimates (int wordsize)*/
+/*
+ *	sets framesizes for our functions from estimates, in place of stack-usage from gcc.
+ *	'wordsize' is that of the C compiler's target.
+ */
+void cccsp_sfi_useestimates (int wordsize)
+{
+	if (!sfitable) {
+		nocc_error ("cccsp_sfi_useestimates(): no table!");
+		return;
+	}
+	stringhash_walk (sfitable->entries, cccsp_sfi_useestimates_walk, &wordsize);
+}
+/*}}}*/
+/*{{{  void cccsp_sfi_startcheck (void)*/
+/*
+ *	called after compiling with estimated framesizes, before loading gcc's stack-usage for that
+ *	compile with cccsp_sfi_loadusage()
+ */
+void cccsp_sfi_startcheck (void)
+{
+	if (!sfitable) {
+		nocc_error ("cccsp_sfi_startcheck(): no table!");
+		return;
+	}
+	stringhash_walk (sfitable->entries, cccsp_sfi_startcheck_walk, NULL);
+}
+/*}}}*/
+/*{{{  int cccsp_sfi_endcheck (void)*/
+/*
+ *	called after loading gcc's stack-usage for a compile with estimated framesizes: records what
+ *	was found for calibration, and if any estimate was short, sets framesizes from gcc's figures
+ *	(as the first C compile would have) so that allocation can be done again.
+ *	returns the number of functions whose frames were bigger than allowed for
+ */
+int cccsp_sfi_endcheck (void)
+{
+	int nshort = 0;
+
+	if (!sfitable) {
+		nocc_error ("cccsp_sfi_endcheck(): no table!");
+		return 0;
+	}
+	stringhash_walk (sfitable->entries, cccsp_sfi_endcheck_walk, &nshort);
+	if (nshort) {
+		stringhash_walk (sfitable->entries, cccsp_sfi_useactual_walk, NULL);
+	}
+
+	return nshort;
+}
+/*}}}*/
+/*{{{  int cccsp_sfi_loadcalib (const char *fname)*/
+/*
+ *	loads a calibration table of estimated against actual framesizes, as saved by cccsp_sfi_savecalib()
+ *	returns 0 on success, > 0 if there is nothing to load (yet), < 0 on error
+ */
+int cccsp_sfi_loadcalib (const char *fname)
+{
+	fhandle_t *fhan;
+	char rbuf[1024];
+	int lineno = 0;
+
+	if (!sfitable) {
+		nocc_error ("cccsp_sfi_loadcalib(): no table!");
+		return -1;
+	}
+	if (fhandle_access (fname, R_OK)) {
+		return 1;
+	}
+	fhan = fhandle_fopen (fname, "r");
+	if (!fhan) {
+		nocc_error ("cccsp_sfi_loadcalib(): failed to open [%s]", fname);
+		return -1;
+	}
+
+	while (fhandle_gets (fhan, rbuf, 1024) > 0) {
+		char name[512];
+		int est, actual;
+		cccsp_sfi_entry_t *sfient;
+
+		lineno++;
+		if ((rbuf[0] == '#') || (rbuf[0] == '\n')) {
+			continue;
+		}
+		if ((sscanf (rbuf, "%511s %d %d", name, &est, &actual) != 3) || (est < 0) || (actual < 0)) {
+			nocc_warning ("cccsp_sfi_loadcalib(): ignoring damaged line %d in [%s]", lineno, fname);
+			continue;
+		}
+
+		sfient = cccsp_sfi_lookupornew (name);
+		sfient->calest = est;
+		sfient->calsize = actual;
+		if ((actual - est) > sfitable->calmargin) {
+			sfitable->calmargin = actual - est;
+		}
+		sfitable->calcount++;
+	}
+
+	fhandle_close (fhan);
+	return sfitable->calcount ? 0 : 1;
+}
+/*}}}*/
+/*{{{  int cccsp_sfi_savecalib (const char *fname, int wordsize)*/
+/*
+ *	saves a calibration table, pairing estimates for our functions with the framesizes gcc reported
+ *	this time, and keeping entries for anything else that was loaded.
+ *	returns 0 on success, non-zero on error
+ */
+int cccsp_sfi_savecalib (const char *fname, int wordsize)
+{
+	cccsp_sfi_calibsave_t csave;
+
+	if (!sfitable) {
+		nocc_error ("cccsp_sfi_savecalib(): no table!");
+		return -1;
+	}
+	csave.fhan = fhandle_fopen (fname, "w");
+	if (!csave.fhan) {
+		nocc_error ("cccsp_sfi_savecalib(): failed to open [%s] for writing", fname);
+		return -1;
+	}
+	csave.wordsize = wordsize;
+
+	fhandle_printf (csave.fhan, "# stack-usage calibration for the CCCSP back-end: function, estimate, actual (bytes)\n");
+	stringhash_walk (sfitable->entries, cccsp_sfi_savecalib_walk, &csave);
+
+	fhandle_close (csave.fhan);
+	return 0;
 }
 /*}}}*/
 /*{{{  void cccsp_sfi_dumptable (fhandle_t *stream)*/
@@ -463,7 +463,7 @@ static int kroccifccsp_prewalktree_codegen (tnode_t *node, void *data)
 	/*}}}*/
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_LCODEGEN)) {
-		i = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_LCODEGEN, 2, node, cgen);
+		i = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_LCODEGEN, node, cgen);
 	}
 
 	/*{{{  if finalisers, do subnodes then finalisers*/
@@ -500,7 +500,7 @@ static int kroccifccsp_modprewalktree_namemap (tnode_t **nodep, void *data)
 	int i = 1;
 
 	if ((*nodep)->tag->ndef->ops && tnode_hascompop_i ((*nodep)->tag->ndef->ops, (int)COPS_LNAMEMAP)) {
-		i = tnode_callcompop_i ((*nodep)->tag->ndef->ops, (int)COPS_LNAMEMAP, 2, nodep, map);
+		i = tnode_callcompop_i2 ((*nodep)->tag->ndef->ops, (int)COPS_LNAMEMAP, nodep, map);
 	}
 
 	return i;
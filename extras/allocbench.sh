@@ -0,0 +1,36 @@
+#! /bin/bash
+#
+#	allocbench.sh -- wall time to compile each source separately with the slab allocator and with the
+#	system allocator (NOCC_SYSALLOC), then the pool usage for the last source
+#	usage: allocbench.sh [-n runs] <nocc> [nocc-options...] -- <sources...>
+#	with no sources, uses the guppy files in the current directory (e.g. run from tests/).
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] <nocc> [nocc-options...] -- <sources...>"
+RUNS=3
+BENCH_SOURCES=1
+bench_args "$@"
+
+# compiles every source separately; any that fail still count, it is the allocation being timed
+allsources () {
+	local f
+
+	for f in $SOURCES; do
+		$NOCC "${OPTS[@]}" $f
+	done
+	return 0
+}
+
+unset NOCC_SYSALLOC
+slab=$(bench_best bench_wallms allsources)
+export NOCC_SYSALLOC=1
+sys=$(bench_best bench_wallms allsources)
+unset NOCC_SYSALLOC
+
+echo "$(echo $SOURCES | wc -w) source file(s), compiled one at a time, best of $RUNS:"
+printf "%-8s | %12s\n" "alloc" "wall (ms)"
+printf "%-8s | %12d\n" "slab" $slab
+printf "%-8s | %12d\n" "system" $sys
+$NOCC "${OPTS[@]}" --dump-dmem $(echo $SOURCES | awk '{print $NF}') 2>&1 > /dev/null | grep -A100 "^memory pool"
@@ -0,0 +1,99 @@
+#
+#	benchlib.sh -- shared parts of the extras/*bench.sh scripts, sourced by them
+#
+#	a script sets USAGE (the part of its usage line after the script name) and RUNS (the default
+#	number of runs), optionally BENCH_OPTS (its own getopts letters) with a bench_opt () to handle
+#	them (it may also take over -n), and BENCH_SOURCES=1 if it takes sources after "--", then:
+#
+#	  bench_args "$@"	parses the options, sets NOCC and OPTS (the nocc options), and with
+#				BENCH_SOURCES also SOURCES (default: the guppy files in the current directory)
+#	  bench_tmpdir		sets TMP to a scratch directory, removed on exit after running BENCH_CLEANUP
+#	  bench_now		prints the time in nanoseconds
+#	  bench_wallms <cmd...>	runs a command with its output discarded, prints its wall time in milliseconds
+#				and returns its exit status
+#	  bench_best <cmd...>	runs a command RUNS times, prints the smallest (integer) thing it printed;
+#				fails if any run does
+#	  bench_fmtus <usecs>	prints microseconds as milliseconds with three decimal places
+#
+
+BENCH_NAME=$(basename $0)
+
+bench_usage () {
+	echo "usage: $BENCH_NAME $USAGE" 1>&2
+	exit 1
+}
+
+bench_args () {
+	local c
+
+	OPTIND=1
+	while getopts "n:$BENCH_OPTS" c; do
+		if [ "$c" = "?" ]; then
+			bench_usage
+		elif declare -F bench_opt > /dev/null && bench_opt $c "$OPTARG"; then
+			continue
+		elif [ "$c" = "n" ]; then
+			RUNS=$OPTARG
+		else
+			bench_usage
+		fi
+	done
+	shift $((OPTIND - 1))
+	NOCC=$1
+	if [ -z "$NOCC" ]; then
+		bench_usage
+	fi
+	shift
+	OPTS=()
+	while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+		OPTS+=("$1")
+		shift
+	done
+	if [ "$BENCH_SOURCES" = "1" ]; then
+		shift
+		SOURCES="$*"
+		if [ -z "$SOURCES" ]; then
+			SOURCES=$(ls *.gpp 2> /dev/null)
+		fi
+		if [ -z "$SOURCES" ]; then
+			echo "$BENCH_NAME: no sources" 1>&2
+			exit 1
+		fi
+	fi
+}
+
+bench_tmpdir () {
+	TMP=$(mktemp -d)
+	trap 'eval "$BENCH_CLEANUP"; rm -rf $TMP' EXIT
+}
+
+bench_now () {
+	date +%s%N
+}
+
+bench_wallms () {
+	local t0 t1 rc
+
+	t0=$(bench_now)
+	"$@" > /dev/null 2>&1
+	rc=$?
+	t1=$(bench_now)
+	echo $(((t1 - t0) / 1000000))
+	return $rc
+}
+
+bench_best () {
+	local i t best=
+
+	for ((i = 0; i < RUNS; i++)); do
+		t=$("$@") || return 1
+		if [ -z "$best" ] || [ $t -lt $best ]; then
+			best=$t
+		fi
+	done
+	echo $best
+}
+
+bench_fmtus () {
+	printf "%d.%03d\n" $(($1 / 1000)) $(($1 % 1000))
+}
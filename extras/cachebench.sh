@@ -0,0 +1,51 @@
+#! /bin/bash
+#
+#	cachebench.sh -- wall time to compile each source separately, without the build cache, into an empty one
+#	and again from it, then the cache statistics
+#	usage: cachebench.sh [-n runs] <nocc> [nocc-options...] -- <sources...>
+#	with no sources, uses the guppy files in the current directory (e.g. run from tests/).
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] <nocc> [nocc-options...] -- <sources...>"
+RUNS=3
+
+BENCH_SOURCES=1
+bench_args "$@"
+bench_tmpdir
+
+# compiles every source separately (failures are timed too)
+compileall () {
+	local f
+
+	for f in $SOURCES; do
+		$NOCC "${OPTS[@]}" $f
+	done
+	return 0
+}
+
+# wall time for compiling every source separately once (milliseconds), optionally into an empty cache
+onerun () {
+	[ "$1" = "cold" ] && rm -rf $TMP/cache
+	bench_wallms compileall
+}
+
+# best of RUNS
+runtime () {
+	bench_best onerun "$@"
+}
+
+unset NOCC_BUILD_CACHE
+none=$(runtime)
+
+export NOCC_BUILD_CACHE=$TMP/cache
+cold=$(runtime cold)
+warm=$(runtime)
+
+echo "$(echo $SOURCES | wc -w) source file(s), compiled one at a time, best of $RUNS:"
+printf "%-8s | %12s\n" "cache" "wall (ms)"
+printf "%-8s | %12d\n" "none" $none
+printf "%-8s | %12d\n" "cold" $cold
+printf "%-8s | %12d\n" "warm" $warm
+$NOCC "${OPTS[@]}" --build-cache-stats 2> /dev/null
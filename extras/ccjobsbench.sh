@@ -0,0 +1,42 @@
+#! /bin/bash
+#
+#	ccjobsbench.sh -- wall time to compile each source with the C compiler run once on the whole of the
+#	generated C (--cccsp-cc-jobs=1), and with the generated C split up and compiled in parallel (--cccsp-cc-jobs=N)
+#	usage: ccjobsbench.sh [-n runs] [-j jobs] <nocc> [nocc-options...] -- <sources...>
+#	with no sources, uses the guppy files in the current directory (e.g. run from tests/).
+#	the build cache is turned off, so that the C compiler always runs.
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] [-j jobs] <nocc> [nocc-options...] -- <sources...>"
+RUNS=3
+JOBS=$(nproc 2> /dev/null || echo 4)
+
+BENCH_OPTS="j:"
+BENCH_SOURCES=1
+bench_opt () {
+	case $1 in
+	j)	JOBS=$2 ;;
+	*)	return 1 ;;
+	esac
+}
+bench_args "$@"
+
+unset NOCC_BUILD_CACHE
+
+echo "best of $RUNS, wall time in milliseconds:"
+printf "%-32s | %12s | %12s | %8s\n" "source" "1 job" "$JOBS jobs" "speedup"
+for f in $SOURCES; do
+	serial=$(bench_best bench_wallms $NOCC "${OPTS[@]}" --cccsp-cc-jobs=1 $f)
+	if [ $? -ne 0 ]; then
+		printf "%-32s | %12s\n" $f "failed"
+		continue
+	fi
+	parallel=$(bench_best bench_wallms $NOCC "${OPTS[@]}" --cccsp-cc-jobs=$JOBS $f)
+	if [ $? -ne 0 ]; then
+		printf "%-32s | %12d | %12s\n" $f $serial "failed"
+		continue
+	fi
+	echo "$f $serial $parallel" | awk '{ printf ("%-32s | %12d | %12d | %7.2fx\n", $1, $2, $3, $3 ? $2 / $3 : 0); }'
+done
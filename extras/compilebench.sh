@@ -0,0 +1,136 @@
+#! /bin/bash
+#
+#	compilebench.sh -- compile-time benchmark over the tests/ corpus, compared against a stored baseline
+#	usage: compilebench.sh [-n runs] [-b baseline] [-s] [-t time%] [-a alloc%] [-z size%] <nocc> [nocc-options...]
+#	run from the tests/ directory.  with -s the results are saved as the baseline instead of being compared;
+#	if the baseline does not exist yet it is created.  exits non-zero if anything regressed past a threshold.
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] [-b baseline] [-s] [-t time%] [-a alloc%] [-z size%] <nocc> [nocc-options...]"
+RUNS=3
+BASELINE=compilebench.baseline
+SAVE=0
+TTHRESH=10		# wall-clock time, percent
+ATHRESH=2		# allocation count and bytes, percent
+ZTHRESH=0		# output size, percent
+TFLOOR=500		# time differences below this many microseconds are noise
+
+BENCH_OPTS="b:st:a:z:"
+bench_opt () {
+	case $1 in
+	b)	BASELINE=$2 ;;
+	s)	SAVE=1 ;;
+	t)	TTHRESH=$2 ;;
+	a)	ATHRESH=$2 ;;
+	z)	ZTHRESH=$2 ;;
+	*)	return 1 ;;
+	esac
+}
+bench_args "$@"
+
+# front-end, the sources for it and the back-ends each is compiled through
+CORPUS="occampi:test_n*.occ:krocetc,krocllvm,cccsp mcsp:test_c*.mcsp:krocetc hopp:test_h*.hopp:krocetc \
+	guppy:test_g*.gpp:cccsp eac:test_ea[0-9]*.eac:krocetc,krocllvm avrasm:test_avr*.asm:atmelavr"
+
+# target triple and any extra options for a back-end (cccsp stops before running the C compiler)
+backend () {
+	case $1 in
+	krocetc)	echo "-t etc-kroc-unknown" ;;
+	krocllvm)	echo "-t llvm-kroc-unknown" ;;
+	cccsp)		echo "-t c-ccsp-unknown --stop-codegen" ;;
+	atmelavr)	echo "-t avr-atmel-unknown" ;;
+	esac
+}
+
+bench_tmpdir
+RESULTS=$TMP/results
+
+# compiles one source RUNS times, keeps the profile of the fastest run, adds its lines to the results
+benchfile () {
+	local fe=$1 be=$2 src=$3 i wall best=
+
+	for ((i = 0; i < RUNS; i++)); do
+		rm -f $TMP/run.csv $TMP/out
+		# no output counts as failure too
+		if ! { $NOCC "${OPTS[@]}" $(backend $be) --profile-to=$TMP/run.csv -o $TMP/out $src; } > /dev/null 2>&1 || \
+				[ ! -f $TMP/run.csv ] || [ ! -s $TMP/out ]; then
+			echo "fail $be $src $fe" >> $RESULTS
+			return
+		fi
+		wall=$(awk -F, '$1 == "total" { print $4 }' $TMP/run.csv)
+		if [ -z "$best" ] || [ $wall -lt $best ]; then
+			best=$wall
+			cp $TMP/run.csv $TMP/best.csv
+		fi
+	done
+	awk -F, -v fe=$fe -v be=$be -v src=$src -v size=$(stat -c %s $TMP/out 2> /dev/null || echo 0) '
+		$1 == "total" { printf "file %s %s %d %d %d %d %d %s\n", be, src, $4, $5, $6 + $7, $9, size, fe }
+		$1 != "total" && $1 != "kind" { gsub (/"/, "", $2); gsub (/ /, "_", $2); printf "%s %s %s %d %d %d %d %d\n", $1, be, $2, $4, $5, $6 + $7, $9, 0 }' \
+		$TMP/best.csv >> $RESULTS
+}
+
+: > $RESULTS
+for c in $CORPUS; do
+	fe=${c%%:*}
+	rest=${c#*:}
+	FILES=$(ls ${rest%%:*} 2> /dev/null)
+	if [ -z "$FILES" ]; then
+		continue
+	fi
+	for be in $(echo ${rest#*:} | tr ',' ' '); do
+		for f in $FILES; do
+			benchfile $fe $be $f
+		done
+	done
+done
+
+# sum stage and pass records over the corpus, leave per-file records as they are
+awk '
+	$1 == "file" || $1 == "fail" { print; next }
+	{ key = $1 " " $2 " " $3; wall[key] += $4; cpu[key] += $5; allocs[key] += $6; bytes[key] += $7; if (!(key in seen)) { seen[key] = 1; order[n++] = key } }
+	END { for (i = 0; i < n; i++) { k = order[i]; printf "%s %d %d %d %d 0\n", k, wall[k], cpu[k], allocs[k], bytes[k] } }' \
+	$RESULTS > $TMP/summary
+
+printf "%-10s %-10s %6s %6s | %12s %12s %12s %12s\n" "front-end" "back-end" "files" "failed" "wall (ms)" "allocs" "alloc KiB" "output KiB"
+awk '
+	$1 == "file" { k = $NF " " $2; files[k]++; wall[k] += $4; allocs[k] += $6; bytes[k] += $7; size[k] += $8; if (!(k in seen)) { seen[k] = 1; order[n++] = k } }
+	$1 == "fail" { k = $NF " " $2; failed[k]++; if (!(k in seen)) { seen[k] = 1; order[n++] = k } }
+	END { for (i = 0; i < n; i++) { k = order[i]; split (k, p, " ");
+		printf "%-10s %-10s %6d %6d | %12.3f %12d %12d %12d\n", p[1], p[2], files[k], failed[k], wall[k] / 1000.0, allocs[k], bytes[k] / 1024, size[k] / 1024 } }' \
+	$TMP/summary
+echo ""
+printf "%-10s %-8s %-36s | %12s %12s %12s\n" "back-end" "kind" "stage / pass" "wall (ms)" "allocs" "alloc KiB"
+awk '$1 != "file" && $1 != "fail" { printf "%-10s %-8s %-36s | %12.3f %12d %12d\n", $2, $1, $3, $4 / 1000.0, $6, $7 / 1024 }' $TMP/summary
+
+if [ $SAVE -eq 1 ] || [ ! -f "$BASELINE" ]; then
+	cp $TMP/summary "$BASELINE"
+	echo ""
+	echo "saved baseline in $BASELINE"
+	exit 0
+fi
+
+# compare against the baseline, one line per regression
+echo ""
+awk -v tthresh=$TTHRESH -v athresh=$ATHRESH -v zthresh=$ZTHRESH -v tfloor=$TFLOOR '
+	function key() { return $1 == "fail" ? "file " $2 " " $3 : $1 " " $2 " " $3 }
+	function check(what, old, new, thresh, floor) {
+		if ((new - old > floor) && (new > old * (1 + thresh / 100.0))) {
+			printf "regression: %s %s: %s %d -> %d (%+.1f%%)\n", $2, $3, what, old, new, old ? ((new - old) * 100.0) / old : 100.0
+			nreg++
+		}
+	}
+	FNR == NR { if ($1 != "fail") { bwall[key()] = $4; ballocs[key()] = $6; bbytes[key()] = $7; bsize[key()] = $8 } next }
+	$1 == "fail" { if (key() in bwall) { printf "regression: %s %s: no longer compiles\n", $2, $3; nreg++ } next }
+	!(key() in bwall) { next }
+	{
+		k = key ()
+		check("wall-clock us", bwall[k], $4, tthresh, tfloor)
+		check("allocations", ballocs[k], $6, athresh, 0)
+		check("allocated bytes", bbytes[k], $7, athresh, 0)
+		check("output bytes", bsize[k], $8, zthresh, 0)
+	}
+	END { printf "%d regression%s against baseline (thresholds: time %s%%, allocations %s%%, output %s%%)\n", nreg, nreg == 1 ? "" : "s", tthresh, athresh, zthresh; exit (nreg ? 1 : 0) }' \
+	"$BASELINE" $TMP/summary
+
@@ -0,0 +1,40 @@
+#! /bin/bash
+#
+#	ldefbench.sh -- compare cold (.ldef parse) and warm (snapshot) start-up per front-end
+#	usage: ldefbench.sh [-n runs] <nocc> [nocc-options...]
+#	run from the tests/ directory (or anywhere the sample sources below can be found).
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] <nocc> [nocc-options...]"
+RUNS=20
+bench_args "$@"
+
+# front-end and a small source for each
+SAMPLES="guppy:test_g1.gpp eac:test_ea1.eac avrasm:test_avr1.asm"
+
+# runs the compiler RUNS times up to the end of parsing, prints the average wall-clock time in ms
+avgtime () {
+	local t0 t1 i
+
+	t0=$(bench_now)
+	for ((i = 0; i < RUNS; i++)); do
+		$NOCC "${OPTS[@]}" "$@" --stop-parse > /dev/null 2>&1
+	done
+	t1=$(bench_now)
+	bench_fmtus $(( (t1 - t0) / (RUNS * 1000) ))
+}
+
+printf "%-10s %-18s %12s %12s\n" "front-end" "source" "cold (ms)" "warm (ms)"
+for s in $SAMPLES; do
+	fe=${s%%:*}
+	src=${s#*:}
+	if [ ! -f "$src" ]; then
+		continue
+	fi
+	cold=$(avgtime --no-ldef-cache $src)
+	$NOCC "${OPTS[@]}" --stop-parse $src > /dev/null 2>&1		# make sure the snapshot exists
+	warm=$(avgtime $src)
+	printf "%-10s %-18s %12s %12s\n" $fe $src $cold $warm
+done
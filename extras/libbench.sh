@@ -0,0 +1,103 @@
+#! /bin/bash
+#
+#	libbench.sh -- front-end time for a program using one entry from a large generated library,
+#	with descriptors parsed on demand and all parsed up front (--no-lib-lazy)
+#	usage: libbench.sh [-n runs] [-e entries] [-f guppy|occampi] <nocc> [nocc-options...]
+#	run from a scratch directory, the library and program are generated there.
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] [-e entries] [-f guppy|occampi] <nocc> [nocc-options...]"
+RUNS=3
+ENTRIES=2000
+FE=guppy
+
+BENCH_OPTS="e:f:"
+bench_opt () {
+	case $1 in
+	e)	ENTRIES=$2 ;;
+	f)	FE=$2 ;;
+	*)	return 1 ;;
+	esac
+}
+bench_args "$@"
+
+# library with ENTRIES procedures and a program that uses the last one
+case $FE in
+occampi)
+	LIBSRC=benchlib.occ
+	USESRC=benchuse.occ
+	{
+		printf -- "-- generated by libbench.sh\n\n#LIBRARY \"benchlib\"\n\n"
+		for ((i = 0; i < ENTRIES; i++)); do
+			printf "PUBLIC PROC bench.%d (VAL INT x, INT y, CHAN INT out!)\n  SEQ\n    y := x + %d\n    out ! y\n:\n\n" $i $i
+		done
+	} > $LIBSRC
+	printf -- "-- generated by libbench.sh\n\n#USE \"benchlib\"\n\nPROC benchuse (CHAN INT out!)\n  INT v:\n  bench.%d (1, v, out!)\n:\n\n" \
+		$((ENTRIES - 1)) > $USESRC
+	;;
+guppy)
+	LIBSRC=benchlib.gpp
+	USESRC=benchuse.gpp
+	{
+		printf "# generated by libbench.sh\n\n@module \"benchlib\"\n  @version \"1.0\"\n  @api 1\n\n\n"
+		for ((i = 0; i < ENTRIES; i++)); do
+			printf "define bench_%d (val int x) -> int\n  return x + %d\nend\n\n" $i $i
+		done
+	} > $LIBSRC
+	printf "# generated by libbench.sh\n\n@use \"benchlib\"\n\ndefine benchuse ()\n  int v\n  v = bench_%d (1)\nend\n\n" \
+		$((ENTRIES - 1)) > $USESRC
+	;;
+*)
+	echo "$BENCH_NAME: unknown front-end $FE" 1>&2
+	exit 1
+	;;
+esac
+
+bench_tmpdir
+
+rm -f benchlib.xlb
+if ! $NOCC "${OPTS[@]}" -c --stop-codegen $LIBSRC > $TMP/lib.log 2>&1 || [ ! -f benchlib.xlb ]; then
+	echo "$BENCH_NAME: failed to build library from $LIBSRC:" 1>&2
+	tail -5 $TMP/lib.log 1>&2
+	exit 1
+fi
+
+# best of RUNS for the parse stage and the front-end passes (microseconds), plus descriptors parsed
+fetime () {
+	local i parse passes best= bparse bpasses ndesc
+
+	for ((i = 0; i < RUNS; i++)); do
+		rm -f $TMP/run.csv
+		if ! $NOCC "${OPTS[@]}" "$@" -v --stop-typecheck --profile-to=$TMP/run.csv $USESRC > $TMP/run.log 2>&1 || [ ! -f $TMP/run.csv ]; then
+			echo "failed"
+			return
+		fi
+		parse=$(awk -F, '$2 == "\"parse\"" { print $4 }' $TMP/run.csv)
+		passes=$(awk -F, '$2 == "\"front-end compiler passes\"" { print $4 }' $TMP/run.csv)
+		if [ -z "$best" ] || [ $((parse + passes)) -lt $best ]; then
+			best=$((parse + passes))
+			bparse=$parse
+			bpasses=$passes
+		fi
+	done
+	ndesc=$(sed -n -e 's/^.*descriptor(s), parsed \([0-9]*\) on demand.*$/\1/p' $TMP/run.log)
+	echo "$bparse $bpasses $best ${ndesc:-all}"
+}
+
+echo "$FE library with $ENTRIES entries, program uses 1 (best of $RUNS):"
+printf "%-10s | %12s %12s %12s %12s\n" "mode" "parse (ms)" "passes (ms)" "total (ms)" "descriptors"
+for mode in lazy eager; do
+	if [ $mode = eager ]; then
+		r=$(fetime --no-lib-lazy)
+	else
+		r=$(fetime)
+	fi
+	if [ "$r" = "failed" ]; then
+		printf "%-10s | %12s\n" $mode "failed"
+		continue
+	fi
+	echo "$mode $r" | awk '{ printf ("%-10s | %12.3f %12.3f %12.3f %12s\n", $1, $2 / 1000, $3 / 1000, $4 / 1000, $5); }'
+done
+
@@ -0,0 +1,58 @@
+#! /bin/bash
+#
+#	opsbench.sh -- compops/langops dispatch cost, optionally against another build of nocc
+#	usage: opsbench.sh [-n runs] [-b base-nocc] <nocc> [nocc-options...]
+#	run from the tests/ directory.
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] [-b base-nocc] <nocc> [nocc-options...]"
+RUNS=3
+BENCH_OPTS="b:"
+BASE=
+
+bench_opt () {
+	if [ "$1" = "b" ]; then
+		BASE=$2
+		return 0
+	fi
+	return 1
+}
+
+bench_args "$@"
+
+# front-end and the sources to compile for each
+CORPUS="guppy:test_g*.gpp eac:test_ea*.eac avrasm:test_avr*.asm"
+
+# runs the front-end passes of the given nocc over each source RUNS times, prints the total wall-clock time in ms
+passtime () {
+	local t0 t1 i f
+
+	t0=$(bench_now)
+	for ((i = 0; i < RUNS; i++)); do
+		for f in $FILES; do
+			$1 "${OPTS[@]}" --stop-check $f > /dev/null 2>&1
+		done
+	done
+	t1=$(bench_now)
+	bench_fmtus $(( (t1 - t0) / 1000 ))
+}
+
+echo "micro-benchmark:"
+$NOCC "${OPTS[@]}" --bench-ops 2>&1 | grep "compop dispatch" | sed -e 's/^.*compop dispatch /    /'
+echo ""
+printf "%-10s %8s | %14s %14s\n" "front-end" "sources" "nocc (ms)" "base (ms)"
+for c in $CORPUS; do
+	fe=${c%%:*}
+	FILES=$(ls ${c#*:} 2> /dev/null)
+	if [ -z "$FILES" ]; then
+		continue
+	fi
+	this=$(passtime $NOCC)
+	base=-
+	if [ -n "$BASE" ]; then
+		base=$(passtime $BASE)
+	fi
+	printf "%-10s %8d | %14s %14s\n" $fe $(echo $FILES | wc -w) $this $base
+done
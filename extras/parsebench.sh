@@ -0,0 +1,42 @@
+#! /bin/bash
+#
+#	parsebench.sh -- parser throughput over the tests/ corpus, with and without DFA transition indexes
+#	usage: parsebench.sh [-n runs] <nocc> [nocc-options...]
+#	run from the tests/ directory.
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] <nocc> [nocc-options...]"
+RUNS=3
+bench_args "$@"
+
+# front-end and the sources to parse for each
+CORPUS="guppy:test_g*.gpp eac:test_ea*.eac avrasm:test_avr*.asm"
+
+# parses each source RUNS times, prints "<steps> <tests> <usecs>" totals from the compiler's -v output
+parsetotals () {
+	local i f
+
+	for ((i = 0; i < RUNS; i++)); do
+		for f in $FILES; do
+			$NOCC "${OPTS[@]}" "$@" -v --stop-parse $f 2>&1 | grep "parsed .*: [0-9]* DFA steps"
+		done
+	done | sed -e 's/^.*: \([0-9]*\) DFA steps, \([0-9]*\) match tests in \([0-9]*\)\.\([0-9]*\) ms.*$/\1 \2 \3\4/' | \
+		awk '{ s += $1; t += $2; u += $3 } END { printf "%d %d %d\n", s, t, u }'
+}
+
+printf "%-8s %10s | %12s %12s | %12s %12s\n" "" "" "linear" "" "indexed" ""
+printf "%-8s %10s | %12s %12s | %12s %12s\n" "front-end" "steps" "tests" "steps/sec" "tests" "steps/sec"
+for c in $CORPUS; do
+	fe=${c%%:*}
+	FILES=$(ls ${c#*:} 2> /dev/null)
+	if [ -z "$FILES" ]; then
+		continue
+	fi
+	read lsteps ltests lusecs < <(parsetotals --no-dfa-index)
+	read isteps itests iusecs < <(parsetotals)
+	printf "%-8s %10d | %12d %12d | %12d %12d\n" $fe $lsteps $ltests $(( lusecs ? (lsteps * 1000000) / lusecs : 0 )) \
+		$itests $(( iusecs ? (isteps * 1000000) / iusecs : 0 ))
+done
+
@@ -0,0 +1,55 @@
+#! /bin/bash
+#
+#	serverbench.sh -- wall time to compile each source separately, with and without a compile server
+#	usage: serverbench.sh [-n runs] <nocc> [nocc-options...] -- <sources...>
+#	with no sources, uses the guppy files in the current directory (e.g. run from tests/).
+#	the server is started with the same options and the first source, to initialise its parser.
+#
+
+. $(dirname $0)/benchlib.sh
+
+USAGE="[-n runs] <nocc> [nocc-options...] -- <sources...>"
+RUNS=3
+SPID=
+
+BENCH_SOURCES=1
+BENCH_CLEANUP='[ -n "$SPID" ] && kill $SPID'
+bench_args "$@"
+bench_tmpdir
+
+# compiles every source separately (failures are timed too)
+compileall () {
+	local f
+
+	for f in $SOURCES; do
+		$NOCC "${OPTS[@]}" $f
+	done
+	return 0
+}
+
+# best of RUNS for compiling every source separately (milliseconds)
+runtime () {
+	bench_best bench_wallms compileall
+}
+
+unset NOCC_SERVER
+local=$(runtime)
+
+$NOCC "${OPTS[@]}" --server=$TMP/server.sock ${SOURCES%% *} > $TMP/server.log 2>&1 &
+SPID=$!
+for ((i = 0; i < 50; i++)); do
+	[ -S $TMP/server.sock ] && break
+	sleep 0.1
+done
+if [ ! -S $TMP/server.sock ]; then
+	echo "$BENCH_NAME: server did not start:" 1>&2
+	tail -5 $TMP/server.log 1>&2
+	exit 1
+fi
+export NOCC_SERVER=$TMP/server.sock
+served=$(runtime)
+
+echo "$(echo $SOURCES | wc -w) source file(s), compiled one at a time, best of $RUNS:"
+printf "%-8s | %12s\n" "mode" "wall (ms)"
+printf "%-8s | %12d\n" "local" $local
+printf "%-8s | %12d\n" "server" $served
@@ -193,7 +193,7 @@ tokenloop:
 		if (!kw) {
 			/* assume name */
 			tok->type = NAME;
-			tok->u.name = string_ndup (ch, (int)(dh - ch));
+			tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 		} else {
 			/* keyword found */
 			tok->type = KEYWORD;
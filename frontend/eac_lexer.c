@@ -225,8 +225,7 @@ static token_t *eac_nexttoken (lexfile_t *lf, lexpriv_t *lp)
 		return NULL;
 	}
 
-	tok = lexer_newtoken (NOTOKEN);
-	tok->origin = (void *)lf;
+	tok = lexer_newlextoken (lf);
 	tok->lineno = lf->lineno;
 
 tokenloop:
@@ -259,7 +258,7 @@ tokenloop:
 		if (!kw) {
 			/* assume name */
 			tok->type = NAME;
-			tok->u.name = string_ndup (ch, (int)(dh - ch));
+			tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 		} else {
 			/* is keyword */
 			tok->type = KEYWORD;
@@ -168,8 +168,7 @@ void *eac_nametoken_to_hook (void *ntok)
 	token_t *tok = (token_t *)ntok;
 	char *rawname;
 
-	rawname = tok->u.name;
-	tok->u.name = NULL;
+	rawname = lexer_claimname (tok);
 
 	lexer_freetoken (tok);
 
@@ -233,8 +233,7 @@ static token_t *guppy_nexttoken (lexfile_t *lf, lexpriv_t *lp)
 		return NULL;
 	}
 
-	tok = lexer_newtoken (NOTOKEN);
-	tok->origin = (void *)lf;
+	tok = lexer_newlextoken (lf);
 	tok->lineno = lf->lineno;
 
 tokenloop:
@@ -368,16 +367,14 @@ nocc_message ("INDENT: advancing curindent to %d, scanto = %d", lop->curindent,
 		for (nstart=dh-1; (nstart > ch) && (*nstart >= '0') && (*nstart <= '9'); nstart--);
 		nstart++;
 
-		tmpstr = string_ndup (ch, (int)(dh - ch));
+		tmpstr = lexer_scratch (lf, ch, (int)(dh - ch));
 		kw = keywords_lookup (tmpstr, (int)(dh - ch), LANGTAG_GUPPY);
-		sfree (tmpstr);
 
 		if (!kw) {
 			if (nstart < dh) {
 				/* check to see if it's a special type (int8, etc.) */
-				tmpstr = string_ndup (ch, (int)(nstart - ch));
+				tmpstr = lexer_scratch (lf, ch, (int)(nstart - ch));
 				kw = keywords_lookup (tmpstr, (int)(nstart - ch), LANGTAG_GUPPY);
-				sfree (tmpstr);
 
 #if 0
 fprintf (stderr, "guppy-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)kw);
@@ -386,10 +383,9 @@ fprintf (stderr, "guppy-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)k
 					/* yes, and the end is all number */
 					int size;
 
-					tmpstr = string_ndup (nstart, (int)(dh - nstart));
+					tmpstr = lexer_scratch (lf, nstart, (int)(dh - nstart));
 					if (sscanf (tmpstr, "%d", &size) != 1) {
 						lexer_error (lf, "invalid number in sized keyword [%s]", kw->name);
-						sfree (tmpstr);
 						goto out_error1;
 					}
 
@@ -399,12 +395,12 @@ fprintf (stderr, "guppy-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)k
 				} else {
 					/* assume name */
 					tok->type = NAME;
-					tok->u.name = string_ndup (ch, (int)(dh - ch));
+					tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 				}
 			} else {
 				/* assume name */
 				tok->type = NAME;
-				tok->u.name = string_ndup (ch, (int)(dh - ch));
+				tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 			}
 		} else {
 			/* keyword found */
@@ -424,13 +420,10 @@ fprintf (stderr, "guppy-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)k
 			lp->offset += (int)(dh - ch);
 
 			/* parse */
-			npbuf = string_ndup (ch + 2, (int)(dh - ch));
+			npbuf = lexer_scratch (lf, ch + 2, (int)(dh - ch) - 2);
 			if (sscanf (npbuf, "%lx", (uint64_t *)&tok->u.ival) != 1) {
 				lexer_error (lf, "malformed hexadecimal constant: 0x%s", npbuf);
-				sfree (npbuf);
 				goto out_error1;
-			} else {
-				sfree (npbuf);
 			}
 		} else {
 			for (dh=ch+1; (dh < chlim) && (((*dh >= '0') && (*dh <= '9')) || (*dh == '.')); dh++) {
@@ -445,17 +438,13 @@ fprintf (stderr, "guppy-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)k
 			lp->offset += (int)(dh - ch);
 
 			/* parse it */
-			npbuf = string_ndup (ch, (int)(dh - ch));
+			npbuf = lexer_scratch (lf, ch, (int)(dh - ch));
 			if ((tok->type == REAL) && (sscanf (npbuf, "%lf", &tok->u.dval) != 1)) {
 				lexer_error (lf, "malformed floating-point constant: %s", npbuf);
-				sfree (npbuf);
 				goto out_error1;
 			} else if ((tok->type == INTEGER) && (sscanf (npbuf, "%ld", &tok->u.ival) != 1)) {
 				lexer_error (lf, "malformed integer constant: %s", npbuf);
-				sfree (npbuf);
 				goto out_error1;
-			} else {
-				sfree (npbuf);
 			}
 		}
 		/*}}}*/
@@ -579,7 +568,7 @@ fprintf (stderr, "guppy-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)k
 				goto out_error1;
 			}
 
-			tok->u.str.ptr = (char *)smalloc (slen + 1);
+			tok->u.str.ptr = lexer_tokalloc (tok, slen + 1);
 			tok->u.str.len = 0;			/* fixup in a bit */
 			xch = tok->u.str.ptr;
 			slen = 0;
@@ -320,8 +320,7 @@ void *guppy_nametoken_to_hook (void *ntok)
 	token_t *tok = (token_t *)ntok;
 	char *rawname;
 
-	rawname = tok->u.name;
-	tok->u.name = NULL;
+	rawname = lexer_claimname (tok);
 
 	lexer_freetoken (tok);
 
@@ -174,7 +174,7 @@ static arraytypehook_t *guppy_newarraytypehook_nd (const int ndim)
 
 	ath->ndim = ndim;
 	ath->nelem = -1;
-	ath->known_sizes = (int *)smalloc (ndim * sizeof (int));
+	ath->known_sizes = (int *)scalloc (ndim, sizeof (int));
 	for (i=0; i<ndim; i++) {
 		ath->known_sizes[i] = -1;
 	}
@@ -314,7 +314,7 @@ static void guppy_setarraytypedims (arraytypehook_t *ath, int ndims, ...)
 		ath->known_sizes = NULL;
 	}
 	if (ndims > 0) {
-		ath->known_sizes = (int *)smalloc (ndims * sizeof (int));
+		ath->known_sizes = (int *)scalloc (ndims, sizeof (int));
 	}
 	va_start (ap, ndims);
 	ath->nelem = 1;
@@ -350,7 +350,7 @@ static void guppy_setarraytypedims_undef (arraytypehook_t *ath, int ndims)
 		ath->known_sizes = NULL;
 	}
 	if (ndims > 0) {
-		ath->known_sizes = (int *)smalloc (ndims * sizeof (int));
+		ath->known_sizes = (int *)scalloc (ndims, sizeof (int));
 	}
 	for (i=0; i<ndims; i++) {
 		ath->known_sizes[i] = -1;
@@ -202,8 +202,7 @@ static token_t *hopp_nexttoken (lexfile_t *lf, lexpriv_t *lp)
 		return NULL;
 	}
 
-	tok = lexer_newtoken (NOTOKEN);
-	tok->origin = (void *)lf;
+	tok = lexer_newlextoken (lf);
 	tok->lineno = lf->lineno;
 
 tokenloop:
@@ -234,7 +233,7 @@ tokenloop:
 		if (!kw) {
 			/* assume name */
 			tok->type = NAME;
-			tok->u.name = string_ndup (ch, (int)(dh - ch));
+			tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 		} else {
 			/* keyword found */
 			tok->type = KEYWORD;
@@ -272,8 +272,8 @@ static int mcsp_codegen_snode (compops_t *cops, tnode_t *node, codegen_t *cgen)
 		guards = parser_getlistitems (glist, &nguards);
 
 		/*{{{  invent some labels for guarded processes and disabling sequences*/
-		labels = (int *)smalloc (nguards * sizeof (int));
-		dlabels = (int *)smalloc (nguards * sizeof (int));
+		labels = (int *)scalloc (nguards, sizeof (int));
+		dlabels = (int *)scalloc (nguards, sizeof (int));
 
 		for (i=0; i<nguards; i++) {
 			labels[i] = codegen_new_label (cgen);
@@ -62,6 +62,7 @@ int occampi_register_frontend (void)
 	}
 
 	opts_add ("c-operators", '\0', occampi_lexer_opthandler_flag, (void *)1, "1use C style operators");
+	opts_add ("no-include-cache", '\0', occampi_parser_opthandler_flag, (void *)1, "1lex and parse #INCLUDE'd files every time they are included");
 	nocc_addxmlnamespace ("occampi", "http://www.cs.kent.ac.uk/projects/ofa/nocc/NAMESPACES/occampi");
 
 	return 0;
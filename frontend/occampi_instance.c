@@ -499,7 +499,7 @@ tnode_dumptree (nname, 1, stderr);
 						return 0;
 					}
 					if (nfp > 0) {
-						fpsetcopy = (tnode_t **)smalloc (nfp * sizeof (tnode_t *));
+						fpsetcopy = (tnode_t **)scalloc (nfp, sizeof (tnode_t *));
 
 						for (i=0; i<nfp; i++) {
 							if (fpset[i]->tag == opi.tag_FPARAM) {
@@ -511,7 +511,7 @@ tnode_dumptree (nname, 1, stderr);
 						}
 					}
 					if (nap > 0) {
-						apsetcopy = (tnode_t **)smalloc (nap * sizeof (tnode_t *));
+						apsetcopy = (tnode_t **)scalloc (nap, sizeof (tnode_t *));
 
 						for (i=0; i<nap; i++) {
 							apsetcopy[i] = apset[i];
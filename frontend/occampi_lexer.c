@@ -325,8 +325,7 @@ static token_t *occampi_nexttoken (lexfile_t *lf, lexpriv_t *lp)
 		return NULL;
 	}
 
-	tok = lexer_newtoken (NOTOKEN);
-	tok->origin = (void *)lf;
+	tok = lexer_newlextoken (lf);
 	tok->lineno = lf->lineno;
 
 tokenloop:
@@ -410,14 +409,13 @@ tokenloop:
 				(*dh == '.') ||
 				((*dh >= '0') && (*dh <= '9'))); dh++);
 		
-		tmpstr = string_ndup (ch, (int)(dh - ch));
+		tmpstr = lexer_scratch (lf, ch, (int)(dh - ch));
 		kw = keywords_lookup (tmpstr, (int)(dh - ch), LANGTAG_OCCAMPI);
-		sfree (tmpstr);
 
 		if (!kw) {
 			/* assume name */
 			tok->type = NAME;
-			tok->u.name = string_ndup (ch, (int)(dh - ch));
+			tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 		} else {
 			/* keyword found */
 			tok->type = KEYWORD;
@@ -442,19 +440,13 @@ tokenloop:
 		}
 		lp->offset += (int)(dh - ch);
 		/* parse it */
-		npbuf = (char *)smalloc ((int)(dh - ch) + 1);
-		memcpy (npbuf, ch, (int)(dh - ch));
-		npbuf[(int)(dh - ch)] = '\0';
+		npbuf = lexer_scratch (lf, ch, (int)(dh - ch));
 		if ((tok->type == REAL) && (sscanf (npbuf, "%lf", &tok->u.dval) != 1)) {
 			lexer_error (lf, "malformed floating-point constant: %s", npbuf);
-			sfree (npbuf);
 			goto out_error1;
 		} else if ((tok->type == INTEGER) && (sscanf (npbuf, "%ld", &tok->u.ival) != 1)) {
 			lexer_error (lf, "malformed integer constant: %s", npbuf);
-			sfree (npbuf);
 			goto out_error1;
-		} else {
-			sfree (npbuf);
 		}
 		/*}}}*/
 	} else switch (*ch) {
@@ -624,7 +616,7 @@ tokenloop:
 				lexer_error (lf, "unexpected end of file");
 				goto out_error1;
 			}
-			tok->u.str.ptr = (char *)smalloc (slen + 1);
+			tok->u.str.ptr = lexer_tokalloc (tok, slen + 1);
 			tok->u.str.len = 0;		/* fixup in a bit */
 			xch = tok->u.str.ptr;
 			slen = 0;
@@ -714,15 +706,10 @@ tokenloop:
 
 			lp->offset += (int)(dh - ch);
 			/* parse it */
-			npbuf = (char *)smalloc ((int)(dh - ch));
-			memcpy (npbuf, ch+1, (int)(dh - ch) - 1);
-			npbuf[(int)(dh - ch) - 1] = '\0';
+			npbuf = lexer_scratch (lf, ch + 1, (int)(dh - ch) - 1);
 			if (sscanf (npbuf, "%lx", &tok->u.ival) != 1) {
 				lexer_error (lf, "malformed hexadecimal constant: %s", npbuf);
-				sfree (npbuf);
 				goto out_error1;
-			} else {
-				sfree (npbuf);
 			}
 			/*}}}*/
 		}
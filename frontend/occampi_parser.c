@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <errno.h>
 
 #include "nocc.h"
@@ -43,6 +44,7 @@
 #include "tnode.h"
 #include "parser.h"
 #include "fcnlib.h"
+#include "opts.h"
 #include "langdef.h"
 #include "dfa.h"
 #include "dfaerror.h"
@@ -57,6 +59,7 @@
 #include "extn.h"
 #include "mwsync.h"
 #include "metadata.h"
+#include "crypto.h"
 
 /*}}}*/
 
@@ -116,6 +119,58 @@ typedef struct {
 
 static occampi_parse_t *occampi_priv = NULL;
 
+/* a directive in an #INCLUDE'd file (or one it includes) with effects beyond the parsed tree, replayed when the cached tree is used */
+typedef struct {
+	int type;				/* OPI_INCDIR_... */
+	char *str;				/* option, library name or EXTERNAL declaration */
+	char *asname;				/* for #USE ... AS, else NULL */
+} occampi_incdir_t;
+
+#define OPI_INCDIR_OPTION	1
+#define OPI_INCDIR_USE		2
+#define OPI_INCDIR_EXTERNAL	3
+
+/* a file read while parsing an #INCLUDE'd file, and the digest of its contents */
+typedef struct {
+	char *path;
+	char *digest;
+} occampi_incdep_t;
+
+/* what parsing an #INCLUDE'd file did, including anything it included in turn */
+typedef struct TAG_occampi_increc {
+	struct TAG_occampi_increc *prev;	/* record for the file including this one, while parsing */
+	DYNARRAY (occampi_incdir_t *, dirs);
+	DYNARRAY (occampi_incdep_t *, deps);	/* the file itself first */
+	int nocache;				/* something in it cannot be replayed */
+} occampi_increc_t;
+
+/* parsed #INCLUDE'd files, by the path the lexer resolved; the tree here is never handed out, only copies of it */
+typedef struct {
+	char *path;
+	int flags;				/* OPI_INCCACHE_... flags of the including file */
+	tnode_t *tree;
+	occampi_increc_t *rec;
+	int parseus;				/* microseconds it took to lex and parse */
+} occampi_inccache_t;
+
+/* state while replaying a cached #INCLUDE (see occampi_increplay) */
+typedef struct {
+	occampi_increc_t *rec;
+	int next;				/* next directive to look at */
+	lexfile_t *lf;				/* including file */
+	int err;
+} occampi_increplay_t;
+
+#define OPI_INCCACHE_LIBRARY	0x0001
+#define OPI_INCCACHE_SEPCOMP	0x0002
+
+STATICSTRINGHASH (occampi_inccache_t *, occampi_inccache, 5);
+static int occampi_useinccache = 1;		/* cleared with --no-include-cache */
+static occampi_increc_t *occampi_increc = NULL;	/* innermost #INCLUDE being parsed */
+static int occampi_inclookups = 0;
+static int occampi_inchits = 0;
+static int occampi_incsavedus = 0;
+
 static feunit_t *feunit_set[] = {
 	&occampi_primproc_feunit,
 	&occampi_cnode_feunit,
@@ -198,8 +253,7 @@ void *occampi_nametoken_to_hook (void *ntok)
 	token_t *tok = (token_t *)ntok;
 	char *rawname;
 
-	rawname = tok->u.name;
-	tok->u.name = NULL;
+	rawname = lexer_claimname (tok);
 
 	lexer_freetoken (tok);
 
@@ -374,15 +428,323 @@ langdef_t *occampi_getlangdef (void)
 /*}}}*/
 
 
+/*{{{  int occampi_parser_opthandler_flag (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	option-handler for occam-pi parser options
+ *	returns 0 on success, non-zero on failure
+ */
+int occampi_parser_opthandler_flag (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	int optv = (int)((uint64_t)opt->arg);
+
+	switch (optv) {
+	case 1:
+		/* --no-include-cache */
+		occampi_useinccache = 0;
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+/*}}}*/
+/*{{{  static int occampi_elapsedus (struct timeval *t_start)*/
+/*
+ *	returns the number of microseconds since 't_start'
+ */
+static int occampi_elapsedus (struct timeval *t_start)
+{
+	struct timeval t_end;
+
+	gettimeofday (&t_end, NULL);
+	return (int)(((t_end.tv_sec - t_start->tv_sec) * 1000000) + (t_end.tv_usec - t_start->tv_usec));
+}
+/*}}}*/
+/*{{{  static occampi_increc_t *occampi_newincrec (void)*/
+/*
+ *	creates a new (empty) #INCLUDE record
+ */
+static occampi_increc_t *occampi_newincrec (void)
+{
+	occampi_increc_t *rec = (occampi_increc_t *)smalloc (sizeof (occampi_increc_t));
+
+	rec->prev = NULL;
+	dynarray_init (rec->dirs);
+	dynarray_init (rec->deps);
+	rec->nocache = 0;
+
+	return rec;
+}
+/*}}}*/
+/*{{{  static void occampi_freeincrec (occampi_increc_t *rec)*/
+/*
+ *	frees an #INCLUDE record
+ */
+static void occampi_freeincrec (occampi_increc_t *rec)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (rec->dirs); i++) {
+		occampi_incdir_t *dir = DA_NTHITEM (rec->dirs, i);
+
+		sfree (dir->str);
+		if (dir->asname) {
+			sfree (dir->asname);
+		}
+		sfree (dir);
+	}
+	dynarray_trash (rec->dirs);
+	for (i=0; i<DA_CUR (rec->deps); i++) {
+		occampi_incdep_t *dep = DA_NTHITEM (rec->deps, i);
+
+		sfree (dep->path);
+		sfree (dep->digest);
+		sfree (dep);
+	}
+	dynarray_trash (rec->deps);
+	sfree (rec);
+
+	return;
+}
+/*}}}*/
+/*{{{  static occampi_incdir_t *occampi_incadddir (occampi_increc_t *rec, int type, const char *str, const char *asname)*/
+/*
+ *	adds a directive to an #INCLUDE record
+ *	returns the new directive
+ */
+static occampi_incdir_t *occampi_incadddir (occampi_increc_t *rec, int type, const char *str, const char *asname)
+{
+	occampi_incdir_t *dir = (occampi_incdir_t *)smalloc (sizeof (occampi_incdir_t));
+
+	dir->type = type;
+	dir->str = string_dup (str);
+	dir->asname = asname ? string_dup (asname) : NULL;
+	dynarray_add (rec->dirs, dir);
+
+	return dir;
+}
+/*}}}*/
+/*{{{  static void occampi_incadddep (occampi_increc_t *rec, const char *path, const char *digest)*/
+/*
+ *	adds a file and its digest to an #INCLUDE record
+ */
+static void occampi_incadddep (occampi_increc_t *rec, const char *path, const char *digest)
+{
+	occampi_incdep_t *dep = (occampi_incdep_t *)smalloc (sizeof (occampi_incdep_t));
+
+	dep->path = string_dup (path);
+	dep->digest = string_dup (digest);
+	dynarray_add (rec->deps, dep);
+
+	return;
+}
+/*}}}*/
+/*{{{  static occampi_incdir_t *occampi_increcdir (int type, const char *str)*/
+/*
+ *	called for directives that do more than add to the tree:  if an #INCLUDE'd file is being parsed,
+ *	records it so that it can be replayed when the cached parse is used.  type 0 is something that
+ *	cannot be replayed (the file is then not cached).
+ *	returns the recorded directive, or NULL if not recording (or type 0)
+ */
+static occampi_incdir_t *occampi_increcdir (int type, const char *str)
+{
+	if (!occampi_increc) {
+		return NULL;
+	}
+	if (!type) {
+		occampi_increc->nocache = 1;
+		return NULL;
+	}
+	return occampi_incadddir (occampi_increc, type, str, NULL);
+}
+/*}}}*/
+/*{{{  static void occampi_incmerge (occampi_increc_t *rec)*/
+/*
+ *	adds what an #INCLUDE'd file did to the record of the file including it, if that is being recorded
+ */
+static void occampi_incmerge (occampi_increc_t *rec)
+{
+	occampi_increc_t *into = occampi_increc;
+	int i;
+
+	if (!into) {
+		return;
+	}
+	for (i=0; i<DA_CUR (rec->dirs); i++) {
+		occampi_incdir_t *dir = DA_NTHITEM (rec->dirs, i);
+
+		occampi_incadddir (into, dir->type, dir->str, dir->asname);
+	}
+	for (i=0; i<DA_CUR (rec->deps); i++) {
+		occampi_incdep_t *dep = DA_NTHITEM (rec->deps, i);
+
+		occampi_incadddep (into, dep->path, dep->digest);
+	}
+	if (rec->nocache) {
+		into->nocache = 1;
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static int occampi_incdepsok (occampi_increc_t *rec, const char *digest)*/
+/*
+ *	checks that a cached #INCLUDE is still good: the file itself has digest 'digest' and nothing it
+ *	included has changed since
+ *	returns non-zero if so
+ */
+static int occampi_incdepsok (occampi_increc_t *rec, const char *digest)
+{
+	int i;
+
+	if (!DA_CUR (rec->deps) || strcmp (DA_NTHITEM (rec->deps, 0)->digest, digest)) {
+		return 0;
+	}
+	for (i=1; i<DA_CUR (rec->deps); i++) {
+		occampi_incdep_t *dep = DA_NTHITEM (rec->deps, i);
+		char *now = crypto_cdigestfile (dep->path);
+		int same = (now && !strcmp (now, dep->digest));
+
+		if (now) {
+			sfree (now);
+		}
+		if (!same) {
+			return 0;
+		}
+	}
+	return 1;
+}
+/*}}}*/
+/*{{{  static int occampi_increplaynode (tnode_t **nodep, void *arg)*/
+/*
+ *	called for each node of a copied #INCLUDE tree:  library-usage nodes (whose copies do not carry the
+ *	library) are created afresh from the next recorded #USE or EXTERNAL
+ *	returns 0 to stop walking, 1 to continue
+ */
+static int occampi_increplaynode (tnode_t **nodep, void *arg)
+{
+	occampi_increplay_t *irp = (occampi_increplay_t *)arg;
+	occampi_incdir_t *dir = NULL;
+	tnode_t *unode;
+
+	if (irp->err) {
+		return 0;
+	}
+	if (!library_islibusenode (*nodep)) {
+		return 1;
+	}
+	for (; irp->next < DA_CUR (irp->rec->dirs); irp->next++) {
+		dir = DA_NTHITEM (irp->rec->dirs, irp->next);
+		if (dir->type != OPI_INCDIR_OPTION) {
+			break;		/* for() */
+		}
+		dir = NULL;
+	}
+	if (!dir) {
+		nocc_internal ("occampi_increplaynode(): more library-usage nodes than recorded directives");
+		irp->err = 1;
+		return 0;
+	}
+	irp->next++;
+
+	if (dir->type == OPI_INCDIR_USE) {
+		unode = library_newusenode (irp->lf, dir->str);
+		if (unode && dir->asname && library_setusenamespace (unode, dir->asname)) {
+			tnode_free (unode);
+			unode = NULL;
+		}
+	} else {
+		unode = library_externaldecl (irp->lf, dir->str);
+	}
+	if (!unode) {
+		irp->err = 1;
+		return 0;
+	}
+	tnode_setnthsub (unode, 0, tnode_nthsubof (*nodep, 0));
+	tnode_setnthsub (*nodep, 0, NULL);
+	tnode_free (*nodep);
+	*nodep = unode;
+
+	return 1;
+}
+/*}}}*/
+/*{{{  static int occampi_increplay (occampi_increc_t *rec, tnode_t **treep, lexfile_t *curlf)*/
+/*
+ *	replays the directives of a cached #INCLUDE into a copy of its tree:  #OPTIONs are processed again
+ *	and library-usage nodes recreated
+ *	returns 0 on success, non-zero on failure
+ */
+static int occampi_increplay (occampi_increc_t *rec, tnode_t **treep, lexfile_t *curlf)
+{
+	occampi_increplay_t irp = {rec, 0, curlf, 0};
+	int i;
+
+	for (i=0; i<DA_CUR (rec->dirs); i++) {
+		occampi_incdir_t *dir = DA_NTHITEM (rec->dirs, i);
+
+		if ((dir->type == OPI_INCDIR_OPTION) && (nocc_dooption_arg (dir->str, (void *)curlf) < 0)) {
+			parser_error (SLOCN (curlf), "failed while processing #OPTION directive from cached #INCLUDE");
+			return -1;
+		}
+	}
+
+	tnode_modprewalktree (treep, occampi_increplaynode, &irp);
+	if (irp.err) {
+		parser_error (SLOCN (curlf), "failed to replay #USE or #PRAGMA EXTERNAL directive from cached #INCLUDE");
+		return -1;
+	}
+	for (; irp.next < DA_CUR (rec->dirs); irp.next++) {
+		if (DA_NTHITEM (rec->dirs, irp.next)->type != OPI_INCDIR_OPTION) {
+			nocc_internal ("occampi_increplay(): fewer library-usage nodes than recorded directives");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+/*}}}*/
+/*{{{  static void occampi_freeinccache_entry (occampi_inccache_t *ic, char *key, void *arg)*/
+/*
+ *	frees a cached #INCLUDE (called via stringhash_walk)
+ */
+static void occampi_freeinccache_entry (occampi_inccache_t *ic, char *key, void *arg)
+{
+	tnode_free (ic->tree);
+	occampi_freeincrec (ic->rec);
+	sfree (ic->path);
+	sfree (ic);
+	return;
+}
+/*}}}*/
+/*{{{  static void occampi_freeinccache (void)*/
+/*
+ *	empties the #INCLUDE cache (at the end of each top-level parse)
+ */
+static void occampi_freeinccache (void)
+{
+	stringhash_walk (occampi_inccache, occampi_freeinccache_entry, NULL);
+	stringhash_trash (occampi_inccache);
+	return;
+}
+/*}}}*/
 /*{{{  static tnode_t *occampi_includefile (char *fname, lexfile_t *curlf)*/
 /*
- *	includes a file
+ *	includes a file.  The parsed tree is cached against the resolved path, with the digests of the file and
+ *	of everything it includes, so headers included many times are only lexed and parsed once;  each inclusion
+ *	gets its own copy, since the includer fills in the (empty) body at the end of it.  Directives that do more
+ *	than add to the tree (#OPTION, #USE, #PRAGMA EXTERNAL) are recorded and replayed for each copy.
  *	returns a tree or NULL
  */
 static tnode_t *occampi_includefile (char *fname, lexfile_t *curlf)
 {
 	tnode_t *tree;
 	lexfile_t *lf;
+	lexpriv_t *lp;
+	occampi_inccache_t *ic = NULL;
+	occampi_increc_t *rec = NULL;
+	char *digest = NULL;
+	int flags = (curlf->islibrary ? OPI_INCCACHE_LIBRARY : 0) | (curlf->sepcomp ? OPI_INCCACHE_SEPCOMP : 0);
+	struct timeval t_start;
 
 	lf = lexer_open (fname);
 	if (!lf) {
@@ -390,6 +752,42 @@ static tnode_t *occampi_includefile (char *fname, lexfile_t *curlf)
 		return NULL;
 	}
 
+	gettimeofday (&t_start, NULL);
+	lp = (lexpriv_t *)lf->priv;
+	if (occampi_useinccache) {
+		/*{{{  already parsed this one?*/
+		digest = crypto_cdigestdata (lp->buffer, lp->size);
+		occampi_inclookups++;
+
+		ic = stringhash_lookup (occampi_inccache, lf->filename);
+		if (ic && (ic->flags == flags) && occampi_incdepsok (ic->rec, digest)) {
+			lexer_close (lf);
+			sfree (digest);
+
+			tree = tnode_copytree (ic->tree);
+			if (occampi_increplay (ic->rec, &tree, curlf)) {
+				tnode_free (tree);
+				return NULL;
+			}
+			occampi_incmerge (ic->rec);
+			occampi_inchits++;
+			occampi_incsavedus += ic->parseus - occampi_elapsedus (&t_start);
+
+			if (compopts.verbose) {
+				nocc_message ("using cached parse of %s", fname);
+			}
+			return tree;
+		}
+		/*}}}*/
+		/*{{{  record what parsing it does*/
+		rec = occampi_newincrec ();
+		occampi_incadddep (rec, lf->filename, digest);
+		sfree (digest);
+		rec->prev = occampi_increc;
+		occampi_increc = rec;
+		/*}}}*/
+	}
+
 	lf->toplevel = 0;
 	lf->islibrary = curlf->islibrary;
 	lf->sepcomp = curlf->sepcomp;
@@ -398,12 +796,41 @@ static tnode_t *occampi_includefile (char *fname, lexfile_t *curlf)
 		nocc_message ("sub-parsing ...");
 	}
 	tree = parser_parse (lf);
+	if (rec) {
+		occampi_increc = rec->prev;
+		rec->prev = NULL;
+		occampi_incmerge (rec);
+	}
 	if (!tree) {
 		parser_error (SLOCN (curlf), "failed to parse #INCLUDE'd file %s", fname);
 		lexer_close (lf);
+		if (rec) {
+			occampi_freeincrec (rec);
+		}
 		return NULL;
 	}
+
+	if (rec && !lf->errcount && !rec->nocache) {
+		/*{{{  keep a copy for next time, replacing any stale one*/
+		if (!ic) {
+			ic = (occampi_inccache_t *)smalloc (sizeof (occampi_inccache_t));
+			ic->path = string_dup (lf->filename);
+			stringhash_insert (occampi_inccache, ic, ic->path);
+		} else {
+			tnode_free (ic->tree);
+			occampi_freeincrec (ic->rec);
+		}
+		ic->parseus = occampi_elapsedus (&t_start);
+		ic->flags = flags;
+		ic->tree = tnode_copytree (tree);
+		ic->rec = rec;
+		rec = NULL;
+		/*}}}*/
+	}
 	lexer_close (lf);
+	if (rec) {
+		occampi_freeincrec (rec);
+	}
 
 	return tree;
 }
@@ -986,6 +1413,7 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 			if (nexttok && lexer_tokmatch (opi.tok_STRING, nexttok)) {
 				/*{{{  option for the compiler*/
 				char *scopy = string_ndup (nexttok->u.str.ptr, nexttok->u.str.len);
+				cmd_option_t *opt = opts_getlongopt (scopy);
 
 				lexer_freetoken (nexttok);
 				if (nocc_dooption_arg (scopy, (void *)lf) < 0) {
@@ -994,6 +1422,10 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 					sfree (scopy);
 					return tree;
 				}
+				/* options for the occam-pi lexer only affect this file, whose tree has them already */
+				if (!opt || (opt->opthandler != occampi_lexer_opthandler_flag)) {
+					occampi_increcdir (OPI_INCDIR_OPTION, scopy);
+				}
 
 				sfree (scopy);
 				/*}}}*/
@@ -1016,6 +1448,7 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 
 				lexer_freetoken (nexttok);
 				tree = library_newlibnode (lf, sname);
+				occampi_increcdir (0, NULL);
 				if (!tree) {
 					parser_error (SLOCN (lf), "failed while processing #LIBRARY directive");
 					sfree (sname);
@@ -1173,6 +1606,7 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 			if (nexttok && lexer_tokmatch (opi.tok_STRING, nexttok)) {
 				/*{{{  using an external library (or separately compiled file)*/
 				char *libname = string_ndup (nexttok->u.str.ptr, nexttok->u.str.len);
+				occampi_incdir_t *dir;
 
 				lexer_freetoken (nexttok);
 				tree = library_newusenode (lf, libname);
@@ -1181,6 +1615,7 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 					sfree (libname);
 					return tree;
 				}
+				dir = occampi_increcdir (OPI_INCDIR_USE, libname);
 				sfree (libname);
 
 				/* maybe followed up with "AS <litstring>" for changing namespaces */
@@ -1194,6 +1629,9 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 
 						lexer_freetoken (nexttok);
 						library_setusenamespace (tree, usename);
+						if (dir) {
+							dir->asname = string_dup (usename);
+						}
 
 						sfree (usename);
 						/*}}}*/
@@ -1254,6 +1692,7 @@ fprintf (stderr, "occampi_declorprocstart(): think i should be including another
 						sfree (extdef);
 						return tree;
 					}
+					occampi_increcdir (OPI_INCDIR_EXTERNAL, extdef);
 					sfree (extdef);
 					*gotall = 1;
 				} else {
@@ -2152,6 +2591,14 @@ static tnode_t *occampi_parser_parse (lexfile_t *lf)
 		tok = lexer_nexttoken (lf);
 	}
 
+	if (lf->toplevel && compopts.verbose && occampi_inclookups) {
+		nocc_message ("#INCLUDE cache: %d lookups, %d hits, about %d.%03d ms of parsing saved", occampi_inclookups, occampi_inchits,
+				occampi_incsavedus / 1000, occampi_incsavedus % 1000);
+	}
+	if (lf->toplevel) {
+		occampi_freeinccache ();
+	}
+
 	/* if building for separate compilation and top-level, drop in library node */
 	if (lf->toplevel && lf->sepcomp && !lf->islibrary) {
 		tnode_t *libnode = library_newlibnode (lf, NULL);		/* use default name */
@@ -780,8 +780,8 @@ static int occampi_codegen_snode (compops_t *cops, tnode_t *node, codegen_t *cge
 		int have_timeout_guard = 0;
 
 		/*{{{  invent some labels for ALT bodies*/
-		p_labels = (int *)smalloc (nguards * sizeof (int));
-		d_labels = (int *)smalloc (nguards * sizeof (int));
+		p_labels = (int *)scalloc (nguards, sizeof (int));
+		d_labels = (int *)scalloc (nguards, sizeof (int));
 
 		for (i=0; i<nguards; i++) {
 			p_labels[i] = codegen_new_label (cgen);
@@ -878,7 +878,7 @@ static int occampi_codegen_snode (compops_t *cops, tnode_t *node, codegen_t *cge
 		}
 
 		/* assign labels to bodies */
-		blabs = (int *)smalloc (nbodies * sizeof (int));
+		blabs = (int *)scalloc (nbodies, sizeof (int));
 		for (i=0; i<nbodies; i++) {
 			tnode_t *cond = bodies[i];
 
@@ -233,8 +233,7 @@ static token_t *oil_nexttoken (lexfile_t *lf, lexpriv_t *lp)
 		return NULL;
 	}
 
-	tok = lexer_newtoken (NOTOKEN);
-	tok->origin = (void *)lf;
+	tok = lexer_newlextoken (lf);
 	tok->lineno = lf->lineno;
 
 tokenloop:
@@ -399,12 +398,12 @@ fprintf (stderr, "oil-lexer: number-ending keyword 0x%8.8x\n", (unsigned int)kw)
 				} else {
 					/* assume name */
 					tok->type = NAME;
-					tok->u.name = string_ndup (ch, (int)(dh - ch));
+					tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 				}
 			} else {
 				/* assume name */
 				tok->type = NAME;
-				tok->u.name = string_ndup (ch, (int)(dh - ch));
+				tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 			}
 		} else {
 			/* keyword found */
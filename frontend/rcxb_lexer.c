@@ -157,7 +157,7 @@ tokenloop:
 		if (!kw) {
 			/* assume name */
 			tok->type = NAME;
-			tok->u.name = string_ndup (ch, (int)(dh - ch));
+			tok->u.name = lexer_tokname (tok, ch, (int)(dh - ch));
 		} else if (kw == lrp->kw_rem) {
 			/* rem ... -- comment to end-of-line */
 			for (dh=ch+1; (dh < chlim) && (*dh != '\n') && (*dh != '\r'); dh++);
@@ -182,6 +182,12 @@ typedef struct TAG_cccsp_sfi_entry {
 	DYNARRAY (struct TAG_cccsp_sfi_entry *, children);	/* children of this one */
 	int framesize;				/* framesize as extracted from gcc */
 	int allocsize;				/* allocation size (framesize + max(children)) */
+	int estlocals;				/* bytes of locals counted for an estimate, -1 if not ours, -2 if unknown */
+	int calest, calsize;			/* estimate and actual framesize from calibration, -1 if none */
+	int estframe;				/* framesize set from an estimate (before reallocation), -1 if not */
+	int usedsize;				/* framesize the estimated build was compiled with */
+	int sccindex, scclow;			/* used when finding recursion (strongly connected components) */
+	int sccnext;				/* next child to visit */
 
 	int parfixup;				/* used when reallocating */
 } cccsp_sfi_entry_t;
@@ -190,6 +196,8 @@ typedef struct TAG_cccsp_sfi_entry {
 
 typedef struct TAG_cccsp_sfi {
 	STRINGHASH (cccsp_sfi_entry_t *, entries, SFIENTRIES_BITSIZE);
+	int calcount;				/* number of calibration entries loaded */
+	int calmargin;				/* most any estimate was found short by */
 } cccsp_sfi_t;
 
 extern int cccsp_sfi_init (void);
@@ -201,6 +209,12 @@ extern void cccsp_sfi_addchild (cccsp_sfi_entry_t *parent, cccsp_sfi_entry_t *ch
 extern int cccsp_sfi_loadcalls (const char *fname);
 extern int cccsp_sfi_loadusage (const char *fname);
 extern int cccsp_sfi_calc_alloc (void);
+extern int cccsp_sfi_canestimate (void);
+extern void cccsp_sfi_useestimates (int wordsize);
+extern void cccsp_sfi_startcheck (void);
+extern int cccsp_sfi_endcheck (void);
+extern int cccsp_sfi_loadcalib (const char *fname);
+extern int cccsp_sfi_savecalib (const char *fname, int wordsize);
 extern void cccsp_sfi_dumptable (struct TAG_fhandle *stream);
 
 extern int cccsp_sfi_error (struct TAG_tnode *node, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
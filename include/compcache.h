@@ -0,0 +1,36 @@
+/*
+ *	compcache.h -- build cache, reuses the outputs of an earlier identical compile
+ *	Copyright (C) 2016 Fred Barnes <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __COMPCACHE_H
+#define __COMPCACHE_H
+
+extern int compcache_enabled (void);
+extern int compcache_begin (int argc, char **argv);
+extern void compcache_end (int ok);
+
+extern void compcache_adddep (const char *path);
+extern void compcache_addoutput (const char *path);
+extern void compcache_nostore (const char *why);
+extern void compcache_addkey (const char *str);
+
+extern int compcache_init (void);
+extern int compcache_shutdown (void);
+
+#endif	/* !__COMPCACHE_H */
+
@@ -24,13 +24,27 @@ typedef struct TAG_crypto {
 	void *priv;
 } crypto_t;
 
+/* running content digest (see crypto_cdigestinit) */
+typedef struct TAG_cdigest {
+	crypto_t *cry;
+	unsigned long long hi, lo;
+} cdigest_t;
+
 
 extern crypto_t *crypto_newdigest (void);
 extern void crypto_freedigest (crypto_t *cry);
 extern int crypto_writedigest (crypto_t *cry, unsigned char *data, int bytes);
 extern char *crypto_readdigest (crypto_t *cry, int *issignedp);
+extern int crypto_havedigest (void);
 extern int crypto_signdigest (crypto_t *cry, char *privfile);
 
+extern void crypto_cdigestinit (cdigest_t *dg);
+extern void crypto_cdigestadd (cdigest_t *dg, const void *data, size_t len);
+extern void crypto_cdigeststr (cdigest_t *dg, const char *str);
+extern char *crypto_cdigestdone (cdigest_t *dg);
+extern char *crypto_cdigestdata (const void *data, size_t len);
+extern char *crypto_cdigestfile (const char *path);
+
 extern int crypto_verifykeyfile (const char *fname, int secure);
 extern int crypto_verifylibfile (const char *libfile, const char **pubkeys, int npubkeys);
 
@@ -48,6 +48,7 @@ typedef struct TAG_dfanode {
 	void *rarg;
 	void *dfainfo;			/* linked to a nameddfa_t node */
 	int incoming;			/* number of incoming transitions */
+	struct TAG_dfaindex *index;	/* compiled transition index (built when first used) */
 } dfanode_t;
 
 
@@ -117,6 +118,8 @@ extern int dfa_findmatch (dfanode_t *dfa, struct TAG_token *tok, dfanode_t **r_p
 extern dfanode_t *dfa_decoderule (const char *rule, ...);
 extern dfanode_t *dfa_decodetrans (const char *rule, ...);
 
+extern dfattbl_t *dfa_newttbl (void);
+extern dfattblent_t *dfa_newttblent (void);
 extern void dfa_freettbl (dfattbl_t *ttbl);
 extern void dfa_dumpttbl (struct TAG_fhandle *stream, dfattbl_t *ttbl);
 extern void dfa_dumpttbl_gra (struct TAG_fhandle *stream, dfattbl_t *ttbl);
@@ -131,6 +134,7 @@ extern void dfa_dumpdeferred (struct TAG_fhandle *stream);
 
 
 extern int dfa_advance (dfastate_t **dfast, struct TAG_parsepriv *pp, struct TAG_token *tok);
+extern void dfa_getstats (uint64_t *r_steps, uint64_t *r_tests);
 extern void dfa_pushnode (dfastate_t *dfast, struct TAG_tnode *node);
 extern struct TAG_tnode *dfa_popnode (dfastate_t *dfast);
 
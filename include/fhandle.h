@@ -23,12 +23,37 @@
 struct TAG_fhscheme;
 struct stat;
 
+/* output buffering modes for a file-handle */
+typedef enum ENUM_fhbufmode {
+	FHB_NONE = 0,			/* unbuffered, each write goes straight to the scheme */
+	FHB_WRITE = 1,			/* buffered in memory, written out in large chunks (with writev where possible) */
+	FHB_MMAP = 2			/* written into mapped windows of the file (falls back to FHB_WRITE) */
+} fhbufmode_e;
+
+/* host files seen by a watcher, see fhandle_setwatch() */
+typedef enum ENUM_fhwatch {
+	FHW_READ = 0,			/* opened for reading */
+	FHW_WRITE = 1,			/* opened for writing */
+	FHW_ABSENT = 2			/* looked for but not there */
+} fhwatch_e;
+
 typedef struct TAG_fhandle {
 	struct TAG_fhscheme *scheme;	/* particular scheme (implementation) */
 	void *ipriv;			/* private per-file for implementation */
 	char *path;			/* actual path (whole thing) */
 	char *spath;			/* scheme path (points into above), without leading file:// etc. */
 	int err;			/* last error associated with open-file */
+
+	fhbufmode_e wbufmode;		/* output buffering */
+	unsigned char *wbuf;		/* output buffer, or mapped window (NULL if unbuffered) */
+	int wbufsize;			/* size of the above */
+	int wbufused;			/* bytes in it */
+	int wbufdone;			/* bytes already passed to the sink (mapped windows only) */
+	size_t wbufoffs;		/* file offset of the mapped window */
+	void (*wsink)(void *, unsigned char *, int);	/* sees output in chunks as it leaves the buffer */
+	void *wsinkarg;
+	int wcalls;			/* output calls made to the scheme (statistics) */
+	size_t wbytes;			/* bytes written */
 } fhandle_t;
 
 extern fhandle_t *fhandle_fopen (const char *path, const char *mode);
@@ -49,6 +74,10 @@ extern int fhandle_write (fhandle_t *fh, unsigned char *buffer, int size);
 extern int fhandle_read (fhandle_t *fh, unsigned char *bufaddr, int max);
 extern int fhandle_gets (fhandle_t *fh, char *bufaddr, int max);
 extern int fhandle_flush (fhandle_t *fh);
+extern int fhandle_setbuffer (fhandle_t *fh, fhbufmode_e mode, int size);
+extern int fhandle_setsink (fhandle_t *fh, void (*sink)(void *, unsigned char *, int), void *arg);
+extern int fhandle_drain (fhandle_t *fh);
+extern void fhandle_setwatch (void (*watch)(void *, const char *, fhwatch_e), void *arg);
 extern int fhandle_isatty (fhandle_t *fh);
 extern int fhandle_ppxml (fhandle_t *fh, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
 extern int fhandle_vppxml (fhandle_t *fh, const char *fmt, va_list ap);
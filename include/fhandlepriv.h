@@ -22,6 +22,7 @@
 
 struct TAG_fhandle;
 struct stat;
+struct iovec;
 
 typedef struct TAG_fhscheme {
 	char *sname;			/* scheme name ("host") */
@@ -44,6 +45,9 @@ typedef struct TAG_fhscheme {
 	int (*getsfcn)(struct TAG_fhandle *, char *, int);
 	int (*flushfcn)(struct TAG_fhandle *);
 	int (*isattyfcn)(struct TAG_fhandle *);
+	int (*writevfcn)(struct TAG_fhandle *, struct iovec *, int);			/* optional */
+	int (*outmapfcn)(struct TAG_fhandle *, unsigned char **, size_t, size_t);	/* optional, extends file and maps writable */
+	int (*truncfcn)(struct TAG_fhandle *, size_t);					/* optional, sets length and position */
 } fhscheme_t;
 
 
@@ -70,6 +70,7 @@ typedef struct TAG_langdefent {
 			char *invbefore;		/* invalid before this pass in the compiler */
 		} tnode;
 	} u;
+	struct TAG_dfattbl *dfatbl;		/* pre-decoded table for DFATRANS and DFABNF (from a snapshot), or NULL */
 } langdefent_t;
 
 typedef struct TAG_langdefsec {
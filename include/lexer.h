@@ -43,6 +43,7 @@ struct TAG_langlexer;
 struct TAG_langparser;
 struct TAG_origin;
 struct TAG_fhandle;
+struct TAG_lexarena;
 
 
 typedef struct TAG_lexfile {
@@ -56,6 +57,7 @@ typedef struct TAG_lexfile {
 	int errcount;
 	int warncount;
 	DYNARRAY (struct TAG_token *, tokbuffer);
+	struct TAG_lexarena *arena;	/* tokens and their names/strings while open */
 
 	/* various flags */
 	unsigned int toplevel : 1;
@@ -93,6 +95,8 @@ typedef struct TAG_token {
 		void *lspec;						/* implementation specific use */
 	} u;
 	void *iptr;							/* implementation specific use (may not be pointer) */
+	struct TAG_lexarena *arena;					/* arena this token lives in (NULL if heap allocated) */
+	int strinarena;							/* non-zero if the name/string is in the arena (or interned) */
 } token_t;
 
 extern token_t *lexer_nexttoken (lexfile_t *lf);
@@ -104,6 +108,7 @@ extern void lexer_dumptoken (struct TAG_fhandle *stream, token_t *tok);
 extern void lexer_dumptoken_short (struct TAG_fhandle *stream, token_t *tok);
 extern char *lexer_stokenstr (token_t *tok);				/* pointer to static buffer returned */
 extern void lexer_freetoken (token_t *tok);
+extern char *lexer_claimname (token_t *tok);
 
 extern int lexer_tokmatch (token_t *formal, token_t *actual);
 extern int lexer_tokmatchlitstr (token_t *actual, const char *str);
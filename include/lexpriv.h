@@ -73,6 +73,13 @@ extern int lexer_unregisterlang (langlexer_t *ll);
 
 extern langlexer_t **lexer_getlanguages (int *nlangs);
 
+/* token allocation for language lexers */
+extern token_t *lexer_newlextoken (lexfile_t *lf);
+extern char *lexer_tokalloc (token_t *tok, int bytes);
+extern char *lexer_tokstrndup (token_t *tok, const char *str, int len);
+extern char *lexer_tokname (token_t *tok, const char *str, int len);
+extern char *lexer_scratch (lexfile_t *lf, const char *str, int len);
+
 
 #endif	/* !__LEXPRIV_H */
 
@@ -57,6 +57,7 @@ extern struct TAG_tnode *library_externaldecl (struct TAG_lexfile *lf, char *ext
 extern int library_setusenamespace (struct TAG_tnode *libusenode, char *nsname);
 
 extern int library_islibnode (struct TAG_tnode *node);
+extern int library_islibusenode (struct TAG_tnode *node);
 extern struct TAG_ntdef *library_getlibnodetag (void);
 
 extern int library_readlibanddigest (const char *libname, struct TAG_crypto *cry, char *srcname, char **algop, char **shashp, char **sdhashp);
@@ -25,12 +25,21 @@ struct TAG_namelist;
 struct TAG_scope;
 struct TAG_fhandle;
 struct TAG_ntdef;
+struct TAG_name;
 
 typedef struct TAG_namespace {
 	char *nspace;
 	struct TAG_namespace *nextns;
 } namespace_t;
 
+typedef struct TAG_namelazy {
+	int (*resolve)(struct TAG_name *, struct TAG_scope *);	/* scopes the real declaration, see name_addlazyscopenamess() */
+	void *hook;
+	int state;		/* 0 = not resolved, 1 = resolving, -1 = failed */
+	DYNARRAY (struct TAG_namespace *, defns);	/* scoper namespaces where the placeholder was added */
+	DYNARRAY (struct TAG_namespace *, usens);
+} namelazy_t;
+
 typedef struct TAG_name {
 	int refc;
 	struct TAG_tnode *decl;
@@ -39,6 +48,8 @@ typedef struct TAG_name {
 	namespace_t *ns;
 	struct TAG_namelist *me;
 	int lexlevel;
+	namelazy_t *lazy;	/* non-NULL for placeholder names not yet resolved */
+	struct TAG_name *resolved;	/* for resolved placeholder names, the real name */
 } name_t;
 
 typedef struct TAG_namelist {
@@ -63,6 +74,7 @@ extern void name_descopename (name_t *name);
 extern void name_delname (name_t *name);
 extern name_t *name_addname (char *str, struct TAG_tnode *decl, struct TAG_tnode *type, struct TAG_tnode *namenode);
 extern name_t *name_addtempname (struct TAG_tnode *decl, struct TAG_tnode *type, struct TAG_ntdef *nametag, struct TAG_tnode **namenode);
+extern name_t *name_addlazyscopenamess (char *str, int (*resolve)(name_t *, struct TAG_scope *), void *hook, struct TAG_scope *ss);
 
 extern namespace_t *name_findnamespace (char *nsname);
 extern namespace_t *name_findnamespacepfx (char *nsname);
@@ -355,6 +355,7 @@ extern void *occampi_stringtoken_to_hook (void *itok);
 /* option handlers inside occam-pi front-end */
 struct TAG_cmd_option;
 extern int occampi_lexer_opthandler_flag (struct TAG_cmd_option *opt, char ***argwalk, int *argleft);
+extern int occampi_parser_opthandler_flag (struct TAG_cmd_option *opt, char ***argwalk, int *argleft);
 extern int occampi_mwsync_opthandler_flag (struct TAG_cmd_option *opt, char ***argwalk, int *argleft);
 
 /* other useful functions */
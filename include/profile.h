@@ -0,0 +1,32 @@
+/*
+ *	profile.h -- per-stage and per-pass compiler profiling
+ *	Copyright (C) 2016 Fred Barnes <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+extern int profile_begin (const char *kind, const char *name);
+extern void profile_end (int idx);
+extern void profile_report (void);
+extern void profile_restart (void);
+
+extern int profile_init (void);
+extern int profile_shutdown (void);
+
+#endif	/* !__PROFILE_H */
+
@@ -0,0 +1,33 @@
+/*
+ *	server.h -- compile server, keeps an initialised compiler around for repeated compiles
+ *	Copyright (C) 2016 Fred Barnes <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __SERVER_H
+#define __SERVER_H
+
+extern int server_client (int argc, char **argv);
+
+extern int server_enabled (void);
+extern int server_run (int *argcp, char ***argvp);
+extern void server_decline (void);
+
+extern int server_init (void);
+extern int server_shutdown (void);
+
+#endif	/* !__SERVER_H */
+
@@ -30,6 +30,8 @@ static inline int bsr (int v)
 		"	bsr	%1,%0	\n" \
 		: "=r" (res) : "r" (v) : "cc");
 	return res;
+#elif defined (__GNUC__)
+	return v ? (31 - __builtin_clz ((unsigned int)v)) : 0;
 #else
 	unsigned int res;
 	int i;
@@ -52,6 +54,7 @@ extern int dmem_size_to_slot (int bytes);
 extern int dmem_size_of_addr (void *ptr);
 extern void *dmem_new (int idx);
 extern void *dmem_alloc (int size);
+extern void *dmem_zalloc (int size);
 extern void dmem_release (void *ptr);
 extern void dmem_usagedump (void);
 
@@ -59,6 +62,8 @@ extern void dmem_usagedump (void);
 
 #ifdef TRACE_MEMORY
 	#define smalloc(X) ss_malloc(__FILE__,__LINE__,X)
+	#define smalloc_nz(X) ss_malloc_nz(__FILE__,__LINE__,X)
+	#define scalloc(N,X) ss_calloc(__FILE__,__LINE__,N,X)
 	#define srealloc(X,A,B) ss_realloc(__FILE__,__LINE__,X,A,B)
 	#define sfree(X) ss_free(__FILE__,__LINE__,X)
 
@@ -68,6 +73,8 @@ extern void dmem_usagedump (void);
 	#define mem_ndup(X,A) ss_mem_ndup(__FILE__,__LINE__,X,A)
 
 	extern void *ss_malloc (const char *, const int, size_t);
+	extern void *ss_malloc_nz (const char *, const int, size_t);
+	extern void *ss_calloc (const char *, const int, size_t, size_t);
 	extern void *ss_realloc (const char *, const int, void *, size_t, size_t);
 	extern void ss_free (const char *, const int, void *);
 	extern void ss_cleanup (void);
@@ -78,6 +85,8 @@ extern void dmem_usagedump (void);
 	extern void *ss_mem_ndup (const char *, const int, const void *, int);
 #else
 	extern void *smalloc (size_t);
+	extern void *smalloc_nz (size_t);
+	extern void *scalloc (size_t, size_t);
 	extern void *srealloc (void *, size_t, size_t);
 	extern void sfree (void *);
 
@@ -87,6 +96,8 @@ extern void dmem_usagedump (void);
 	extern void *mem_ndup (const void *, int);
 #endif
 
+extern void smem_counters (unsigned long *nallocs, unsigned long *nreallocs, unsigned long *nfrees, unsigned long long *nbytes);
+
 extern char *string_fmt (const char *, ...) __attribute__ ((format (printf, 1, 2)));
 extern char *string_upper (const char *);
 extern char *string_lower (const char *);
@@ -150,109 +161,102 @@ extern int da_hasitem (int *cur, int *max, void ***array, void *item);
 #define dynarray_move(DSTARRAY,SRCARRAY) do { dynarray_trash(DSTARRAY); DA_PTR(DSTARRAY) = DA_PTR(SRCARRAY); \
 						DA_CUR(DSTARRAY) = DA_CUR(SRCARRAY); DA_MAX(DSTARRAY) = DA_MAX(SRCARRAY); dynarray_init (SRCARRAY); } while (0)
 
-/* stuff for string-based hashes */
+/* stuff for string-based and pointer-based hashes: open-addressed (robin-hood) tables that grow in powers of two,
+ * BITSIZE only gives the initial size.  duplicate keys are allowed, lookups find the earliest inserted */
+
+typedef struct TAG_hashtable {
+	void **items;			/* item in each slot */
+	void **keys;			/* key in each slot (char * for string-hashes) */
+	unsigned int *hashes;		/* cached hash-code for each slot, 0 if empty */
+	int size;			/* number of slots (0 until first insert) */
+	int count;			/* number of occupied slots */
+	int bitsize;			/* initial size */
+} hashtable_t;
+
+#define HT_INITIALISER(BITSIZE) {NULL, NULL, NULL, 0, 0, (BITSIZE)}
 
 #define SH_TABLE(NAME) NAME
-#define SH_KEYS(NAME) NAME ## _keys
-#define SH_BSIZES(NAME) NAME ## _bsizes
-#define SH_SIZE(NAME) NAME ## _size
-#define SH_BITSIZE(NAME) NAME ## _bitsize
 #define SH_LOOKUP(NAME) NAME ## _lookup
-#define STATICSTRINGHASH(TYPE,NAME,BITSIZE) static TYPE* SH_TABLE(NAME)[1 << (BITSIZE)]; \
-		static char** SH_KEYS(NAME)[1 << (BITSIZE)]; \
-		static int SH_BSIZES(NAME)[1 << (BITSIZE)]; \
-		static const int SH_SIZE(NAME) = (1 << (BITSIZE)); \
-		static const int SH_BITSIZE(NAME) = (BITSIZE); \
-		static TYPE (*SH_LOOKUP(NAME))(int *, void ***, char ***, int, char *) = (TYPE(*)(int *, void ***, char ***, int, char *))sh_lookup
-#define STRINGHASH(TYPE,NAME,BITSIZE) TYPE* SH_TABLE(NAME)[1 << (BITSIZE)]; \
-		char** SH_KEYS(NAME)[1 << (BITSIZE)]; \
-		int SH_BSIZES(NAME)[1 << (BITSIZE)]; \
-		int SH_SIZE(NAME); \
-		int SH_BITSIZE(NAME); \
-		TYPE (*SH_LOOKUP(NAME))(int *, void ***, char ***, int, char *)
+#define STATICSTRINGHASH(TYPE,NAME,BITSIZE) static hashtable_t SH_TABLE(NAME) = HT_INITIALISER(BITSIZE); \
+		static TYPE (*SH_LOOKUP(NAME))(hashtable_t *, char *) = (TYPE(*)(hashtable_t *, char *))sh_lookup
+#define STRINGHASH(TYPE,NAME,BITSIZE) hashtable_t SH_TABLE(NAME); \
+		TYPE (*SH_LOOKUP(NAME))(hashtable_t *, char *)
 
 
 #ifdef TRACE_MEMORY
-	#define sh_insert(X,A,B,C,D,E) ss_sh_insert(__FILE__,__LINE__,X,A,B,C,D,E)
-	#define sh_remove(X,A,B,C,D,E) ss_sh_remove(__FILE__,__LINE__,X,A,B,C,D,E)
-	#define sh_trash(X,A,B,C) ss_sh_trash(__FILE__,__LINE__,X,A,B,C)
+	#define sh_insert(X,A,B) ss_sh_insert(__FILE__,__LINE__,X,A,B)
+	#define sh_remove(X,A,B) ss_sh_remove(__FILE__,__LINE__,X,A,B)
+	#define sh_trash(X) ss_sh_trash(__FILE__,__LINE__,X)
 
-	extern void ss_sh_insert (const char *file, const int line, int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key);
-	extern void ss_sh_remove (const char *file, const int line, int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key);
-	extern void ss_sh_trash (const char *file, const int line, int *bsizes, void ***table, char ***keys, int size);
+	extern void ss_sh_insert (const char *file, const int line, hashtable_t *ht, void *item, char *key);
+	extern void ss_sh_remove (const char *file, const int line, hashtable_t *ht, void *item, char *key);
+	extern void ss_sh_trash (const char *file, const int line, hashtable_t *ht);
 #else
-	extern void sh_insert (int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key);
-	extern void sh_remove (int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key);
-	extern void sh_trash (int *bsizes, void ***table, char ***keys, int size);
+	extern void sh_insert (hashtable_t *ht, void *item, char *key);
+	extern void sh_remove (hashtable_t *ht, void *item, char *key);
+	extern void sh_trash (hashtable_t *ht);
 #endif
 
-extern void sh_init (int *bsizes, void ***table, char ***keys, int *szptr, int *bszptr, void **fnptr, int bitsize);
-extern void sh_sinit (int *bsizes, void ***table, char ***keys, int size);
-extern void *sh_lookup (int *bsizes, void ***table, char ***keys, int bitsize, char *match);
-extern void sh_dump (FILE *stream, int *bsizes, void ***table, char ***keys, int size);
-extern void sh_walk (int *bsizes, void ***table, char ***keys, int size, void (*func)(void *, char *, void *), void *p);
+extern void sh_init (hashtable_t *ht, void **fnptr, int bitsize);
+extern void sh_sinit (hashtable_t *ht);
+extern void *sh_lookup (hashtable_t *ht, char *match);
+extern void sh_dump (FILE *stream, hashtable_t *ht);
+extern void sh_walk (hashtable_t *ht, void (*func)(void *, char *, void *), void *p);
 extern unsigned int sh_stringhash (const char *str, const int len);
 
-#define stringhash_init(SHASH,BITSIZE) sh_init((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), &SH_SIZE(SHASH), &SH_BITSIZE(SHASH), (void *)&(SH_LOOKUP(SHASH)), (BITSIZE))
-#define stringhash_sinit(SHASH) sh_sinit((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_SIZE(SHASH))
-#define stringhash_insert(SHASH,ITEM,KEY) sh_insert((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_BITSIZE(SHASH), (void *)(ITEM), (char *)(KEY))
-#define stringhash_remove(SHASH,ITEM,KEY) sh_remove((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_BITSIZE(SHASH), (void *)(ITEM), (char *)(KEY))
-#define stringhash_lookup(SHASH,ITEM) SH_LOOKUP(SHASH) ((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_BITSIZE(SHASH), (char *)(ITEM))
-#define stringhash_dump(STREAM,SHASH) sh_dump((STREAM),(int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_SIZE(SHASH))
-#define stringhash_walk(SHASH,FUNC,P) sh_walk((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_SIZE(SHASH), (void (*)(void *, char *, void *))(FUNC), (P))
-#define stringhash_trash(SHASH) sh_trash((int *)&((SH_BSIZES(SHASH))[0]), (void ***)&((SH_TABLE(SHASH))[0]), (char ***)&((SH_KEYS(SHASH))[0]), SH_SIZE(SHASH))
+#define stringhash_init(SHASH,BITSIZE) sh_init(&SH_TABLE(SHASH), (void *)&(SH_LOOKUP(SHASH)), (BITSIZE))
+#define stringhash_sinit(SHASH) sh_sinit(&SH_TABLE(SHASH))
+#define stringhash_insert(SHASH,ITEM,KEY) sh_insert(&SH_TABLE(SHASH), (void *)(ITEM), (char *)(KEY))
+#define stringhash_remove(SHASH,ITEM,KEY) sh_remove(&SH_TABLE(SHASH), (void *)(ITEM), (char *)(KEY))
+#define stringhash_lookup(SHASH,ITEM) SH_LOOKUP(SHASH) (&SH_TABLE(SHASH), (char *)(ITEM))
+#define stringhash_dump(STREAM,SHASH) sh_dump((STREAM), &SH_TABLE(SHASH))
+#define stringhash_walk(SHASH,FUNC,P) sh_walk(&SH_TABLE(SHASH), (void (*)(void *, char *, void *))(FUNC), (P))
+#define stringhash_trash(SHASH) sh_trash(&SH_TABLE(SHASH))
 
 /* stuff for pointer-based hashes (keys are just the name) */
 
 #define PH_TABLE(NAME) NAME
-#define PH_KEYS(NAME) NAME ## _keys
-#define PH_BSIZES(NAME) NAME ## _bsizes
-#define PH_SIZE(NAME) NAME ## _size
-#define PH_BITSIZE(NAME) NAME ## _bitsize
 #define PH_LOOKUP(NAME) NAME ## _lookup
-#define STATICPOINTERHASH(TYPE,NAME,BITSIZE) static TYPE* PH_TABLE(NAME)[1 << (BITSIZE)]; \
-		static void **PH_KEYS(NAME)[1 << (BITSIZE)]; \
-		static int PH_BSIZES(NAME)[1 << (BITSIZE)]; \
-		static const int PH_SIZE(NAME) = (1 << (BITSIZE)); \
-		static const int PH_BITSIZE(NAME) = (BITSIZE); \
-		static TYPE (*PH_LOOKUP(NAME))(int *, void ***, void ***, int, void *) = (TYPE(*)(int *, void ***, void ***, int, void *))ph_lookup
-#define POINTERHASH(TYPE,NAME,BITSIZE) TYPE* PH_TABLE(NAME)[1 << (BITSIZE)]; \
-		void **PH_KEYS(NAME)[1 << (BITSIZE)]; \
-		int PH_BSIZES(NAME)[1 << (BITSIZE)]; \
-		int PH_SIZE(NAME); \
-		int PH_BITSIZE(NAME); \
-		TYPE (*PH_LOOKUP(NAME))(int *, void ***, void ***, int, void *)
+#define STATICPOINTERHASH(TYPE,NAME,BITSIZE) static hashtable_t PH_TABLE(NAME) = HT_INITIALISER(BITSIZE); \
+		static TYPE (*PH_LOOKUP(NAME))(hashtable_t *, void *) = (TYPE(*)(hashtable_t *, void *))ph_lookup
+#define POINTERHASH(TYPE,NAME,BITSIZE) hashtable_t PH_TABLE(NAME); \
+		TYPE (*PH_LOOKUP(NAME))(hashtable_t *, void *)
 
 #ifdef TRACE_MEMORY
-	#define ph_insert(X,A,B,C,D,E) ss_ph_insert(__FILE__,__LINE__,X,A,B,C,D,E)
-	#define ph_remove(X,A,B,C,D,E) ss_ph_remove(__FILE__,__LINE__,X,A,B,C,D,E)
-	#define ph_trash(X,A,B,C) ss_ph_trash(__FILE__,__LINE__,X,A,B,C)
+	#define ph_insert(X,A,B) ss_ph_insert(__FILE__,__LINE__,X,A,B)
+	#define ph_remove(X,A,B) ss_ph_remove(__FILE__,__LINE__,X,A,B)
+	#define ph_trash(X) ss_ph_trash(__FILE__,__LINE__,X)
 
-	extern void ss_ph_insert (const char *file, const int line, int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key);
-	extern void ss_ph_remove (const char *file, const int line, int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key);
-	extern void ss_ph_trash (const char *file, const int line, int *bsizes, void ***table, void ***keys, int size);
+	extern void ss_ph_insert (const char *file, const int line, hashtable_t *ht, void *item, void *key);
+	extern void ss_ph_remove (const char *file, const int line, hashtable_t *ht, void *item, void *key);
+	extern void ss_ph_trash (const char *file, const int line, hashtable_t *ht);
 #else
-	extern void ph_insert (int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key);
-	extern void ph_remove (int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key);
-	extern void ph_trash (int *bsizes, void ***table, void ***keys, int size);
+	extern void ph_insert (hashtable_t *ht, void *item, void *key);
+	extern void ph_remove (hashtable_t *ht, void *item, void *key);
+	extern void ph_trash (hashtable_t *ht);
 #endif
-extern void ph_init (int *bsizes, void ***table, void ***keys, int *szptr, int *bszptr, void **fnptr, int bitsize);
-extern void ph_sinit (int *bsizes, void ***table, void ***keys, int size);
-extern void *ph_lookup (int *bsizes, void ***table, void ***keys, int bitsize, void *match);
-extern void ph_dump (FILE *stream, int *bsizes, void ***table, void ***keys, int size);
-extern void ph_walk (int *bsizes, void ***table, void ***keys, int size, void (*func)(void *, void *, void *), void *p);
-extern void ph_lwalk (int *bsizes, void ***table, void ***keys, int bitsize, void *match, void (*func)(void *, void *, void *), void *p);
-
-#define pointerhash_init(PHASH,BITSIZE) ph_init((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), &PH_SIZE(PHASH), &PH_BITSIZE(PHASH), (void *)&(PH_LOOKUP(PHASH)), (BITSIZE))
-#define pointerhash_sinit(PHASH) ph_sinit((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_SIZE(PHASH))
-#define pointerhash_insert(PHASH,ITEM,KEY) ph_insert((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_BITSIZE(PHASH), (void *)(ITEM), (void *)(KEY))
-#define pointerhash_remove(PHASH,ITEM,KEY) ph_remove((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_BITSIZE(PHASH), (void *)(ITEM), (void *)(KEY))
-#define pointerhash_lookup(PHASH,KEY) PH_LOOKUP(PHASH) ((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_BITSIZE(PHASH), (void *)(KEY))
-#define pointerhash_dump(STREAM,PHASH) ph_dump((STREAM), (int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_SIZE(PHASH))
-#define pointerhash_walk(PHASH,FUNC,P) ph_walk((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_SIZE(PHASH), (void (*)(void *, void *, void *))(FUNC), (P))
-#define pointerhash_lwalk(PHASH,ITEM,FUNC,P) ph_walk((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_BITSIZE(PHASH), (void *)(ITEM), (void (*)(void *, void *, void *))(FUNC), (P))
-#define pointerhash_trash(PHASH) ph_trash((int *)&((PH_BSIZES(PHASH))[0]), (void ***)&((PH_TABLE(PHASH))[0]), (void ***)&((PH_KEYS(PHASH))[0]), PH_SIZE(PHASH))
-
+extern void ph_init (hashtable_t *ht, void **fnptr, int bitsize);
+extern void ph_sinit (hashtable_t *ht);
+extern void *ph_lookup (hashtable_t *ht, void *match);
+extern void ph_dump (FILE *stream, hashtable_t *ht);
+extern void ph_walk (hashtable_t *ht, void (*func)(void *, void *, void *), void *p);
+extern void ph_lwalk (hashtable_t *ht, void *match, void (*func)(void *, void *, void *), void *p);
+
+#define pointerhash_init(PHASH,BITSIZE) ph_init(&PH_TABLE(PHASH), (void *)&(PH_LOOKUP(PHASH)), (BITSIZE))
+#define pointerhash_sinit(PHASH) ph_sinit(&PH_TABLE(PHASH))
+#define pointerhash_insert(PHASH,ITEM,KEY) ph_insert(&PH_TABLE(PHASH), (void *)(ITEM), (void *)(KEY))
+#define pointerhash_remove(PHASH,ITEM,KEY) ph_remove(&PH_TABLE(PHASH), (void *)(ITEM), (void *)(KEY))
+#define pointerhash_lookup(PHASH,KEY) PH_LOOKUP(PHASH) (&PH_TABLE(PHASH), (void *)(KEY))
+#define pointerhash_dump(STREAM,PHASH) ph_dump((STREAM), &PH_TABLE(PHASH))
+#define pointerhash_walk(PHASH,FUNC,P) ph_walk(&PH_TABLE(PHASH), (void (*)(void *, void *, void *))(FUNC), (P))
+#define pointerhash_lwalk(PHASH,ITEM,FUNC,P) ph_lwalk(&PH_TABLE(PHASH), (void *)(ITEM), (void (*)(void *, void *, void *))(FUNC), (P))
+#define pointerhash_trash(PHASH) ph_trash(&PH_TABLE(PHASH))
+
+/* interned strings (never freed, equal strings intern to the same pointer) */
+
+extern char *string_intern (const char *str);
+extern char *string_nintern (const char *str, int len);
+extern void string_internstats (int *lookups, int *hits, int *nstrings, int *bytes, int *saved);
 
 /* other useful things */
 
@@ -284,5 +288,8 @@ extern void time_setin (struct timeval *t1, struct timeval *t2);
 #endif
 extern char *strstrip (char *str);
 
+#define MEM_HASH64_INIT 0xcbf29ce484222325ULL
+extern unsigned long long mem_hash64 (unsigned long long hval, const void *data, int len);
+
 #endif	/* !__SUPPORT_H */
 
@@ -100,6 +100,8 @@ struct TAG_map;
 struct TAG_codegen;
 struct TAG_uchk_state;
 struct TAG_origin;
+struct TAG_tnoderegion;
+struct TAG_chookset;
 
 /*{{{  srclocn_t definition*/
 typedef struct TAG_srclocn {
@@ -113,8 +115,9 @@ typedef struct TAG_tnode {
 	ntdef_t *tag;
 	srclocn_t *org;
 
-	DYNARRAY (void *, items);		/* general subnotes/name-nodes/hook-nodes */
-	DYNARRAY (void *, chooks);		/* compiler hooks */
+	DYNARRAY (void *, items);		/* general subnotes/name-nodes/hook-nodes (stored after the node) */
+	struct TAG_chookset *chooks;		/* compiler hooks (NULL if none) */
+	struct TAG_tnoderegion *region;		/* region this node was allocated in (NULL if heap) */
 } tnode_t;
 
 
@@ -315,6 +318,12 @@ extern tnode_t *tnode_copyoraliastree (tnode_t *t, copycontrol_e (*cora_fcn)(tno
 extern tnode_t *tnode_copytree (tnode_t *t);
 extern int tnode_substitute (tnode_t **tptr, tnode_t *curptr, tnode_t *newptr);
 extern void tnode_free (tnode_t *t);
+
+extern struct TAG_tnoderegion *tnode_newregion (void);
+extern struct TAG_tnoderegion *tnode_setregion (struct TAG_tnoderegion *rgn);
+extern void tnode_freeregion (struct TAG_tnoderegion *rgn);
+extern void tnode_nodecounts (int *created, int *live);
+
 extern void tnode_dumptree (tnode_t *t, int indent, struct TAG_fhandle *stream);
 extern void tnode_dumpstree (tnode_t *t, int indent, struct TAG_fhandle *stream);
 extern void tnode_dumpnodetypes (struct TAG_fhandle *stream);
@@ -325,6 +334,8 @@ extern int tnode_hascompop (compops_t *cops, char *name);
 extern int tnode_callcompop (compops_t *cops, char *name, int nparams, ...);
 extern int tnode_hascompop_i (compops_t *cops, int idx);
 extern int tnode_callcompop_i (compops_t *cops, int idx, int nparams, ...);
+extern int tnode_callcompop_i1 (compops_t *cops, int idx, void *arg0);
+extern int tnode_callcompop_i2 (compops_t *cops, int idx, void *arg0, void *arg1);
 extern int tnode_newcompop (char *name, compops_e opno, int nparams, struct TAG_origin *origin);
 extern compop_t *tnode_findcompop (char *name);
 extern void tnode_dumpcompops (compops_t *cops, struct TAG_fhandle *stream);
@@ -336,6 +347,8 @@ extern int tnode_haslangop (langops_t *lops, char *name);
 extern int64_t tnode_calllangop (langops_t *lops, char *name, int nparams, ...);
 extern int tnode_haslangop_i (langops_t *lops, int idx);
 extern int64_t tnode_calllangop_i (langops_t *lops, int idx, int nparams, ...);
+extern int64_t tnode_calllangop_i1 (langops_t *lops, int idx, void *arg0);
+extern int64_t tnode_calllangop_i2 (langops_t *lops, int idx, void *arg0, void *arg1);
 extern int tnode_newlangop (char *name, langops_e opno, int nparams, struct TAG_origin *origin);
 extern langop_t *tnode_findlangop (char *name);
 
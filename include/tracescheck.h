@@ -48,6 +48,12 @@ typedef struct TAG_tchknode {
 	tchknodetype_e type;
 	struct TAG_tnode *orgnode;			/* so we know where it came from */
 	int mark;
+	int refs;					/* hash-consed (shared, immutable) nodes: number of holders, 0 otherwise */
+	int simple;					/* hash-consed nodes: no single-item lists here or below */
+	unsigned int hval;				/* hash-consed nodes: structural hash */
+	struct TAG_tchknode *hnext;			/* hash-consed nodes: next in hash chain */
+	int closed;					/* tchk_isclosed() result, valid in the copy numbered closedgen */
+	unsigned int closedgen;
 	union {
 		struct {
 			DYNARRAY (struct TAG_tchknode *, items);
@@ -403,7 +403,7 @@ static int cprop_modpostwalktree (tnode_t **tptr, void *arg)
 		if (compopts.traceconstprop) {
 			nocc_message ("constprop: checking (%s,%s)", (*tptr)->tag->ndef->name, (*tptr)->tag->name);
 		}
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_CONSTPROP, 1, tptr);
+		i = tnode_callcompop_i1 ((*tptr)->tag->ndef->ops, (int)COPS_CONSTPROP, tptr);
 	}
 	return i;
 }
@@ -29,6 +29,9 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
 #include <errno.h>
 
 #include "nocc.h"
@@ -53,6 +56,34 @@
 #include "names.h"
 #include "target.h"
 #include "langdeflookup.h"
+#include "opts.h"
+
+
+/*}}}*/
+/*{{{  private types/data*/
+
+#define LDEFCACHE_MAGIC "NOCCLDC"		/* 8 bytes including terminator */
+#define LDEFCACHE_VERSION 1
+#define LDEFCACHE_ENDIAN 0x01020304
+
+/* reduction kinds for entries in snapshot DFA tables */
+#define LDCRED_NONE 0
+#define LDCRED_NAMED 1
+#define LDCRED_NULL 2
+#define LDCRED_INLIST 3
+
+typedef struct TAG_ldcbuf {
+	unsigned char *data;
+	int cur;
+	int max;
+	int err;
+} ldcbuf_t;
+
+static int ldef_usecache = 1;			/* cleared with --no-ldef-cache */
+static char *ldef_cachedir = NULL;		/* set with --ldef-cache-dir, else derived from compopts.cachedir */
+static int ldef_cachestate = 0;			/* 0 = not checked yet, 1 = usable, -1 = not usable */
+static int ldef_readdepth = 0;			/* nesting of .IMPORT reads */
+STATICDYNARRAY (char *, ldef_srcfiles);		/* files read for the current top-level definition */
 
 
 /*}}}*/
@@ -70,6 +101,7 @@ static langdefent_t *ldef_newlangdefent (void)
 	lde->lineno = 0;
 
 	lde->type = LDE_INVALID;
+	lde->dfatbl = NULL;
 	return lde;
 }
 /*}}}*/
@@ -105,6 +137,10 @@ static void ldef_freelangdefent (langdefent_t *lde)
 			sfree (lde->u.dfarule);
 			lde->u.dfarule = NULL;
 		}
+		if (lde->dfatbl) {
+			dfa_freettbl (lde->dfatbl);
+			lde->dfatbl = NULL;
+		}
 		break;
 	case LDE_KEYWORD:
 		if (lde->u.keyword) {
@@ -818,6 +854,7 @@ static int ldef_readlangdefs (langdef_t *ldef, const char *rfname)
 		nocc_error ("ldef_readlangdefs(): failed to open [%s]: %s", rfname, strerror (fhandle_lasterr (fhan)));
 		return -1;
 	}
+	dynarray_add (ldef_srcfiles, string_dup (rfname));
 
 	buf = (char *)smalloc (1024);
 	for (;;) {
@@ -944,6 +981,725 @@ out_local:
 }
 /*}}}*/
 
+/*{{{  static void ldc_wbytes (ldcbuf_t *lb, const void *data, int len)*/
+/*
+ *	appends raw bytes to a snapshot buffer
+ */
+static void ldc_wbytes (ldcbuf_t *lb, const void *data, int len)
+{
+	if ((lb->cur + len) > lb->max) {
+		int nmax = lb->max ? (lb->max << 1) : 4096;
+
+		while (nmax < (lb->cur + len)) {
+			nmax <<= 1;
+		}
+		lb->data = (unsigned char *)srealloc (lb->data, lb->max, nmax);
+		lb->max = nmax;
+	}
+	memcpy (lb->data + lb->cur, data, len);
+	lb->cur += len;
+	return;
+}
+/*}}}*/
+/*{{{  static void ldc_wint (ldcbuf_t *lb, int val)*/
+/*
+ *	appends an integer to a snapshot buffer
+ */
+static void ldc_wint (ldcbuf_t *lb, int val)
+{
+	int32_t v = (int32_t)val;
+
+	ldc_wbytes (lb, &v, sizeof (v));
+	return;
+}
+/*}}}*/
+/*{{{  static void ldc_wu64 (ldcbuf_t *lb, uint64_t val)*/
+/*
+ *	appends a 64-bit value to a snapshot buffer
+ */
+static void ldc_wu64 (ldcbuf_t *lb, uint64_t val)
+{
+	ldc_wbytes (lb, &val, sizeof (val));
+	return;
+}
+/*}}}*/
+/*{{{  static void ldc_wstr (ldcbuf_t *lb, const char *str)*/
+/*
+ *	appends a string (may be NULL) to a snapshot buffer
+ */
+static void ldc_wstr (ldcbuf_t *lb, const char *str)
+{
+	if (!str) {
+		ldc_wint (lb, -1);
+	} else {
+		int slen = strlen (str);
+
+		ldc_wint (lb, slen);
+		ldc_wbytes (lb, str, slen);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void ldc_rbytes (ldcbuf_t *lb, void *dest, int len)*/
+/*
+ *	reads raw bytes from a snapshot buffer, sets the error flag on overrun
+ */
+static void ldc_rbytes (ldcbuf_t *lb, void *dest, int len)
+{
+	if (lb->err || (len < 0) || ((lb->cur + len) > lb->max)) {
+		lb->err = 1;
+		memset (dest, 0, (len > 0) ? len : 0);
+		return;
+	}
+	memcpy (dest, lb->data + lb->cur, len);
+	lb->cur += len;
+	return;
+}
+/*}}}*/
+/*{{{  static int ldc_rint (ldcbuf_t *lb)*/
+/*
+ *	reads an integer from a snapshot buffer
+ */
+static int ldc_rint (ldcbuf_t *lb)
+{
+	int32_t v;
+
+	ldc_rbytes (lb, &v, sizeof (v));
+	return (int)v;
+}
+/*}}}*/
+/*{{{  static uint64_t ldc_ru64 (ldcbuf_t *lb)*/
+/*
+ *	reads a 64-bit value from a snapshot buffer
+ */
+static uint64_t ldc_ru64 (ldcbuf_t *lb)
+{
+	uint64_t v;
+
+	ldc_rbytes (lb, &v, sizeof (v));
+	return v;
+}
+/*}}}*/
+/*{{{  static char *ldc_rstr (ldcbuf_t *lb)*/
+/*
+ *	reads a string from a snapshot buffer
+ *	returns new string, or NULL (if the string was NULL or on error)
+ */
+static char *ldc_rstr (ldcbuf_t *lb)
+{
+	int slen = ldc_rint (lb);
+	char *str;
+
+	if (lb->err || (slen == -1)) {
+		return NULL;
+	}
+	if ((slen < 0) || ((lb->cur + slen) > lb->max)) {
+		lb->err = 1;
+		return NULL;
+	}
+	str = string_ndup ((char *)lb->data + lb->cur, slen);
+	lb->cur += slen;
+
+	return str;
+}
+/*}}}*/
+/*{{{  static int ldef_digestfile (const char *fname, uint64_t *dp)*/
+/*
+ *	computes a digest over the contents of a file
+ *	returns 0 on success, non-zero on failure
+ */
+static int ldef_digestfile (const char *fname, uint64_t *dp)
+{
+	struct stat stbuf;
+	uint64_t hval = MEM_HASH64_INIT;
+
+	if (fhandle_stat (fname, &stbuf)) {
+		return -1;
+	}
+	if (stbuf.st_size > 0) {
+		fhandle_t *fhan = fhandle_open (fname, O_RDONLY, 0);
+		unsigned char *buf;
+
+		if (!fhan) {
+			return -1;
+		}
+		buf = fhandle_mapfile (fhan, 0, (size_t)stbuf.st_size);
+		if (!buf) {
+			fhandle_close (fhan);
+			return -1;
+		}
+		hval = mem_hash64 (hval, buf, (int)stbuf.st_size);
+		fhandle_unmapfile (fhan, buf, 0, (size_t)stbuf.st_size);
+		fhandle_close (fhan);
+	}
+	*dp = hval;
+
+	return 0;
+}
+/*}}}*/
+/*{{{  static uint64_t ldef_snapshotkey (const char *rfname)*/
+/*
+ *	returns the key for a language definition snapshot: this build of the compiler plus where the definition was found
+ */
+static uint64_t ldef_snapshotkey (const char *rfname)
+{
+	static uint64_t buildid = 0;
+
+	if (!buildid) {
+		const char *vstr = version_string_long ();
+		const char *bstr = __DATE__ " " __TIME__;
+		struct stat stbuf;
+		int fmt = LDEFCACHE_VERSION;
+
+		buildid = mem_hash64 (MEM_HASH64_INIT, vstr, strlen (vstr));
+		buildid = mem_hash64 (buildid, bstr, strlen (bstr));
+		buildid = mem_hash64 (buildid, &fmt, sizeof (fmt));
+		if (!fhandle_stat ("/proc/self/exe", &stbuf)) {
+			/* catches rebuilds that did not touch this file */
+			buildid = mem_hash64 (buildid, &stbuf.st_size, sizeof (stbuf.st_size));
+			buildid = mem_hash64 (buildid, &stbuf.st_mtime, sizeof (stbuf.st_mtime));
+		}
+	}
+
+	return mem_hash64 (buildid, rfname, strlen (rfname));
+}
+/*}}}*/
+/*{{{  static int ldef_checkcachedir (void)*/
+/*
+ *	decides whether language definition snapshots can be used, creating the snapshot directory if needed
+ *	returns non-zero if usable, 0 otherwise
+ */
+static int ldef_checkcachedir (void)
+{
+	if (!ldef_cachestate) {
+		ldef_cachestate = -1;
+
+		if (ldef_usecache) {
+			if (!ldef_cachedir && compopts.cachedir) {
+				ldef_cachedir = string_fmt ("%s/ldef", compopts.cachedir);
+			}
+			if (ldef_cachedir) {
+				if (fhandle_access (ldef_cachedir, W_OK) && fhandle_mkdir (ldef_cachedir, 0700)) {
+					if (compopts.verbose) {
+						nocc_message ("not using language definition snapshots, failed to create [%s]: %s", ldef_cachedir,
+								strerror (fhandle_lasterr (NULL)));
+					}
+				} else {
+					ldef_cachestate = 1;
+				}
+			}
+		}
+	}
+
+	return (ldef_cachestate > 0);
+}
+/*}}}*/
+/*{{{  static char *ldef_snapshotpath (const char *fname, const char *rfname)*/
+/*
+ *	returns the snapshot file name for a particular language definition (one per definition found)
+ */
+static char *ldef_snapshotpath (const char *fname, const char *rfname)
+{
+	const char *base = strrchr (fname, '/');
+
+	base = base ? (base + 1) : fname;
+	return string_fmt ("%s/%s-%16.16llx.ldc", ldef_cachedir, base, mem_hash64 (MEM_HASH64_INIT, rfname, strlen (rfname)));
+}
+/*}}}*/
+/*{{{  static int ldef_ttblredkind (dfattblent_t *tblent)*/
+/*
+ *	determines how a DFA table entry's reduction can be recreated from a snapshot
+ *	returns LDCRED_..., or -1 if it cannot
+ */
+static int ldef_ttblredkind (dfattblent_t *tblent)
+{
+	if (tblent->rname) {
+		return LDCRED_NAMED;
+	} else if (!tblent->reduce) {
+		return LDCRED_NONE;
+	} else if ((tblent->reduce == parser_generic_reduce) && (tblent->rarg == parser_lookup_grule ("parser:nullreduce"))) {
+		return LDCRED_NULL;
+	} else if (tblent->reduce == parser_inlistreduce) {
+		return LDCRED_INLIST;
+	}
+	return -1;
+}
+/*}}}*/
+/*{{{  static void ldef_wttbl (ldcbuf_t *lb, dfattbl_t *ttbl)*/
+/*
+ *	writes a pre-decoded DFA table into a snapshot buffer.  tables holding
+ *	things that cannot be recreated from names (var-arg pointers) are left out.
+ */
+static void ldef_wttbl (ldcbuf_t *lb, dfattbl_t *ttbl)
+{
+	int i;
+
+	if (ttbl) {
+		for (i=0; i<DA_CUR (ttbl->entries); i++) {
+			dfattblent_t *tblent = DA_NTHITEM (ttbl->entries, i);
+
+			if (tblent->namedptr || (ldef_ttblredkind (tblent) < 0)) {
+				break;		/* for() */
+			}
+		}
+	}
+	if (!ttbl || (i < DA_CUR (ttbl->entries))) {
+		ldc_wint (lb, 0);
+		return;
+	}
+
+	ldc_wint (lb, 1);
+	ldc_wstr (lb, ttbl->name);
+	ldc_wint (lb, ttbl->op);
+	ldc_wint (lb, ttbl->nstates);
+	ldc_wint (lb, DA_CUR (ttbl->entries));
+	for (i=0; i<DA_CUR (ttbl->entries); i++) {
+		dfattblent_t *tblent = DA_NTHITEM (ttbl->entries, i);
+
+		ldc_wint (lb, tblent->s_state);
+		ldc_wint (lb, tblent->e_state);
+		ldc_wstr (lb, tblent->e_named);
+		ldc_wstr (lb, tblent->match);
+		ldc_wstr (lb, tblent->rname);
+		ldc_wint (lb, ldef_ttblredkind (tblent));
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static dfattbl_t *ldef_rttbl (ldcbuf_t *lb)*/
+/*
+ *	reads a pre-decoded DFA table from a snapshot buffer
+ *	returns table on success, NULL if not present or on error
+ */
+static dfattbl_t *ldef_rttbl (ldcbuf_t *lb)
+{
+	dfattbl_t *ttbl;
+	int i, nents;
+
+	if (!ldc_rint (lb) || lb->err) {
+		return NULL;
+	}
+
+	ttbl = dfa_newttbl ();
+	ttbl->name = ldc_rstr (lb);
+	ttbl->op = ldc_rint (lb);
+	ttbl->nstates = ldc_rint (lb);
+	nents = ldc_rint (lb);
+	for (i=0; (i<nents) && !lb->err; i++) {
+		dfattblent_t *tblent = dfa_newttblent ();
+
+		tblent->s_state = ldc_rint (lb);
+		tblent->e_state = ldc_rint (lb);
+		tblent->e_named = ldc_rstr (lb);
+		tblent->match = ldc_rstr (lb);
+		tblent->rname = ldc_rstr (lb);
+		switch (ldc_rint (lb)) {
+		case LDCRED_NULL:
+			tblent->reduce = parser_generic_reduce;
+			tblent->rarg = parser_lookup_grule ("parser:nullreduce");
+			break;
+		case LDCRED_INLIST:
+			tblent->reduce = parser_inlistreduce;
+			break;
+		default:
+			/* named reductions get resolved when the table is used */
+			break;
+		}
+		dynarray_add (ttbl->entries, tblent);
+	}
+
+	if (lb->err) {
+		dfa_freettbl (ttbl);
+		return NULL;
+	}
+	return ttbl;
+}
+/*}}}*/
+/*{{{  static void ldef_resolvettbl (dfattbl_t *ttbl)*/
+/*
+ *	resolves named reductions in a pre-decoded DFA table, as dfa_transtotbl() or dfa_bnftotbl() would have done
+ */
+static void ldef_resolvettbl (dfattbl_t *ttbl)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (ttbl->entries); i++) {
+		dfattblent_t *tblent = DA_NTHITEM (ttbl->entries, i);
+		char *rname = tblent->rname;
+		int rlen;
+
+		if (!rname || ((rlen = strlen (rname)) < 2) || (rname[0] != '{')) {
+			continue;
+		}
+		if ((rname[1] == '<') && (rlen >= 4)) {
+			char *rdx = string_ndup (rname + 2, rlen - 4);
+
+			tblent->rarg = parser_lookup_grule (rdx);
+			tblent->reduce = tblent->rarg ? parser_generic_reduce : NULL;
+			sfree (rdx);
+		} else {
+			char *rdx = string_ndup (rname + 1, rlen - 2);
+
+			tblent->reduce = parser_lookup_reduce (rdx);
+			tblent->rarg = tblent->reduce ? parser_lookup_rarg (rdx) : NULL;
+			sfree (rdx);
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void ldef_predecode (langdef_t *ldef)*/
+/*
+ *	decodes DFA rules in a freshly read language definition ahead of time, so that they can be
+ *	put into a snapshot.  rules that fail to decode are left for langdef_init_dfatrans() to report.
+ */
+static void ldef_predecode (langdef_t *ldef)
+{
+	int i, j;
+
+	for (i=0; i<DA_CUR (ldef->sections); i++) {
+		langdefsec_t *lsec = DA_NTHITEM (ldef->sections, i);
+
+		for (j=0; j<DA_CUR (lsec->ents); j++) {
+			langdefent_t *lde = DA_NTHITEM (lsec->ents, j);
+
+			if (lde->dfatbl) {
+				continue;
+			} else if (lde->type == LDE_DFATRANS) {
+				lde->dfatbl = dfa_transtotbl (lde->u.dfarule);
+			} else if (lde->type == LDE_DFABNF) {
+				lde->dfatbl = dfa_bnftotbl (lde->u.dfarule);
+			}
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static int ldef_savesnapshot (langdef_t *ldef, const char *spath, const char *rfname, int srcstart)*/
+/*
+ *	writes a snapshot of a language definition (including pre-decoded DFA tables).  written
+ *	to a temporary file then renamed into place, so concurrent compiles see either old or new.
+ *	returns 0 on success, non-zero on failure
+ */
+static int ldef_savesnapshot (langdef_t *ldef, const char *spath, const char *rfname, int srcstart)
+{
+	ldcbuf_t lb = {NULL, 0, 0, 0};
+	char magic[8] = LDEFCACHE_MAGIC;
+	fhandle_t *fhan;
+	char *tmpname;
+	int i, j, k;
+	int rval = 0;
+
+	/*{{{  header and source files*/
+	ldc_wbytes (&lb, magic, 8);
+	ldc_wint (&lb, LDEFCACHE_VERSION);
+	ldc_wint (&lb, LDEFCACHE_ENDIAN);
+	ldc_wu64 (&lb, ldef_snapshotkey (rfname));
+
+	ldc_wint (&lb, DA_CUR (ldef_srcfiles) - srcstart);
+	for (i=srcstart; i<DA_CUR (ldef_srcfiles); i++) {
+		char *sfname = DA_NTHITEM (ldef_srcfiles, i);
+		uint64_t digest;
+
+		if (ldef_digestfile (sfname, &digest)) {
+			sfree (lb.data);
+			return -1;
+		}
+		ldc_wstr (&lb, sfname);
+		ldc_wu64 (&lb, digest);
+	}
+
+	/*}}}*/
+	/*{{{  definition*/
+	ldc_wstr (&lb, ldef->ident);
+	ldc_wstr (&lb, ldef->desc);
+	ldc_wstr (&lb, ldef->maintainer);
+	ldc_wstr (&lb, ldef->version);
+	ldc_wint (&lb, DA_CUR (ldef->sections));
+	for (i=0; i<DA_CUR (ldef->sections); i++) {
+		langdefsec_t *lsec = DA_NTHITEM (ldef->sections, i);
+
+		ldc_wstr (&lb, lsec->ident);
+		ldc_wint (&lb, DA_CUR (lsec->ents));
+		for (j=0; j<DA_CUR (lsec->ents); j++) {
+			langdefent_t *lde = DA_NTHITEM (lsec->ents, j);
+
+			ldc_wint (&lb, (int)lde->type);
+			ldc_wint (&lb, lde->lineno);
+			switch (lde->type) {
+			case LDE_INVALID:
+				break;
+			case LDE_GRL:
+			case LDE_RFUNC:
+				ldc_wstr (&lb, lde->u.redex.name);
+				ldc_wstr (&lb, lde->u.redex.desc);
+				break;
+			case LDE_DFATRANS:
+			case LDE_DFABNF:
+				ldc_wstr (&lb, lde->u.dfarule);
+				ldef_wttbl (&lb, lde->dfatbl);
+				break;
+			case LDE_KEYWORD:
+				ldc_wstr (&lb, lde->u.keyword);
+				break;
+			case LDE_SYMBOL:
+				ldc_wstr (&lb, lde->u.symbol);
+				break;
+			case LDE_DFAERR:
+				ldc_wstr (&lb, lde->u.dfaerror.dfaname);
+				ldc_wint (&lb, lde->u.dfaerror.source);
+				ldc_wint (&lb, lde->u.dfaerror.rcode);
+				ldc_wstr (&lb, lde->u.dfaerror.msg);
+				break;
+			case LDE_TNODE:
+				ldc_wstr (&lb, lde->u.tnode.name);
+				ldc_wint (&lb, lde->u.tnode.nsub);
+				ldc_wint (&lb, lde->u.tnode.nname);
+				ldc_wint (&lb, lde->u.tnode.nhook);
+				ldc_wint (&lb, DA_CUR (lde->u.tnode.descs));
+				for (k=0; k<DA_CUR (lde->u.tnode.descs); k++) {
+					ldc_wstr (&lb, DA_NTHITEM (lde->u.tnode.descs, k));
+				}
+				ldc_wstr (&lb, lde->u.tnode.invbefore);
+				ldc_wstr (&lb, lde->u.tnode.invafter);
+				break;
+			}
+		}
+	}
+
+	/*}}}*/
+	/*{{{  trailing check digest*/
+	ldc_wu64 (&lb, mem_hash64 (MEM_HASH64_INIT, lb.data, lb.cur));
+
+	/*}}}*/
+	/*{{{  write out*/
+	tmpname = string_fmt ("%s.%d.tmp", spath, (int)getpid ());
+	fhan = fhandle_fopen (tmpname, "w");
+	if (!fhan) {
+		rval = -1;
+	} else {
+		if (fhandle_write (fhan, lb.data, lb.cur) != lb.cur) {
+			rval = -1;
+		}
+		if (fhandle_close (fhan)) {
+			rval = -1;
+		}
+		if (!rval && rename (tmpname, spath)) {
+			rval = -1;
+		}
+		if (rval) {
+			unlink (tmpname);
+		}
+	}
+	if (rval && compopts.verbose) {
+		nocc_message ("failed to write language definition snapshot [%s]", spath);
+	}
+	sfree (tmpname);
+	sfree (lb.data);
+
+	/*}}}*/
+	return rval;
+}
+/*}}}*/
+/*{{{  static langdef_t *ldef_loadsnapshot (const char *spath, const char *rfname)*/
+/*
+ *	loads a language definition from a snapshot, if there is a valid one that is up-to-date
+ *	returns langdef_t structure on success, NULL if not
+ */
+static langdef_t *ldef_loadsnapshot (const char *spath, const char *rfname)
+{
+	struct stat stbuf;
+	fhandle_t *fhan;
+	unsigned char *buf;
+	ldcbuf_t lb = {NULL, 0, 0, 0};
+	langdef_t *ldef = NULL;
+	char magic[8];
+	char *why = NULL;
+	uint64_t digest;
+	int i, j, k, n;
+
+	if (fhandle_stat (spath, &stbuf) || (stbuf.st_size < (int)(8 + 3 * sizeof (int32_t) + 2 * sizeof (uint64_t)))) {
+		return NULL;
+	}
+	fhan = fhandle_open (spath, O_RDONLY, 0);
+	if (!fhan) {
+		return NULL;
+	}
+	buf = fhandle_mapfile (fhan, 0, (size_t)stbuf.st_size);
+	if (!buf) {
+		fhandle_close (fhan);
+		return NULL;
+	}
+
+	lb.data = buf;
+	lb.max = (int)stbuf.st_size - sizeof (uint64_t);
+
+	/*{{{  check header, trailer and source files*/
+	memcpy (&digest, buf + lb.max, sizeof (uint64_t));
+	if (digest != mem_hash64 (MEM_HASH64_INIT, buf, lb.max)) {
+		why = "corrupt";
+		goto out_local;
+	}
+	ldc_rbytes (&lb, magic, 8);
+	if (memcmp (magic, LDEFCACHE_MAGIC, 8) || (ldc_rint (&lb) != LDEFCACHE_VERSION) || (ldc_rint (&lb) != LDEFCACHE_ENDIAN)) {
+		why = "from an incompatible version";
+		goto out_local;
+	}
+	if (ldc_ru64 (&lb) != ldef_snapshotkey (rfname)) {
+		why = "from a different build";
+		goto out_local;
+	}
+	n = ldc_rint (&lb);
+	for (i=0; (i<n) && !lb.err; i++) {
+		char *sfname = ldc_rstr (&lb);
+		uint64_t sdigest = ldc_ru64 (&lb);
+
+		if (!sfname || ldef_digestfile (sfname, &digest) || (digest != sdigest)) {
+			why = "out of date";
+		}
+		if (sfname) {
+			sfree (sfname);
+		}
+		if (why) {
+			goto out_local;
+		}
+	}
+
+	/*}}}*/
+	/*{{{  definition*/
+	ldef = ldef_newlangdef ();
+	ldef->ident = ldc_rstr (&lb);
+	ldef->desc = ldc_rstr (&lb);
+	ldef->maintainer = ldc_rstr (&lb);
+	ldef->version = ldc_rstr (&lb);
+
+	n = ldc_rint (&lb);
+	for (i=0; (i<n) && !lb.err; i++) {
+		langdefsec_t *lsec = ldef_newlangdefsec ();
+		int nents;
+
+		lsec->ldef = ldef;
+		lsec->ident = ldc_rstr (&lb);
+		dynarray_add (ldef->sections, lsec);
+
+		nents = ldc_rint (&lb);
+		for (j=0; (j<nents) && !lb.err; j++) {
+			langdefent_t *lde = ldef_newlangdefent ();
+
+			lde->ldef = ldef;
+			lde->type = (langdefent_e)ldc_rint (&lb);
+			lde->lineno = ldc_rint (&lb);
+			switch (lde->type) {
+			case LDE_INVALID:
+				break;
+			case LDE_GRL:
+			case LDE_RFUNC:
+				lde->u.redex.name = ldc_rstr (&lb);
+				lde->u.redex.desc = ldc_rstr (&lb);
+				break;
+			case LDE_DFATRANS:
+			case LDE_DFABNF:
+				lde->u.dfarule = ldc_rstr (&lb);
+				lde->dfatbl = ldef_rttbl (&lb);
+				break;
+			case LDE_KEYWORD:
+				lde->u.keyword = ldc_rstr (&lb);
+				break;
+			case LDE_SYMBOL:
+				lde->u.symbol = ldc_rstr (&lb);
+				break;
+			case LDE_DFAERR:
+				lde->u.dfaerror.dfaname = ldc_rstr (&lb);
+				lde->u.dfaerror.source = ldc_rint (&lb);
+				lde->u.dfaerror.rcode = ldc_rint (&lb);
+				lde->u.dfaerror.msg = ldc_rstr (&lb);
+				break;
+			case LDE_TNODE:
+				lde->u.tnode.name = ldc_rstr (&lb);
+				lde->u.tnode.nsub = ldc_rint (&lb);
+				lde->u.tnode.nname = ldc_rint (&lb);
+				lde->u.tnode.nhook = ldc_rint (&lb);
+				dynarray_init (lde->u.tnode.descs);
+				k = ldc_rint (&lb);
+				for (; (k > 0) && !lb.err; k--) {
+					dynarray_add (lde->u.tnode.descs, ldc_rstr (&lb));
+				}
+				lde->u.tnode.invbefore = ldc_rstr (&lb);
+				lde->u.tnode.invafter = ldc_rstr (&lb);
+				break;
+			default:
+				lde->type = LDE_INVALID;
+				lb.err = 1;
+				break;
+			}
+			dynarray_add (lsec->ents, lde);
+		}
+	}
+	if (lb.err || (lb.cur != lb.max)) {
+		why = "corrupt";
+		ldef_freelangdef (ldef);
+		ldef = NULL;
+	}
+
+	/*}}}*/
+
+out_local:
+	if (why && compopts.verbose) {
+		nocc_message ("language definition snapshot [%s] is %s, ignoring", spath, why);
+	}
+	fhandle_unmapfile (fhan, buf, 0, (size_t)stbuf.st_size);
+	fhandle_close (fhan);
+
+	return ldef;
+}
+/*}}}*/
+/*{{{  static int ldef_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	called to handle language definition command-line options
+ *	returns 0 on success, non-zero on failure
+ */
+static int ldef_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	int optv = (int)((uint64_t)opt->arg);
+
+	switch (optv) {
+		/*{{{  1 -- disable snapshots*/
+	case 1:
+		ldef_usecache = 0;
+		break;
+		/*}}}*/
+		/*{{{  2 -- set snapshot directory*/
+	case 2:
+		{
+			char *ch = strchr (**argwalk, '=');
+
+			if (ch) {
+				ch++;
+			} else {
+				(*argwalk)++;
+				(*argleft)--;
+				if (!**argwalk || !*argleft) {
+					nocc_error ("missing argument for option --%s", opt->name);
+					(*argwalk)--, (*argleft)++;
+					return -1;
+				}
+				ch = **argwalk;
+			}
+			if (ldef_cachedir) {
+				sfree (ldef_cachedir);
+			}
+			ldef_cachedir = string_dup (ch);
+		}
+		break;
+		/*}}}*/
+	default:
+		nocc_error ("ldef_opthandler(): unknown option [%s]", **argwalk);
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
+
 
 /*{{{  langdefsec_t *langdef_findsection (langdef_t *ldef, const char *ident)*/
 /*
@@ -1146,7 +1902,16 @@ dfattbl_t **langdef_init_dfatrans (langdefsec_t *lsec, int *ntrans)
 				break;
 			case LDE_DFATRANS:
 				{
-					dfattbl_t *dfat = dfa_transtotbl (lde->u.dfarule);
+					dfattbl_t *dfat;
+
+					if (lde->dfatbl) {
+						/* pre-decoded, take it */
+						dfat = lde->dfatbl;
+						lde->dfatbl = NULL;
+						ldef_resolvettbl (dfat);
+					} else {
+						dfat = dfa_transtotbl (lde->u.dfarule);
+					}
 
 					if (!dfat) {
 						nocc_error ("invalid DFA transition table in language definition for [%s (%s)], line %d", lsec->ldef->ident, lsec->ident, lde->lineno);
@@ -1163,7 +1928,16 @@ dfattbl_t **langdef_init_dfatrans (langdefsec_t *lsec, int *ntrans)
 				break;
 			case LDE_DFABNF:
 				{
-					dfattbl_t *dfat = dfa_bnftotbl (lde->u.dfarule);
+					dfattbl_t *dfat;
+
+					if (lde->dfatbl) {
+						/* pre-decoded, take it */
+						dfat = lde->dfatbl;
+						lde->dfatbl = NULL;
+						ldef_resolvettbl (dfat);
+					} else {
+						dfat = dfa_bnftotbl (lde->u.dfarule);
+					}
 
 					if (!dfat) {
 						nocc_error ("invalid DFA BNF in language definition for [%s (%s)], line %d", lsec->ldef->ident, lsec->ident, lde->lineno);
@@ -1274,13 +2048,17 @@ int langdef_treecheck_setup (langdef_t *ldef)
 
 /*{{{  langdef_t *langdef_readdefs (const char *fname)*/
 /*
- *	reads a language definition file (epaths searched for these if not absolute or in the CWD)
+ *	reads a language definition file (epaths searched for these if not absolute or in the CWD).
+ *	uses an up-to-date snapshot if there is one, otherwise parses and writes a new snapshot.
  *	returns langdef_t structure on success, NULL on failure
  */
 langdef_t *langdef_readdefs (const char *fname)
 {
 	langdef_t *ldef = NULL;
 	char *rfname;
+	char *spath = NULL;
+	int fromsnapshot = 0;
+	struct timeval t_start, t_end;
 
 	if (!access (fname, R_OK)) {
 		rfname = string_dup (fname);
@@ -1303,18 +2081,54 @@ langdef_t *langdef_readdefs (const char *fname)
 		}
 	}
 
-	ldef = ldef_newlangdef ();
-	if (ldef_readlangdefs (ldef, rfname)) {
-		/* failed, return NULL */
-		ldef_freelangdef (ldef);
-		ldef = NULL;
-	} else {
-		ldef->cursec = NULL;
-		if (compopts.verbose) {
-			nocc_message ("language definitions loaded, [%s] version [%s]", ldef->desc ?: rfname, ldef->version ?: "(none)");
+	gettimeofday (&t_start, NULL);
+	if (!ldef_readdepth && ldef_checkcachedir ()) {
+		spath = ldef_snapshotpath (fname, rfname);
+		ldef = ldef_loadsnapshot (spath, rfname);
+		fromsnapshot = (ldef != NULL);
+	}
+
+	if (!ldef) {
+		int srcstart = DA_CUR (ldef_srcfiles);
+
+		ldef_readdepth++;
+		ldef = ldef_newlangdef ();
+		if (ldef_readlangdefs (ldef, rfname)) {
+			/* failed, return NULL */
+			ldef_freelangdef (ldef);
+			ldef = NULL;
+		} else {
+			ldef->cursec = NULL;
 		}
+		ldef_readdepth--;
+
+		if (ldef && spath) {
+			ldef_predecode (ldef);
+			ldef_savesnapshot (ldef, spath, rfname, srcstart);
+		}
+		if (!ldef_readdepth) {
+			int i;
+
+			for (i=0; i<DA_CUR (ldef_srcfiles); i++) {
+				sfree (DA_NTHITEM (ldef_srcfiles, i));
+			}
+			dynarray_trash (ldef_srcfiles);
+			dynarray_init (ldef_srcfiles);
+		}
+	}
+
+	if (ldef && compopts.verbose) {
+		int usecs;
+
+		gettimeofday (&t_end, NULL);
+		usecs = ((int)(t_end.tv_sec - t_start.tv_sec) * 1000000) + (int)(t_end.tv_usec - t_start.tv_usec);
+		nocc_message ("language definitions loaded, [%s] version [%s] (%s, %d.%3.3d ms)", ldef->desc ?: rfname, ldef->version ?: "(none)",
+				fromsnapshot ? "snapshot" : "parsed", usecs / 1000, usecs % 1000);
 	}
 
+	if (spath) {
+		sfree (spath);
+	}
 	sfree (rfname);
 
 	return ldef;
@@ -1341,6 +2155,11 @@ void langdef_freelangdef (langdef_t *ldef)
  */
 int langdef_init (void)
 {
+	dynarray_init (ldef_srcfiles);
+
+	opts_add ("no-ldef-cache", '\0', ldef_opthandler, (void *)1, "1do not use or write language definition snapshots");
+	opts_add ("ldef-cache-dir", '\0', ldef_opthandler, (void *)2, "1directory for language definition snapshots (default <cachedir>/ldef)");
+
 	return 0;
 }
 /*}}}*/
@@ -1351,6 +2170,12 @@ int langdef_init (void)
  */
 int langdef_shutdown (void)
 {
+	if (ldef_cachedir) {
+		sfree (ldef_cachedir);
+		ldef_cachedir = NULL;
+	}
+	dynarray_trash (ldef_srcfiles);
+
 	return 0;
 }
 /*}}}*/
@@ -60,7 +60,7 @@ static int langops_getdescriptor_walk (tnode_t *node, void *ptr)
 		return 0;
 	}
 	if (node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETDESCRIPTOR)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETDESCRIPTOR, 2, node, (char **)ptr);
+		r = tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_GETDESCRIPTOR, node, (char **)ptr);
 	} else {
 		r = 1;
 	}
@@ -90,7 +90,7 @@ static int langops_getname_walk (tnode_t *node, void *ptr)
 		return 0;
 	}
 	if (node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETNAME)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETNAME, 2, node, (char **)ptr);
+		r = tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_GETNAME, node, (char **)ptr);
 		if (r < 0) {
 			r = 1;		/* try again down the tree */
 		}
@@ -123,7 +123,7 @@ int langops_isconst (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_ISCONST)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_ISCONST, 1, node);
+		r = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_ISCONST, node);
 	}
 	if (compopts.traceconstprop) {
 		nocc_message ("langops: isconst? (%s,%s) = %d", node->tag->ndef->name, node->tag->name, r);
@@ -145,7 +145,7 @@ int langops_isdefpointer (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_ISDEFPOINTER)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_ISDEFPOINTER, 1, node);
+		r = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_ISDEFPOINTER, node);
 	}
 	return r;
 }
@@ -166,7 +166,7 @@ int64_t langops_constvalof (tnode_t *node, void *ptr)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_CONSTVALOF)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_CONSTVALOF, 2, node, ptr);
+		r = tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_CONSTVALOF, node, ptr);
 	} else {
 		tnode_warning (node, "extracting non-existant constant value!");
 	}
@@ -188,7 +188,7 @@ int langops_constsizeof (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_CONSTSIZEOF)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_CONSTSIZEOF, 1, node);
+		r = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_CONSTSIZEOF, node);
 	}
 	if (compopts.traceconstprop) {
 		nocc_message ("langops: constsizeof? (%s,%s) = %d", node->tag->ndef->name, node->tag->name, r);
@@ -210,7 +210,7 @@ int langops_valbyref (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_VALBYREF)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_VALBYREF, 1, node);
+		r = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_VALBYREF, node);
 	}
 
 	return r;
@@ -269,7 +269,7 @@ int langops_isaddressable (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_ISADDRESSABLE)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_ISADDRESSABLE, 1, node);
+		r = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_ISADDRESSABLE, node);
 	}
 	return r;
 }
@@ -301,7 +301,7 @@ int langops_isvar (tnode_t *node)
 
 		r = (nvar == nitems);
 	} else if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_ISVAR)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_ISVAR, 1, node);
+		r = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_ISVAR, node);
 	}
 	return r;
 }
@@ -317,7 +317,7 @@ tnode_t *langops_retypeconst (tnode_t *node, tnode_t *type)
 
 	/* does the operation on the type, rather than the operand */
 	if (type && type->tag->ndef->lops && tnode_haslangop_i (type->tag->ndef->lops, (int)LOPS_RETYPECONST)) {
-		nc = (tnode_t *)tnode_calllangop_i (type->tag->ndef->lops, (int)LOPS_RETYPECONST, 2, node, type);
+		nc = (tnode_t *)tnode_calllangop_i2 (type->tag->ndef->lops, (int)LOPS_RETYPECONST, node, type);
 	}
 	return nc;
 }
@@ -337,7 +337,7 @@ tnode_t *langops_dimtreeof (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_DIMTREEOF)) {
-		dt = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_DIMTREEOF, 1, node);
+		dt = (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_DIMTREEOF, node);
 	}
 	return dt;
 }
@@ -358,9 +358,9 @@ tnode_t *langops_dimtreeof_node (tnode_t *node, tnode_t *varnode)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_DIMTREEOF_NODE)) {
-		dt = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_DIMTREEOF_NODE, 2, node, varnode);
+		dt = (tnode_t *)tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_DIMTREEOF_NODE, node, varnode);
 	} else if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_DIMTREEOF)) {
-		dt = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_DIMTREEOF, 1, node);
+		dt = (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_DIMTREEOF, node);
 	}
 
 	return dt;
@@ -376,7 +376,7 @@ tnode_t *langops_hiddenparamsof (tnode_t *node)
 	tnode_t *hp = NULL;
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_HIDDENPARAMSOF)) {
-		hp = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_HIDDENPARAMSOF, 1, node);
+		hp = (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_HIDDENPARAMSOF, node);
 	}
 	return hp;
 }
@@ -391,7 +391,7 @@ int langops_hiddenslotsof (tnode_t *node)
 	int n = 0;
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_HIDDENSLOTSOF)) {
-		n = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_HIDDENSLOTSOF, 1, node);
+		n = tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_HIDDENSLOTSOF, node);
 	}
 	return n;
 }
@@ -452,7 +452,7 @@ tnode_t *langops_getbasename (tnode_t *node)
 		return NULL;
 	}
 	while (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETBASENAME)) {
-		node = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETBASENAME, 1, node);
+		node = (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_GETBASENAME, node);
 	}
 	return node;
 }
@@ -470,7 +470,7 @@ tnode_t *langops_getfieldname (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETFIELDNAME)) {
-		return (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETFIELDNAME, 1, node);
+		return (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_GETFIELDNAME, node);
 	}
 	return NULL;
 }
@@ -490,7 +490,7 @@ tnode_t *langops_getfieldnamelist (tnode_t *node)
 	}
 
 	while (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETFIELDNAME)) {
-		tnode_t *field = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETFIELDNAME, 1, node);
+		tnode_t *field = (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_GETFIELDNAME, node);
 
 		if (field) {
 #if 0
@@ -521,7 +521,7 @@ int langops_iscommunicable (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_ISCOMMUNICABLE)) {
-		return tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_ISCOMMUNICABLE, 1, node);
+		return tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_ISCOMMUNICABLE, node);
 	}
 	return 0;
 }
@@ -539,7 +539,7 @@ tnode_t *langops_gettags (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETTAGS)) {
-		return (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETTAGS, 1, node);
+		return (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_GETTAGS, node);
 	}
 	return NULL;
 }
@@ -557,7 +557,7 @@ name_t *langops_nameof (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_NAMEOF)) {
-		return (name_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_NAMEOF, 1, node);
+		return (name_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_NAMEOF, node);
 	}
 	return NULL;
 }
@@ -575,7 +575,7 @@ tnode_t *langops_tracespecof (tnode_t *node)
 	}
 
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_TRACESPECOF)) {
-		return (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_TRACESPECOF, 1, node);
+		return (tnode_t *)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_TRACESPECOF, node);
 	}
 	return NULL;
 }
@@ -593,7 +593,7 @@ static int langops_getctypeof_walk (tnode_t *node, void *ptr)
 		return 0;
 	}
 	if (node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GETCTYPEOF)) {
-		r = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETCTYPEOF, 2, node, (char **)ptr);
+		r = tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_GETCTYPEOF, node, (char **)ptr);
 		if (r < 0) {
 			r = 1;		/* try again down the tree */
 		}
@@ -619,7 +619,7 @@ void langops_getctypeof (tnode_t *node, char **str)
 int langops_guesstlp (tnode_t *node)
 {
 	if (node && node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_GUESSTLP)) {
-		return (int)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GUESSTLP, 1, node);
+		return (int)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_GUESSTLP, node);
 	}
 	return 0;
 }
@@ -632,7 +632,7 @@ int langops_guesstlp (tnode_t *node)
 tnode_t *langops_initcall (tnode_t *type, tnode_t *name)
 {
 	if (type && type->tag->ndef->lops && tnode_haslangop_i (type->tag->ndef->lops, (int)LOPS_INITCALL)) {
-		return (tnode_t *)tnode_calllangop_i (type->tag->ndef->lops, (int)LOPS_INITCALL, 2, type, name);
+		return (tnode_t *)tnode_calllangop_i2 (type->tag->ndef->lops, (int)LOPS_INITCALL, type, name);
 	}
 	return NULL;
 }
@@ -645,7 +645,7 @@ tnode_t *langops_initcall (tnode_t *type, tnode_t *name)
 tnode_t *langops_freecall (tnode_t *type, tnode_t *name)
 {
 	if (type && type->tag->ndef->lops && tnode_haslangop_i (type->tag->ndef->lops, (int)LOPS_FREECALL)) {
-		return (tnode_t *)tnode_calllangop_i (type->tag->ndef->lops, (int)LOPS_FREECALL, 2, type, name);
+		return (tnode_t *)tnode_calllangop_i2 (type->tag->ndef->lops, (int)LOPS_FREECALL, type, name);
 	}
 	return NULL;
 }
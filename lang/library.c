@@ -26,9 +26,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <errno.h>
 
 #include "nocc.h"
@@ -56,6 +59,7 @@
 #include "map.h"
 #include "codegen.h"
 #include "crypto.h"
+#include "compcache.h"
 #include "target.h"
 #include "treeops.h"
 #include "xml.h"
@@ -105,10 +109,48 @@ typedef struct TAG_libfile {
 	DYNARRAY (char *, autoinclude);
 	DYNARRAY (char *, autouse);
 	DYNARRAY (libfile_metadata_t *, mdata);
+	int isbinary;		/* non-zero if read from a binary library */
 
 	/* below used when parsing, not general info! */
 	libfile_srcunit_t *curunit;
 } libfile_t;
+/*}}}*/
+/*{{{  binary library-file private types*/
+
+/*
+ *	binary libraries hold the same information as the XML ones, laid out so that they can be used directly from a
+ *	mapping of the file: a fixed header, the library/source-unit/entry records, a symbol table of entries sorted by
+ *	name and a table of NUL-terminated strings.  all references are offsets (records and symbols from the start of
+ *	the file, strings from the start of the string table), so nothing depends on where the file is mapped.
+ */
+
+#define LIBBIN_MAGIC "NOCCXLB"			/* 8 bytes including terminator */
+#define LIBBIN_VERSION 1
+#define LIBBIN_ENDIAN 0x01020304
+#define LIBBIN_HDRSIZE (8 + 8 * (int)sizeof (int32_t))
+
+typedef struct TAG_libbinbuf {
+	unsigned char *data;
+	int cur;
+	int max;
+	int err;
+} libbinbuf_t;
+
+typedef struct TAG_libbinfile {
+	fhandle_t *fhan;
+	unsigned char *data;
+	int size;
+	int recoff, reclen;	/* library record (and everything below it) */
+	int symoff, nsyms;	/* symbol table: pairs of (name, entry-offset), sorted by name */
+	int stroff, strsize;	/* string table */
+} libbinfile_t;
+
+typedef struct TAG_libbinsym {
+	char *name;
+	int nameoff;		/* in the string table */
+	int offset;		/* of the entry record */
+} libbinsym_t;
+
 /*}}}*/
 /*{{{  private types*/
 /*{{{  library definition*/
@@ -159,8 +201,15 @@ typedef struct TAG_libusenodehook {
 	libfile_t *libdata;
 	tnode_t *decltree;
 	DYNARRAY (tnode_t *, decls);
+	int lazy;		/* descriptors parsed on first use, see lib_resolvelazyname() */
+	DYNARRAY (struct TAG_liblazyname *, lazynames);
 } libusenodehook_t;
 
+typedef struct TAG_liblazyname {
+	libusenodehook_t *lunh;
+	libfile_entry_t *lfent;
+} liblazyname_t;
+
 
 /*}}}*/
 /*}}}*/
@@ -178,6 +227,8 @@ static ntdef_t *tag_templibusenode = NULL;
 static char *libpath = NULL;
 static char *scpath = NULL;
 static int allpublic = 0;
+static int libformat = 0;		/* 0 = as found (XML for new libraries), 1 = XML, 2 = binary */
+static int lazydescs = 1;		/* cleared with --no-lib-lazy */
 
 static chook_t *libchook = NULL;
 static chook_t *uselinkchook = NULL;
@@ -253,6 +304,34 @@ static int lib_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
 		scpath = string_dup (ch);
 		break;
 		/*}}}*/
+		/*{{{  --lib-format <xml|binary>*/
+	case 4:
+		if ((ch = strchr (**argwalk, '=')) != NULL) {
+			ch++;
+		} else {
+			(*argwalk)++;
+			(*argleft)--;
+			if (!**argwalk || !*argleft) {
+				nocc_error ("missing argument for option %s", (*argwalk)[-1]);
+				return -1;
+			}
+			ch = **argwalk;
+		}
+		if (!strcmp (ch, "xml")) {
+			libformat = 1;
+		} else if (!strcmp (ch, "binary")) {
+			libformat = 2;
+		} else {
+			nocc_error ("unknown library format [%s], expected \"xml\" or \"binary\"", ch);
+			return -1;
+		}
+		break;
+		/*}}}*/
+		/*{{{  --no-lib-lazy*/
+	case 5:
+		lazydescs = 0;
+		break;
+		/*}}}*/
 	default:
 		nocc_error ("lib_opthandler(): unknown option [%s]", **argwalk);
 		return -1;
@@ -746,6 +825,8 @@ static libusenodehook_t *lib_newlibusenodehook (lexfile_t *lf, char *libname)
 	lunh->libdata = NULL;
 	lunh->decltree = NULL;
 	dynarray_init (lunh->decls);
+	lunh->lazy = 0;
+	dynarray_init (lunh->lazynames);
 
 	return lunh;
 }
@@ -768,6 +849,10 @@ static void lib_libusenodehook_free (void *hook)
 			}
 		}
 		dynarray_trash (lunh->decls);
+		for (i=0; i<DA_CUR (lunh->lazynames); i++) {
+			sfree (DA_NTHITEM (lunh->lazynames, i));
+		}
+		dynarray_trash (lunh->lazynames);
 
 		if (lunh->libname) {
 			sfree (lunh->libname);
@@ -1215,6 +1300,385 @@ static void lib_freelibfile (libfile_t *lf)
 }
 /*}}}*/
 
+/*{{{  static void lib_bin_wbytes (libbinbuf_t *lb, const void *data, int len)*/
+/*
+ *	appends raw bytes to a binary library buffer
+ */
+static void lib_bin_wbytes (libbinbuf_t *lb, const void *data, int len)
+{
+	if ((lb->cur + len) > lb->max) {
+		int nmax = lb->max ? (lb->max << 1) : 1024;
+
+		while (nmax < (lb->cur + len)) {
+			nmax <<= 1;
+		}
+		lb->data = (unsigned char *)srealloc (lb->data, lb->max, nmax);
+		lb->max = nmax;
+	}
+	memcpy (lb->data + lb->cur, data, len);
+	lb->cur += len;
+	return;
+}
+/*}}}*/
+/*{{{  static void lib_bin_wint (libbinbuf_t *lb, int val)*/
+/*
+ *	appends an integer to a binary library buffer
+ */
+static void lib_bin_wint (libbinbuf_t *lb, int val)
+{
+	int32_t v = (int32_t)val;
+
+	lib_bin_wbytes (lb, &v, sizeof (v));
+	return;
+}
+/*}}}*/
+/*{{{  static void lib_bin_wstr (libbinbuf_t *lb, libbinbuf_t *strs, const char *str, int len)*/
+/*
+ *	adds a string (or raw data if len is not -1) to the string table and appends its offset, -1 if NULL
+ */
+static void lib_bin_wstr (libbinbuf_t *lb, libbinbuf_t *strs, const char *str, int len)
+{
+	if (!str) {
+		lib_bin_wint (lb, -1);
+	} else {
+		lib_bin_wint (lb, strs->cur);
+		lib_bin_wbytes (strs, str, (len < 0) ? strlen (str) : len);
+		lib_bin_wbytes (strs, "", 1);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void lib_bin_wmetadata (libbinbuf_t *lb, libbinbuf_t *strs, libfile_metadata_t *lmd)*/
+/*
+ *	appends a meta-data record to a binary library buffer
+ */
+static void lib_bin_wmetadata (libbinbuf_t *lb, libbinbuf_t *strs, libfile_metadata_t *lmd)
+{
+	lib_bin_wstr (lb, strs, lmd->name, -1);
+	lib_bin_wstr (lb, strs, lmd->data, lmd->dlen);
+	lib_bin_wint (lb, lmd->dlen);
+	return;
+}
+/*}}}*/
+/*{{{  static int lib_bin_rint (libbinbuf_t *lb)*/
+/*
+ *	reads an integer from a binary library buffer, sets the error flag on overrun
+ */
+static int lib_bin_rint (libbinbuf_t *lb)
+{
+	int32_t v;
+
+	if (lb->err || ((lb->cur + (int)sizeof (v)) > lb->max)) {
+		lb->err = 1;
+		return 0;
+	}
+	memcpy (&v, lb->data + lb->cur, sizeof (v));
+	lb->cur += sizeof (v);
+	return (int)v;
+}
+/*}}}*/
+/*{{{  static const char *lib_bin_strat (libbinfile_t *lbf, int soff)*/
+/*
+ *	returns a string from the string table of a mapped binary library, in place
+ *	returns NULL if soff is -1 or not a valid string
+ */
+static const char *lib_bin_strat (libbinfile_t *lbf, int soff)
+{
+	const char *str;
+
+	if ((soff < 0) || (soff >= lbf->strsize)) {
+		return NULL;
+	}
+	str = (const char *)lbf->data + lbf->stroff + soff;
+	if (!memchr (str, '\0', lbf->strsize - soff)) {
+		return NULL;
+	}
+	return str;
+}
+/*}}}*/
+/*{{{  static char *lib_bin_rstr (libbinfile_t *lbf, libbinbuf_t *lb)*/
+/*
+ *	reads a string reference from a binary library buffer
+ *	returns new string, or NULL (if the string was NULL or on error)
+ */
+static char *lib_bin_rstr (libbinfile_t *lbf, libbinbuf_t *lb)
+{
+	int soff = lib_bin_rint (lb);
+	const char *str;
+
+	if (lb->err || (soff == -1)) {
+		return NULL;
+	}
+	str = lib_bin_strat (lbf, soff);
+	if (!str) {
+		lb->err = 1;
+		return NULL;
+	}
+	return string_dup (str);
+}
+/*}}}*/
+/*{{{  static libfile_metadata_t *lib_bin_rmetadata (libbinfile_t *lbf, libbinbuf_t *lb)*/
+/*
+ *	reads a meta-data record from a binary library buffer
+ *	returns new libfile_metadata_t on success, NULL on failure
+ */
+static libfile_metadata_t *lib_bin_rmetadata (libbinfile_t *lbf, libbinbuf_t *lb)
+{
+	libfile_metadata_t *lmd = lib_newlibfile_metadata ();
+	int doff;
+
+	lmd->name = lib_bin_rstr (lbf, lb);
+	doff = lib_bin_rint (lb);
+	lmd->dlen = lib_bin_rint (lb);
+	if (!lb->err && (doff >= 0) && (doff < lbf->strsize) && (lmd->dlen >= 0) && (lmd->dlen < (lbf->strsize - doff))) {
+		lmd->data = string_ndup ((char *)lbf->data + lbf->stroff + doff, lmd->dlen);
+	} else {
+		lb->err = 1;
+	}
+	if (lb->err) {
+		lib_freelibfile_metadata (lmd);
+		return NULL;
+	}
+	return lmd;
+}
+/*}}}*/
+/*{{{  static libfile_entry_t *lib_bin_rentry (libbinfile_t *lbf, libbinbuf_t *lb)*/
+/*
+ *	reads an entry record from a binary library buffer
+ *	returns new libfile_entry_t on success, NULL on failure
+ */
+static libfile_entry_t *lib_bin_rentry (libbinfile_t *lbf, libbinbuf_t *lb)
+{
+	libfile_entry_t *lfe = lib_newlibfile_entry ();
+	int i, n;
+
+	lfe->name = lib_bin_rstr (lbf, lb);
+	lfe->langname = lib_bin_rstr (lbf, lb);
+	lfe->targetname = lib_bin_rstr (lbf, lb);
+	lfe->descriptor = lib_bin_rstr (lbf, lb);
+	lfe->ws = lib_bin_rint (lb);
+	lfe->vs = lib_bin_rint (lb);
+	lfe->ms = lib_bin_rint (lb);
+	lfe->adjust = lib_bin_rint (lb);
+
+	n = lib_bin_rint (lb);
+	for (i=0; !lb->err && (i<n); i++) {
+		libfile_metadata_t *lmd = lib_bin_rmetadata (lbf, lb);
+
+		if (lmd) {
+			dynarray_add (lfe->mdata, lmd);
+		}
+	}
+	if (lb->err) {
+		lib_freelibfile_entry (lfe);
+		return NULL;
+	}
+	return lfe;
+}
+/*}}}*/
+/*{{{  static libbinfile_t *lib_bin_open (const char *fname)*/
+/*
+ *	maps a binary library file and checks its header, does not read anything else
+ *	returns new libbinfile_t on success, NULL if this is not a (usable) binary library
+ */
+static libbinfile_t *lib_bin_open (const char *fname)
+{
+	struct stat stbuf;
+	libbinfile_t *lbf;
+	libbinbuf_t lb = {NULL, 0, 0, 0};
+
+	if (fhandle_stat (fname, &stbuf) || (stbuf.st_size < LIBBIN_HDRSIZE) || (stbuf.st_size > INT_MAX)) {
+		return NULL;
+	}
+	lbf = (libbinfile_t *)smalloc (sizeof (libbinfile_t));
+	lbf->size = (int)stbuf.st_size;
+	lbf->fhan = fhandle_open (fname, O_RDONLY, 0);
+	if (!lbf->fhan) {
+		sfree (lbf);
+		return NULL;
+	}
+	lbf->data = fhandle_mapfile (lbf->fhan, 0, (size_t)lbf->size);
+	if (!lbf->data || memcmp (lbf->data, LIBBIN_MAGIC, 8)) {
+		goto out_fail;
+	}
+
+	lb.data = lbf->data;
+	lb.cur = 8;
+	lb.max = LIBBIN_HDRSIZE;
+	if ((lib_bin_rint (&lb) != LIBBIN_VERSION) || (lib_bin_rint (&lb) != LIBBIN_ENDIAN)) {
+		nocc_warning ("binary library %s is from an incompatible version of the compiler", fname);
+		goto out_fail;
+	}
+	lbf->recoff = lib_bin_rint (&lb);
+	lbf->reclen = lib_bin_rint (&lb);
+	lbf->symoff = lib_bin_rint (&lb);
+	lbf->nsyms = lib_bin_rint (&lb);
+	lbf->stroff = lib_bin_rint (&lb);
+	lbf->strsize = lib_bin_rint (&lb);
+
+	/* each offset must be within the file, then each length no more than what is left after it */
+	if (lb.err || (lbf->recoff < LIBBIN_HDRSIZE) || (lbf->recoff > lbf->size) ||
+			(lbf->symoff < LIBBIN_HDRSIZE) || (lbf->symoff > lbf->size) ||
+			(lbf->stroff < LIBBIN_HDRSIZE) || (lbf->stroff > lbf->size) ||
+			(lbf->reclen < 0) || ((size_t)lbf->reclen > (size_t)(lbf->size - lbf->recoff)) ||
+			(lbf->nsyms < 0) || ((size_t)lbf->nsyms > ((size_t)(lbf->size - lbf->symoff) / (2 * sizeof (int32_t)))) ||
+			(lbf->strsize < 0) || ((size_t)lbf->strsize > (size_t)(lbf->size - lbf->stroff))) {
+		nocc_warning ("binary library %s is corrupt", fname);
+		goto out_fail;
+	}
+	return lbf;
+
+out_fail:
+	if (lbf->data) {
+		fhandle_unmapfile (lbf->fhan, lbf->data, 0, (size_t)lbf->size);
+	}
+	fhandle_close (lbf->fhan);
+	sfree (lbf);
+	return NULL;
+}
+/*}}}*/
+/*{{{  static void lib_bin_close (libbinfile_t *lbf)*/
+/*
+ *	unmaps and closes a binary library file
+ */
+static void lib_bin_close (libbinfile_t *lbf)
+{
+	fhandle_unmapfile (lbf->fhan, lbf->data, 0, (size_t)lbf->size);
+	fhandle_close (lbf->fhan);
+	sfree (lbf);
+	return;
+}
+/*}}}*/
+/*{{{  static int lib_bin_isbinary (const char *fname)*/
+/*
+ *	determines whether a library file is in the binary format (by its magic bytes)
+ *	returns non-zero if binary, zero otherwise
+ */
+static int lib_bin_isbinary (const char *fname)
+{
+	fhandle_t *fhan = fhandle_open (fname, O_RDONLY, 0);
+	unsigned char magic[8];
+	int r = 0;
+
+	if (!fhan) {
+		return 0;
+	}
+	if ((fhandle_read (fhan, magic, 8) == 8) && !memcmp (magic, LIBBIN_MAGIC, 8)) {
+		r = 1;
+	}
+	fhandle_close (fhan);
+	return r;
+}
+/*}}}*/
+/*{{{  static int lib_bin_readlibrary (libfile_t *lf, const char *fname)*/
+/*
+ *	reads a binary library file into a (blank) libfile_t
+ *	returns 0 on success, non-zero on failure
+ */
+static int lib_bin_readlibrary (libfile_t *lf, const char *fname)
+{
+	libbinfile_t *lbf = lib_bin_open (fname);
+	libbinbuf_t lb = {NULL, 0, 0, 0};
+	int i, j, n, nunits;
+
+	if (!lbf) {
+		return -1;
+	}
+	lb.data = lbf->data;
+	lb.cur = lbf->recoff;
+	lb.max = lbf->recoff + lbf->reclen;
+
+	lf->isbinary = 1;
+	/*{{{  library record*/
+	lf->libname = lib_bin_rstr (lbf, &lb);
+	lf->namespace = lib_bin_rstr (lbf, &lb);
+	lf->nativelib = lib_bin_rstr (lbf, &lb);
+
+	n = lib_bin_rint (&lb);
+	for (i=0; !lb.err && (i<n); i++) {
+		char *ifile = lib_bin_rstr (lbf, &lb);
+
+		if (ifile) {
+			dynarray_add (lf->autoinclude, ifile);
+		}
+	}
+	n = lib_bin_rint (&lb);
+	for (i=0; !lb.err && (i<n); i++) {
+		char *lfile = lib_bin_rstr (lbf, &lb);
+
+		if (lfile) {
+			dynarray_add (lf->autouse, lfile);
+		}
+	}
+	n = lib_bin_rint (&lb);
+	for (i=0; !lb.err && (i<n); i++) {
+		libfile_metadata_t *lmd = lib_bin_rmetadata (lbf, &lb);
+
+		if (lmd) {
+			dynarray_add (lf->mdata, lmd);
+		}
+	}
+
+	/*}}}*/
+	/*{{{  source-unit records, each followed by its entries*/
+	nunits = lib_bin_rint (&lb);
+	for (i=0; !lb.err && (i<nunits); i++) {
+		libfile_srcunit_t *lfsu = lib_newlibfile_srcunit ();
+
+		dynarray_add (lf->srcs, lfsu);
+		lfsu->fname = lib_bin_rstr (lbf, &lb);
+		lfsu->hashalgo = lib_bin_rstr (lbf, &lb);
+		lfsu->hashvalue = lib_bin_rstr (lbf, &lb);
+		lfsu->dhashvalue = lib_bin_rstr (lbf, &lb);
+		lfsu->issigned = lib_bin_rint (&lb);
+
+		n = lib_bin_rint (&lb);
+		for (j=0; !lb.err && (j<n); j++) {
+			libfile_metadata_t *lmd = lib_bin_rmetadata (lbf, &lb);
+
+			if (lmd) {
+				dynarray_add (lfsu->mdata, lmd);
+			}
+		}
+		n = lib_bin_rint (&lb);
+		for (j=0; !lb.err && (j<n); j++) {
+			libfile_entry_t *lfe = lib_bin_rentry (lbf, &lb);
+
+			if (lfe) {
+				dynarray_add (lfsu->entries, lfe);
+			}
+		}
+		if (!lfsu->fname) {
+			lb.err = 1;
+		}
+	}
+
+	/*}}}*/
+	lib_bin_close (lbf);
+
+	if (lb.err) {
+		nocc_error ("lib_bin_readlibrary(): binary library %s is corrupt", fname);
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static int lib_bin_comparesyms (libbinsym_t *s1, libbinsym_t *s2)*/
+/*
+ *	compares two symbols by name, for sorting the symbol table
+ */
+static int lib_bin_comparesyms (libbinsym_t *s1, libbinsym_t *s2)
+{
+	int r = strcmp (s1->name, s2->name);
+
+	if (!r) {
+		/* keep library order for same-named entries */
+		r = s1->offset - s2->offset;
+	}
+	return r;
+}
+/*}}}*/
+
 
 /*{{{  static void lib_xmlhandler_init (xmlhandler_t *xh)*/
 /*
@@ -1686,15 +2150,14 @@ static libfile_t *lib_newlibrary (char *libname)
 	return lf;
 }
 /*}}}*/
-/*{{{  static libfile_t *lib_readlibrary (const char *libname, int using)*/
+/*{{{  static int lib_findlibfile (const char *libname, int using, char *fbuf)*/
 /*
- *	reads a library-file and returns it, returns NULL on failure.
- *	Will return a blank library if none exists, unless "using" is true (in which case compiler library paths are searched)
+ *	works out the file-name for a library, placed in fbuf (FILENAME_MAX bytes).  if "using" is true the library must
+ *	exist, and compiler library paths are searched for it (as .xlb or .xlo);  otherwise this is where it will be written.
+ *	returns 0 on success, non-zero if not found
  */
-static libfile_t *lib_readlibrary (const char *libname, int using)
+static int lib_findlibfile (const char *libname, int using, char *fbuf)
 {
-	libfile_t *lf = NULL;
-	char fbuf[FILENAME_MAX];
 	int flen = 0;
 	int i;
 
@@ -1766,7 +2229,7 @@ fprintf (stderr, "lib_readlibrary(): trying [%s]\n", fbuf);
 				}
 				if (!flen) {
 					/* none found */
-					return NULL;
+					return -1;
 				}
 			}
 		}
@@ -1785,12 +2248,39 @@ fprintf (stderr, "lib_readlibrary(): trying [%s]\n", fbuf);
 		flen += snprintf (fbuf + flen, FILENAME_MAX - (flen + 2), "%s.xlb", libname);
 	}
 
+	return 0;
+}
+/*}}}*/
+/*{{{  static libfile_t *lib_readlibrary (const char *libname, int using)*/
+/*
+ *	reads a library-file and returns it, returns NULL on failure.
+ *	Will return a blank library if none exists, unless "using" is true (in which case compiler library paths are searched)
+ */
+static libfile_t *lib_readlibrary (const char *libname, int using)
+{
+	libfile_t *lf = NULL;
+	char fbuf[FILENAME_MAX];
+	int i;
+
+	if (lib_findlibfile (libname, using, fbuf)) {
+		return NULL;
+	}
+
 	lf = lib_newlibfile ();
 	lf->fname = string_dup (fbuf);
-	if (!access (fbuf, R_OK)) {
+	if (!access (fbuf, R_OK) && lib_bin_isbinary (fbuf)) {
+		/*{{{  read binary file*/
+		if (lib_bin_readlibrary (lf, fbuf)) {
+			nocc_error ("lib_readlibrary(): failed to read binary library in: %s", fbuf);
+			lib_freelibfile (lf);
+			lf = NULL;
+		}
+		/*}}}*/
+	} else if (!access (fbuf, R_OK)) {
 		/*{{{  read file*/
 		xmlhandler_t *lfxh;
 
+		compcache_adddep (fbuf);		/* not read through the fhandle layer */
 		lfxh = xml_new_handler ();
 		lfxh->uhook = (void *)lf;
 		lfxh->init = lib_xmlhandler_init;
@@ -1833,6 +2323,141 @@ static int lib_writelibrary_metadata (fhandle_t *libstream, int indent, libfile_
 	return 0;
 }
 /*}}}*/
+/*{{{  static int lib_bin_writelibrary (libfile_t *lf, const char *fname)*/
+/*
+ *	writes out a library-file in the binary format, will trash any existing file
+ *	returns 0 on success, non-zero on failure
+ */
+static int lib_bin_writelibrary (libfile_t *lf, const char *fname)
+{
+	libbinbuf_t recs = {NULL, 0, 0, 0};
+	libbinbuf_t strs = {NULL, 0, 0, 0};
+	libbinbuf_t hdr = {NULL, 0, 0, 0};
+	DYNARRAY (libbinsym_t *, syms);
+	fhandle_t *libstream;
+	int i, j, k;
+	int rval = 0;
+
+	dynarray_init (syms);
+	/*{{{  library record*/
+	lib_bin_wstr (&recs, &strs, lf->libname, -1);
+	lib_bin_wstr (&recs, &strs, lf->namespace, -1);
+	lib_bin_wstr (&recs, &strs, lf->nativelib, -1);
+	lib_bin_wint (&recs, DA_CUR (lf->autoinclude));
+	for (i=0; i<DA_CUR (lf->autoinclude); i++) {
+		lib_bin_wstr (&recs, &strs, DA_NTHITEM (lf->autoinclude, i), -1);
+	}
+	lib_bin_wint (&recs, DA_CUR (lf->autouse));
+	for (i=0; i<DA_CUR (lf->autouse); i++) {
+		lib_bin_wstr (&recs, &strs, DA_NTHITEM (lf->autouse, i), -1);
+	}
+	lib_bin_wint (&recs, DA_CUR (lf->mdata));
+	for (i=0; i<DA_CUR (lf->mdata); i++) {
+		lib_bin_wmetadata (&recs, &strs, DA_NTHITEM (lf->mdata, i));
+	}
+
+	/*}}}*/
+	/*{{{  source-unit records, each followed by its entries*/
+	lib_bin_wint (&recs, DA_CUR (lf->srcs));
+	for (i=0; i<DA_CUR (lf->srcs); i++) {
+		libfile_srcunit_t *lfsu = DA_NTHITEM (lf->srcs, i);
+
+		lib_bin_wstr (&recs, &strs, lfsu->fname, -1);
+		lib_bin_wstr (&recs, &strs, lfsu->hashalgo, -1);
+		lib_bin_wstr (&recs, &strs, lfsu->hashvalue, -1);
+		lib_bin_wstr (&recs, &strs, lfsu->dhashvalue, -1);
+		lib_bin_wint (&recs, lfsu->issigned);
+		lib_bin_wint (&recs, DA_CUR (lfsu->mdata));
+		for (j=0; j<DA_CUR (lfsu->mdata); j++) {
+			lib_bin_wmetadata (&recs, &strs, DA_NTHITEM (lfsu->mdata, j));
+		}
+
+		lib_bin_wint (&recs, DA_CUR (lfsu->entries));
+		for (j=0; j<DA_CUR (lfsu->entries); j++) {
+			libfile_entry_t *lfe = DA_NTHITEM (lfsu->entries, j);
+
+			if (lfe->name) {
+				/* unnamed entries cannot be looked up, so stay out of the symbol table */
+				libbinsym_t *sym = (libbinsym_t *)smalloc (sizeof (libbinsym_t));
+
+				sym->name = lfe->name;
+				sym->nameoff = strs.cur;
+				sym->offset = LIBBIN_HDRSIZE + recs.cur;
+				dynarray_add (syms, sym);
+			}
+
+			lib_bin_wstr (&recs, &strs, lfe->name, -1);
+			lib_bin_wstr (&recs, &strs, lfe->langname, -1);
+			lib_bin_wstr (&recs, &strs, lfe->targetname, -1);
+			lib_bin_wstr (&recs, &strs, lfe->descriptor, -1);
+			lib_bin_wint (&recs, lfe->ws);
+			lib_bin_wint (&recs, lfe->vs);
+			lib_bin_wint (&recs, lfe->ms);
+			lib_bin_wint (&recs, lfe->adjust);
+			lib_bin_wint (&recs, DA_CUR (lfe->mdata));
+			for (k=0; k<DA_CUR (lfe->mdata); k++) {
+				lib_bin_wmetadata (&recs, &strs, DA_NTHITEM (lfe->mdata, k));
+			}
+		}
+	}
+
+	/*}}}*/
+	/*{{{  symbol table, sorted by name, goes straight after the records*/
+	if (DA_CUR (syms) > 1) {
+		dynarray_qsort (syms, lib_bin_comparesyms);
+	}
+	for (i=0; i<DA_CUR (syms); i++) {
+		libbinsym_t *sym = DA_NTHITEM (syms, i);
+
+		lib_bin_wint (&recs, sym->nameoff);
+		lib_bin_wint (&recs, sym->offset);
+	}
+
+	/*}}}*/
+	/*{{{  header*/
+	lib_bin_wbytes (&hdr, LIBBIN_MAGIC, 8);
+	lib_bin_wint (&hdr, LIBBIN_VERSION);
+	lib_bin_wint (&hdr, LIBBIN_ENDIAN);
+	lib_bin_wint (&hdr, LIBBIN_HDRSIZE);
+	lib_bin_wint (&hdr, recs.cur - (DA_CUR (syms) * 2 * sizeof (int32_t)));
+	lib_bin_wint (&hdr, LIBBIN_HDRSIZE + recs.cur - (DA_CUR (syms) * 2 * sizeof (int32_t)));
+	lib_bin_wint (&hdr, DA_CUR (syms));
+	lib_bin_wint (&hdr, LIBBIN_HDRSIZE + recs.cur);
+	lib_bin_wint (&hdr, strs.cur);
+
+	/*}}}*/
+	/*{{{  write out*/
+	libstream = fhandle_fopen (fname, "w");
+	if (!libstream) {
+		nocc_error ("lib_bin_writelibrary(): failed to open %s for writing: %s", fname, strerror (fhandle_lasterr (libstream)));
+		rval = -1;
+	} else {
+		if ((fhandle_write (libstream, hdr.data, hdr.cur) != hdr.cur) || (fhandle_write (libstream, recs.data, recs.cur) != recs.cur) ||
+				(fhandle_write (libstream, strs.data, strs.cur) != strs.cur)) {
+			nocc_error ("lib_bin_writelibrary(): failed to write %s: %s", fname, strerror (fhandle_lasterr (libstream)));
+			rval = -1;
+		}
+		fhandle_close (libstream);
+	}
+
+	/*}}}*/
+	for (i=0; i<DA_CUR (syms); i++) {
+		sfree (DA_NTHITEM (syms, i));
+	}
+	dynarray_trash (syms);
+	if (hdr.data) {
+		sfree (hdr.data);
+	}
+	if (recs.data) {
+		sfree (recs.data);
+	}
+	if (strs.data) {
+		sfree (strs.data);
+	}
+
+	return rval;
+}
+/*}}}*/
 /*{{{  static int lib_writelibrary (libfile_t *lf)*/
 /*
  *	writes out a library-file, will trash any existing file
@@ -1858,6 +2483,10 @@ static int lib_writelibrary (libfile_t *lf)
 	}
 	flen += snprintf (fbuf + flen, FILENAME_MAX - (flen + 2), "%s", lf->fname);
 
+	if ((libformat == 2) || (!libformat && lf->isbinary)) {
+		return lib_bin_writelibrary (lf, fbuf);
+	}
+
 	xmluri = nocc_lookupxmlnamespace ("nocc");
 	if (!xmluri) {
 		nocc_error ("lib_writelibrary(): failed to find \"nocc\" XML namespace!");
@@ -2157,6 +2786,25 @@ static int lib_mergeintolibrary (libfile_t *lf, libnodehook_t *lnh, libfile_srcu
 	return 0;
 }
 /*}}}*/
+/*{{{  static void lib_attachentry (tnode_t *decl, libfile_entry_t *lfent)*/
+/*
+ *	attaches library-file information (sizes and meta-data) to a declaration parsed from its descriptor
+ */
+static void lib_attachentry (tnode_t *decl, libfile_entry_t *lfent)
+{
+	int i;
+
+	tnode_setchook (decl, uselinkchook, (void *)lfent);
+	for (i=0; i<DA_CUR (lfent->mdata); i++) {
+		libfile_metadata_t *lfmd = DA_NTHITEM (lfent->mdata, i);
+
+		if (decl->tag->ndef->lops && tnode_haslangop (decl->tag->ndef->lops, "importmetadata")) {
+			tnode_calllangop (decl->tag->ndef->lops, "importmetadata", 3, decl, lfmd->name, lfmd->data);
+		}
+	}
+	return;
+}
+/*}}}*/
 /*{{{  static int lib_parsedescriptors (lexfile_t *orglf, libusenodehook_t *lunh)*/
 /*
  *	processes a library usage node, parsing the descriptors
@@ -2251,16 +2899,7 @@ tnode_dumptree (decltree, 1, FHAN_STDERR);
 					libfile_entry_t *lfent = DA_NTHITEM (lfsu->entries, j);
 
 					if (lfent && lfent->descriptor && lfent->langname && !strcmp (lfent->langname, orglf->parser->langname)) {
-						int k;
-
-						tnode_setchook (ditems[di], uselinkchook, (void *)lfent);
-						for (k=0; k<DA_CUR (lfent->mdata); k++) {
-							libfile_metadata_t *lfmd = DA_NTHITEM (lfent->mdata, k);
-
-							if (ditems[di]->tag->ndef->lops && tnode_haslangop (ditems[di]->tag->ndef->lops, "importmetadata")) {
-								tnode_calllangop (ditems[di]->tag->ndef->lops, "importmetadata", 3, ditems[di], lfmd->name, lfmd->data);
-							}
-						}
+						lib_attachentry (ditems[di], lfent);
 						di++;
 					}
 				}
@@ -2282,16 +2921,8 @@ tnode_dumptree (decltree, 1, FHAN_STDERR);
 
 					if (lfent && lfent->descriptor && lfent->langname && !strcmp (lfent->langname, orglf->parser->langname)) {
 						int tnflags = tnode_tnflagsof (thisnode);
-						int k;
-
-						tnode_setchook (thisnode, uselinkchook, (void *)lfent);
-						for (k=0; k<DA_CUR (lfent->mdata); k++) {
-							libfile_metadata_t *lfmd = DA_NTHITEM (lfent->mdata, k);
 
-							if (thisnode->tag->ndef->lops && tnode_haslangop (thisnode->tag->ndef->lops, "importmetadata")) {
-								tnode_calllangop (thisnode->tag->ndef->lops, "importmetadata", 3, thisnode, lfmd->name, lfmd->data);
-							}
-						}
+						lib_attachentry (thisnode, lfent);
 						if (tnflags & TNF_LONGDECL) {
 							thisnode = tnode_nthsubof (thisnode, 3);
 						} else if (tnflags & TNF_SHORTDECL) {
@@ -2693,12 +3324,177 @@ static int lib_prescope_libusenode (compops_t *cops, tnode_t **nodep, prescope_t
 {
 	libusenodehook_t *lunh = (libusenodehook_t *)tnode_nthhookof (*nodep, 0);
 
-	/* still got a declaration tree in the hook here */
-	prescope_subtree (&lunh->decltree, ps);
+	/* still got a declaration tree in the hook here (unless parsed lazily) */
+	if (lunh->decltree) {
+		prescope_subtree (&lunh->decltree, ps);
+	}
 
 	return 1;
 }
 /*}}}*/
+/*{{{  static int lib_resolvelazyname (name_t *pname, scope_t *ss)*/
+/*
+ *	resolves a placeholder name for a library entry on first use: parses just that entry's descriptor,
+ *	then pre-scopes and scopes the declaration ('ss' is as at the point of the library usage)
+ *	returns 0 on success, non-zero on failure
+ */
+static int lib_resolvelazyname (name_t *pname, scope_t *ss)
+{
+	liblazyname_t *lln = (liblazyname_t *)pname->lazy->hook;
+	libusenodehook_t *lunh = lln->lunh;
+	char *dbuf;
+	lexfile_t *lexbuf;
+	tnode_t *decl;
+	prescope_t ps;
+
+	/*{{{  open descriptor as a lexfile_t and parse it*/
+	dbuf = string_fmt ("%s\n", lln->lfent->descriptor);
+	lexbuf = lexer_openbuf (lunh->libname, lunh->lf->parser->langname, dbuf);
+	if (!lexbuf) {
+		nocc_error ("lib_resolvelazyname(): failed to open buffer..");
+		sfree (dbuf);
+		return -1;
+	}
+
+	decl = parser_descparse (lexbuf);
+	lexer_close (lexbuf);
+	sfree (dbuf);
+
+	if (!decl) {
+		nocc_error ("failed to parse descriptor for [%s] in library [%s]", lln->lfent->name, lunh->libname);
+		return -1;
+	}
+	if (parser_islistnode (decl)) {
+		/* single declaration in a list */
+		tnode_t *list = decl;
+		tnode_t **items;
+		int nitems;
+
+		items = parser_getlistitems (list, &nitems);
+		if (nitems != 1) {
+			nocc_error ("descriptor for [%s] in library [%s] has %d declarations", lln->lfent->name, lunh->libname, nitems);
+			tnode_free (list);
+			return -1;
+		}
+		decl = items[0];
+		items[0] = NULL;
+		tnode_free (list);
+	}
+
+	/*}}}*/
+	lib_attachentry (decl, lln->lfent);
+
+	/*{{{  pre-scope and scope it*/
+	ps.err = 0;
+	ps.warn = 0;
+	ps.hook = NULL;
+	ps.lang = ss->lang;
+	prescope_subtree (&decl, &ps);
+	if (ps.err) {
+		tnode_free (decl);
+		return -1;
+	}
+
+	tnode_modprepostwalktree (&decl, scope_modprewalktree, scope_modpostwalktree, (void *)ss);
+
+	/*}}}*/
+	dynarray_add (lunh->decls, decl);
+
+	return 0;
+}
+/*}}}*/
+/*{{{  static int lib_scopein_lazylibusenode (tnode_t **nodep, scope_t *ss)*/
+/*
+ *	scopes-in a library usage node whose descriptors have not been parsed: puts a placeholder name in scope
+ *	for each entry, only those used get parsed (lib_resolvelazyname).  if the usage node has a body, that is
+ *	scoped and the names go out of scope afterwards;  otherwise they stay in scope for what follows.
+ *	returns 0 to stop walk, 1 to continue
+ */
+static int lib_scopein_lazylibusenode (tnode_t **nodep, scope_t *ss)
+{
+	libusenodehook_t *lunh = (libusenodehook_t *)tnode_nthhookof (*nodep, 0);
+	libfile_t *lf = lunh->libdata;
+	tnode_t **bodyp = tnode_nthsubaddr (*nodep, 0);
+	namespace_t *ns = NULL;
+	void *nsmark;
+	int i;
+
+	/*{{{  sort out namespace, as lib_scopein_libusenode*/
+	if (lunh->namespace && lunh->asnamespace && strlen (lunh->asnamespace)) {
+		ns = name_findnamespace (lunh->asnamespace);
+		if (ns) {
+			scope_error (*nodep, ss, "namespace [%s] already in use", lunh->asnamespace);
+			return 0;
+		}
+
+		ns = name_newnamespace (lunh->asnamespace);
+
+		if (strcmp (lunh->namespace, lunh->asnamespace)) {
+			/* real namespace is different from the one used */
+			namespace_t *realns = name_findnamespace (lunh->namespace);
+
+			if (realns) {
+				scope_warning (*nodep, ss, "namespace [%s] already present", lunh->namespace);
+			} else {
+				realns = name_newnamespace (lunh->namespace);
+			}
+			ns->nextns = realns;
+
+			name_hidenamespace (realns);
+		}
+	} else if (lunh->namespace && strlen (lunh->namespace)) {
+		ns = name_findnamespace (lunh->namespace);
+		if (!ns) {
+			ns = name_newnamespace (lunh->namespace);
+		}
+	}
+
+	/*}}}*/
+	nsmark = name_markscope ();
+
+	/*{{{  placeholder names for entries in this language*/
+	if (ns) {
+		scope_pushdefns (ss, ns);
+	}
+	for (i=0; i<DA_CUR (lf->srcs); i++) {
+		libfile_srcunit_t *lfsu = DA_NTHITEM (lf->srcs, i);
+		int j;
+
+		for (j=0; j<DA_CUR (lfsu->entries); j++) {
+			libfile_entry_t *lfent = DA_NTHITEM (lfsu->entries, j);
+
+			if (lfent && lfent->name && lfent->descriptor && lfent->langname && !strcmp (lfent->langname, lunh->lf->parser->langname)) {
+				liblazyname_t *lln = (liblazyname_t *)smalloc (sizeof (liblazyname_t));
+
+				lln->lunh = lunh;
+				lln->lfent = lfent;
+				dynarray_add (lunh->lazynames, lln);
+
+				name_addlazyscopenamess (lfent->name, lib_resolvelazyname, (void *)lln, ss);
+			}
+		}
+	}
+	if (ns) {
+		scope_popdefns (ss, ns);
+		scope_pushusens (ss, ns);
+	}
+
+	/*}}}*/
+	if (*bodyp) {
+		/*{{{  scope body, then placeholders go*/
+		tnode_modprepostwalktree (bodyp, scope_modprewalktree, scope_modpostwalktree, (void *)ss);
+
+		if (ns) {
+			scope_popusens (ss, ns);
+		}
+		name_markdescope (nsmark);
+
+		/*}}}*/
+	}
+
+	return 0;
+}
+/*}}}*/
 /*{{{  static int lib_scopein_libusenode (compops_t *cops, tnode_t **nodep, scope_t *ss)*/
 /*
  *	scopes-in library usage nodes (puts declarations into scope)
@@ -2712,6 +3508,10 @@ static int lib_scopein_libusenode (compops_t *cops, tnode_t **nodep, scope_t *ss
 	tnode_t *tempnode = NULL;
 	namespace_t *ns = NULL;
 
+	if (lunh->lazy) {
+		return lib_scopein_lazylibusenode (nodep, ss);
+	}
+
 	if (parser_islistnode (decltree)) {
 		/* do nothing for this.. */
 		nocc_internal ("arf, stop and fixme!");
@@ -2846,6 +3646,10 @@ static int lib_typecheck_libusenode (compops_t *cops, tnode_t *node, typecheck_t
 	libusenodehook_t *lunh = (libusenodehook_t *)tnode_nthhookof (node, 0);
 	int i;
 
+	if (lunh->lazy && compopts.verbose) {
+		/* scoping is done, so everything used has been parsed */
+		nocc_message ("library [%s]: %d descriptor(s), parsed %d on demand", lunh->libname, DA_CUR (lunh->lazynames), DA_CUR (lunh->decls));
+	}
 	for (i=0; i<DA_CUR (lunh->decls); i++) {
 		tnode_t *decl = DA_NTHITEM (lunh->decls, i);
 
@@ -3285,6 +4089,8 @@ int library_init (void)
 	opts_add ("liboutpath", '\0', lib_opthandler, (void *)1, "0output directory for library info");
 	opts_add ("liballpublic", '\0', lib_opthandler, (void *)2, "1all top-level entries public in library");
 	opts_add ("scoutpath", '\0', lib_opthandler, (void *)3, "0output directory for .xlo files");
+	opts_add ("lib-format", '\0', lib_opthandler, (void *)4, "1format for written libraries (xml or binary)");
+	opts_add ("no-lib-lazy", '\0', lib_opthandler, (void *)5, "1parse all library descriptors when a library is used");
 
 	/*}}}*/
 	/*{{{  importmetadata language operation*/
@@ -3586,8 +4392,10 @@ tnode_t *library_newusenode (lexfile_t *lf, char *libname)
 		return NULL;
 	}
 
-	/* parse descriptors */
-	if (lib_parsedescriptors (lf, lunh)) {
+	/* parse descriptors, now or as they are used */
+	if (lazydescs) {
+		lunh->lazy = 1;
+	} else if (lib_parsedescriptors (lf, lunh)) {
 		nocc_error ("failed to parse descriptors in library [%s]", libname);
 		lib_libusenodehook_free (lunh);
 		return NULL;
@@ -3664,6 +4472,19 @@ int library_islibnode (tnode_t *node)
 	return 0;
 }
 /*}}}*/
+/*{{{  int library_islibusenode (tnode_t *node)*/
+/*
+ *	determines whether a particular node is a library-usage node (from #USE or an EXTERNAL declaration)
+ *	returns truth value
+ */
+int library_islibusenode (tnode_t *node)
+{
+	if (node && (node->tag == tag_libusenode)) {
+		return 1;
+	}
+	return 0;
+}
+/*}}}*/
 /*{{{  ntdef_t *library_getlibnodetag (void)*/
 /*
  *	returns the tag used to identify library nodes
@@ -425,7 +425,7 @@ static int mchk_prewalk_tree (tnode_t *node, void *data)
 	}
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_MOBILITYCHECK)) {
-		res = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_MOBILITYCHECK, 2, node, mcstate);
+		res = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_MOBILITYCHECK, node, mcstate);
 	}
 
 	return res;
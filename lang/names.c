@@ -51,6 +51,16 @@ STATICSTRINGHASH (namespace_t *, namespaces, 4);
 
 static int tempnamecounter = 1;
 
+static namelist_t *lazywatch = NULL;		/* while resolving a placeholder name, the list it is on */
+static name_t *lazyfound = NULL;		/* and the first real name added to that list */
+
+/* a name taken out of scope while a placeholder is resolved, and where it was */
+typedef struct TAG_namehidden {
+	name_t *name;
+	int idx;				/* in its namelist's scopes */
+	int curscope;				/* of its namelist */
+} namehidden_t;
+
 /*}}}*/
 
 
@@ -80,6 +90,145 @@ int name_shutdown (void)
 /*}}}*/
 
 
+/*{{{  static namehidden_t *name_hideabove (name_t *mark, int *nhidden)*/
+/*
+ *	takes the names scoped after 'mark' out of scope, most recent first, recording where they were
+ *	returns an array of them for name_unhide(), NULL if there were none (or 'mark' is not in scope)
+ */
+static namehidden_t *name_hideabove (name_t *mark, int *nhidden)
+{
+	namehidden_t *hidden;
+	int i, top;
+
+	for (top = DA_CUR (namestack) - 1; (top >= 0) && (DA_NTHITEM (namestack, top) != mark); top--);
+	*nhidden = (top < 0) ? 0 : (DA_CUR (namestack) - 1) - top;
+	if (!*nhidden) {
+		return NULL;
+	}
+
+	hidden = (namehidden_t *)smalloc_nz (*nhidden * sizeof (namehidden_t));
+	for (i=0; i<*nhidden; i++) {
+		name_t *tname = DA_NTHITEM (namestack, DA_CUR (namestack) - 1);
+		namelist_t *nl = tname->me;
+		int j;
+
+		for (j=DA_CUR (nl->scopes) - 1; (j >= 0) && (DA_NTHITEM (nl->scopes, j) != tname); j--);
+		hidden[i].name = tname;
+		hidden[i].idx = j;
+		hidden[i].curscope = nl->curscope;
+		if (j >= 0) {
+			dynarray_delitem (nl->scopes, j);
+		}
+		if (nl->curscope >= DA_CUR (nl->scopes)) {
+			nl->curscope = DA_CUR (nl->scopes) - 1;
+		}
+		dynarray_delitem (namestack, DA_CUR (namestack) - 1);
+	}
+	return hidden;
+}
+/*}}}*/
+/*{{{  static void name_unhide (namehidden_t *hidden, int nhidden)*/
+/*
+ *	puts back names taken out of scope by name_hideabove(), exactly where they were, and frees the array
+ */
+static void name_unhide (namehidden_t *hidden, int nhidden)
+{
+	int i;
+
+	for (i=nhidden - 1; i>=0; i--) {
+		namelist_t *nl = hidden[i].name->me;
+
+		if (hidden[i].idx >= 0) {
+			dynarray_insert (nl->scopes, hidden[i].name, hidden[i].idx);
+		}
+		nl->curscope = hidden[i].curscope;
+		dynarray_add (namestack, hidden[i].name);
+	}
+	if (hidden) {
+		sfree (hidden);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static name_t *name_lazyresolve (name_t *name, scope_t *ss)*/
+/*
+ *	if a name is a placeholder (added with name_addlazyscopenamess), returns the real name it stands
+ *	for, resolving it first if this is the first use (which needs scoper-state).  the resolver runs
+ *	as if where the placeholder was added: with the namespaces and lexical level from then, and with
+ *	names scoped since out of the way.  anything it leaves in scope is descoped again, the placeholder
+ *	stays in scope instead.
+ *	returns the name, or NULL if a placeholder could not be resolved
+ */
+static name_t *name_lazyresolve (name_t *name, scope_t *ss)
+{
+	namelazy_t *nlz = name->lazy;
+	namelist_t *savewatch;
+	name_t *savefound;
+	namehidden_t *hidden;
+	int nhidden;
+	scope_t lss;
+	void *mark;
+
+	if (name->resolved) {
+		return name->resolved;
+	} else if (!nlz) {
+		return name;
+	} else if (nlz->state || !ss) {
+		/* failed, recursive, or not scoping */
+		return NULL;
+	}
+
+	nlz->state = 1;
+	/*{{{  scoper-state as where the placeholder was added*/
+	lss = *ss;
+	dynarray_init (lss.defns);
+	dynarray_copy (lss.defns, nlz->defns);
+	dynarray_init (lss.usens);
+	dynarray_copy (lss.usens, nlz->usens);
+	lss.lexlevel = name->lexlevel;
+	hidden = name_hideabove (name, &nhidden);
+
+	/*}}}*/
+	savewatch = lazywatch;
+	savefound = lazyfound;
+	lazywatch = name->me;
+	lazyfound = NULL;
+	mark = name_markscope ();
+
+	if (nlz->resolve (name, &lss) || !lazyfound) {
+		nlz->state = -1;
+	} else {
+		name->resolved = lazyfound;
+
+		/* as if it had been declared where the placeholder was */
+		lazyfound->ns = name->ns;
+		lazyfound->lexlevel = name->lexlevel;
+	}
+	name_markdescope (mark);
+
+	lazywatch = savewatch;
+	lazyfound = savefound;
+
+	/*{{{  back to the scoper-state at the lookup*/
+	name_unhide (hidden, nhidden);
+	ss->err = lss.err;
+	ss->warn = lss.warn;
+	ss->scoped = lss.scoped;
+	dynarray_trash (lss.defns);
+	dynarray_trash (lss.usens);
+
+	/*}}}*/
+	if (name->resolved) {
+		/* done with it */
+		dynarray_trash (nlz->defns);
+		dynarray_trash (nlz->usens);
+		sfree (nlz);
+		name->lazy = NULL;
+	}
+
+	return name->resolved;
+}
+/*}}}*/
 /*{{{  name_t *name_lookup (char *str)*/
 /*
  *	looks up a name -- returns it at the current scoping level (or last if unset)
@@ -106,9 +255,9 @@ fprintf (stderr, "name_lookup(): str=[%s], nl=%p, nl->curscope = %d, DA_CUR (nl-
 			start = nl->curscope;
 		}
 		for (i=start; i >= 0; i--) {
-			name = DA_NTHITEM (nl->scopes, i);
+			name = name_lazyresolve (DA_NTHITEM (nl->scopes, i), NULL);
 
-			if (!(tnode_ntflagsof (NameNodeOf (name)) & NTF_HIDDENNAME)) {
+			if (name && !(tnode_ntflagsof (NameNodeOf (name)) & NTF_HIDDENNAME)) {
 				/* if not set, use this one */
 				break;			/* for() */
 			}
@@ -144,9 +293,9 @@ name_t *name_lookup_nodetag (char *str, ntdef_t *ttag)
 		}
 
 		for (i=start; i >= 0; i--) {
-			name = DA_NTHITEM (nl->scopes, i);
+			name = name_lazyresolve (DA_NTHITEM (nl->scopes, i), NULL);
 
-			if (NameNodeOf (name)->tag == ttag) {
+			if (name && (NameNodeOf (name)->tag == ttag)) {
 				/* this one */
 				break;			/* for() */
 			}
@@ -200,6 +349,9 @@ fprintf (stderr, "name_lookupss(): here 1! str=[%s] ss = %p, DA_CUR (usens) = %d
 				for (i=top; i >= 0; i--) {
 					name_t *tname = DA_NTHITEM (nl->scopes, i);
 
+					if (tname && (tname->ns == ns)) {
+						tname = name_lazyresolve (tname, ss);
+					}
 					if (tname && (tname->ns == ns) && !(tnode_ntflagsof (NameNodeOf (tname)) & NTF_HIDDENNAME)) {
 						/* this one */
 						name = tname;
@@ -230,6 +382,9 @@ name_dumpnames (stderr);
 #if 0
 fprintf (stderr, "tname->me->name = [%s], tname->ns->nspace = [%s]\n", tname->me->name, tname->ns ? tname->ns->nspace : "<empty>");
 #endif
+				if (tname && (!tname->ns || !strlen (tname->ns->nspace))) {
+					tname = name_lazyresolve (tname, ss);
+				}
 				if (tname && (!tname->ns || !strlen (tname->ns->nspace)) && !(tnode_ntflagsof (NameNodeOf (tname)) & NTF_HIDDENNAME)) {
 					/* this one */
 					name = tname;
@@ -250,6 +405,10 @@ fprintf (stderr, "name_lookupss(): found stack for [%s], looking for one in a vi
 					if (!tname || !tname->ns || !strlen (tname->ns->nspace)) {
 						continue;		/* for() */
 					}
+					for (j = (DA_CUR (ss->usens) - 1); (j >= 0) && (tname->ns != DA_NTHITEM (ss->usens, j)); j--);
+					if ((j < 0) || !(tname = name_lazyresolve (tname, ss))) {
+						continue;		/* for() */
+					}
 					for (j = (DA_CUR (ss->usens) - 1); (j >= 0) && ((tname->ns != DA_NTHITEM (ss->usens, j)) ||
 							(tnode_ntflagsof (NameNodeOf (tname)) & NTF_HIDDENNAME)); j--);
 					if (j >= 0) {
@@ -309,6 +468,9 @@ name_t *name_lookupss_nodetag (char *str, scope_t *ss, ntdef_t *ttag)
 				for (i=top; i >= 0; i--) {
 					name_t *tname = DA_NTHITEM (nl->scopes, i);
 
+					if (tname && (tname->ns == ns)) {
+						tname = name_lazyresolve (tname, ss);
+					}
 					if (tname && (tname->ns == ns) && (NameNodeOf (tname)->tag == ttag)) {
 						/* this one */
 						name = tname;
@@ -332,6 +494,9 @@ name_t *name_lookupss_nodetag (char *str, scope_t *ss, ntdef_t *ttag)
 			for (i=top; i >= 0; i--) {
 				name_t *tname = DA_NTHITEM (nl->scopes, i);
 
+				if (tname && (!tname->ns || !strlen (tname->ns->nspace))) {
+					tname = name_lazyresolve (tname, ss);
+				}
 				if (tname && (!tname->ns || !strlen (tname->ns->nspace)) && (NameNodeOf (tname)->tag == ttag)) {
 					/* this one */
 					name = tname;
@@ -348,6 +513,10 @@ name_t *name_lookupss_nodetag (char *str, scope_t *ss, ntdef_t *ttag)
 					if (!tname || !tname->ns || !strlen (tname->ns->nspace)) {
 						continue;		/* for() */
 					}
+					for (j = (DA_CUR (ss->usens) - 1); (j >= 0) && (tname->ns != DA_NTHITEM (ss->usens, j)); j--);
+					if ((j < 0) || !(tname = name_lazyresolve (tname, ss))) {
+						continue;		/* for() */
+					}
 					for (j = (DA_CUR (ss->usens) - 1); (j >= 0) && (tname->ns != DA_NTHITEM (ss->usens, j)) &&
 							(NameNodeOf (tname)->tag != ttag); j--);
 					if (j >= 0) {
@@ -380,18 +549,20 @@ name_t *name_addname (char *str, tnode_t *decl, tnode_t *type, tnode_t *namenode
 #if 0
 fprintf (stderr, "name_addname(): here! str=\"%s\"\n", str);
 #endif
-	name = (name_t *)smalloc (sizeof (name_t));
+	name = (name_t *)smalloc_nz (sizeof (name_t));
 	name->decl = decl;
 	name->type = type;
 	name->namenode = namenode;
 	name->refc = 1;				/* because it won't ever be looked up really */
+	name->lazy = NULL;
+	name->resolved = NULL;
 	name->ns = NULL;
 	name->lexlevel = 0;
 
 	nl = stringhash_lookup (names, str);
 	if (!nl) {
-		nl = (namelist_t *)smalloc (sizeof (namelist_t));
-		nl->name = string_dup (str);
+		nl = (namelist_t *)smalloc_nz (sizeof (namelist_t));
+		nl->name = string_intern (str);
 		dynarray_init (nl->scopes);
 		nl->curscope = -1;
 		stringhash_insert (names, nl, nl->name);
@@ -414,11 +585,13 @@ name_t *name_addscopenamess (char *str, tnode_t *decl, tnode_t *type, tnode_t *n
 #if 0
 fprintf (stderr, "name_addscopenamess(): here! str=\"%s\", default-namespace: \"%s\"\n", str, (ss && DA_CUR (ss->defns)) ? (DA_NTHITEM (ss->defns, DA_CUR (ss->defns) - 1)->nspace) : "(none)");
 #endif
-	name = (name_t *)smalloc (sizeof (name_t));
+	name = (name_t *)smalloc_nz (sizeof (name_t));
 	name->decl = decl;
 	name->type = type;
 	name->namenode = namenode;
 	name->refc = 0;
+	name->lazy = NULL;
+	name->resolved = NULL;
 	if (ss && DA_CUR (ss->defns)) {
 		name->ns = DA_NTHITEM (ss->defns, DA_CUR (ss->defns) - 1);
 	} else {
@@ -436,8 +609,8 @@ tnode_dumptree (type, 1, stderr);
 
 	nl = stringhash_lookup (names, str);
 	if (!nl) {
-		nl = (namelist_t *)smalloc (sizeof (namelist_t));
-		nl->name = string_dup (str);
+		nl = (namelist_t *)smalloc_nz (sizeof (namelist_t));
+		nl->name = string_intern (str);
 		dynarray_init (nl->scopes);
 		nl->curscope = -1;
 		stringhash_insert (names, nl, nl->name);
@@ -447,6 +620,9 @@ tnode_dumptree (type, 1, stderr);
 	name->me = nl;
 
 	dynarray_add (namestack, name);
+	if ((nl == lazywatch) && !lazyfound) {
+		lazyfound = name;
+	}
 	
 	return name;
 }
@@ -470,11 +646,13 @@ name_t *name_addsubscopenamess (char *str, void *scopemark, tnode_t *decl, tnode
 	name_t *name;
 	namelist_t *nl;
 
-	name = (name_t *)smalloc (sizeof (name_t));
+	name = (name_t *)smalloc_nz (sizeof (name_t));
 	name->decl = decl;
 	name->type = type;
 	name->namenode = namenode;
 	name->refc = 0;
+	name->lazy = NULL;
+	name->resolved = NULL;
 	if (ss && DA_CUR (ss->defns)) {
 		name->ns = DA_NTHITEM (ss->defns, DA_CUR (ss->defns) - 1);
 	} else {
@@ -488,8 +666,8 @@ name_t *name_addsubscopenamess (char *str, void *scopemark, tnode_t *decl, tnode
 
 	nl = stringhash_lookup (names, str);
 	if (!nl) {
-		nl = (namelist_t *)smalloc (sizeof (namelist_t));
-		nl->name = string_dup (str);
+		nl = (namelist_t *)smalloc_nz (sizeof (namelist_t));
+		nl->name = string_intern (str);
 		dynarray_init (nl->scopes);
 		nl->curscope = -1;
 		stringhash_insert (names, nl, nl->name);
@@ -633,14 +811,16 @@ name_t *name_addtempname (tnode_t *decl, tnode_t *type, ntdef_t *nametag, tnode_
 	namelist_t *nl;
 	char *str;
 
-	str = (char *)smalloc (32);
+	str = (char *)smalloc_nz (32);
 	sprintf (str, "$tmp.%d", tempnamecounter++);
 
-	name = (name_t *)smalloc (sizeof (name_t));
+	name = (name_t *)smalloc_nz (sizeof (name_t));
 	name->decl = decl;
 	name->type = type;
 	name->namenode = namenode ? *namenode : NULL;
 	name->refc = 0;
+	name->lazy = NULL;
+	name->resolved = NULL;
 	name->ns = NULL;
 	name->lexlevel = 0;
 
@@ -651,8 +831,8 @@ tnode_dumptree (type, 1, stderr);
 
 	nl = stringhash_lookup (names, str);
 	if (!nl) {
-		nl = (namelist_t *)smalloc (sizeof (namelist_t));
-		nl->name = string_dup (str);
+		nl = (namelist_t *)smalloc_nz (sizeof (namelist_t));
+		nl->name = string_intern (str);
 		dynarray_init (nl->scopes);
 		nl->curscope = -1;
 		stringhash_insert (names, nl, nl->name);
@@ -669,6 +849,31 @@ tnode_dumptree (type, 1, stderr);
 /*}}}*/
 
 
+/*{{{  name_t *name_addlazyscopenamess (char *str, int (*resolve)(name_t *, scope_t *), void *hook, scope_t *ss)*/
+/*
+ *	adds a placeholder name and returns it, after putting it in scope (namespace and lexical level as
+ *	for name_addscopenamess).  the first name_lookupss() that finds it calls "resolve", which should scope
+ *	the real declaration;  from then on lookups return the real name in its place.
+ */
+name_t *name_addlazyscopenamess (char *str, int (*resolve)(name_t *, scope_t *), void *hook, scope_t *ss)
+{
+	name_t *name = name_addscopenamess (str, NULL, NULL, NULL, ss);
+	namelazy_t *nlz = (namelazy_t *)smalloc_nz (sizeof (namelazy_t));
+
+	nlz->resolve = resolve;
+	nlz->hook = hook;
+	nlz->state = 0;
+	dynarray_init (nlz->defns);
+	dynarray_copy (nlz->defns, ss->defns);
+	dynarray_init (nlz->usens);
+	dynarray_copy (nlz->usens, ss->usens);
+	name->lazy = nlz;
+
+	return name;
+}
+/*}}}*/
+
+
 /*{{{  namespace_t *name_findnamespace (char *nsname)*/
 /*
  *	looks up a whole namespace by name
@@ -853,6 +1058,10 @@ static void name_walkdumpname (namelist_t *nl, char *key, void *ptr)
 		name_t *name = DA_NTHITEM (nl->scopes, i);
 		tnode_t *declnode = name->decl;
 
+		if (!declnode) {
+			fhandle_printf (stream, "\t%d\trefc = %-3d  placeholder%s\n", i, name->refc, name->resolved ? " (resolved)" : "");
+			continue;		/* for() */
+		}
 		fhandle_printf (stream, "\t%d\trefc = %-3d  decl = %p, (%s,%s):\n", i, name->refc, declnode,
 			declnode->tag->ndef->name, declnode->tag->name);
 	}
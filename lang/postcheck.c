@@ -62,7 +62,7 @@ static int postcheck_modprewalk_tree (tnode_t **node, void *data)
 		return 0;
 	}
 	if ((*node)->tag->ndef->ops && tnode_hascompop_i ((*node)->tag->ndef->ops, (int)COPS_POSTCHECK)) {
-		result = tnode_callcompop_i ((*node)->tag->ndef->ops, (int)COPS_POSTCHECK, 2, node, (postcheck_t *)data);
+		result = tnode_callcompop_i2 ((*node)->tag->ndef->ops, (int)COPS_POSTCHECK, node, (postcheck_t *)data);
 	}
 
 	return result;
@@ -62,7 +62,7 @@ static int precheck_prewalk_tree (tnode_t *node, void *data)
 		return 0;
 	}
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_PRECHECK)) {
-		result = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_PRECHECK, 1, node);
+		result = tnode_callcompop_i1 (node->tag->ndef->ops, (int)COPS_PRECHECK, node);
 	}
 
 	return result;
@@ -229,7 +229,7 @@ int scope_modprewalktree (tnode_t **node, void *arg)
 			nocc_message ("SCOPE-IN: scope_modprewalktree: about to scope-in node @%p type [%s:%s]",
 					*node, (*node)->tag->ndef->name, (*node)->tag->name);
 		}
-		i = tnode_callcompop_i ((*node)->tag->ndef->ops, (int)COPS_SCOPEIN, 2, node, sarg);
+		i = tnode_callcompop_i2 ((*node)->tag->ndef->ops, (int)COPS_SCOPEIN, node, sarg);
 	}
 
 	return i;
@@ -249,7 +249,7 @@ int scope_modpostwalktree (tnode_t **node, void *arg)
 			nocc_message ("SCOPE-OUT: scope_modpostwalktree: about to scope-out node @%p type [%s:%s]",
 					*node, (*node)->tag->ndef->name, (*node)->tag->name);
 		}
-		i = tnode_callcompop_i ((*node)->tag->ndef->ops, (int)COPS_SCOPEOUT, 2, node, sarg);
+		i = tnode_callcompop_i2 ((*node)->tag->ndef->ops, (int)COPS_SCOPEOUT, node, sarg);
 	}
 
 	return i;
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include "nocc.h"
 #include "support.h"
@@ -44,6 +45,7 @@
 #include "names.h"
 #include "typecheck.h"
 #include "target.h"
+#include "opts.h"
 /*}}}*/
 
 /*{{{  private stuff*/
@@ -64,6 +66,10 @@ STATICDYNARRAY (langop_t *, alangops);
 STATICSTRINGHASH (char *, tracingcompops, 3);
 STATICSTRINGHASH (char *, tracinglangops, 3);
 
+/* operations looked up by name, keyed on the name pointer given (nearly always a string constant) */
+STATICPOINTERHASH (compop_t *, compopnames, 6);
+STATICPOINTERHASH (langop_t *, langopnames, 6);
+
 #define SRCLEXMAP_LINE_HASHBITS	(4)
 typedef struct TAG_srclexmap {
 	POINTERHASH (srclocn_t *, lines, SRCLEXMAP_LINE_HASHBITS);
@@ -72,9 +78,57 @@ typedef struct TAG_srclexmap {
 /* this maps lexfile_t's to srclexmap_t's */
 STATICPOINTERHASH (srclexmap_t *, srclexmap, 3);
 
+#define TNODEREGION_BLOCKSIZE (64 * 1024)	/* bytes per region block */
+
+/* a region holds tree-nodes (with their items) for a compilation, freed all at once */
+typedef struct TAG_tnoderegion {
+	DYNARRAY (void *, blocks);		/* allocated blocks */
+	DYNARRAY (tnode_t *, freelist);		/* freed nodes by number of items (linked through 'org') */
+	char *next;				/* next unused byte in the current block */
+	int left;				/* unused bytes in the current block */
+	int nnodes;				/* statistics */
+	int nreused;
+	int nbytes;
+	int nlive;				/* nodes allocated here and not yet released */
+} tnoderegion_t;
+
+static tnoderegion_t *tnode_curregion = NULL;	/* where new nodes come from, NULL for the heap */
+static int tnode_useregions = 1;		/* cleared with --no-tnode-regions */
+
+static int tnode_ncreated = 0;			/* tree-nodes allocated, ever */
+static int tnode_nlive = 0;			/* tree-nodes allocated and not yet released (or region-freed) */
+
+#define CHOOKSET_SORTEDMAX (8)			/* largest set kept as sorted pairs, more than this become a hash-table */
+
+/* a node's compiler hooks: 'size' entries stored straight after this, either sorted by id or hashed on id (id -1 for empty) */
+typedef struct TAG_chookent {
+	int id;
+	void *hook;
+} chookent_t;
+
+typedef struct TAG_chookset {
+	int count;				/* entries in use */
+	int size;				/* entries allocated */
+	int maxid;				/* highest id ever set */
+	int hashed;				/* non-zero if the entries are a hash-table */
+} chookset_t;
+
+#define CHOOKSET_ENTS(CS) ((chookent_t *)((CS) + 1))
+#define CHOOKSET_BYTES(SIZE) (sizeof (chookset_t) + ((SIZE) * sizeof (chookent_t)))
+
+/* statistics for the compiler-hook store (current and peak) */
+static int tnode_chsets = 0;
+static int tnode_chhooks = 0;
+static int tnode_chbytes = 0;
+static int tnode_chdense = 0;			/* bytes that a per-node array indexed by id would have needed */
+static int tnode_chpeakbytes = 0;
+static int tnode_chpeakdense = 0;
+static int tnode_chpeaksets = 0;
+
 /* forwards */
 static void tnode_isetindent (fhandle_t *stream, int indent);
 static void tnode_ssetindent (fhandle_t *stream, int indent);
+static void tnode_benchops (void);
 
 typedef struct TAG_treesubst {
 	tnode_t *curptr;
@@ -154,7 +208,7 @@ static void tnode_list_hookfree (void *hook)
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -183,12 +237,12 @@ static void *tnode_list_hookcopyoralias (void *hook, copycontrol_e (*cora_fcn)(t
 		return NULL;
 	}
 	cur = (int *)array;
-	max = (int *)array + 1;
+	max = (int *)(array + 1);
 	array += 2;
 
 	narray = (tnode_t **)smalloc ((*max + 2) * sizeof (tnode_t *));
 	nacur = (int *)narray;
-	namax = (int *)narray + 1;
+	namax = (int *)(narray + 1);
 	*nacur = *cur;
 	*namax = *max;
 	rhook = (void *)narray;
@@ -228,7 +282,7 @@ static void tnode_list_hookdumptree (tnode_t *node, void *hook, int indent, fhan
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -253,7 +307,7 @@ static void tnode_list_hookdumpstree (tnode_t *node, void *hook, int indent, fha
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -278,7 +332,7 @@ static void tnode_list_hookpostwalktree (tnode_t *node, void *hook, void (*func)
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -303,7 +357,7 @@ static void tnode_list_hookprewalktree (tnode_t *node, void *hook, int (*func)(t
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -328,7 +382,7 @@ static void tnode_list_hookmodprewalktree (tnode_t **node, void *hook, int (*fun
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -353,7 +407,7 @@ static void tnode_list_hookmodprepostwalktree (tnode_t **node, void *hook, int (
 		return;
 	}
 	cur = (int *)hook;
-	max = (int *)hook + 1;
+	max = (int *)((tnode_t **)hook + 1);
 	array += 2;
 
 	for (i=0; i<*cur; i++) {
@@ -366,6 +420,30 @@ static void tnode_list_hookmodprepostwalktree (tnode_t **node, void *hook, int (
 /*}}}*/
 
 
+/*{{{  static int tnode_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	option handler for tree-node options
+ *	returns 0 on success, non-zero on failure
+ */
+static int tnode_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	switch ((int)((uint64_t)opt->arg)) {
+	case 1:
+		/*{{{  --no-tnode-regions*/
+		tnode_useregions = 0;
+		break;
+		/*}}}*/
+	case 3:
+		/*{{{  --bench-ops*/
+		tnode_benchops ();
+		break;
+		/*}}}*/
+	default:
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
 /*{{{  int tnode_init (void)*/
 /*
  *	initialises node handler
@@ -392,6 +470,11 @@ int tnode_init (void)
 
 	stringhash_sinit (tracingcompops);
 	stringhash_sinit (tracinglangops);
+	pointerhash_sinit (compopnames);
+	pointerhash_sinit (langopnames);
+
+	opts_add ("no-tnode-regions", '\0', tnode_opthandler, (void *)1, "1allocate tree-nodes individually rather than in a region");
+	opts_add ("bench-ops", '\0', tnode_opthandler, (void *)3, "1measure the cost of calling compiler operations");
 
 	if (compopts.tracecompops) {
 		char *copy = string_dup (compopts.tracecompops);
@@ -1228,6 +1311,410 @@ void tnode_modprepostwalktree (tnode_t **t, int (*prefcn)(tnode_t **, void *), i
 /*}}}*/
 
 
+/*{{{  tnoderegion_t *tnode_newregion (void)*/
+/*
+ *	creates a new (empty) tree-node region
+ */
+tnoderegion_t *tnode_newregion (void)
+{
+	tnoderegion_t *rgn = (tnoderegion_t *)smalloc (sizeof (tnoderegion_t));
+
+	dynarray_init (rgn->blocks);
+	dynarray_init (rgn->freelist);
+	rgn->next = NULL;
+	rgn->left = 0;
+	rgn->nnodes = 0;
+	rgn->nreused = 0;
+	rgn->nbytes = 0;
+
+	return rgn;
+}
+/*}}}*/
+/*{{{  tnoderegion_t *tnode_setregion (tnoderegion_t *rgn)*/
+/*
+ *	sets the region that new tree-nodes are allocated in (NULL for the heap)
+ *	returns the previous region
+ */
+tnoderegion_t *tnode_setregion (tnoderegion_t *rgn)
+{
+	tnoderegion_t *prev = tnode_curregion;
+
+	tnode_curregion = rgn;
+	return prev;
+}
+/*}}}*/
+/*{{{  void tnode_freeregion (tnoderegion_t *rgn)*/
+/*
+ *	frees a tree-node region, and with it every node allocated there.  hooks are not freed:
+ *	this is for throwing away whole trees at the end of a compilation.
+ */
+void tnode_freeregion (tnoderegion_t *rgn)
+{
+	int i;
+
+	if (!rgn) {
+		nocc_internal ("tnode_freeregion(): NULL region");
+		return;
+	}
+	if (tnode_curregion == rgn) {
+		tnode_curregion = NULL;
+	}
+	if (compopts.verbose && rgn->nnodes) {
+		nocc_message ("tree-node region: %d nodes (%d reused), %d bytes in %d blocks", rgn->nnodes, rgn->nreused,
+				rgn->nbytes, DA_CUR (rgn->blocks));
+	}
+	if (compopts.verbose && tnode_chpeaksets) {
+		nocc_message ("compiler hooks: at most %d nodes with hooks in %d bytes (%d per node), per-node arrays would need %d bytes (%d per node)",
+				tnode_chpeaksets, tnode_chpeakbytes, tnode_chpeakbytes / tnode_chpeaksets, tnode_chpeakdense, tnode_chpeakdense / tnode_chpeaksets);
+	}
+	tnode_nlive -= rgn->nlive;
+	for (i=0; i<DA_CUR (rgn->blocks); i++) {
+		sfree (DA_NTHITEM (rgn->blocks, i));
+	}
+	dynarray_trash (rgn->blocks);
+	dynarray_trash (rgn->freelist);
+	sfree (rgn);
+
+	return;
+}
+/*}}}*/
+/*{{{  void tnode_nodecounts (int *created, int *live)*/
+/*
+ *	returns the number of tree-nodes allocated so far and the number still live (either may be NULL)
+ */
+void tnode_nodecounts (int *created, int *live)
+{
+	if (created) {
+		*created = tnode_ncreated;
+	}
+	if (live) {
+		*live = tnode_nlive;
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static tnode_t *tnode_alloc (ntdef_t *tag, int clearitems)*/
+/*
+ *	allocates a tree-node for the given tag, with room for its items stored straight after it.
+ *	comes from the current region if there is one.  the items are only cleared if 'clearitems'
+ *	is set, otherwise the caller must set them all.
+ */
+static tnode_t *tnode_alloc (ntdef_t *tag, int clearitems)
+{
+	int nitems = tag->ndef->nsub + tag->ndef->nname + tag->ndef->nhooks;
+	int bytes = sizeof (tnode_t) + (nitems * sizeof (void *));
+	tnoderegion_t *rgn = tnode_useregions ? tnode_curregion : NULL;
+	tnode_t *t;
+
+	if (!rgn) {
+		t = (tnode_t *)smalloc_nz (bytes);
+	} else if ((nitems < DA_CUR (rgn->freelist)) && DA_NTHITEM (rgn->freelist, nitems)) {
+		t = DA_NTHITEM (rgn->freelist, nitems);
+		DA_SETNTHITEM (rgn->freelist, nitems, (tnode_t *)t->org);
+		rgn->nreused++;
+	} else {
+		if (bytes > (TNODEREGION_BLOCKSIZE >> 2)) {
+			/* big, give it a block of its own */
+			t = (tnode_t *)smalloc_nz (bytes);
+			dynarray_add (rgn->blocks, (void *)t);
+		} else {
+			if (rgn->left < bytes) {
+				rgn->next = (char *)smalloc_nz (TNODEREGION_BLOCKSIZE);
+				rgn->left = TNODEREGION_BLOCKSIZE;
+				dynarray_add (rgn->blocks, (void *)rgn->next);
+			}
+			t = (tnode_t *)rgn->next;
+			rgn->next += bytes;
+			rgn->left -= bytes;
+		}
+		rgn->nbytes += bytes;
+	}
+	if (rgn) {
+		rgn->nnodes++;
+		rgn->nlive++;
+	}
+	tnode_ncreated++;
+	tnode_nlive++;
+
+	t->tag = tag;
+	t->org = NULL;
+	t->region = rgn;
+	DA_PTR (t->items) = (void **)(t + 1);
+	DA_CUR (t->items) = nitems;
+	DA_MAX (t->items) = nitems;
+	t->chooks = NULL;
+	if (clearitems && nitems) {
+		memset (DA_PTR (t->items), 0, nitems * sizeof (void *));
+	}
+
+	return t;
+}
+/*}}}*/
+/*{{{  static void tnode_chookaccount (int dsets, int dents, int dbytes, int ddense)*/
+/*
+ *	updates the compiler-hook store statistics
+ */
+static void tnode_chookaccount (int dsets, int dents, int dbytes, int ddense)
+{
+	tnode_chsets += dsets;
+	tnode_chhooks += dents;
+	tnode_chbytes += dbytes;
+	tnode_chdense += ddense;
+
+	if (tnode_chsets > tnode_chpeaksets) {
+		tnode_chpeaksets = tnode_chsets;
+	}
+	if (tnode_chbytes > tnode_chpeakbytes) {
+		tnode_chpeakbytes = tnode_chbytes;
+	}
+	if (tnode_chdense > tnode_chpeakdense) {
+		tnode_chpeakdense = tnode_chdense;
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static chookent_t *tnode_chookfind (chookset_t *cs, int id)*/
+/*
+ *	finds the entry for a particular compiler-hook id in a set
+ *	returns entry (whose hook may be NULL) or NULL if not present
+ */
+static chookent_t *tnode_chookfind (chookset_t *cs, int id)
+{
+	chookent_t *ents = CHOOKSET_ENTS (cs);
+	int i;
+
+	if (cs->hashed) {
+		int mask = cs->size - 1;
+
+		for (i = (id & mask); ents[i].id >= 0; i = ((i + 1) & mask)) {
+			if (ents[i].id == id) {
+				return &ents[i];
+			}
+		}
+		return NULL;
+	}
+	for (i=0; (i < cs->count) && (ents[i].id <= id); i++) {
+		if (ents[i].id == id) {
+			return &ents[i];
+		}
+	}
+	return NULL;
+}
+/*}}}*/
+/*{{{  static chookset_t *tnode_chookrehash (chookset_t *cs, int size)*/
+/*
+ *	moves the entries of a compiler-hook set into a new hash-table of the given size (power of 2)
+ *	returns the new set, old one is freed
+ */
+static chookset_t *tnode_chookrehash (chookset_t *cs, int size)
+{
+	chookset_t *ncs = (chookset_t *)smalloc (CHOOKSET_BYTES (size));
+	chookent_t *ents = CHOOKSET_ENTS (cs);
+	chookent_t *nents = CHOOKSET_ENTS (ncs);
+	int i;
+
+	ncs->count = cs->count;
+	ncs->size = size;
+	ncs->maxid = cs->maxid;
+	ncs->hashed = 1;
+	for (i=0; i<size; i++) {
+		nents[i].id = -1;
+	}
+	for (i=0; i<(cs->hashed ? cs->size : cs->count); i++) {
+		if (ents[i].id >= 0) {
+			int j;
+
+			for (j = (ents[i].id & (size - 1)); nents[j].id >= 0; j = ((j + 1) & (size - 1)));
+			nents[j] = ents[i];
+		}
+	}
+	tnode_chookaccount (0, 0, (int)(CHOOKSET_BYTES (size) - CHOOKSET_BYTES (cs->size)), 0);
+	sfree (cs);
+
+	return ncs;
+}
+/*}}}*/
+/*{{{  static chookset_t *tnode_chookadd (chookset_t *cs, int id, void *hook)*/
+/*
+ *	adds an entry to a compiler-hook set (which may be NULL), must not already be present
+ *	returns the set, which may have moved
+ */
+static chookset_t *tnode_chookadd (chookset_t *cs, int id, void *hook)
+{
+	chookent_t *ents;
+	int i;
+
+	if (!cs) {
+		cs = (chookset_t *)smalloc (CHOOKSET_BYTES (1));
+		cs->count = 0;
+		cs->size = 1;
+		cs->maxid = -1;
+		cs->hashed = 0;
+		tnode_chookaccount (1, 0, (int)CHOOKSET_BYTES (1), 0);
+	}
+	if (id > cs->maxid) {
+		tnode_chookaccount (0, 0, 0, (int)((id - cs->maxid) * sizeof (void *)));
+		cs->maxid = id;
+	}
+
+	if (!cs->hashed && (cs->count == cs->size)) {
+		if (cs->size < CHOOKSET_SORTEDMAX) {
+			cs = (chookset_t *)srealloc (cs, CHOOKSET_BYTES (cs->size), CHOOKSET_BYTES (cs->size * 2));
+			tnode_chookaccount (0, 0, (int)(cs->size * sizeof (chookent_t)), 0);
+			cs->size *= 2;
+		} else {
+			cs = tnode_chookrehash (cs, CHOOKSET_SORTEDMAX * 2);
+		}
+	} else if (cs->hashed && (((cs->count + 1) * 4) > (cs->size * 3))) {
+		cs = tnode_chookrehash (cs, cs->size * 2);
+	}
+
+	ents = CHOOKSET_ENTS (cs);
+	if (cs->hashed) {
+		for (i = (id & (cs->size - 1)); ents[i].id >= 0; i = ((i + 1) & (cs->size - 1)));
+	} else {
+		/* keep sorted */
+		for (i = cs->count; (i > 0) && (ents[i - 1].id > id); i--) {
+			ents[i] = ents[i - 1];
+		}
+	}
+	ents[i].id = id;
+	ents[i].hook = hook;
+	cs->count++;
+	tnode_chookaccount (0, 1, 0, 0);
+
+	return cs;
+}
+/*}}}*/
+/*{{{  static void tnode_chookremove (chookset_t *cs, int id)*/
+/*
+ *	removes an entry from a compiler-hook set (doesn't free the hook itself)
+ *	in a hash-table the entry stays (with a NULL hook) so that probe sequences are unbroken
+ */
+static void tnode_chookremove (chookset_t *cs, int id)
+{
+	chookent_t *ent = tnode_chookfind (cs, id);
+	chookent_t *ents = CHOOKSET_ENTS (cs);
+	int i;
+
+	if (!ent) {
+		return;
+	}
+	if (cs->hashed) {
+		ent->hook = NULL;
+		return;
+	}
+	for (i = (int)(ent - ents); i < (cs->count - 1); i++) {
+		ents[i] = ents[i + 1];
+	}
+	cs->count--;
+	tnode_chookaccount (0, -1, 0, 0);
+
+	return;
+}
+/*}}}*/
+/*{{{  static int tnode_chooknext (chookset_t *cs, int *posp, chook_t **chp, void **hookp)*/
+/*
+ *	iterates over the present (non-NULL) hooks in a compiler-hook set in id order, '*posp' should start at 0
+ *	returns non-zero and sets '*chp' and '*hookp' if another was found, zero at the end
+ */
+static int tnode_chooknext (chookset_t *cs, int *posp, chook_t **chp, void **hookp)
+{
+	if (!cs) {
+		return 0;
+	}
+	for (;;) {
+		chookent_t *ent;
+
+		if (cs->hashed) {
+			/* walk by id, so output stays in id order */
+			if (*posp > cs->maxid) {
+				return 0;
+			}
+			ent = tnode_chookfind (cs, *posp);
+		} else {
+			if (*posp >= cs->count) {
+				return 0;
+			}
+			ent = CHOOKSET_ENTS (cs) + *posp;
+		}
+		(*posp)++;
+
+		if (ent && ent->hook) {
+			*chp = DA_NTHITEM (acomphooks, ent->id);
+			*hookp = ent->hook;
+			return 1;
+		}
+	}
+}
+/*}}}*/
+/*{{{  static chookset_t *tnode_copychookset (chookset_t *cs)*/
+/*
+ *	duplicates a compiler-hook set (hooks themselves are not copied)
+ */
+static chookset_t *tnode_copychookset (chookset_t *cs)
+{
+	int bytes = (int)CHOOKSET_BYTES (cs->size);
+	chookset_t *ncs = (chookset_t *)smalloc (bytes);
+
+	memcpy (ncs, cs, bytes);
+	tnode_chookaccount (1, cs->count, bytes, (int)((cs->maxid + 1) * sizeof (void *)));
+
+	return ncs;
+}
+/*}}}*/
+/*{{{  static void tnode_freechookset (chookset_t *cs)*/
+/*
+ *	frees a compiler-hook set (hooks themselves are not freed)
+ */
+static void tnode_freechookset (chookset_t *cs)
+{
+	tnode_chookaccount (-1, -cs->count, -(int)CHOOKSET_BYTES (cs->size), -(int)((cs->maxid + 1) * sizeof (void *)));
+	sfree (cs);
+	return;
+}
+/*}}}*/
+/*{{{  static void tnode_release (tnode_t *t)*/
+/*
+ *	releases the memory of a tree-node (contents already dealt with)
+ */
+static void tnode_release (tnode_t *t)
+{
+	tnoderegion_t *rgn = t->region;
+	int nitems = DA_CUR (t->items);
+
+	if (DA_PTR (t->items) != (void **)(t + 1)) {
+		/* should not happen, but someone resized them */
+		dynarray_trash (t->items);
+	}
+	if (t->chooks) {
+		tnode_freechookset (t->chooks);
+		t->chooks = NULL;
+	}
+	tnode_nlive--;
+
+	if (!rgn) {
+		sfree (t);
+		return;
+	}
+	rgn->nlive--;
+	if (DA_CUR (rgn->freelist) <= nitems) {
+		int i = DA_CUR (rgn->freelist);
+
+		dynarray_setsize (rgn->freelist, nitems + 1);
+		for (; i<=nitems; i++) {
+			DA_SETNTHITEM (rgn->freelist, i, NULL);
+		}
+	}
+	t->tag = NULL;
+	t->org = (srclocn_t *)DA_NTHITEM (rgn->freelist, nitems);
+	DA_SETNTHITEM (rgn->freelist, nitems, t);
+
+	return;
+}
+/*}}}*/
+
+
 /*{{{  tnode_t *tnode_new (ntdef_t *tag, srclocn_t *src)*/
 /*
  *	allocates a new tree-node
@@ -1236,14 +1723,9 @@ tnode_t *tnode_new (ntdef_t *tag, srclocn_t *src)
 {
 	tnode_t *tmp;
 
-	tmp = (tnode_t *)smalloc (sizeof (tnode_t));
-	memset (tmp, 0, sizeof (tnode_t));
-	tmp->tag = tag;
+	tmp = tnode_alloc (tag, 1);
 	tmp->org = src;
 
-	dynarray_init (tmp->items);
-	dynarray_setsize (tmp->items, tag->ndef->nsub + tag->ndef->nname + tag->ndef->nhooks);
-
 	return tmp;
 }
 /*}}}*/
@@ -1255,18 +1737,9 @@ tnode_t *tnode_newfrom (ntdef_t *tag, tnode_t *src)
 {
 	tnode_t *tmp;
 
-	tmp = (tnode_t *)smalloc (sizeof (tnode_t));
-	memset (tmp, 0, sizeof (tnode_t));
-	tmp->tag = tag;
+	tmp = tnode_alloc (tag, 1);
 	tmp->org = src->org;
 
-	dynarray_init (tmp->items);
-	dynarray_setsize (tmp->items, tag->ndef->nsub + tag->ndef->nname + tag->ndef->nhooks);
-	dynarray_init (tmp->chooks);
-	if (DA_CUR (acomphooks)) {
-		dynarray_setsize (tmp->chooks, DA_CUR (acomphooks));
-	}
-
 	return tmp;
 }
 /*}}}*/
@@ -1280,18 +1753,9 @@ tnode_t *tnode_create (ntdef_t *tag, srclocn_t *src, ...)
 	int i;
 	tnode_t *tmp;
 
-	tmp = (tnode_t *)smalloc (sizeof (tnode_t));
-	memset (tmp, 0, sizeof (tnode_t));
-	tmp->tag = tag;
+	tmp = tnode_alloc (tag, 0);
 	tmp->org = src;
 
-	dynarray_init (tmp->items);
-	dynarray_setsize (tmp->items, tag->ndef->nsub + tag->ndef->nname + tag->ndef->nhooks);
-	dynarray_init (tmp->chooks);
-	if (DA_CUR (acomphooks)) {
-		dynarray_setsize (tmp->chooks, DA_CUR (acomphooks));
-	}
-
 	va_start (ap, src);
 	/* should have everything supplied here.. */
 	for (i=0; i<DA_CUR (tmp->items); i++) {
@@ -1329,18 +1793,9 @@ tnode_t *tnode_createfrom (ntdef_t *tag, tnode_t *src, ...)
 	int i;
 	tnode_t *tmp;
 
-	tmp = (tnode_t *)smalloc (sizeof (tnode_t));
-	memset (tmp, 0, sizeof (tnode_t));
-	tmp->tag = tag;
+	tmp = tnode_alloc (tag, 0);
 	tmp->org = src ? src->org : NULL;
 
-	dynarray_init (tmp->items);
-	dynarray_setsize (tmp->items, tag->ndef->nsub + tag->ndef->nname + tag->ndef->nhooks);
-	dynarray_init (tmp->chooks);
-	if (DA_CUR (acomphooks)) {
-		dynarray_setsize (tmp->chooks, DA_CUR (acomphooks));
-	}
-
 	va_start (ap, src);
 	/* should have everything supplied here.. */
 	for (i=0; i<DA_CUR (tmp->items); i++) {
@@ -1376,6 +1831,8 @@ void tnode_free (tnode_t *t)
 {
 	int i;
 	tndef_t *tnd;
+	chook_t *ch;
+	void *chc;
 
 	if (!t) {
 		return;
@@ -1405,22 +1862,18 @@ void tnode_free (tnode_t *t)
 		}
 		/* types and names don't take up any space here.. */
 	}
-	for (i=0; i<DA_CUR (t->chooks); i++) {
-		chook_t *ch = DA_NTHITEM (acomphooks, i);
-		void *chc = DA_NTHITEM (t->chooks, i);
-
-		if (ch && chc && ch->chook_free) {
+	i = 0;
+	while (tnode_chooknext (t->chooks, &i, &ch, &chc)) {
+		if (ch->chook_free) {
 			ch->chook_free (chc);
-		} else if (ch && chc) {
+		} else {
 			nocc_warning ("tnode_free(): freeing compiler-hook (%s) [%s:%s] %p with sfree().", ch->name, tnd->name, t->tag->name, chc);
 			sfree (chc);
 		}
 	}
 	/* FIXME: links in name-nodes back to declarations */
 
-	dynarray_trash (t->items);
-	dynarray_trash (t->chooks);
-	sfree (t);
+	tnode_release (t);
 
 	return;
 }
@@ -1481,23 +1934,19 @@ if (cora_fcn) {
 
 	/* don't forget to do compiler hooks */
 #if 0
-fprintf (stderr, "tnode_copyoraliastree(): copying [%s], num chooks = %d\n", t->tag->name, DA_CUR (t->chooks));
+fprintf (stderr, "tnode_copyoraliastree(): copying [%s], num chooks = %d\n", t->tag->name, t->chooks ? t->chooks->count : 0);
 #endif
-	if (DA_CUR (tmp->chooks) < DA_CUR (t->chooks)) {
-		dynarray_setsize (tmp->chooks, DA_CUR (acomphooks));
-	}
-	for (i=0; i<DA_CUR (t->chooks); i++) {
-		chook_t *ch = DA_NTHITEM (acomphooks, i);
-		void *chc = DA_NTHITEM (t->chooks, i);
-
-		if (ch && chc && (cora & COPY_CHOOKS) && ch->chook_copy) {
-			chc = ch->chook_copy (chc);
+	if (t->chooks) {
+		chook_t *ch;
+		void *chc;
+
+		tmp->chooks = tnode_copychookset (t->chooks);
+		i = 0;
+		while ((cora & COPY_CHOOKS) && tnode_chooknext (tmp->chooks, &i, &ch, &chc)) {
+			if (ch->chook_copy) {
+				tnode_chookfind (tmp->chooks, ch->id)->hook = ch->chook_copy (chc);
+			}
 		}
-		DA_SETNTHITEM (tmp->chooks, i, chc);
-	}
-	/* populate remaining hooks */
-	for (; i<DA_CUR (acomphooks); i++) {
-		dynarray_add (tmp->chooks, NULL);
 	}
 
 	return tmp;
@@ -1597,6 +2046,8 @@ void tnode_dumptree (tnode_t *t, int indent, fhandle_t *stream)
 {
 	int i;
 	tndef_t *tnd;
+	chook_t *ch;
+	void *chc;
 
 	tnode_isetindent (stream, indent);
 	if (!t) {
@@ -1625,14 +2076,12 @@ void tnode_dumptree (tnode_t *t, int indent, fhandle_t *stream)
 			}
 		}
 	}
-	for (i=0; i<DA_CUR (t->chooks); i++) {
+	i = 0;
+	while (tnode_chooknext (t->chooks, &i, &ch, &chc)) {
 		/* compiler hooks */
-		chook_t *ch = DA_NTHITEM (acomphooks, i);
-		void *chc = DA_NTHITEM (t->chooks, i);
-
-		if (ch && chc && ch->chook_dumptree) {
+		if (ch->chook_dumptree) {
 			ch->chook_dumptree (t, chc, indent + 1, stream);
-		} else if (ch && chc) {
+		} else {
 			tnode_isetindent (stream, indent + 1);
 			fhandle_ppxml (stream, "<chook id=\"%s\" addr=\"%p\" />\n", ch->name, chc);
 		}
@@ -1651,6 +2100,8 @@ void tnode_dumpstree (tnode_t *t, int indent, fhandle_t *stream)
 {
 	int i;
 	tndef_t *tnd;
+	chook_t *ch;
+	void *chc;
 
 	tnode_ssetindent (stream, indent);
 	if (!t) {
@@ -1678,14 +2129,12 @@ void tnode_dumpstree (tnode_t *t, int indent, fhandle_t *stream)
 			}
 		}
 	}
-	for (i=0; i<DA_CUR (t->chooks); i++) {
+	i = 0;
+	while (tnode_chooknext (t->chooks, &i, &ch, &chc)) {
 		/* compiler hooks */
-		chook_t *ch = DA_NTHITEM (acomphooks, i);
-		void *chc = DA_NTHITEM (t->chooks, i);
-
-		if (ch && chc && ch->chook_dumpstree) {
+		if (ch->chook_dumpstree) {
 			ch->chook_dumpstree (t, chc, indent + 1, stream);
-		} else if (ch && chc) {
+		} else {
 			tnode_ssetindent (stream, indent + 1);
 			fhandle_printf (stream, "(chook (id \"%s\") (addr %p))\n", ch->name, chc);
 		}
@@ -1827,6 +2276,29 @@ compops_t *tnode_removecompops (compops_t *cops)
 }
 /*}}}*/
 
+/*{{{  static compop_t *tnode_lookupcompop (char *name)*/
+/*
+ *	finds a compiler operation by name, remembering the name pointer for next time
+ *	returns compop_t pointer on success, NULL on failure
+ */
+static compop_t *tnode_lookupcompop (char *name)
+{
+	compop_t *cop = pointerhash_lookup (compopnames, name);
+
+	if (cop) {
+		if ((cop->name == name) || !strcmp (cop->name, name)) {
+			return cop;
+		}
+		/* pointer re-used for some other string */
+		pointerhash_remove (compopnames, cop, name);
+	}
+	cop = stringhash_lookup (compops, name);
+	if (cop) {
+		pointerhash_insert (compopnames, cop, name);
+	}
+	return cop;
+}
+/*}}}*/
 /*{{{  int tnode_setcompop (compops_t *cops, char *name, int nparams, int (*fcn)(compops_t *, ...))*/
 /*
  *	sets a compiler operation on a compops_t structure by name
@@ -1834,7 +2306,7 @@ compops_t *tnode_removecompops (compops_t *cops)
  */
 int tnode_setcompop (compops_t *cops, char *name, int nparams, int (*fcn)(compops_t *, ...))
 {
-	compop_t *cop = stringhash_lookup (compops, name);
+	compop_t *cop = tnode_lookupcompop (name);
 
 	if (!cop) {
 		nocc_internal ("tnode_setcompop(): no such compiler operation [%s]", name);
@@ -1863,7 +2335,7 @@ int tnode_setcompop (compops_t *cops, char *name, int nparams, int (*fcn)(compop
  */
 int tnode_setcompop_bottom (compops_t *cops, char *name, int nparams, int (*fcn)(compops_t *, ...))
 {
-	compop_t *cop = stringhash_lookup (compops, name);
+	compop_t *cop = tnode_lookupcompop (name);
 	compops_t *cx;
 
 	if (!cop) {
@@ -1923,7 +2395,7 @@ int tnode_setcompop_bottom (compops_t *cops, char *name, int nparams, int (*fcn)
  */
 int tnode_hascompop (compops_t *cops, char *name)
 {
-	compop_t *cop = stringhash_lookup (compops, name);
+	compop_t *cop = tnode_lookupcompop (name);
 
 	if (!cops) {
 		return 0;
@@ -2058,7 +2530,7 @@ static int tnode_icallcompop (compops_t *cops, compop_t *op, va_list ap)
  */
 int tnode_callcompop (compops_t *cops, char *name, int nparams, ...)
 {
-	compop_t *cop = stringhash_lookup (compops, name);
+	compop_t *cop = tnode_lookupcompop (name);
 	va_list ap;
 	int r;
 
@@ -2144,6 +2616,130 @@ int tnode_callcompop_i (compops_t *cops, int idx, int nparams, ...)
 	return r;
 }
 /*}}}*/
+/*{{{  static void *tnode_resolvecompop (compops_t **copsp, int idx)*/
+/*
+ *	follows call-throughs for operation 'idx' starting at *copsp, setting *copsp to the compops_t the operation
+ *	is found in;  returns the function or NULL if there isn't one
+ */
+static void *tnode_resolvecompop (compops_t **copsp, int idx)
+{
+	compops_t *cops = *copsp;
+	void *fcn = (idx < DA_CUR (cops->opfuncs)) ? DA_NTHITEM (cops->opfuncs, idx) : NULL;
+
+	while (fcn == (void *)tnode_callthroughcompops) {
+		cops = cops->next;
+		if (!cops) {
+			return NULL;
+		}
+		fcn = (idx < DA_CUR (cops->opfuncs)) ? DA_NTHITEM (cops->opfuncs, idx) : NULL;
+	}
+	*copsp = cops;
+	return fcn;
+}
+/*}}}*/
+/*{{{  int tnode_callcompop_i1 (compops_t *cops, int idx, void *arg0)*/
+/*
+ *	calls a 1-parameter compiler operation by index, without going through varargs
+ *	returns function's return value on success (usually 0 or 1), <0 on failure
+ */
+int tnode_callcompop_i1 (compops_t *cops, int idx, void *arg0)
+{
+	compop_t *cop;
+	compops_t *cx = cops;
+	void *fcn;
+
+	if ((idx < 0) || (idx >= DA_CUR (acompops)) || !(cop = DA_NTHITEM (acompops, idx)) || (cop->nparams != 1) ||
+			!(fcn = tnode_resolvecompop (&cx, idx))) {
+		/* let the general version sort it out (and report any problems) */
+		return tnode_callcompop_i (cops, idx, 1, arg0);
+	}
+	if (cop->dotrace) {
+		nocc_message ("compoptrace: %p [%s]", cop, cop->name);
+	}
+	return ((int (*)(compops_t *, void *))fcn) (cx, arg0);
+}
+/*}}}*/
+/*{{{  int tnode_callcompop_i2 (compops_t *cops, int idx, void *arg0, void *arg1)*/
+/*
+ *	calls a 2-parameter compiler operation by index, without going through varargs
+ *	returns function's return value on success (usually 0 or 1), <0 on failure
+ */
+int tnode_callcompop_i2 (compops_t *cops, int idx, void *arg0, void *arg1)
+{
+	compop_t *cop;
+	compops_t *cx = cops;
+	void *fcn;
+
+	if ((idx < 0) || (idx >= DA_CUR (acompops)) || !(cop = DA_NTHITEM (acompops, idx)) || (cop->nparams != 2) ||
+			!(fcn = tnode_resolvecompop (&cx, idx))) {
+		/* let the general version sort it out (and report any problems) */
+		return tnode_callcompop_i (cops, idx, 2, arg0, arg1);
+	}
+	if (cop->dotrace) {
+		nocc_message ("compoptrace: %p [%s]", cop, cop->name);
+	}
+	return ((int (*)(compops_t *, void *, void *))fcn) (cx, arg0, arg1);
+}
+/*}}}*/
+/*{{{  static int tnode_benchop (compops_t *cops, tnode_t *node)*/
+/*
+ *	does nothing, called by tnode_benchops()
+ */
+static int tnode_benchop (compops_t *cops, tnode_t *node)
+{
+	return (node == NULL);
+}
+/*}}}*/
+/*{{{  static void tnode_benchops (void)*/
+/*
+ *	times calls to a compiler operation inherited through two call-through compops_t's (as for most
+ *	node types), by name, by index, and through the typed helper
+ */
+#define TNODE_BENCHCALLS (2000000)
+static void tnode_benchops (void)
+{
+	static const char *modes[] = {"by name", "by index", "typed, by index"};
+	compops_t *base, *top;
+	int mode, i, r = 0;
+
+	base = tnode_newcompops ();
+	tnode_setcompop (base, "precheck", 1, COMPOPTYPE (tnode_benchop));
+	top = tnode_insertcompops (tnode_insertcompops (base));
+
+	for (mode=0; mode<3; mode++) {
+		struct timeval t_start, t_end;
+		int usecs;
+
+		gettimeofday (&t_start, NULL);
+		for (i=0; i<TNODE_BENCHCALLS; i++) {
+			switch (mode) {
+			case 0:
+				r += tnode_callcompop (top, "precheck", 1, NULL);
+				break;
+			case 1:
+				r += tnode_callcompop_i (top, (int)COPS_PRECHECK, 1, NULL);
+				break;
+			default:
+				r += tnode_callcompop_i1 (top, (int)COPS_PRECHECK, NULL);
+				break;
+			}
+		}
+		gettimeofday (&t_end, NULL);
+		usecs = (int)(((t_end.tv_sec - t_start.tv_sec) * 1000000) + (t_end.tv_usec - t_start.tv_usec));
+		nocc_message ("compop dispatch (%s): %d calls in %d.%3.3d ms, %d.%2.2d ns/call", modes[mode], TNODE_BENCHCALLS,
+				usecs / 1000, usecs % 1000, (usecs * 10) / (TNODE_BENCHCALLS / 100), ((usecs * 1000) / (TNODE_BENCHCALLS / 100)) % 100);
+	}
+
+	if (r != (3 * TNODE_BENCHCALLS)) {
+		nocc_internal ("tnode_benchops(): expected %d, got %d", 3 * TNODE_BENCHCALLS, r);
+	}
+	top = tnode_removecompops (top);
+	top = tnode_removecompops (top);
+	tnode_freecompops (base);
+
+	return;
+}
+/*}}}*/
 /*{{{  int tnode_newcompop (char *name, compops_e opno, int nparams, origin_t *origin)*/
 /*
  *	creates a new compiler operation with the given name;  if 'opno' is valid (!= COPS_INVALID), setting a preset one
@@ -2158,7 +2754,7 @@ int tnode_newcompop (char *name, compops_e opno, int nparams, origin_t *origin)
 		return (int)cop->opno;
 	}
 	cop = (compop_t *)smalloc (sizeof (compop_t));
-	cop->name = string_dup (name);
+	cop->name = string_intern (name);
 	if (opno == COPS_INVALID) {
 		/* means select one */
 		cop->opno = (compops_e)DA_CUR (acompops);
@@ -2194,7 +2790,7 @@ fprintf (stderr, "tnode_newcompop(): extra clear from %d to %d\n", (int)cop->opn
  */
 compop_t *tnode_findcompop (char *name)
 {
-	return stringhash_lookup (compops, name);
+	return tnode_lookupcompop (name);
 }
 /*}}}*/
 /*{{{  void tnode_dumpcompops (compops_t *cops, fhandle_t *stream)*/
@@ -2325,6 +2921,29 @@ langops_t *tnode_removelangops (langops_t *lops)
 }
 /*}}}*/
 
+/*{{{  static langop_t *tnode_lookuplangop (char *name)*/
+/*
+ *	finds a language operation by name, remembering the name pointer for next time
+ *	returns langop_t pointer on success, NULL on failure
+ */
+static langop_t *tnode_lookuplangop (char *name)
+{
+	langop_t *lop = pointerhash_lookup (langopnames, name);
+
+	if (lop) {
+		if ((lop->name == name) || !strcmp (lop->name, name)) {
+			return lop;
+		}
+		/* pointer re-used for some other string */
+		pointerhash_remove (langopnames, lop, name);
+	}
+	lop = stringhash_lookup (langops, name);
+	if (lop) {
+		pointerhash_insert (langopnames, lop, name);
+	}
+	return lop;
+}
+/*}}}*/
 /*{{{  int tnode_setlangop (langops_t *lops, char *name, int nparams, int64_t (*fcn)(langops_t *, ...))*/
 /*
  *	sets a language-operation on a node
@@ -2332,7 +2951,7 @@ langops_t *tnode_removelangops (langops_t *lops)
  */
 int tnode_setlangop (langops_t *lops, char *name, int nparams, int64_t (*fcn)(langops_t *, ...))
 {
-	langop_t *lop = stringhash_lookup (langops, name);
+	langop_t *lop = tnode_lookuplangop (name);
 
 	if (!lop) {
 		nocc_internal ("tnode_setlangop(): no such language operation [%s]", name);
@@ -2361,7 +2980,7 @@ int tnode_setlangop (langops_t *lops, char *name, int nparams, int64_t (*fcn)(la
  */
 int tnode_haslangop (langops_t *lops, char *name)
 {
-	langop_t *lop = stringhash_lookup (langops, name);
+	langop_t *lop = tnode_lookuplangop (name);
 
 	if (!lops) {
 		return 0;
@@ -2497,7 +3116,7 @@ static int64_t tnode_icalllangop (langops_t *lops, langop_t *op, va_list ap)
  */
 int64_t tnode_calllangop (langops_t *lops, char *name, int nparams, ...)
 {
-	langop_t *lop = stringhash_lookup (langops, name);
+	langop_t *lop = tnode_lookuplangop (name);
 	va_list ap;
 	int64_t r;
 
@@ -2586,6 +3205,71 @@ int64_t tnode_calllangop_i (langops_t *lops, int idx, int nparams, ...)
 	return r;
 }
 /*}}}*/
+/*{{{  static void *tnode_resolvelangop (langops_t **lopsp, int idx)*/
+/*
+ *	follows call-throughs for operation 'idx' starting at *lopsp, setting *lopsp to the langops_t the operation
+ *	is found in;  returns the function or NULL if there isn't one
+ */
+static void *tnode_resolvelangop (langops_t **lopsp, int idx)
+{
+	langops_t *lops = *lopsp;
+	void *fcn = (idx < DA_CUR (lops->opfuncs)) ? DA_NTHITEM (lops->opfuncs, idx) : NULL;
+
+	while (fcn == (void *)tnode_callthroughlangops) {
+		lops = lops->next;
+		if (!lops) {
+			return NULL;
+		}
+		fcn = (idx < DA_CUR (lops->opfuncs)) ? DA_NTHITEM (lops->opfuncs, idx) : NULL;
+	}
+	*lopsp = lops;
+	return fcn;
+}
+/*}}}*/
+/*{{{  int64_t tnode_calllangop_i1 (langops_t *lops, int idx, void *arg0)*/
+/*
+ *	calls a 1-parameter language operation by index, without going through varargs
+ *	returns function's return value on success (may be anything for language-ops), <0 on failure
+ */
+int64_t tnode_calllangop_i1 (langops_t *lops, int idx, void *arg0)
+{
+	langop_t *lop;
+	langops_t *cx = lops;
+	void *fcn;
+
+	if ((idx < 0) || (idx >= DA_CUR (alangops)) || !(lop = DA_NTHITEM (alangops, idx)) || (lop->nparams != 1) ||
+			!(fcn = tnode_resolvelangop (&cx, idx))) {
+		/* let the general version sort it out (and report any problems) */
+		return tnode_calllangop_i (lops, idx, 1, arg0);
+	}
+	if (lop->dotrace) {
+		nocc_message ("langoptrace: [%s]", lop->name);
+	}
+	return ((int64_t (*)(langops_t *, void *))fcn) (cx, arg0);
+}
+/*}}}*/
+/*{{{  int64_t tnode_calllangop_i2 (langops_t *lops, int idx, void *arg0, void *arg1)*/
+/*
+ *	calls a 2-parameter language operation by index, without going through varargs
+ *	returns function's return value on success (may be anything for language-ops), <0 on failure
+ */
+int64_t tnode_calllangop_i2 (langops_t *lops, int idx, void *arg0, void *arg1)
+{
+	langop_t *lop;
+	langops_t *cx = lops;
+	void *fcn;
+
+	if ((idx < 0) || (idx >= DA_CUR (alangops)) || !(lop = DA_NTHITEM (alangops, idx)) || (lop->nparams != 2) ||
+			!(fcn = tnode_resolvelangop (&cx, idx))) {
+		/* let the general version sort it out (and report any problems) */
+		return tnode_calllangop_i (lops, idx, 2, arg0, arg1);
+	}
+	if (lop->dotrace) {
+		nocc_message ("langoptrace: [%s]", lop->name);
+	}
+	return ((int64_t (*)(langops_t *, void *, void *))fcn) (cx, arg0, arg1);
+}
+/*}}}*/
 /*{{{  int tnode_newlangop (char *name, langops_e opno, int nparams, origin_t *origin)*/
 /*
  *	creates a new language operation with the given name;  if 'opno' is valid (!= LOPS_INVALID), setting a preset one
@@ -2600,7 +3284,7 @@ int tnode_newlangop (char *name, langops_e opno, int nparams, origin_t *origin)
 		return (int)lop->opno;
 	}
 	lop = (langop_t *)smalloc (sizeof (langop_t));
-	lop->name = string_dup (name);
+	lop->name = string_intern (name);
 	if (opno == LOPS_INVALID) {
 		/* means select one */
 		lop->opno = (langops_e)DA_CUR (alangops);
@@ -2633,7 +3317,7 @@ int tnode_newlangop (char *name, langops_e opno, int nparams, origin_t *origin)
  */
 langop_t *tnode_findlangop (char *name)
 {
-	return stringhash_lookup (langops, name);
+	return tnode_lookuplangop (name);
 }
 /*}}}*/
 
@@ -2703,7 +3387,7 @@ int tnode_haschook (tnode_t *t, chook_t *ch)
 		nocc_internal ("tnode_haschook(): null chook or tree!");
 		return 0;
 	}
-	if (ch->id >= DA_CUR (t->chooks)) {
+	if (!t->chooks || !tnode_getchook (t, ch)) {
 		/* no such hook */
 		return 0;
 	}
@@ -2716,16 +3400,18 @@ int tnode_haschook (tnode_t *t, chook_t *ch)
  */
 void *tnode_getchook (tnode_t *t, chook_t *ch)
 {
+	chookent_t *ent;
+
 	if (!ch || !t) {
 		nocc_internal ("tnode_getchook(): null chook or tree!");
 		return NULL;
 	}
-	if (ch->id >= DA_CUR (t->chooks)) {
+	if (!t->chooks || !(ent = tnode_chookfind (t->chooks, ch->id))) {
 		/* no hook yet */
 		return NULL;
 	}
 
-	return DA_NTHITEM (t->chooks, ch->id);
+	return ent->hook;
 }
 /*}}}*/
 /*{{{  void tnode_setchook (tnode_t *t, chook_t *ch, void *hook)*/
@@ -2734,21 +3420,27 @@ void *tnode_getchook (tnode_t *t, chook_t *ch)
  */
 void tnode_setchook (tnode_t *t, chook_t *ch, void *hook)
 {
-	int i;
+	chookent_t *ent;
 
 	if (!ch || !t) {
 		nocc_internal ("tnode_setchook(): null chook or tree!");
 	}
-	for (i=DA_CUR (t->chooks); i <= ch->id; i++) {
-		dynarray_add (t->chooks, NULL);
-	}
+	ent = t->chooks ? tnode_chookfind (t->chooks, ch->id) : NULL;
 
-	if (DA_NTHITEM (t->chooks, ch->id)) {
+	if (ent && ent->hook) {
 		if (ch->chook_free) {
-			ch->chook_free (DA_NTHITEM (t->chooks, ch->id));
+			ch->chook_free (ent->hook);
 		}
 	}
-	DA_SETNTHITEM (t->chooks, ch->id, hook);
+	if (!hook) {
+		if (ent) {
+			tnode_chookremove (t->chooks, ch->id);
+		}
+	} else if (ent) {
+		ent->hook = hook;
+	} else {
+		t->chooks = tnode_chookadd (t->chooks, ch->id, hook);
+	}
 
 	return;
 }
@@ -2763,11 +3455,11 @@ void tnode_clearchook (tnode_t *t, chook_t *ch)
 	if (!ch || !t) {
 		nocc_internal ("tnode_clearchook(): null chook or tree!");
 	}
-	if (ch->id >= DA_CUR (t->chooks)) {
+	if (!t->chooks) {
 		return;		/* doesn't exist anyway */
 	}
 
-	DA_SETNTHITEM (t->chooks, ch->id, NULL);
+	tnode_chookremove (t->chooks, ch->id);
 
 	return;
 }
@@ -2804,13 +3496,14 @@ int tnode_promotechooks (tnode_t *tsource, tnode_t *tdest)
 	if (!tsource || !tdest) {
 		nocc_internal ("tnode_promotechooks(): null tree!");
 	}
-	for (i=0; i<DA_CUR (tsource->chooks); i++) {
+	for (i=0; tsource->chooks && (i <= tsource->chooks->maxid); i++) {
 		chook_t *chdef = DA_NTHITEM (acomphooks, i);
+		void *hook;
 
-		if ((chdef->flags & CHOOK_AUTOPROMOTE) && DA_NTHITEM (tsource->chooks, i)) {
+		if ((chdef->flags & CHOOK_AUTOPROMOTE) && (hook = tnode_getchook (tsource, chdef))) {
 			/* this one */
-			tnode_setchook (tdest, chdef, DA_NTHITEM (tsource->chooks, i));
-			DA_SETNTHITEM (tsource->chooks, i, NULL);
+			tnode_chookremove (tsource->chooks, i);
+			tnode_setchook (tdest, chdef, hook);
 			moved++;
 		}
 	}
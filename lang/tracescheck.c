@@ -64,11 +64,23 @@ static chook_t *tchk_traceschook = NULL;
 static chook_t *tchk_tracesimplchook = NULL;
 static chook_t *tchk_tracesbvarschook = NULL;
 
+/* hash-consing of closed sub-traces (no atoms, atom-references or fixpoints), shared by copies */
+static tchknode_t **tchk_hctable = NULL;
+static int tchk_hcbits = 0;
+static int tchk_hccount = 0;
+
+#define TCHK_HCINITBITS 8
+
+/* closedness is worked out once per node for each (outermost) copy, nothing changes while copying */
+static unsigned int tchk_copygen = 0;
+static int tchk_copydepth = 0;
+
 
 /*}}}*/
 /*{{{  forward decls*/
 static tchk_traces_t *tchk_newtchktraces (void);
 static void tchk_freetchktraces (tchk_traces_t *tct);
+static void tchk_freetchknode (tchknode_t *tcn);
 
 /*}}}*/
 /*{{{  private types*/
@@ -371,6 +383,10 @@ int tracescheck_init (void)
 
 	tchk_acounter = 1;
 
+	tchk_hcbits = TCHK_HCINITBITS;
+	tchk_hctable = (tchknode_t **)smalloc ((1 << tchk_hcbits) * sizeof (tchknode_t *));
+	tchk_hccount = 0;
+
 	nocc_addxmlnamespace ("tracescheck", "http://www.cs.kent.ac.uk/projects/ofa/nocc/NAMESPACES/tracescheck");
 
 	/*{{{  traces compiler-hooks*/
@@ -417,6 +433,24 @@ int tracescheck_init (void)
  */
 int tracescheck_shutdown (void)
 {
+	/* any hash-consed nodes left are still owned by trees; they just stop being shared */
+	if (tchk_hctable) {
+		int i;
+
+		for (i=0; i<(1 << tchk_hcbits); i++) {
+			tchknode_t *tcn, *next;
+
+			for (tcn = tchk_hctable[i]; tcn; tcn = next) {
+				next = tcn->hnext;
+				tcn->hnext = NULL;
+			}
+		}
+		sfree (tchk_hctable);
+		tchk_hctable = NULL;
+	}
+	tchk_hcbits = 0;
+	tchk_hccount = 0;
+
 	return 0;
 }
 /*}}}*/
@@ -548,10 +582,353 @@ static tchknode_t *tchk_newtchknode (tnode_t *orgnode)
 	tcn->type = TCN_INVALID;
 	tcn->orgnode = orgnode;
 	tcn->mark = 0;
+	tcn->refs = 0;
+	tcn->simple = 0;
+	tcn->hval = 0;
+	tcn->hnext = NULL;
+	tcn->closed = 0;
+	tcn->closedgen = 0;
 
 	return tcn;
 }
 /*}}}*/
+/*{{{  static unsigned int tchk_hcmix (unsigned int h, const void *ptr)*/
+/*
+ *	mixes a pointer into a structural hash
+ */
+static unsigned int tchk_hcmix (unsigned int h, const void *ptr)
+{
+	uint64_t v = (uint64_t)(uintptr_t)ptr;
+
+	h ^= (unsigned int)(v ^ (v >> 32));
+	h *= 0x01000193;
+	h ^= (h >> 15);
+	return h;
+}
+/*}}}*/
+/*{{{  static unsigned int tchk_hcnodehash (tchknode_t *tcn)*/
+/*
+ *	computes the structural hash of a node whose sub-nodes are all hash-consed
+ *	(so these can be hashed by address)
+ */
+static unsigned int tchk_hcnodehash (tchknode_t *tcn)
+{
+	unsigned int h = 0x811c9dc5 ^ (unsigned int)tcn->type;
+	int i;
+
+	h = tchk_hcmix (h, tcn->orgnode);
+	switch (tcn->type) {
+	case TCN_SEQ:
+	case TCN_PAR:
+	case TCN_DET:
+	case TCN_NDET:
+		for (i=0; i<DA_CUR (tcn->u.tcnlist.items); i++) {
+			h = tchk_hcmix (h, DA_NTHITEM (tcn->u.tcnlist.items, i));
+		}
+		break;
+	case TCN_INPUT:
+	case TCN_OUTPUT:
+		h = tchk_hcmix (h, tcn->u.tcnio.varptr);
+		h = tchk_hcmix (h, tcn->u.tcnio.tagptr);
+		break;
+	case TCN_NODEREF:
+		h = tchk_hcmix (h, tcn->u.tcnnref.nref);
+		break;
+	case TCN_FIELD:
+		h = tchk_hcmix (h, tcn->u.tcnfield.base);
+		h = tchk_hcmix (h, tcn->u.tcnfield.field);
+		break;
+	default:
+		break;
+	}
+	return h;
+}
+/*}}}*/
+/*{{{  static int tchk_hcsamenode (tchknode_t *a, tchknode_t *b)*/
+/*
+ *	compares two nodes whose sub-nodes are all hash-consed
+ *	returns non-zero if structurally the same
+ */
+static int tchk_hcsamenode (tchknode_t *a, tchknode_t *b)
+{
+	int i;
+
+	if ((a->type != b->type) || (a->orgnode != b->orgnode)) {
+		return 0;
+	}
+	switch (a->type) {
+	case TCN_SEQ:
+	case TCN_PAR:
+	case TCN_DET:
+	case TCN_NDET:
+		if (DA_CUR (a->u.tcnlist.items) != DA_CUR (b->u.tcnlist.items)) {
+			return 0;
+		}
+		for (i=0; i<DA_CUR (a->u.tcnlist.items); i++) {
+			if (DA_NTHITEM (a->u.tcnlist.items, i) != DA_NTHITEM (b->u.tcnlist.items, i)) {
+				return 0;
+			}
+		}
+		return 1;
+	case TCN_INPUT:
+	case TCN_OUTPUT:
+		return ((a->u.tcnio.varptr == b->u.tcnio.varptr) && (a->u.tcnio.tagptr == b->u.tcnio.tagptr));
+	case TCN_NODEREF:
+		return (a->u.tcnnref.nref == b->u.tcnnref.nref);
+	case TCN_FIELD:
+		return ((a->u.tcnfield.base == b->u.tcnfield.base) && (a->u.tcnfield.field == b->u.tcnfield.field));
+	default:
+		break;
+	}
+	return 1;
+}
+/*}}}*/
+/*{{{  static void tchk_hcgrow (void)*/
+/*
+ *	doubles the size of the hash-cons table
+ */
+static void tchk_hcgrow (void)
+{
+	int oldsize = (1 << tchk_hcbits);
+	tchknode_t **oldtable = tchk_hctable;
+	int i;
+
+	tchk_hcbits++;
+	tchk_hctable = (tchknode_t **)smalloc ((1 << tchk_hcbits) * sizeof (tchknode_t *));
+	for (i=0; i<oldsize; i++) {
+		tchknode_t *tcn, *next;
+
+		for (tcn = oldtable[i]; tcn; tcn = next) {
+			int slot = tcn->hval & ((1 << tchk_hcbits) - 1);
+
+			next = tcn->hnext;
+			tcn->hnext = tchk_hctable[slot];
+			tchk_hctable[slot] = tcn;
+		}
+	}
+	sfree (oldtable);
+	return;
+}
+/*}}}*/
+/*{{{  static void tchk_hcremove (tchknode_t *tcn)*/
+/*
+ *	removes a node from the hash-cons table (last reference gone, or being unshared)
+ */
+static void tchk_hcremove (tchknode_t *tcn)
+{
+	tchknode_t **tptr;
+
+	if (!tchk_hctable) {
+		/* after shutdown */
+		return;
+	}
+	for (tptr = &(tchk_hctable[tcn->hval & ((1 << tchk_hcbits) - 1)]); *tptr; tptr = &((*tptr)->hnext)) {
+		if (*tptr == tcn) {
+			*tptr = tcn->hnext;
+			tcn->hnext = NULL;
+			tchk_hccount--;
+			return;
+		}
+	}
+	nocc_internal ("tchk_hcremove(): node %p not in hash-cons table", tcn);
+	return;
+}
+/*}}}*/
+/*{{{  static int tchk_isclosed (tchknode_t *tcn)*/
+/*
+ *	determines whether a sub-trace is closed, i.e. has no atoms, atom-references or fixpoints
+ *	in it, and so can be hash-consed (copies of these need fresh atoms).  the result is kept in
+ *	the node for the rest of the copy in progress, so each node is only looked at once.
+ *	returns non-zero if closed
+ */
+static int tchk_isclosed (tchknode_t *tcn)
+{
+	int i, closed = 0;
+
+	if (tcn->refs > 0) {
+		return 1;
+	}
+	if (tchk_copydepth && (tcn->closedgen == tchk_copygen)) {
+		return tcn->closed;
+	}
+	switch (tcn->type) {
+	case TCN_SEQ:
+	case TCN_PAR:
+	case TCN_DET:
+	case TCN_NDET:
+		closed = 1;
+		for (i=0; closed && (i<DA_CUR (tcn->u.tcnlist.items)); i++) {
+			tchknode_t *item = DA_NTHITEM (tcn->u.tcnlist.items, i);
+
+			if (item && !tchk_isclosed (item)) {
+				closed = 0;
+			}
+		}
+		break;
+	case TCN_INPUT:
+	case TCN_OUTPUT:
+		closed = (tcn->u.tcnio.varptr && tchk_isclosed (tcn->u.tcnio.varptr) &&
+				(!tcn->u.tcnio.tagptr || tchk_isclosed (tcn->u.tcnio.tagptr)));
+		break;
+	case TCN_FIELD:
+		closed = (tcn->u.tcnfield.base && tchk_isclosed (tcn->u.tcnfield.base));
+		break;
+	case TCN_NODEREF:
+	case TCN_SKIP:
+	case TCN_STOP:
+	case TCN_DIV:
+	case TCN_CHAOS:
+		closed = 1;
+		break;
+	default:
+		break;
+	}
+	if (tchk_copydepth) {
+		tcn->closed = closed;
+		tcn->closedgen = tchk_copygen;
+	}
+	return closed;
+}
+/*}}}*/
+/*{{{  static tchknode_t *tchk_hashcons (tchknode_t *tcn)*/
+/*
+ *	returns the shared (hash-consed) node structurally identical to a closed sub-trace,
+ *	creating it if there isn't one yet.  The given sub-trace is not consumed.
+ *	returns shared node, holding a reference for the caller
+ */
+static tchknode_t *tchk_hashcons (tchknode_t *tcn)
+{
+	tchknode_t *key, *hcn;
+	int i;
+
+	if (tcn->refs > 0) {
+		tcn->refs++;
+		return tcn;
+	}
+
+	/* candidate with shared sub-nodes */
+	key = tchk_newtchknode (tcn->orgnode);
+	key->type = tcn->type;
+	key->simple = 1;
+	switch (tcn->type) {
+	case TCN_SEQ:
+	case TCN_PAR:
+	case TCN_DET:
+	case TCN_NDET:
+		dynarray_init (key->u.tcnlist.items);
+		for (i=0; i<DA_CUR (tcn->u.tcnlist.items); i++) {
+			tchknode_t *item = DA_NTHITEM (tcn->u.tcnlist.items, i);
+
+			if (item) {
+				item = tchk_hashcons (item);
+				dynarray_add (key->u.tcnlist.items, item);
+				key->simple = key->simple && item->simple;
+			}
+		}
+		if (DA_CUR (key->u.tcnlist.items) == 1) {
+			key->simple = 0;
+		}
+		break;
+	case TCN_INPUT:
+	case TCN_OUTPUT:
+		key->u.tcnio.varptr = tchk_hashcons (tcn->u.tcnio.varptr);
+		key->u.tcnio.tagptr = tcn->u.tcnio.tagptr ? tchk_hashcons (tcn->u.tcnio.tagptr) : NULL;
+		key->simple = key->u.tcnio.varptr->simple && (!key->u.tcnio.tagptr || key->u.tcnio.tagptr->simple);
+		break;
+	case TCN_NODEREF:
+		key->u.tcnnref.nref = tcn->u.tcnnref.nref;
+		break;
+	case TCN_FIELD:
+		key->u.tcnfield.base = tchk_hashcons (tcn->u.tcnfield.base);
+		key->u.tcnfield.field = tcn->u.tcnfield.field;
+		key->simple = key->u.tcnfield.base->simple;
+		break;
+	default:
+		break;
+	}
+	key->hval = tchk_hcnodehash (key);
+
+	for (hcn = tchk_hctable[key->hval & ((1 << tchk_hcbits) - 1)]; hcn; hcn = hcn->hnext) {
+		if ((hcn->hval == key->hval) && tchk_hcsamenode (hcn, key)) {
+			/* already have this one, drop the candidate (and its sub-node references) */
+			hcn->refs++;
+			tchk_freetchknode (key);
+			return hcn;
+		}
+	}
+
+	if (tchk_hccount >= (2 << tchk_hcbits)) {
+		tchk_hcgrow ();
+	}
+	i = key->hval & ((1 << tchk_hcbits) - 1);
+	key->hnext = tchk_hctable[i];
+	tchk_hctable[i] = key;
+	tchk_hccount++;
+	key->refs = 1;
+
+	return key;
+}
+/*}}}*/
+/*{{{  static tchknode_t *tchk_unshare (tchknode_t *tcn)*/
+/*
+ *	turns a reference to a hash-consed node into an ordinary (modifiable) node of its own,
+ *	whose sub-nodes stay shared.  The caller's reference is given up.
+ *	returns the modifiable node
+ */
+static tchknode_t *tchk_unshare (tchknode_t *tcn)
+{
+	tchknode_t *ucn;
+	int i;
+
+	if (tcn->refs == 0) {
+		return tcn;
+	} else if (tcn->refs == 1) {
+		/* only holder, can have it as it is */
+		tchk_hcremove (tcn);
+		tcn->refs = 0;
+		return tcn;
+	}
+
+	ucn = tchk_newtchknode (tcn->orgnode);
+	ucn->type = tcn->type;
+	switch (tcn->type) {
+	case TCN_SEQ:
+	case TCN_PAR:
+	case TCN_DET:
+	case TCN_NDET:
+		dynarray_init (ucn->u.tcnlist.items);
+		for (i=0; i<DA_CUR (tcn->u.tcnlist.items); i++) {
+			tchknode_t *item = DA_NTHITEM (tcn->u.tcnlist.items, i);
+
+			item->refs++;
+			dynarray_add (ucn->u.tcnlist.items, item);
+		}
+		break;
+	case TCN_INPUT:
+	case TCN_OUTPUT:
+		ucn->u.tcnio.varptr = tcn->u.tcnio.varptr;
+		ucn->u.tcnio.varptr->refs++;
+		ucn->u.tcnio.tagptr = tcn->u.tcnio.tagptr;
+		if (ucn->u.tcnio.tagptr) {
+			ucn->u.tcnio.tagptr->refs++;
+		}
+		break;
+	case TCN_NODEREF:
+		ucn->u.tcnnref.nref = tcn->u.tcnnref.nref;
+		break;
+	case TCN_FIELD:
+		ucn->u.tcnfield.base = tcn->u.tcnfield.base;
+		ucn->u.tcnfield.base->refs++;
+		ucn->u.tcnfield.field = tcn->u.tcnfield.field;
+		break;
+	default:
+		break;
+	}
+	tcn->refs--;
+
+	return ucn;
+}
+/*}}}*/
 /*{{{  static void tchk_freetchknode (tchknode_t *tcn)*/
 /*
  *	frees a tchknode_t structure (deep)
@@ -562,6 +939,14 @@ static void tchk_freetchknode (tchknode_t *tcn)
 		nocc_internal ("tchk_freetchknode(): NULL node!");
 		return;
 	}
+	if (tcn->refs > 0) {
+		/* hash-consed: only goes when the last holder lets go */
+		tcn->refs--;
+		if (tcn->refs > 0) {
+			return;
+		}
+		tchk_hcremove (tcn);
+	}
 	switch (tcn->type) {
 	case TCN_INVALID:
 	case TCN_SKIP:
@@ -600,7 +985,13 @@ static void tchk_freetchknode (tchknode_t *tcn)
 		break;
 	case TCN_INPUT:
 	case TCN_OUTPUT:
-		/* always a link into the tree */
+		/* always a link into the tree, unless shared */
+		if (tcn->u.tcnio.varptr && (tcn->u.tcnio.varptr->refs > 0)) {
+			tchk_freetchknode (tcn->u.tcnio.varptr);
+		}
+		if (tcn->u.tcnio.tagptr && (tcn->u.tcnio.tagptr->refs > 0)) {
+			tchk_freetchknode (tcn->u.tcnio.tagptr);
+		}
 		tcn->u.tcnio.varptr = NULL;
 		tcn->u.tcnio.tagptr = NULL;
 		break;
@@ -860,7 +1251,7 @@ static int tchk_prewalk_tree (tnode_t *node, void *data)
 	}
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_TRACESCHECK)) {
-		res = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_TRACESCHECK, 2, node, tcstate);
+		res = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_TRACESCHECK, node, tcstate);
 	}
 
 	return res;
@@ -961,6 +1352,68 @@ static int tchk_substatomrefsinnode (tchknode_t *node, tchknode_t *aold, tchknod
 	return r;
 }
 /*}}}*/
+/*{{{  static tchknode_t **tchk_subnodeptr (tchknode_t *tcn, int idx)*/
+/*
+ *	returns the address of a node's 'idx'th sub-node, NULL if it has no more
+ */
+static tchknode_t **tchk_subnodeptr (tchknode_t *tcn, int idx)
+{
+	switch (tcn->type) {
+	case TCN_SEQ:
+	case TCN_PAR:
+	case TCN_DET:
+	case TCN_NDET:
+		return (idx < DA_CUR (tcn->u.tcnlist.items)) ? DA_NTHITEMADDR (tcn->u.tcnlist.items, idx) : NULL;
+	case TCN_FIXPOINT:
+		return (idx == 0) ? &(tcn->u.tcnfix.id) : ((idx == 1) ? &(tcn->u.tcnfix.proc) : NULL);
+	case TCN_INPUT:
+	case TCN_OUTPUT:
+		return (idx == 0) ? &(tcn->u.tcnio.varptr) : (((idx == 1) && tcn->u.tcnio.tagptr) ? &(tcn->u.tcnio.tagptr) : NULL);
+	case TCN_FIELD:
+		return (idx == 0) ? &(tcn->u.tcnfield.base) : NULL;
+	default:
+		break;
+	}
+	return NULL;
+}
+/*}}}*/
+/*{{{  static int tchk_modprewalksub (tchknode_t **tcnptr, int idx, int (*func)(tchknode_t **, void *), void *arg)*/
+/*
+ *	does a mod pre-walk of a node's 'idx'th sub-node.  if the node is shared (hash-consed), the
+ *	sub-node is walked through a reference of its own, and the node is only unshared if the
+ *	sub-node is actually rewritten
+ *	returns the result of tracescheck_modprewalk() on the sub-node
+ */
+static int tchk_modprewalksub (tchknode_t **tcnptr, int idx, int (*func)(tchknode_t **, void *), void *arg)
+{
+	tchknode_t **sptr = tchk_subnodeptr (*tcnptr, idx);
+	tchknode_t *sub;
+	int r;
+
+	if (!sptr) {
+		return 0;
+	}
+	if (!(*tcnptr)->refs || !*sptr) {
+		return tracescheck_modprewalk (sptr, func, arg);
+	}
+
+	/* sub-nodes of shared nodes are shared, so any rewrite of this one makes a new node */
+	sub = *sptr;
+	sub->refs++;
+	r = tracescheck_modprewalk (&sub, func, arg);
+	if (sub == *sptr) {
+		sub->refs--;
+		return r;
+	}
+
+	*tcnptr = tchk_unshare (*tcnptr);
+	sptr = tchk_subnodeptr (*tcnptr, idx);
+	tchk_freetchknode (*sptr);
+	*sptr = sub;
+
+	return r;
+}
+/*}}}*/
 /*{{{  static int tchk_simplifynodeprewalk (tchknode_t **tcnptr, void *arg)*/
 /*
  *	called to simplify a node (in a modprewalk)
@@ -975,6 +1428,10 @@ static int tchk_simplifynodeprewalk (tchknode_t **tcnptr, void *arg)
 		return 0;
 	}
 	tcn = *tcnptr;
+	if ((tcn->refs > 0) && tcn->simple) {
+		/* shared and known to be as simple as it gets */
+		return 0;
+	}
 	switch (tcn->type) {
 	default:
 		break;
@@ -983,7 +1440,10 @@ static int tchk_simplifynodeprewalk (tchknode_t **tcnptr, void *arg)
 	case TCN_DET:
 	case TCN_NDET:
 		if (DA_CUR (tcn->u.tcnlist.items) == 1) {
-			tchknode_t *item = DA_NTHITEM (tcn->u.tcnlist.items, 0);
+			tchknode_t *item;
+
+			tcn = tchk_unshare (tcn);
+			item = DA_NTHITEM (tcn->u.tcnlist.items, 0);
 
 			*tcnptr = item;
 			dynarray_trash (tcn->u.tcnlist.items);
@@ -1007,6 +1467,7 @@ static int tchk_prunetracesmodprewalk (tchknode_t **nodep, void *arg)
 	tchknode_t *n = *nodep;
 	int i, changed;
 
+	/* sub-nodes are walked here: a shared node is unshared only if one of them is rewritten */
 	switch (n->type) {
 		/*{{{  INVALID,ATOM,ATOMREF,SKIP,STOP,DIV,CHAOS*/
 	case TCN_INVALID:
@@ -1022,15 +1483,15 @@ static int tchk_prunetracesmodprewalk (tchknode_t **nodep, void *arg)
 	case TCN_FIXPOINT:
 		changed = 0;
 		{
-			tchknode_t **iptr = &(n->u.tcnfix.proc);
 			int saved_changed = ptrace->changed;
 
 			ptrace->changed = 0;
-			tracescheck_modprewalk (iptr, tchk_prunetracesmodprewalk, (void *)ptrace);
+			tchk_modprewalksub (nodep, 1, tchk_prunetracesmodprewalk, (void *)ptrace);
 
 			changed += ptrace->changed;
 			ptrace->changed = saved_changed;
 		}
+		n = *nodep;
 		if (changed) {
 			/* inspect what's left for obvious cases */
 			if (!n->u.tcnfix.proc) {
@@ -1098,18 +1559,20 @@ static int tchk_prunetracesmodprewalk (tchknode_t **nodep, void *arg)
 	case TCN_SEQ:
 	case TCN_PAR:
 		changed = 0;
-		for (i=0; i<DA_CUR (n->u.tcnlist.items); i++) {
-			tchknode_t **iptr = DA_NTHITEMADDR (n->u.tcnlist.items, i);
+		for (i=0; i<DA_CUR ((*nodep)->u.tcnlist.items); i++) {
 			int saved_changed = ptrace->changed;
 
 			ptrace->changed = 0;
-			tracescheck_modprewalk (iptr, tchk_prunetracesmodprewalk, (void *)ptrace);
+			tchk_modprewalksub (nodep, i, tchk_prunetracesmodprewalk, (void *)ptrace);
 
 			changed += ptrace->changed;
 			ptrace->changed = saved_changed;
 		}
+		n = *nodep;
 		if (changed) {
 			/* might have some NULL items in the list */
+			n = tchk_unshare (n);
+			*nodep = n;
 			for (i=0; i<DA_CUR (n->u.tcnlist.items); i++) {
 				if (!DA_NTHITEM (n->u.tcnlist.items, i)) {
 					dynarray_delitem (n->u.tcnlist.items, i);
@@ -1153,26 +1616,24 @@ static int tchk_prunetracesmodprewalk (tchknode_t **nodep, void *arg)
 	case TCN_OUTPUT:
 		changed = 0;
 		{
-			tchknode_t **iptr = &(n->u.tcnio.varptr);
 			int saved_changed = ptrace->changed;
 
 			ptrace->changed = 0;
-			tracescheck_modprewalk (iptr, tchk_prunetracesmodprewalk, (void *)ptrace);
+			tchk_modprewalksub (nodep, 0, tchk_prunetracesmodprewalk, (void *)ptrace);
 
 			changed += ptrace->changed;
 			ptrace->changed = saved_changed;
 
 			/* and the tag if we have one */
-			if (n->u.tcnio.tagptr) {
-				iptr = &(n->u.tcnio.tagptr);
-
+			if ((*nodep)->u.tcnio.tagptr) {
 				ptrace->changed = 0;
-				tracescheck_modprewalk (iptr, tchk_prunetracesmodprewalk, (void *)ptrace);
+				tchk_modprewalksub (nodep, 1, tchk_prunetracesmodprewalk, (void *)ptrace);
 
 				changed += ptrace->changed;
 				ptrace->changed = saved_changed;
 			}
 		}
+		n = *nodep;
 		if (changed) {
 			if (!n->u.tcnio.varptr) {
 				/* we're toast */
@@ -1187,15 +1648,15 @@ static int tchk_prunetracesmodprewalk (tchknode_t **nodep, void *arg)
 	case TCN_FIELD:
 		changed = 0;
 		{
-			tchknode_t **iptr = &(n->u.tcnfield.base);
 			int saved_changed = ptrace->changed;
 
 			ptrace->changed = 0;
-			tracescheck_modprewalk (iptr, tchk_prunetracesmodprewalk, (void *)ptrace);
+			tchk_modprewalksub (nodep, 0, tchk_prunetracesmodprewalk, (void *)ptrace);
 
 			changed += ptrace->changed;
 			ptrace->changed = saved_changed;
 		}
+		n = *nodep;
 		if (changed) {
 			if (!n->u.tcnfield.base) {
 				/* we're toast */
@@ -1234,17 +1695,18 @@ static int tchk_firsteventprewalk (tchknode_t *node, void *arg)
 	return 1;
 }
 /*}}}*/
-/*{{{  static int tchk_substitutenodes_prewalk (tchknode_t *tcn, void *arg)*/
+/*{{{  static int tchk_substitutenodes_modprewalk (tchknode_t **tcnptr, void *arg)*/
 /*
- *	substitutes node references in a traces node (prewalk)
+ *	substitutes node references in a traces node (modprewalk)
  *	returns 0 to stop walk, 1 to continue
  */
-static int tchk_substitutenodes_prewalk (tchknode_t *tcn, void *arg)
+static int tchk_substitutenodes_modprewalk (tchknode_t **tcnptr, void *arg)
 {
 	substnode_t *sn = (substnode_t *)arg;
+	tchknode_t *tcn = *tcnptr;
 
 	if (!sn) {
-		nocc_serious ("tchk_substitutenodes_prewalk(): NULL substnode state!");
+		nocc_serious ("tchk_substitutenodes_modprewalk(): NULL substnode state!");
 		return 0;
 	}
 	if (!tcn) {
@@ -1255,6 +1717,8 @@ static int tchk_substitutenodes_prewalk (tchknode_t *tcn, void *arg)
 
 		for (i=0; i<sn->count; i++) {
 			if (tcn->u.tcnnref.nref == sn->flist[i]) {
+				tcn = tchk_unshare (tcn);
+				*tcnptr = tcn;
 				tcn->u.tcnnref.nref = sn->alist[i];
 				break;
 			}
@@ -1396,61 +1860,14 @@ int tracescheck_modprewalk (tchknode_t **tcnptr, int (*func)(tchknode_t **, void
 		return 0;
 	}
 	i = func (tcnptr, arg);
-	if (i) {
-		switch ((*tcnptr)->type) {
-			/*{{{  INVALID,ATOM,ATOMREF,NODEREF,SKIP,STOP,DIV,CHAOS*/
-		case TCN_INVALID:
-		case TCN_ATOM:
-		case TCN_ATOMREF:
-		case TCN_NODEREF:
-		case TCN_SKIP:
-		case TCN_STOP:
-		case TCN_DIV:
-		case TCN_CHAOS:
-			break;
-			/*}}}*/
-			/*{{{  SEQ,PAR,DET,NDET*/
-		case TCN_SEQ:
-		case TCN_PAR:
-		case TCN_DET:
-		case TCN_NDET:
-			for (i=0; i<DA_CUR ((*tcnptr)->u.tcnlist.items); i++) {
-				tchknode_t **iptr = DA_NTHITEMADDR ((*tcnptr)->u.tcnlist.items, i);
+	if (i && *tcnptr) {
+		int idx;
 
-				if (tracescheck_modprewalk (iptr, func, arg)) {
-					r++;
-				}
-			}
-			break;
-			/*}}}*/
-			/*{{{  FIXPOINT*/
-		case TCN_FIXPOINT:
-			if (tracescheck_modprewalk (&((*tcnptr)->u.tcnfix.id), func, arg)) {
-				r++;
-			}
-			if (tracescheck_modprewalk (&((*tcnptr)->u.tcnfix.proc), func, arg)) {
-				r++;
-			}
-			break;
-			/*}}}*/
-			/*{{{  INPUT,OUTPUT*/
-		case TCN_INPUT:
-		case TCN_OUTPUT:
-			if (tracescheck_modprewalk (&((*tcnptr)->u.tcnio.varptr), func, arg)) {
+		/* a shared node is unshared only if one of its sub-nodes is rewritten */
+		for (idx=0; tchk_subnodeptr (*tcnptr, idx); idx++) {
+			if (tchk_modprewalksub (tcnptr, idx, func, arg)) {
 				r++;
 			}
-			if ((*tcnptr)->u.tcnio.tagptr && tracescheck_modprewalk (&((*tcnptr)->u.tcnio.tagptr), func, arg)) {
-				r++;
-			}
-			break;
-			/*}}}*/
-			/*{{{  FIELD*/
-		case TCN_FIELD:
-			if (tracescheck_modprewalk (&((*tcnptr)->u.tcnfield.base), func, arg)) {
-				r++;
-			}
-			break;
-			/*}}}*/
 		}
 	}
 	return r;
@@ -2091,9 +2508,23 @@ tchknode_t *tracescheck_dupref (tchknode_t *tcn)
 	return newtcn;
 }
 /*}}}*/
+/*{{{  static tchknode_t *tchk_copysubnode (tchknode_t *tcn)*/
+/*
+ *	duplicates a sub-node of a traces-check node: closed sub-traces are shared (hash-consed)
+ *	returns new or shared node
+ */
+static tchknode_t *tchk_copysubnode (tchknode_t *tcn)
+{
+	if (tcn && tchk_isclosed (tcn)) {
+		return tchk_hashcons (tcn);
+	}
+	return tracescheck_copynode (tcn);
+}
+/*}}}*/
 /*{{{  tchknode_t *tracescheck_copynode (tchknode_t *tcn)*/
 /*
- *	duplicates (deep) a traces-check node
+ *	duplicates (deep) a traces-check node; closed sub-traces are not copied, but shared
+ *	(hash-consed), so the new node is the only part guaranteed to be unshared
  *	returns new node on success, NULL on failure
  */
 tchknode_t *tracescheck_copynode (tchknode_t *tcn)
@@ -2104,7 +2535,15 @@ tchknode_t *tracescheck_copynode (tchknode_t *tcn)
 		nocc_serious ("tracescheck_copynode(): NULL node!");
 		return NULL;
 	}
-	
+	if (!tchk_copydepth) {
+		/* outermost copy: closedness worked out afresh */
+		tchk_copygen++;
+		if (!tchk_copygen) {
+			tchk_copygen++;
+		}
+	}
+	tchk_copydepth++;
+
 	tcc = tchk_newtchknode (tcn->orgnode);
 
 	tcc->type = tcn->type;
@@ -2126,7 +2565,7 @@ tchknode_t *tracescheck_copynode (tchknode_t *tcn)
 				tchknode_t *item = DA_NTHITEM (tcn->u.tcnlist.items, i);
 
 				if (item) {
-					tchknode_t *icopy = tracescheck_copynode (item);
+					tchknode_t *icopy = tchk_copysubnode (item);
 
 					dynarray_add (tcc->u.tcnlist.items, icopy);
 				}
@@ -2137,9 +2576,9 @@ tchknode_t *tracescheck_copynode (tchknode_t *tcn)
 		/*{{{  INPUT,OUTPUT*/
 	case TCN_INPUT:
 	case TCN_OUTPUT:
-		tcc->u.tcnio.varptr = tracescheck_copynode (tcn->u.tcnio.varptr);
+		tcc->u.tcnio.varptr = tchk_copysubnode (tcn->u.tcnio.varptr);
 		if (tcn->u.tcnio.tagptr) {
-			tcc->u.tcnio.tagptr = tracescheck_copynode (tcn->u.tcnio.tagptr);
+			tcc->u.tcnio.tagptr = tchk_copysubnode (tcn->u.tcnio.tagptr);
 		} else {
 			tcc->u.tcnio.tagptr = NULL;
 		}
@@ -2155,7 +2594,7 @@ tchknode_t *tracescheck_copynode (tchknode_t *tcn)
 			tcc->u.tcnfix.proc = NULL;
 
 			if (tcn->u.tcnfix.proc) {
-				tcc->u.tcnfix.proc = tracescheck_copynode (tcn->u.tcnfix.proc);
+				tcc->u.tcnfix.proc = tchk_copysubnode (tcn->u.tcnfix.proc);
 
 				/* now go through and rename references */
 				tchk_substatomrefsinnode (tcc->u.tcnfix.proc, tcn->u.tcnfix.id, tcc->u.tcnfix.id);
@@ -2192,12 +2631,13 @@ tchknode_t *tracescheck_copynode (tchknode_t *tcn)
 		/*}}}*/
 		/*{{{  FIELD*/
 	case TCN_FIELD:
-		tcc->u.tcnfield.base = tracescheck_copynode (tcn->u.tcnfield.base);
+		tcc->u.tcnfield.base = tchk_copysubnode (tcn->u.tcnfield.base);
 		tcc->u.tcnfield.field = tcn->u.tcnfield.field;
 		break;
 		/*}}}*/
 	}
 
+	tchk_copydepth--;
 	return tcc;
 }
 /*}}}*/
@@ -2547,7 +2987,10 @@ for (i=0; i<count; i++) {
 fprintf (stderr, "    %p (%s) -> %p (%s)\n", sn->flist[i], sn->flist[i]->tag->name, sn->alist[i], sn->alist[i]->tag->name);
 }}
 #endif
-	tracescheck_prewalk (tcn, tchk_substitutenodes_prewalk, (void *)sn);
+	if (tcn->refs > 0) {
+		nocc_internal ("tracescheck_substitutenodes(): shared node at top-level");
+	}
+	tracescheck_modprewalk (&tcn, tchk_substitutenodes_modprewalk, (void *)sn);
 
 	tchk_freesubstnode (sn);
 	return 0;
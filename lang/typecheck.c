@@ -178,7 +178,7 @@ int typecheck_prewalktree (tnode_t *node, void *arg)
 	int i = 1;
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_TYPECHECK)) {
-		i = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_TYPECHECK, 2, node, (typecheck_t *)arg);
+		i = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_TYPECHECK, node, (typecheck_t *)arg);
 	}
 	return i;
 }
@@ -241,7 +241,7 @@ tnode_dumptree (typelist, 1, stderr);
 		nocc_internal ("typecheck_gettype(): don't know how to get type of [%s]", node->tag->ndef->name);
 		return NULL;
 	}
-	type = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETTYPE, 2, node, default_type);
+	type = (tnode_t *)tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_GETTYPE, node, default_type);
 
 	if (compopts.tracetypecheck) {
 		/*{{{  report type-check (get-type part)*/
@@ -267,7 +267,7 @@ tnode_t *typecheck_getsubtype (tnode_t *node, tnode_t *default_type)
 		nocc_internal ("typecheck_getsubtype(): don't know how to get sub-type of [%s]", node->tag->ndef->name);
 		return NULL;
 	}
-	type = (tnode_t *)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_GETSUBTYPE, 2, node, default_type);
+	type = (tnode_t *)tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_GETSUBTYPE, node, default_type);
 
 	return type;
 }
@@ -372,7 +372,7 @@ tnode_t *typecheck_typereduce (tnode_t *type)
 			nocc_message ("typecheck_typereduce(): reducing (%s,%s)", type->tag->ndef->name, type->tag->name);
 			/*}}}*/
 		}
-		return (tnode_t *)tnode_calllangop_i (type->tag->ndef->lops, (int)LOPS_TYPEREDUCE, 1, type);
+		return (tnode_t *)tnode_calllangop_i1 (type->tag->ndef->lops, (int)LOPS_TYPEREDUCE, type);
 	}
 	return NULL;
 }
@@ -395,7 +395,7 @@ int typecheck_cantypecast (tnode_t *node, tnode_t *srctype)
 					srctype->tag->ndef->name, srctype->tag->name);
 			/*}}}*/
 		}
-		return tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_CANTYPECAST, 2, node, srctype);
+		return tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_CANTYPECAST, node, srctype);
 	}
 	tnode_warning (node, "typecheck_cantypecast(): don\'t know how to check type-casts to (%s,%s)", node->tag->ndef->name, node->tag->name);
 	return 0;
@@ -416,7 +416,7 @@ int typecheck_istype (tnode_t *node)
 			nocc_message ("typecheck_istype(): checking whether (%s,%s) is a type", node->tag->ndef->name, node->tag->name);
 			/*}}}*/
 		}
-		return tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_ISTYPE, 1, node);
+		return tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_ISTYPE, node);
 	}
 	return 0;
 }
@@ -431,7 +431,7 @@ typecat_e typecheck_typetype (tnode_t *node)
 		return TYPE_NOTTYPE;
 	}
 	if (node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_TYPETYPE)) {
-		return (typecat_e)tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_TYPETYPE, 1, node);
+		return (typecat_e)tnode_calllangop_i1 (node->tag->ndef->lops, (int)LOPS_TYPETYPE, node);
 	}
 	nocc_message ("typecheck_typetype(): called for non-supporting node! (%s,%s)", node->tag->ndef->name, node->tag->name);
 	return TYPE_NOTTYPE;
@@ -504,7 +504,7 @@ int typeresolve_modprewalktree (tnode_t **nodep, void *arg)
 	int i = 1;
 
 	if (*nodep && (*nodep)->tag->ndef->ops && tnode_hascompop_i ((*nodep)->tag->ndef->ops, (int)COPS_TYPERESOLVE)) {
-		i = tnode_callcompop_i ((*nodep)->tag->ndef->ops, (int)COPS_TYPERESOLVE, 2, nodep, (typecheck_t *)arg);
+		i = tnode_callcompop_i2 ((*nodep)->tag->ndef->ops, (int)COPS_TYPERESOLVE, nodep, (typecheck_t *)arg);
 	}
 	return i;
 }
@@ -53,8 +53,18 @@
 typedef struct TAG_uchk_chook_set {
 	DYNARRAY (tnode_t *, items);
 	DYNARRAY (uint64_t, modes);
+	POINTERHASH (void *, index, 4);		/* item -> (index in items + 1) */
 } uchk_chook_set_t;
 
+/* per-branch bitsets used when checking the branches of a PAR for overlaps */
+typedef enum ENUM_uchk_bits {
+	UCB_READ = 0,
+	UCB_WRITE = 1,
+	UCB_INPUT = 2,
+	UCB_OUTPUT = 3,
+	UCB_NSETS = 4
+} uchk_bits_e;
+
 typedef struct TAG_uchk_chook {
 	DYNARRAY (uchk_chook_set_t *, parusage);
 } uchk_chook_t;
@@ -86,6 +96,7 @@ static uchk_chook_set_t *uchk_newuchkchookset (void)
 
 	dynarray_init (ucset->items);
 	dynarray_init (ucset->modes);
+	pointerhash_init (ucset->index, 4);
 
 	return ucset;
 }
@@ -129,6 +140,7 @@ static void uchk_freeuchkchookset (uchk_chook_set_t *ucset)
 	}
 	dynarray_trash (ucset->items);
 	dynarray_trash (ucset->modes);
+	pointerhash_trash (ucset->index);
 
 	sfree (ucset);
 	return;
@@ -353,7 +365,7 @@ fprintf (stderr, "uchk_prewalk_tree(): [%s]\n", node->tag->name);
 			uchk_mode_t savedmode = ucstate->defmode;
 
 			ucstate->defmode = thook->mode;
-			result = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_DO_USAGECHECK, 2, node, ucstate);
+			result = tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_DO_USAGECHECK, node, ucstate);
 			ucstate->defmode = savedmode;
 			/*}}}*/
 		} else {
@@ -364,7 +376,7 @@ fprintf (stderr, "uchk_prewalk_tree(): [%s]\n", node->tag->name);
 		}
 	} else {
 		if (node->tag->ndef->lops && tnode_haslangop_i (node->tag->ndef->lops, (int)LOPS_DO_USAGECHECK)) {
-			result = tnode_calllangop_i (node->tag->ndef->lops, (int)LOPS_DO_USAGECHECK, 2, node, ucstate);
+			result = tnode_calllangop_i2 (node->tag->ndef->lops, (int)LOPS_DO_USAGECHECK, node, ucstate);
 		}
 	}
 
@@ -410,7 +422,7 @@ static int puchk_modprewalk_tree (tnode_t **tptr, void *data)
 	}
 
 	if ((*tptr)->tag->ndef->ops && tnode_hascompop_i ((*tptr)->tag->ndef->ops, (int)COPS_POSTUSAGECHECK)) {
-		result = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_POSTUSAGECHECK, 1, tptr);
+		result = tnode_callcompop_i1 ((*tptr)->tag->ndef->ops, (int)COPS_POSTUSAGECHECK, tptr);
 	}
 
 	return result;
@@ -550,6 +562,27 @@ void usagecheck_warning (tnode_t *org, uchk_state_t *ucstate, const char *fmt, .
 /*}}}*/
 
 
+/*{{{  static void uchk_setadd (uchk_chook_set_t *ucset, tnode_t *node, uchk_mode_t mode)*/
+/*
+ *	adds an item to a usage-checking set, or merges the mode into an existing entry
+ */
+static void uchk_setadd (uchk_chook_set_t *ucset, tnode_t *node, uchk_mode_t mode)
+{
+	int idx = (int)((uintptr_t)pointerhash_lookup (ucset->index, node));
+
+	if (idx) {
+		uchk_mode_t chkmode = (uchk_mode_t)DA_NTHITEM (ucset->modes, idx - 1);
+
+		chkmode |= mode;
+		DA_SETNTHITEM (ucset->modes, idx - 1, (uint64_t)chkmode);
+	} else {
+		dynarray_add (ucset->items, node);
+		dynarray_add (ucset->modes, (uint64_t)mode);
+		pointerhash_insert (ucset->index, (void *)((uintptr_t)DA_CUR (ucset->items)), node);
+	}
+	return;
+}
+/*}}}*/
 /*{{{  int usagecheck_addname (tnode_t *node, uchk_state_t *ucstate, uchk_mode_t mode)*/
 /*
  *	adds a name to parallel usage with the given mode
@@ -559,7 +592,6 @@ int usagecheck_addname (tnode_t *node, uchk_state_t *ucstate, uchk_mode_t mode)
 {
 	uchk_chook_t *uchook;
 	uchk_chook_set_t *ucset;
-	int i;
 
 	if (node->tag == uchk_tag_USAGE) {
 		node = tnode_nthsubof (node, 0);
@@ -580,22 +612,7 @@ nocc_message ("usagecheck_addname(): allocating [%s,%s] with mode 0x%x", node->t
 		return -1;
 	}
 
-	for (i=0; i<DA_CUR (ucset->items); i++) {
-		tnode_t *chknode = DA_NTHITEM (ucset->items, i);
-
-		if (chknode == node) {
-			uchk_mode_t chkmode = (uchk_mode_t)DA_NTHITEM (ucset->modes, i);
-
-			chkmode |= mode;
-			DA_SETNTHITEM (ucset->modes, i, (uint64_t)chkmode);
-			break;		/* for() */
-		}
-	}
-
-	if (i == DA_CUR (ucset->items)) {
-		dynarray_add (ucset->items, node);
-		dynarray_add (ucset->modes, (uint64_t)mode);
-	}
+	uchk_setadd (ucset, node, mode);
 
 	return 0;
 }
@@ -628,26 +645,7 @@ int usagecheck_mergeall (tnode_t *node, uchk_state_t *ucstate)
 		int j;
 
 		for (j=0; j<DA_CUR (srcset->items); j++) {
-			tnode_t *srcnode = DA_NTHITEM (srcset->items, j);
-			uchk_mode_t srcmode = (uchk_mode_t)DA_NTHITEM (srcset->modes, j);
-			int k;
-
-			for (k=0; k<DA_CUR (ucset->items); k++) {
-				tnode_t *chknode = DA_NTHITEM (ucset->items, k);
-
-				if (srcnode == chknode) {
-					uchk_mode_t chkmode = (uchk_mode_t)DA_NTHITEM (ucset->modes, k);
-
-					chkmode |= srcmode;
-					DA_SETNTHITEM (ucset->modes, k, (uint64_t)chkmode);
-					break;		/* for(k) */
-				}
-			}
-			if (k == DA_CUR (ucset->items)) {
-				dynarray_add (ucset->items, srcnode);
-				dynarray_add (ucset->modes, (uint64_t)srcmode);
-			}
-
+			uchk_setadd (ucset, DA_NTHITEM (srcset->items, j), (uchk_mode_t)DA_NTHITEM (srcset->modes, j));
 		}
 	}
 	return 0;
@@ -697,10 +695,88 @@ static int usagecheck_sub_no_overlaps (tnode_t *node, uchk_state_t *ucstate, uch
 	return 0;
 }
 /*}}}*/
+/*{{{  static int usagecheck_anyoverlap (uchk_chook_t *srchook)*/
+/*
+ *	quick check for any overlap between the branches of a PAR: items are numbered, each branch's reads,
+ *	writes, inputs and outputs become bitsets, and each branch is checked against the union of those before it
+ *	(word-wise, a loop the C compiler can vectorise).
+ *	returns non-zero if some pair of branches clash
+ */
+static int usagecheck_anyoverlap (uchk_chook_t *srchook)
+{
+	POINTERHASH (void *, numbers, 6);
+	int nitems = 0;
+	int nwords, i, j, w;
+	uint64_t *bits, *seen, clash = 0;
+
+	pointerhash_init (numbers, 6);
+	for (i=0; i<DA_CUR (srchook->parusage); i++) {
+		uchk_chook_set_t *ucset = DA_NTHITEM (srchook->parusage, i);
+
+		for (j=0; j<DA_CUR (ucset->items); j++) {
+			tnode_t *item = DA_NTHITEM (ucset->items, j);
+
+			if (!pointerhash_lookup (numbers, item)) {
+				nitems++;
+				pointerhash_insert (numbers, (void *)((uintptr_t)nitems), item);
+			}
+		}
+	}
+
+	if (!nitems) {
+		pointerhash_trash (numbers);
+		return 0;
+	}
+	nwords = (nitems + 63) >> 6;
+	bits = (uint64_t *)smalloc (2 * UCB_NSETS * nwords * sizeof (uint64_t));
+	seen = bits + (UCB_NSETS * nwords);
+
+	for (i=0; !clash && (i<DA_CUR (srchook->parusage)); i++) {
+		uchk_chook_set_t *ucset = DA_NTHITEM (srchook->parusage, i);
+		uint64_t *br = bits + (UCB_READ * nwords), *bw = bits + (UCB_WRITE * nwords);
+		uint64_t *bi = bits + (UCB_INPUT * nwords), *bo = bits + (UCB_OUTPUT * nwords);
+		uint64_t *sr = seen + (UCB_READ * nwords), *sw = seen + (UCB_WRITE * nwords);
+		uint64_t *si = seen + (UCB_INPUT * nwords), *so = seen + (UCB_OUTPUT * nwords);
+
+		memset (bits, 0, UCB_NSETS * nwords * sizeof (uint64_t));
+		for (j=0; j<DA_CUR (ucset->items); j++) {
+			int n = (int)((uintptr_t)pointerhash_lookup (numbers, DA_NTHITEM (ucset->items, j))) - 1;
+			uchk_mode_t mode = (uchk_mode_t)DA_NTHITEM (ucset->modes, j);
+			uint64_t mask = (uint64_t)1 << (n & 63);
+
+			if (mode & USAGE_READ) {
+				br[n >> 6] |= mask;
+			}
+			if (mode & USAGE_WRITE) {
+				bw[n >> 6] |= mask;
+			}
+			if (mode & USAGE_INPUT) {
+				bi[n >> 6] |= mask;
+			}
+			if (mode & USAGE_OUTPUT) {
+				bo[n >> 6] |= mask;
+			}
+		}
+		for (w=0; w<nwords; w++) {
+			clash |= (bi[w] & si[w]) | (bo[w] & so[w]) | (bw[w] & (sw[w] | sr[w])) | (br[w] & sw[w]);
+			sr[w] |= br[w];
+			sw[w] |= bw[w];
+			si[w] |= bi[w];
+			so[w] |= bo[w];
+		}
+	}
+
+	sfree (bits);
+	pointerhash_trash (numbers);
+
+	return (clash != 0);
+}
+/*}}}*/
 /*{{{  int usagecheck_no_overlaps (tnode_t *node, uchk_state_t *ucstate)*/
 /*
  *	checks that there are no overlaps in usage-checking sets of the given node
- *	(e.g. when checking PAR nodes for safety)
+ *	(e.g. when checking PAR nodes for safety).  pairs of branches are only compared item by item
+ *	(and names produced) if the bitset check finds a clash somewhere.
  *	returns 0 on success, non-zero on failure (errors reported)
  */
 int usagecheck_no_overlaps (tnode_t *node, uchk_state_t *ucstate)
@@ -712,6 +788,9 @@ int usagecheck_no_overlaps (tnode_t *node, uchk_state_t *ucstate)
 		usagecheck_error (node, ucstate, "no sets here..");
 		return -1;
 	}
+	if ((DA_CUR (srchook->parusage) < 2) || !usagecheck_anyoverlap (srchook)) {
+		return 0;
+	}
 
 	for (i=0; i<DA_CUR (srchook->parusage); i++) {
 		uchk_chook_set_t *srcset = DA_NTHITEM (srchook->parusage, i);
@@ -59,6 +59,26 @@ STATICDYNARRAY (lexfile_t *, openlexfiles);
 /* slightly nasty: if we want a log of all tokens, do here in nexttoken() */
 static fhandle_t *tokendumpstream;
 
+#define LEXARENA_TOKBLOCK 512		/* tokens per arena block */
+#define LEXARENA_STRBLOCK 16384		/* bytes per arena string block */
+
+/* per-lexfile arena for tokens and their names/strings, released in bulk when the file is closed */
+typedef struct TAG_lexarena {
+	DYNARRAY (void *, blocks);	/* token and string blocks */
+	token_t *tfree;			/* recycled tokens (linked through iptr) */
+	token_t *tnext;			/* next unused token in the current block */
+	int tleft;			/* unused tokens in the current block */
+	char *snext;			/* next unused byte in the current string block */
+	int sleft;			/* unused bytes in the current string block */
+	char *scratch;			/* scratch buffer for lexer_scratch() */
+	int scratchsize;
+	int live;			/* tokens handed out and not yet freed */
+	int closed;			/* set if the lexfile was closed with tokens still live */
+	int ntokens;			/* statistics */
+	int nrecycled;
+	int nbytes;
+} lexarena_t;
+
 /*}}}*/
 
 
@@ -100,6 +120,56 @@ int lexer_shutdown (void)
 /*}}}*/
 
 
+/*{{{  static lexarena_t *lexer_newarena (void)*/
+/*
+ *	creates a new (empty) token arena
+ */
+static lexarena_t *lexer_newarena (void)
+{
+	lexarena_t *la = (lexarena_t *)smalloc (sizeof (lexarena_t));
+
+	dynarray_init (la->blocks);
+	la->tfree = NULL;
+	la->tnext = NULL;
+	la->tleft = 0;
+	la->snext = NULL;
+	la->sleft = 0;
+	la->scratch = NULL;
+	la->scratchsize = 0;
+	la->live = 0;
+	la->closed = 0;
+	la->ntokens = 0;
+	la->nrecycled = 0;
+	la->nbytes = 0;
+
+	return la;
+}
+/*}}}*/
+/*{{{  static void lexer_freearena (lexarena_t *la)*/
+/*
+ *	frees a token arena, along with all the tokens and strings in it
+ */
+static void lexer_freearena (lexarena_t *la)
+{
+	int i;
+
+	if (!la) {
+		nocc_warning ("lexer_freearena(): NULL pointer!");
+		return;
+	}
+	for (i=0; i<DA_CUR (la->blocks); i++) {
+		sfree (DA_NTHITEM (la->blocks, i));
+	}
+	dynarray_trash (la->blocks);
+	if (la->scratch) {
+		sfree (la->scratch);
+	}
+	sfree (la);
+	return;
+}
+/*}}}*/
+
+
 /*{{{  int lexer_relpathto (const char *filename, char *target, int tsize)*/
 /*
  *	determines the current relative path to a particular file-name, based on something that we can read
@@ -294,8 +364,6 @@ fprintf (stderr, "lexer_open(): openlexfile[%d] has supported extension \"%s\"\n
 	if (i == DA_CUR (lexfiles)) {
 		lf = (lexfile_t *)smalloc (sizeof (lexfile_t));
 
-		memset (lf, 0, sizeof (lexfile_t));
-
 		lf->filename = string_dup (fnbuf);
 		for (lf->fnptr = lf->filename + (strlen (lf->filename) - 1); (lf->fnptr > lf->filename) && ((lf->fnptr)[-1] != '/'); (lf->fnptr)--);
 
@@ -346,6 +414,7 @@ fprintf (stderr, "lexer_open(): openlexfile[%d] has supported extension \"%s\"\n
 	lf->warncount = 0;
 	lf->ppriv = NULL;
 	dynarray_init (lf->tokbuffer);
+	lf->arena = lexer_newarena ();
 	if (lf->lexer->openfile) {
 		lf->lexer->openfile (lf, lp);
 	}
@@ -459,6 +528,7 @@ lexfile_t *lexer_openbuf (char *fname, char *langname, char *buf)
 	lf->sepcomp = 0;
 
 	dynarray_init (lf->tokbuffer);
+	lf->arena = lexer_newarena ();
 	if (lf->lexer->openfile) {
 		lf->lexer->openfile (lf, lp);
 	}
@@ -516,6 +586,22 @@ void lexer_close (lexfile_t *lf)
 	}
 	sfree (lp);
 	lf->priv = NULL;
+
+	if (lf->arena) {
+		lexarena_t *la = lf->arena;
+
+		if (compopts.verbose > 1) {
+			nocc_message ("lexed %s: %d tokens (%d recycled), %d bytes of names/strings", lf->fnptr,
+					la->ntokens, la->nrecycled, la->nbytes);
+		}
+		if (!la->live) {
+			lexer_freearena (la);
+		} else {
+			/* tokens still in use, released when the last one is freed */
+			la->closed = 1;
+		}
+		lf->arena = NULL;
+	}
 	/* leave lf alone for things that refer back to it */
 	return;
 }
@@ -627,7 +713,6 @@ lexfile_t *lexer_internal (const char *fname)
 	}
 
 	lf = (lexfile_t *)smalloc (sizeof (lexfile_t));
-	memset (lf, 0, sizeof (lexfile_t));
 
 	lf->filename = ciname;
 	lf->fnptr = lf->filename;
@@ -643,6 +728,7 @@ lexfile_t *lexer_internal (const char *fname)
 	lf->warncount = 0;
 
 	dynarray_init (lf->tokbuffer);
+	lf->arena = NULL;
 
 	lf->toplevel = 0;
 	lf->islibrary = 0;
@@ -672,6 +758,8 @@ token_t *lexer_newtoken (tokentype_t type, ...)
 	tok->lineno = 0;
 	tok->colno = 0;
 	tok->tokwidth = 0;
+	tok->arena = NULL;
+	tok->strinarena = 0;
 
 	va_start (ap, type);
 	switch (type) {
@@ -713,7 +801,7 @@ token_t *lexer_newtoken (tokentype_t type, ...)
 			char *name = va_arg (ap, char *);
 
 			if (name) {
-				tok->u.name = string_dup (name);
+				tok->u.name = lexer_tokname (tok, name, strlen (name));
 			} else {
 				tok->u.name = NULL;
 			}
@@ -748,6 +836,136 @@ token_t *lexer_newtoken (tokentype_t type, ...)
 	return tok;
 }
 /*}}}*/
+/*{{{  token_t *lexer_newlextoken (lexfile_t *lf)*/
+/*
+ *	creates a new (NOTOKEN) token for a language lexer, taken from the lexfile's arena if it has one
+ */
+token_t *lexer_newlextoken (lexfile_t *lf)
+{
+	lexarena_t *la = lf->arena;
+	token_t *tok;
+
+	if (!la) {
+		tok = lexer_newtoken (NOTOKEN);
+		tok->origin = lf;
+		return tok;
+	}
+
+	if (la->tfree) {
+		tok = la->tfree;
+		la->tfree = (token_t *)tok->iptr;
+		la->nrecycled++;
+	} else {
+		if (!la->tleft) {
+			la->tnext = (token_t *)smalloc_nz (LEXARENA_TOKBLOCK * sizeof (token_t));
+			la->tleft = LEXARENA_TOKBLOCK;
+			dynarray_add (la->blocks, (void *)la->tnext);
+		}
+		tok = la->tnext++;
+		la->tleft--;
+	}
+	la->live++;
+	la->ntokens++;
+
+	memset ((void *)tok, 0, sizeof (token_t));
+	tok->type = NOTOKEN;
+	tok->origin = lf;
+	tok->arena = la;
+	tok->strinarena = 0;
+
+	return tok;
+}
+/*}}}*/
+/*{{{  char *lexer_tokalloc (token_t *tok, int bytes)*/
+/*
+ *	allocates space for a token's name or string, in the token's arena if it has one (not cleared).
+ *	the space belongs to the token: lexer_freetoken() releases it, lexer_claimname() takes it.
+ */
+char *lexer_tokalloc (token_t *tok, int bytes)
+{
+	lexarena_t *la = tok->arena;
+	char *ptr;
+
+	if (!la) {
+		tok->strinarena = 0;
+		return (char *)smalloc_nz (bytes);
+	}
+
+	if (bytes > (LEXARENA_STRBLOCK >> 2)) {
+		/* big, give it a block of its own */
+		ptr = (char *)smalloc_nz (bytes);
+		dynarray_add (la->blocks, (void *)ptr);
+	} else {
+		if (la->sleft < bytes) {
+			la->snext = (char *)smalloc_nz (LEXARENA_STRBLOCK);
+			la->sleft = LEXARENA_STRBLOCK;
+			dynarray_add (la->blocks, (void *)la->snext);
+		}
+		ptr = la->snext;
+		la->snext += bytes;
+		la->sleft -= bytes;
+	}
+	la->nbytes += bytes;
+	tok->strinarena = 1;
+
+	return ptr;
+}
+/*}}}*/
+/*{{{  char *lexer_tokstrndup (token_t *tok, const char *str, int len)*/
+/*
+ *	duplicates a string for use as a token's name or string (see lexer_tokalloc())
+ */
+char *lexer_tokstrndup (token_t *tok, const char *str, int len)
+{
+	char *ptr = lexer_tokalloc (tok, len + 1);
+
+	memcpy (ptr, str, len);
+	ptr[len] = '\0';
+	return ptr;
+}
+/*}}}*/
+/*{{{  char *lexer_tokname (token_t *tok, const char *str, int len)*/
+/*
+ *	returns the interned name for a NAME token.  like an arena string, lexer_freetoken() leaves it
+ *	alone and lexer_claimname() hands out a copy.
+ */
+char *lexer_tokname (token_t *tok, const char *str, int len)
+{
+	tok->strinarena = 1;
+	return string_nintern (str, len);
+}
+/*}}}*/
+/*{{{  char *lexer_scratch (lexfile_t *lf, const char *str, int len)*/
+/*
+ *	copies a string into a scratch buffer belonging to the lexfile, for short-lived use in a lexer
+ *	(e.g. keyword lookup, number conversion).  valid until the next call.
+ */
+char *lexer_scratch (lexfile_t *lf, const char *str, int len)
+{
+	lexarena_t *la = lf->arena;
+
+	if (!la) {
+		nocc_internal ("lexer_scratch(): %s is not open", lf->filename);
+		return NULL;
+	}
+	if (la->scratchsize <= len) {
+		int nsize = la->scratchsize ? la->scratchsize : 64;
+
+		while (nsize <= len) {
+			nsize <<= 1;
+		}
+		if (la->scratch) {
+			sfree (la->scratch);
+		}
+		la->scratch = (char *)smalloc_nz (nsize);
+		la->scratchsize = nsize;
+	}
+	memcpy (la->scratch, str, len);
+	la->scratch[len] = '\0';
+
+	return la->scratch;
+}
+/*}}}*/
 /*{{{  void lexer_dumptoken (fhandle_t *stream, token_t *tok)*/
 /*
  *	prints out what a token is (for debugging)
@@ -1035,13 +1253,13 @@ void lexer_freetoken (token_t *tok)
 	}
 	switch (tok->type) {
 	case NAME:
-		if (tok->u.name) {
+		if (tok->u.name && !tok->strinarena) {
 			sfree (tok->u.name);
 		}
 		break;
 	case STRING:
 	case INAME:
-		if (tok->u.str.ptr) {
+		if (tok->u.str.ptr && !tok->strinarena) {
 			sfree (tok->u.str.ptr);
 		}
 		break;
@@ -1053,11 +1271,40 @@ void lexer_freetoken (token_t *tok)
 	default:
 		break;
 	}
+	if (tok->arena) {
+		lexarena_t *la = tok->arena;
+
+		/* back on the free-list for this arena (cleared when reused) */
+		tok->iptr = (void *)la->tfree;
+		la->tfree = tok;
+		la->live--;
+
+		if (la->closed && !la->live) {
+			lexer_freearena (la);
+		}
+		return;
+	}
 	memset ((void *)tok, 0, sizeof (token_t));
 	sfree (tok);
 	return;
 }
 /*}}}*/
+/*{{{  char *lexer_claimname (token_t *tok)*/
+/*
+ *	takes the name from a NAME token, leaving the token without one
+ *	returns a string the caller owns (and must eventually sfree)
+ */
+char *lexer_claimname (token_t *tok)
+{
+	char *name = tok->u.name;
+
+	if (name && tok->strinarena) {
+		name = string_dup (name);
+	}
+	tok->u.name = NULL;
+	return name;
+}
+/*}}}*/
 /*{{{  int lexer_tokmatch (token_t *formal, token_t *actual)*/
 /*
  *	returns non-zero if "actual" is a match for "formal"
@@ -0,0 +1,1375 @@
+/*
+ *	compcache.c -- build cache, reuses the outputs of an earlier identical compile
+ *	Copyright (C) 2016 Fred Barnes <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ *	with --build-cache <dir> (or NOCC_BUILD_CACHE set), a compile is looked up in a local cache directory
+ *	before any compiler stages run.  the lookup key is a digest of the compiler itself, the target, the
+ *	specs file (and the settings it expanded from the environment, see compcache_addkey()), any NOCC_*
+ *	environment variables, the working directory and the arguments.  an entry records the files the compile read
+ *	(by content digest), the files it looked for and did not find, the files it wrote, and whatever it
+ *	said on standard output and error.  if all the files read are unchanged and none of those missing
+ *	have appeared, the outputs are put back and the compile is done.
+ *
+ *	files are seen through the fhandle layer as they are opened, anything else (libraries, objects from
+ *	the C compiler) is reported with compcache_adddep() and compcache_addoutput().  entries and restored
+ *	outputs are written to a temporary name and renamed, so builds sharing a cache directory only ever
+ *	see whole files.  statistics live in the cache directory and are updated under a lock, as is the
+ *	least-recently-used trimming when the cache outgrows its size limit.
+ */
+
+/*{{{  includes*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <utime.h>
+#include <dirent.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "nocc.h"
+#include "support.h"
+#include "version.h"
+#include "opts.h"
+#include "origin.h"
+#include "fhandle.h"
+#include "crypto.h"
+#include "compcache.h"
+
+extern char **environ;
+
+/*}}}*/
+/*{{{  private types/data*/
+
+#define COMPCACHE_MAGIC "nocc-build-cache 1"
+#define COMPCACHE_DEFSIZE 256			/* default size limit, MiB */
+#define COMPCACHE_TRIMTO 90			/* percentage of the limit trimmed down to */
+#define COMPCACHE_STALETMP 3600			/* temporary files older than this (seconds) are left-overs */
+
+/* counters kept in <dir>/stats */
+typedef struct TAG_ccstats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long stores;
+	unsigned long long evictions;
+	unsigned long long bytes;		/* approximate, corrected when trimming */
+} ccstats_t;
+
+/* an output file in a cache entry */
+typedef struct TAG_ccoutput {
+	char *path;
+	unsigned int mode;
+	size_t size;
+	unsigned char *data;
+} ccoutput_t;
+
+/* an entry file found when trimming the cache */
+typedef struct TAG_ccfile {
+	char *path;
+	time_t mtime;
+	size_t size;
+} ccfile_t;
+
+static char *cc_dir = NULL;			/* set by --build-cache, or from NOCC_BUILD_CACHE */
+static int cc_limit = COMPCACHE_DEFSIZE;	/* --build-cache-size, MiB */
+
+static int cc_active = 0;			/* recording a compile */
+static char *cc_entry = NULL;			/* entry file for this compile */
+static char *cc_nostorewhy = NULL;
+
+STATICDYNARRAY (char *, cc_deps);
+STATICDYNARRAY (char *, cc_depsigs);		/* stat signature of each when first read (see compcache_statsig) */
+STATICDYNARRAY (char *, cc_keyextra);		/* other settings in the lookup key (see compcache_addkey) */
+STATICDYNARRAY (char *, cc_outputs);
+STATICDYNARRAY (char *, cc_absent);
+
+static FILE *cc_capture[2] = {NULL, NULL};	/* copies of standard output and error while recording */
+static int cc_savedfd[2] = {-1, -1};		/* the real standard output and error */
+static pid_t cc_teepid = -1;			/* process copying output to both (see compcache_tee) */
+static int cc_atexit = 0;
+
+
+/*}}}*/
+
+
+/*{{{  static char *compcache_statsig (const char *path)*/
+/*
+ *	returns a string that changes whenever the file is modified (or replaced), or NULL if it cannot be stat'd
+ */
+static char *compcache_statsig (const char *path)
+{
+	struct stat stbuf;
+
+	if (stat (path, &stbuf)) {
+		return NULL;
+	}
+	return string_fmt ("%lld.%09ld %lld %llu", (long long)stbuf.st_mtim.tv_sec, (long)stbuf.st_mtim.tv_nsec,
+			(long long)stbuf.st_size, (unsigned long long)stbuf.st_ino);
+}
+/*}}}*/
+/*{{{  static int compcache_strcompare (char *first, char *second)*/
+/*
+ *	compares two strings (for sorting)
+ */
+static int compcache_strcompare (char *first, char *second)
+{
+	return strcmp (first, second);
+}
+/*}}}*/
+/*{{{  static int compcache_writeall (int fd, const void *buf, size_t len)*/
+/*
+ *	writes a buffer to a file
+ *	returns 0 on success, non-zero on failure
+ */
+static int compcache_writeall (int fd, const void *buf, size_t len)
+{
+	const char *ch = (const char *)buf;
+
+	while (len > 0) {
+		ssize_t n = write (fd, ch, len);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;		/* while() */
+			}
+			return -1;
+		}
+		ch += n;
+		len -= n;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static unsigned char *compcache_readfd (int fd, size_t *lenp, int *modep)*/
+/*
+ *	reads the whole of an open (regular) file into memory, from the start
+ *	returns a new buffer on success (with length and mode set, NUL terminated), NULL on failure
+ */
+static unsigned char *compcache_readfd (int fd, size_t *lenp, int *modep)
+{
+	struct stat stbuf;
+	unsigned char *buf;
+	size_t got = 0;
+
+	if (fstat (fd, &stbuf) || !S_ISREG (stbuf.st_mode)) {
+		return NULL;
+	}
+	buf = (unsigned char *)smalloc ((size_t)stbuf.st_size + 1);
+	while (got < (size_t)stbuf.st_size) {
+		ssize_t n = pread (fd, buf + got, (size_t)stbuf.st_size - got, (off_t)got);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;		/* while() */
+			}
+			break;				/* while() */
+		} else if (!n) {
+			break;				/* while() */
+		}
+		got += n;
+	}
+	if (got != (size_t)stbuf.st_size) {
+		sfree (buf);
+		return NULL;
+	}
+	buf[got] = '\0';
+	*lenp = got;
+	if (modep) {
+		*modep = (int)(stbuf.st_mode & 07777);
+	}
+	return buf;
+}
+/*}}}*/
+/*{{{  static unsigned char *compcache_readfile (const char *path, size_t *lenp, int *modep)*/
+/*
+ *	reads the whole of a file into memory
+ *	returns a new buffer on success (with length and mode set, NUL terminated), NULL on failure
+ */
+static unsigned char *compcache_readfile (const char *path, size_t *lenp, int *modep)
+{
+	unsigned char *buf;
+	int fd = open (path, O_RDONLY);
+
+	if (fd < 0) {
+		return NULL;
+	}
+	buf = compcache_readfd (fd, lenp, modep);
+	close (fd);
+	return buf;
+}
+/*}}}*/
+/*{{{  static int compcache_tmpopen (const char *path, char **tmpnamep, int mode)*/
+/*
+ *	creates a new temporary file for writing a file that is then renamed into place (same directory, so atomic).
+ *	the name is fresh: an existing file (another compile's, or something planted) is never written through.
+ *	returns a descriptor on success (with *tmpnamep set to a new string), < 0 on failure
+ */
+static int compcache_tmpopen (const char *path, char **tmpnamep, int mode)
+{
+	const char *base = strrchr (path, '/');
+	int i, fd = -1;
+
+	for (i=0; (fd < 0) && (i < 16); i++) {
+		if (!base) {
+			*tmpnamep = string_fmt (".%s.nbc%d.%d", path, (int)getpid (), i);
+		} else {
+			*tmpnamep = string_fmt ("%.*s/.%s.nbc%d.%d", (int)(base - path), path, base + 1, (int)getpid (), i);
+		}
+		fd = open (*tmpnamep, O_WRONLY | O_CREAT | O_EXCL, mode);
+		if (fd < 0) {
+			int err = errno;
+
+			sfree (*tmpnamep);
+			*tmpnamep = NULL;
+			errno = err;
+			if (err != EEXIST) {
+				break;		/* for() */
+			}
+		}
+	}
+	return fd;
+}
+/*}}}*/
+/*{{{  static int compcache_putfile (const char *path, const unsigned char *data, size_t len, int mode)*/
+/*
+ *	writes a file by writing a temporary and renaming it over the original
+ *	returns 0 on success, non-zero on failure
+ */
+static int compcache_putfile (const char *path, const unsigned char *data, size_t len, int mode)
+{
+	char *tmpname;
+	int fd = compcache_tmpopen (path, &tmpname, 0600);
+
+	if (fd < 0) {
+		return -1;
+	}
+	if (compcache_writeall (fd, data, len) || fchmod (fd, mode) || close (fd)) {
+		close (fd);
+		unlink (tmpname);
+		sfree (tmpname);
+		return -1;
+	}
+	if (rename (tmpname, path)) {
+		unlink (tmpname);
+		sfree (tmpname);
+		return -1;
+	}
+	sfree (tmpname);
+	return 0;
+}
+/*}}}*/
+
+
+/*{{{  static const char *compcache_dir (void)*/
+/*
+ *	returns the cache directory in use, or NULL if none
+ */
+static const char *compcache_dir (void)
+{
+	if (!cc_dir) {
+		char *env = getenv ("NOCC_BUILD_CACHE");
+
+		if (env && *env) {
+			cc_dir = string_dup (env);
+		}
+	}
+	return cc_dir;
+}
+/*}}}*/
+/*{{{  static int compcache_lock (void)*/
+/*
+ *	takes the cache-wide lock (for statistics and trimming), blocking until available
+ *	returns a descriptor to pass to compcache_unlock(), or < 0 on failure
+ */
+static int compcache_lock (void)
+{
+	char *lname = string_fmt ("%s/lock", cc_dir);
+	int fd = open (lname, O_RDWR | O_CREAT, 0644);
+	struct flock fl;
+
+	sfree (lname);
+	if (fd < 0) {
+		return -1;
+	}
+	memset (&fl, 0, sizeof (fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	while (fcntl (fd, F_SETLKW, &fl) < 0) {
+		if (errno != EINTR) {
+			close (fd);
+			return -1;
+		}
+	}
+	return fd;
+}
+/*}}}*/
+/*{{{  static void compcache_unlock (int fd)*/
+/*
+ *	releases the cache-wide lock
+ */
+static void compcache_unlock (int fd)
+{
+	if (fd >= 0) {
+		close (fd);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void compcache_readstats (ccstats_t *st)*/
+/*
+ *	reads the statistics file (missing or unreadable counts as all zero)
+ */
+static void compcache_readstats (ccstats_t *st)
+{
+	char *sname = string_fmt ("%s/stats", cc_dir);
+	size_t len;
+	char *buf = (char *)compcache_readfile (sname, &len, NULL);
+
+	memset (st, 0, sizeof (ccstats_t));
+	sfree (sname);
+	if (buf) {
+		if (sscanf (buf, "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nbytes %llu\n",
+				&st->hits, &st->misses, &st->stores, &st->evictions, &st->bytes) != 5) {
+			memset (st, 0, sizeof (ccstats_t));
+		}
+		sfree (buf);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void compcache_writestats (ccstats_t *st)*/
+/*
+ *	writes the statistics file
+ */
+static void compcache_writestats (ccstats_t *st)
+{
+	char *sname = string_fmt ("%s/stats", cc_dir);
+	char *str = string_fmt ("hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nbytes %llu\n",
+			st->hits, st->misses, st->stores, st->evictions, st->bytes);
+
+	compcache_putfile (sname, (unsigned char *)str, strlen (str), 0644);
+	sfree (str);
+	sfree (sname);
+	return;
+}
+/*}}}*/
+/*{{{  static int compcache_ccfilecompare (ccfile_t *first, ccfile_t *second)*/
+/*
+ *	compares cache entry files by last use (for sorting)
+ */
+static int compcache_ccfilecompare (ccfile_t *first, ccfile_t *second)
+{
+	if (first->mtime == second->mtime) {
+		return strcmp (first->path, second->path);
+	}
+	return (first->mtime < second->mtime) ? -1 : 1;
+}
+/*}}}*/
+/*{{{  static unsigned long long compcache_scan (int trim, int *nentries, unsigned long long *evicted)*/
+/*
+ *	scans the cache directory, adding up the size of the entries.  if 'trim' is set, least-recently-used
+ *	entries are removed until under the trim level, and stale temporary files are tidied up.
+ *	called with the lock held when trimming.
+ *	returns the number of bytes in the (remaining) entries
+ */
+static unsigned long long compcache_scan (int trim, int *nentries, unsigned long long *evicted)
+{
+	DYNARRAY (ccfile_t *, files);
+	DIR *dir;
+	struct dirent *de;
+	unsigned long long total = 0;
+	unsigned long long trimto = ((unsigned long long)cc_limit << 20) * COMPCACHE_TRIMTO / 100;
+	time_t now = time (NULL);
+	int i;
+
+	dynarray_init (files);
+	dir = opendir (cc_dir);
+	while (dir && ((de = readdir (dir)) != NULL)) {
+		char *sdname;
+		DIR *sdir;
+		struct dirent *sde;
+
+		if ((strlen (de->d_name) != 2) || !strchr ("0123456789abcdef", de->d_name[0]) || !strchr ("0123456789abcdef", de->d_name[1])) {
+			continue;		/* while() */
+		}
+		sdname = string_fmt ("%s/%s", cc_dir, de->d_name);
+		sdir = opendir (sdname);
+		while (sdir && ((sde = readdir (sdir)) != NULL)) {
+			char *fname;
+			struct stat stbuf;
+
+			if (!strcmp (sde->d_name, ".") || !strcmp (sde->d_name, "..")) {
+				continue;		/* while() */
+			}
+			fname = string_fmt ("%s/%s", sdname, sde->d_name);
+			if (stat (fname, &stbuf) || !S_ISREG (stbuf.st_mode)) {
+				sfree (fname);
+			} else if (sde->d_name[0] == '.') {
+				/* temporary, being written, or left behind by a compile that died */
+				if (trim && ((now - stbuf.st_mtime) > COMPCACHE_STALETMP)) {
+					unlink (fname);
+				}
+				sfree (fname);
+			} else {
+				ccfile_t *ccf = (ccfile_t *)smalloc (sizeof (ccfile_t));
+
+				ccf->path = fname;
+				ccf->mtime = stbuf.st_mtime;
+				ccf->size = (size_t)stbuf.st_size;
+				dynarray_add (files, ccf);
+				total += ccf->size;
+			}
+		}
+		if (sdir) {
+			closedir (sdir);
+		}
+		sfree (sdname);
+	}
+	if (dir) {
+		closedir (dir);
+	}
+
+	if (trim && (total > trimto) && (DA_CUR (files) > 1)) {
+		dynarray_qsort (files, compcache_ccfilecompare);
+	}
+	for (i=0; i<DA_CUR (files); i++) {
+		ccfile_t *ccf = DA_NTHITEM (files, i);
+
+		if (trim && (total > trimto) && !unlink (ccf->path)) {
+			total -= ccf->size;
+			if (evicted) {
+				(*evicted)++;
+			}
+		} else if (nentries) {
+			(*nentries)++;
+		}
+		sfree (ccf->path);
+		sfree (ccf);
+	}
+	dynarray_trash (files);
+
+	return total;
+}
+/*}}}*/
+/*{{{  static void compcache_count (int hit, int stored, size_t bytes)*/
+/*
+ *	updates the statistics after a lookup, trimming the cache if it has grown too big
+ */
+static void compcache_count (int hit, int stored, size_t bytes)
+{
+	int lfd = compcache_lock ();
+	ccstats_t st;
+
+	if (lfd < 0) {
+		return;
+	}
+	compcache_readstats (&st);
+	if (hit) {
+		st.hits++;
+	} else {
+		st.misses++;
+	}
+	if (stored) {
+		st.stores++;
+		st.bytes += bytes;
+	}
+	if (st.bytes > ((unsigned long long)cc_limit << 20)) {
+		st.bytes = compcache_scan (1, NULL, &st.evictions);
+		if (compopts.verbose) {
+			nocc_message ("build cache: trimmed to %llu bytes", st.bytes);
+		}
+	}
+	compcache_writestats (&st);
+	compcache_unlock (lfd);
+	return;
+}
+/*}}}*/
+
+
+/*{{{  static void compcache_watch (void *arg, const char *path, fhwatch_e what)*/
+/*
+ *	told about host files as the compiler opens (or fails to find) them
+ */
+static void compcache_watch (void *arg, const char *path, fhwatch_e what)
+{
+	switch (what) {
+	case FHW_READ:
+		compcache_adddep (path);
+		break;
+	case FHW_WRITE:
+		compcache_addoutput (path);
+		break;
+	case FHW_ABSENT:
+		if (cc_active) {
+			int i;
+
+			for (i=0; (i<DA_CUR (cc_absent)) && strcmp (DA_NTHITEM (cc_absent, i), path); i++);
+			if (i == DA_CUR (cc_absent)) {
+				dynarray_add (cc_absent, string_dup (path));
+			}
+		}
+		break;
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void compcache_tee (int *rfds)*/
+/*
+ *	run in a process of its own while recording: copies what the compile writes to standard output and error
+ *	through to the real ones as it arrives, and into the capture files, until both pipes are closed
+ */
+static void compcache_tee (int *rfds)
+{
+	struct pollfd pfds[2];
+	char buf[4096];
+	int i, nopen = 2;
+
+	signal (SIGPIPE, SIG_IGN);		/* keep draining even if the real output has gone */
+	for (i=0; i<2; i++) {
+		pfds[i].fd = rfds[i];
+		pfds[i].events = POLLIN;
+		pfds[i].revents = 0;
+	}
+	while (nopen) {
+		if (poll (pfds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;		/* while() */
+			}
+			break;				/* while() */
+		}
+		for (i=0; i<2; i++) {
+			ssize_t n;
+
+			if ((pfds[i].fd < 0) || !pfds[i].revents) {
+				continue;		/* for() */
+			}
+			n = read (pfds[i].fd, buf, sizeof (buf));
+			if ((n < 0) && (errno == EINTR)) {
+				continue;		/* for() */
+			} else if (n <= 0) {
+				close (pfds[i].fd);
+				pfds[i].fd = -1;
+				nopen--;
+				continue;		/* for() */
+			}
+			compcache_writeall (cc_savedfd[i], buf, (size_t)n);
+			compcache_writeall (fileno (cc_capture[i]), buf, (size_t)n);
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void compcache_uncapture (int *pfds)*/
+/*
+ *	undoes a part-done compcache_capture(): puts back the real standard output and error, closes pipes
+ *	(pairs in 'pfds', -1 where not open) and capture files
+ */
+static void compcache_uncapture (int *pfds)
+{
+	int i;
+
+	for (i=0; i<4; i++) {
+		if (pfds[i] >= 0) {
+			close (pfds[i]);
+		}
+	}
+	for (i=0; i<2; i++) {
+		if (cc_savedfd[i] >= 0) {
+			dup2 (cc_savedfd[i], i + 1);
+			close (cc_savedfd[i]);
+			cc_savedfd[i] = -1;
+		}
+		if (cc_capture[i]) {
+			fclose (cc_capture[i]);
+			cc_capture[i] = NULL;
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static int compcache_capture (void)*/
+/*
+ *	starts capturing standard output and error, so they can be stored with an entry.  they are piped through
+ *	a separate process that passes them on as they are written (so the compile's output still appears as it
+ *	goes) and keeps a copy of each in a temporary file.
+ *	returns 0 on success, non-zero on failure
+ */
+static int compcache_capture (void)
+{
+	int pfds[4] = {-1, -1, -1, -1};		/* read and write ends of the pipes for output and error */
+	int i;
+
+	fflush (stdout);
+	fflush (stderr);
+	fhandle_flush (FHAN_STDOUT);
+	fhandle_flush (FHAN_STDERR);
+	for (i=0; i<2; i++) {
+		cc_capture[i] = tmpfile ();
+		cc_savedfd[i] = dup (i + 1);
+		if (!cc_capture[i] || (cc_savedfd[i] < 0) || pipe (pfds + (i << 1))) {
+			compcache_uncapture (pfds);
+			return -1;
+		}
+	}
+
+	cc_teepid = fork ();
+	if (!cc_teepid) {
+		int rfds[2] = {pfds[0], pfds[2]};
+
+		close (pfds[1]);
+		close (pfds[3]);
+		compcache_tee (rfds);
+		_exit (EXIT_SUCCESS);
+	} else if (cc_teepid < 0) {
+		cc_teepid = -1;
+		compcache_uncapture (pfds);
+		return -1;
+	}
+
+	for (i=0; i<2; i++) {
+		close (pfds[i << 1]);
+		dup2 (pfds[(i << 1) + 1], i + 1);
+		close (pfds[(i << 1) + 1]);
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static void compcache_release (unsigned char **bufs, size_t *lens)*/
+/*
+ *	stops capturing standard output and error (already passed on as it was written).  if 'bufs' is non-NULL,
+ *	the captured output and error are returned in it (as new buffers).
+ */
+static void compcache_release (unsigned char **bufs, size_t *lens)
+{
+	int i, status;
+
+	if (cc_teepid < 0) {
+		return;
+	}
+	fflush (stdout);
+	fflush (stderr);
+	fhandle_flush (FHAN_STDOUT);
+	fhandle_flush (FHAN_STDERR);
+
+	/* putting the real ones back closes the pipes, the tee finishes once it has copied everything */
+	for (i=0; i<2; i++) {
+		dup2 (cc_savedfd[i], i + 1);
+		close (cc_savedfd[i]);
+		cc_savedfd[i] = -1;
+	}
+	while ((waitpid (cc_teepid, &status, 0) < 0) && (errno == EINTR));
+	cc_teepid = -1;
+
+	for (i=0; i<2; i++) {
+		unsigned char *buf = NULL;
+		size_t len = 0;
+
+		if (bufs) {
+			buf = compcache_readfd (fileno (cc_capture[i]), &len, NULL);
+		}
+		fclose (cc_capture[i]);
+		cc_capture[i] = NULL;
+
+		if (bufs) {
+			bufs[i] = buf;
+			lens[i] = buf ? len : 0;
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void compcache_atexit (void)*/
+/*
+ *	makes sure captured output is not lost if the compiler exits part-way through (still counted as a miss)
+ */
+static void compcache_atexit (void)
+{
+	if (cc_active) {
+		fhandle_setwatch (NULL, NULL);
+		cc_active = 0;
+		compcache_release (NULL, NULL);
+		compcache_count (0, 0, 0);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static char *compcache_key (int argc, char **argv)*/
+/*
+ *	works out the lookup key for a compile: the compiler, target, specs file and its expanded settings,
+ *	NOCC_* environment, working directory and arguments
+ *	returns the key digest as a new string (without its method tag, for use as a file name)
+ */
+static char *compcache_key (int argc, char **argv)
+{
+	cdigest_t dg;
+	struct stat stbuf;
+	char cwd[FILENAME_MAX];
+	char *str, *ch;
+	int i;
+
+	crypto_cdigestinit (&dg);
+	crypto_cdigeststr (&dg, COMPCACHE_MAGIC);
+	crypto_cdigeststr (&dg, version_string ());
+	crypto_cdigeststr (&dg, compopts.target_str ?: "");
+	if (!stat ("/proc/self/exe", &stbuf)) {
+		str = string_fmt ("exe %lld %lld", (long long)stbuf.st_size, (long long)stbuf.st_mtime);
+		crypto_cdigeststr (&dg, str);
+		sfree (str);
+	}
+	if (compopts.specsfile && ((str = crypto_cdigestfile (compopts.specsfile)) != NULL)) {
+		crypto_cdigeststr (&dg, str);
+		sfree (str);
+	}
+	for (i=0; i<DA_CUR (cc_keyextra); i++) {
+		crypto_cdigeststr (&dg, DA_NTHITEM (cc_keyextra, i));
+	}
+	if (environ) {
+		DYNARRAY (char *, envs);
+		char **ep;
+
+		/* NOCC_* settings can change the compile, except those for the cache and compile server */
+		dynarray_init (envs);
+		for (ep = environ; *ep; ep++) {
+			if (!strncmp (*ep, "NOCC_", 5) && strncmp (*ep, "NOCC_BUILD_CACHE", 16) && strncmp (*ep, "NOCC_SERVER=", 12)) {
+				dynarray_add (envs, *ep);
+			}
+		}
+		if (DA_CUR (envs) > 1) {
+			dynarray_qsort (envs, compcache_strcompare);
+		}
+		for (i=0; i<DA_CUR (envs); i++) {
+			crypto_cdigeststr (&dg, DA_NTHITEM (envs, i));
+		}
+		dynarray_trash (envs);
+	}
+	if (getcwd (cwd, FILENAME_MAX)) {
+		crypto_cdigeststr (&dg, cwd);
+	}
+	for (i=1; i<argc; i++) {
+		if (!strncmp (argv[i], "--build-cache", 13)) {
+			/* cache options do not change the compile */
+			if ((!strcmp (argv[i], "--build-cache") || !strcmp (argv[i], "--build-cache-size")) && (i < (argc - 1))) {
+				i++;
+			}
+			continue;		/* for() */
+		}
+		crypto_cdigeststr (&dg, argv[i]);
+	}
+
+	str = crypto_cdigestdone (&dg);
+	ch = string_dup (str + 2);
+	sfree (str);
+	return ch;
+}
+/*}}}*/
+/*{{{  static int compcache_lookup (const char *ename)*/
+/*
+ *	tries to satisfy a compile from a cache entry, checking its inputs and putting back its outputs
+ *	returns 1 on a hit, 0 otherwise
+ */
+static int compcache_lookup (const char *ename)
+{
+	size_t elen, offs;
+	unsigned char *ebuf = compcache_readfile (ename, &elen, NULL);
+	DYNARRAY (ccoutput_t *, outs);
+	size_t errlen = 0, outlen = 0;
+	char *ch, *lend;
+	int ok = 0, i;
+
+	if (!ebuf) {
+		return 0;
+	}
+	dynarray_init (outs);
+
+	/*{{{  check the header, and the files read and not found while going*/
+	ch = (char *)ebuf;
+	lend = strchr (ch, '\n');
+	if (!lend || strncmp (ch, COMPCACHE_MAGIC "\n", (lend - ch) + 1)) {
+		goto out_free;
+	}
+	for (ch = lend + 1; (lend = strchr (ch, '\n')) != NULL; ch = lend + 1) {
+		*lend = '\0';
+		if (!strncmp (ch, "dep ", 4)) {
+			char *path = strchr (ch + 4, ' ');
+			char *digest;
+
+			if (!path) {
+				goto out_free;
+			}
+			*path = '\0';
+			path++;
+			digest = crypto_cdigestfile (path);
+			if (!digest || strcmp (digest, ch + 4)) {
+				if (digest) {
+					sfree (digest);
+				}
+				if (compopts.verbose) {
+					nocc_message ("build cache: %s has changed", path);
+				}
+				goto out_free;
+			}
+			sfree (digest);
+		} else if (!strncmp (ch, "absent ", 7)) {
+			if (!access (ch + 7, F_OK)) {
+				if (compopts.verbose) {
+					nocc_message ("build cache: %s has appeared", ch + 7);
+				}
+				goto out_free;
+			}
+		} else if (!strncmp (ch, "out ", 4)) {
+			ccoutput_t *cco = (ccoutput_t *)smalloc (sizeof (ccoutput_t));
+			unsigned long long size;
+			int n = 0;
+
+			dynarray_add (outs, cco);
+			if (sscanf (ch + 4, "%o %llu %n", &cco->mode, &size, &n) != 2 || !n) {
+				goto out_free;
+			}
+			cco->size = (size_t)size;
+			cco->path = ch + 4 + n;
+		} else if (!strncmp (ch, "stderr ", 7)) {
+			errlen = (size_t)strtoull (ch + 7, NULL, 10);
+		} else if (!strncmp (ch, "stdout ", 7)) {
+			outlen = (size_t)strtoull (ch + 7, NULL, 10);
+		} else if (!strcmp (ch, "end")) {
+			break;		/* for() */
+		} else {
+			goto out_free;
+		}
+	}
+	if (!lend) {
+		goto out_free;
+	}
+
+	/*}}}*/
+	/*{{{  check the data adds up, and put the outputs back*/
+	offs = (size_t)((unsigned char *)lend + 1 - ebuf);
+	{
+		size_t need = offs + errlen + outlen;
+
+		for (i=0; i<DA_CUR (outs); i++) {
+			need += DA_NTHITEM (outs, i)->size;
+		}
+		if (need != elen) {
+			goto out_free;
+		}
+	}
+	offs += errlen + outlen;
+	for (i=0; i<DA_CUR (outs); i++) {
+		ccoutput_t *cco = DA_NTHITEM (outs, i);
+
+		if (compcache_putfile (cco->path, ebuf + offs, cco->size, (int)cco->mode)) {
+			nocc_warning ("build cache: failed to restore %s: %s", cco->path, strerror (errno));
+			goto out_free;
+		}
+		offs += cco->size;
+	}
+
+	/*}}}*/
+	/*{{{  replay what the compile said, and mark the entry as recently used*/
+	offs = (size_t)((unsigned char *)lend + 1 - ebuf);
+	fflush (stdout);
+	fflush (stderr);
+	compcache_writeall (2, ebuf + offs, errlen);
+	compcache_writeall (1, ebuf + offs + errlen, outlen);
+	utime (ename, NULL);
+	ok = 1;
+
+	/*}}}*/
+out_free:
+	for (i=0; i<DA_CUR (outs); i++) {
+		sfree (DA_NTHITEM (outs, i));
+	}
+	dynarray_trash (outs);
+	sfree (ebuf);
+	return ok;
+}
+/*}}}*/
+/*{{{  static int compcache_store (unsigned char **bufs, size_t *lens, size_t *sizep)*/
+/*
+ *	writes a cache entry for the compile just done
+ *	returns 0 on success, non-zero if the compile cannot be stored (reason given if verbose)
+ */
+static int compcache_store (unsigned char **bufs, size_t *lens, size_t *sizep)
+{
+	DYNARRAY (char *, lines);
+	DYNARRAY (ccoutput_t *, odata);
+	char *why = NULL;
+	char *tmpname, *sdir;
+	size_t total = 0;
+	int i, j, fd;
+
+	dynarray_init (lines);
+	dynarray_init (odata);
+	dynarray_add (lines, string_fmt ("%s\n", COMPCACHE_MAGIC));
+
+	/*{{{  files read: drop any also written, check none changed while compiling*/
+	for (i=0; !why && (i<DA_CUR (cc_deps)); i++) {
+		char *path = DA_NTHITEM (cc_deps, i);
+		char *sig;
+		char *digest;
+
+		for (j=0; (j<DA_CUR (cc_outputs)) && strcmp (DA_NTHITEM (cc_outputs, j), path); j++);
+		if (j < DA_CUR (cc_outputs)) {
+			continue;		/* for() */
+		}
+		sig = compcache_statsig (path);
+		if (strchr (path, '\n')) {
+			why = string_fmt ("odd file name");
+		} else if (!sig) {
+			why = string_fmt ("%s went away", path);
+		} else if (!DA_NTHITEM (cc_depsigs, i) || strcmp (sig, DA_NTHITEM (cc_depsigs, i))) {
+			/* compared with when it was first read, not the time the compile started */
+			why = string_fmt ("%s was modified during the compile", path);
+		} else if (!(digest = crypto_cdigestfile (path))) {
+			why = string_fmt ("%s unreadable", path);
+		} else {
+			dynarray_add (lines, string_fmt ("dep %s %s\n", digest, path));
+			sfree (digest);
+		}
+		if (sig) {
+			sfree (sig);
+		}
+	}
+	/*}}}*/
+	/*{{{  files not found: must still not be there*/
+	for (i=0; !why && (i<DA_CUR (cc_absent)); i++) {
+		char *path = DA_NTHITEM (cc_absent, i);
+
+		if (strchr (path, '\n')) {
+			why = string_fmt ("odd file name");
+		} else if (!access (path, F_OK)) {
+			/* probably one of the outputs, or something that appeared while compiling; leave if written */
+			for (j=0; (j<DA_CUR (cc_outputs)) && strcmp (DA_NTHITEM (cc_outputs, j), path); j++);
+			if (j == DA_CUR (cc_outputs)) {
+				why = string_fmt ("%s appeared during the compile", path);
+			}
+		} else {
+			dynarray_add (lines, string_fmt ("absent %s\n", path));
+		}
+	}
+	/*}}}*/
+	/*{{{  files written*/
+	for (i=0; !why && (i<DA_CUR (cc_outputs)); i++) {
+		char *path = DA_NTHITEM (cc_outputs, i);
+		ccoutput_t *cco;
+		int mode;
+
+		if (strchr (path, '\n')) {
+			why = string_fmt ("odd file name");
+			continue;		/* for() */
+		}
+		cco = (ccoutput_t *)smalloc (sizeof (ccoutput_t));
+		cco->path = path;
+		cco->data = compcache_readfile (path, &cco->size, &mode);
+		cco->mode = (unsigned int)mode;
+		dynarray_add (odata, cco);
+		if (!cco->data) {
+			why = string_fmt ("output %s unreadable", path);
+		} else {
+			dynarray_add (lines, string_fmt ("out %o %llu %s\n", cco->mode, (unsigned long long)cco->size, path));
+		}
+	}
+	/*}}}*/
+
+	if (!why) {
+		dynarray_add (lines, string_fmt ("stderr %llu\nstdout %llu\nend\n", (unsigned long long)lens[1], (unsigned long long)lens[0]));
+
+		sdir = string_fmt ("%.*s", (int)(strrchr (cc_entry, '/') - cc_entry), cc_entry);
+		mkdir (sdir, 0755);
+		sfree (sdir);
+
+		fd = compcache_tmpopen (cc_entry, &tmpname, 0644);
+		if (fd < 0) {
+			why = string_fmt ("cannot write %s: %s", cc_entry, strerror (errno));
+		} else {
+			int err = 0;
+
+			for (i=0; i<DA_CUR (lines); i++) {
+				err |= compcache_writeall (fd, DA_NTHITEM (lines, i), strlen (DA_NTHITEM (lines, i)));
+				total += strlen (DA_NTHITEM (lines, i));
+			}
+			err |= compcache_writeall (fd, bufs[1], lens[1]);
+			err |= compcache_writeall (fd, bufs[0], lens[0]);
+			total += lens[0] + lens[1];
+			for (i=0; i<DA_CUR (odata); i++) {
+				err |= compcache_writeall (fd, DA_NTHITEM (odata, i)->data, DA_NTHITEM (odata, i)->size);
+				total += DA_NTHITEM (odata, i)->size;
+			}
+			/* on disk before it is renamed into place, so an entry is never seen part-written, even after a crash */
+			if (fsync (fd)) {
+				err = 1;
+			}
+			if (close (fd)) {
+				err = 1;
+			}
+			if (err || rename (tmpname, cc_entry)) {
+				why = string_fmt ("failed to write %s: %s", cc_entry, strerror (errno));
+				unlink (tmpname);
+			}
+			sfree (tmpname);
+		}
+	}
+
+	for (i=0; i<DA_CUR (lines); i++) {
+		sfree (DA_NTHITEM (lines, i));
+	}
+	dynarray_trash (lines);
+	for (i=0; i<DA_CUR (odata); i++) {
+		ccoutput_t *cco = DA_NTHITEM (odata, i);
+
+		if (cco->data) {
+			sfree (cco->data);
+		}
+		sfree (cco);
+	}
+	dynarray_trash (odata);
+
+	if (why) {
+		if (compopts.verbose) {
+			nocc_message ("build cache: not storing, %s", why);
+		}
+		sfree (why);
+		return -1;
+	}
+	*sizep = total;
+	return 0;
+}
+/*}}}*/
+
+
+/*{{{  int compcache_enabled (void)*/
+/*
+ *	tests whether the build cache is in use
+ *	returns non-zero if so
+ */
+int compcache_enabled (void)
+{
+	return (compcache_dir () != NULL);
+}
+/*}}}*/
+/*{{{  int compcache_begin (int argc, char **argv)*/
+/*
+ *	called before any compiler stages run: looks the compile up in the cache, and if there starts recording it
+ *	returns 1 if satisfied from the cache (nothing more to do), 0 if the compile should go ahead
+ */
+int compcache_begin (int argc, char **argv)
+{
+	char *key;
+
+	if (!compcache_dir () || cc_active) {
+		return 0;
+	}
+	if (mkdir (cc_dir, 0755) && (errno != EEXIST)) {
+		nocc_warning ("build cache: cannot create %s: %s", cc_dir, strerror (errno));
+		return 0;
+	}
+
+	key = compcache_key (argc, argv);
+	if (cc_entry) {
+		sfree (cc_entry);
+	}
+	cc_entry = string_fmt ("%s/%.2s/%s", cc_dir, key, key + 2);
+	sfree (key);
+
+	if (compcache_lookup (cc_entry)) {
+		if (compopts.verbose) {
+			nocc_message ("build cache: hit, %s", cc_entry);
+		}
+		compcache_count (1, 0, 0);
+		return 1;
+	}
+	if (compopts.verbose) {
+		nocc_message ("build cache: miss, %s", cc_entry);
+	}
+
+	/*{{{  record the compile*/
+	if (compcache_capture ()) {
+		nocc_warning ("build cache: failed to capture output, not caching");
+		return 0;
+	}
+	if (!cc_atexit) {
+		atexit (compcache_atexit);
+		cc_atexit = 1;
+	}
+	cc_active = 1;
+	fhandle_setwatch (compcache_watch, NULL);
+
+	/*}}}*/
+	return 0;
+}
+/*}}}*/
+/*{{{  void compcache_end (int ok)*/
+/*
+ *	called when a compile finishes, stores it in the cache if it worked (and was recorded)
+ */
+void compcache_end (int ok)
+{
+	unsigned char *bufs[2] = {NULL, NULL};
+	size_t lens[2] = {0, 0};
+	size_t bytes = 0;
+	int stored = 0;
+	int i;
+
+	if (!cc_active) {
+		return;
+	}
+	fhandle_setwatch (NULL, NULL);
+	cc_active = 0;
+	compcache_release (bufs, lens);
+
+	if (ok && cc_nostorewhy) {
+		if (compopts.verbose) {
+			nocc_message ("build cache: not storing, %s", cc_nostorewhy);
+		}
+	} else if (ok && (!bufs[0] || !bufs[1])) {
+		if (compopts.verbose) {
+			nocc_message ("build cache: not storing, captured output unreadable");
+		}
+	} else if (ok) {
+		stored = !compcache_store (bufs, lens, &bytes);
+	}
+	compcache_count (0, stored, bytes);
+
+	for (i=0; i<2; i++) {
+		if (bufs[i]) {
+			sfree (bufs[i]);
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  void compcache_adddep (const char *path)*/
+/*
+ *	notes a file the compile depends on (read by other than the fhandle layer)
+ */
+void compcache_adddep (const char *path)
+{
+	if (cc_active) {
+		int i;
+
+		for (i=0; (i<DA_CUR (cc_deps)) && strcmp (DA_NTHITEM (cc_deps, i), path); i++);
+		if (i == DA_CUR (cc_deps)) {
+			dynarray_add (cc_deps, string_dup (path));
+			dynarray_add (cc_depsigs, compcache_statsig (path));
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  void compcache_addoutput (const char *path)*/
+/*
+ *	notes a file the compile produces (written by other than the fhandle layer)
+ */
+void compcache_addoutput (const char *path)
+{
+	if (cc_active) {
+		int i;
+
+		for (i=0; (i<DA_CUR (cc_outputs)) && strcmp (DA_NTHITEM (cc_outputs, i), path); i++);
+		if (i == DA_CUR (cc_outputs)) {
+			dynarray_add (cc_outputs, string_dup (path));
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  void compcache_addkey (const char *str)*/
+/*
+ *	adds a setting that changes the compile, but is not in the arguments or the specs file itself (such as a
+ *	specs-file string after environment variables are substituted) to the lookup key
+ */
+void compcache_addkey (const char *str)
+{
+	dynarray_add (cc_keyextra, string_dup (str));
+	return;
+}
+/*}}}*/
+/*{{{  void compcache_nostore (const char *why)*/
+/*
+ *	called when the compile depends on something the cache cannot check, so it is not stored
+ */
+void compcache_nostore (const char *why)
+{
+	if (cc_active && !cc_nostorewhy) {
+		cc_nostorewhy = string_dup (why);
+	}
+	return;
+}
+/*}}}*/
+
+
+/*{{{  static int compcache_dostats (void *arg)*/
+/*
+ *	reports build cache statistics (compiler initialisation function for --build-cache-stats)
+ *	returns 0 on success, non-zero on failure
+ */
+static int compcache_dostats (void *arg)
+{
+	ccstats_t st;
+	int lfd, nentries = 0;
+	unsigned long long bytes, lookups;
+
+	if (!compcache_dir ()) {
+		nocc_error ("no build cache, use --build-cache <dir> or set NOCC_BUILD_CACHE");
+		return -1;
+	}
+	lfd = compcache_lock ();
+	if (lfd < 0) {
+		nocc_error ("build cache %s: %s", cc_dir, strerror (errno));
+		return -1;
+	}
+	compcache_readstats (&st);
+	bytes = compcache_scan (0, &nentries, NULL);
+	compcache_unlock (lfd);
+
+	lookups = st.hits + st.misses;
+	fhandle_printf (FHAN_STDOUT, "build cache %s\n", cc_dir);
+	fhandle_printf (FHAN_STDOUT, "    entries:   %d in %llu KiB (limit %d MiB)\n", nentries, (bytes + 1023) >> 10, cc_limit);
+	fhandle_printf (FHAN_STDOUT, "    lookups:   %llu, %llu hits (%llu%%), %llu misses\n", lookups, st.hits,
+			lookups ? ((st.hits * 100) / lookups) : 0ULL, st.misses);
+	fhandle_printf (FHAN_STDOUT, "    stores:    %llu, %llu evicted\n", st.stores, st.evictions);
+	fhandle_flush (FHAN_STDOUT);
+
+	nocc_cleanexit ();
+	return 0;
+}
+/*}}}*/
+/*{{{  static int compcache_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	option handler for build cache options
+ *	returns 0 on success, non-zero on failure
+ */
+static int compcache_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	char *ch;
+
+	switch ((int)((uint64_t)opt->arg)) {
+	case 1:
+	case 2:
+		/*{{{  --build-cache <dir>, --build-cache-size <MiB>*/
+		ch = strchr (**argwalk, '=');
+		if (ch) {
+			ch++;
+		} else {
+			(*argwalk)++;
+			(*argleft)--;
+			if (!**argwalk || !*argleft) {
+				nocc_error ("missing argument for option %s", (*argwalk)[-1]);
+				(*argwalk)--, (*argleft)++;
+				return -1;
+			}
+			ch = **argwalk;
+		}
+		if ((int)((uint64_t)opt->arg) == 1) {
+			if (cc_dir) {
+				sfree (cc_dir);
+			}
+			cc_dir = string_dup (ch);
+		} else if ((sscanf (ch, "%d", &cc_limit) != 1) || (cc_limit < 1)) {
+			nocc_error ("bad size for %s: %s", opt->name, ch);
+			cc_limit = COMPCACHE_DEFSIZE;
+			return -1;
+		}
+		break;
+		/*}}}*/
+	case 3:
+		/*{{{  --build-cache-stats*/
+		nocc_addcompilerinitfunc ("buildcachestats", INTERNAL_ORIGIN, compcache_dostats, NULL);
+		break;
+		/*}}}*/
+	default:
+		nocc_error ("compcache_opthandler(): unknown option [%s]", **argwalk);
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  int compcache_init (void)*/
+/*
+ *	initialises the build cache (just registers options)
+ *	returns 0 on success, non-zero on failure
+ */
+int compcache_init (void)
+{
+	opts_add ("build-cache", '\0', compcache_opthandler, (void *)1, "1cache compiles in the given directory (also NOCC_BUILD_CACHE)");
+	opts_add ("build-cache-size", '\0', compcache_opthandler, (void *)2, "1size limit for the build cache in MiB (default 256)");
+	opts_add ("build-cache-stats", '\0', compcache_opthandler, (void *)3, "1report build cache statistics");
+
+	return 0;
+}
+/*}}}*/
+/*{{{  int compcache_shutdown (void)*/
+/*
+ *	shuts-down the build cache
+ *	returns 0 on success, non-zero on failure
+ */
+int compcache_shutdown (void)
+{
+	int i;
+
+	/* a compile still being recorded (one that failed) is counted as a miss, and stops being recorded */
+	compcache_end (0);
+
+	for (i=0; i<DA_CUR (cc_deps); i++) {
+		sfree (DA_NTHITEM (cc_deps, i));
+		if (DA_NTHITEM (cc_depsigs, i)) {
+			sfree (DA_NTHITEM (cc_depsigs, i));
+		}
+	}
+	dynarray_trash (cc_deps);
+	dynarray_trash (cc_depsigs);
+	for (i=0; i<DA_CUR (cc_keyextra); i++) {
+		sfree (DA_NTHITEM (cc_keyextra, i));
+	}
+	dynarray_trash (cc_keyextra);
+	for (i=0; i<DA_CUR (cc_outputs); i++) {
+		sfree (DA_NTHITEM (cc_outputs, i));
+	}
+	dynarray_trash (cc_outputs);
+	for (i=0; i<DA_CUR (cc_absent); i++) {
+		sfree (DA_NTHITEM (cc_absent, i));
+	}
+	dynarray_trash (cc_absent);
+	if (cc_nostorewhy) {
+		sfree (cc_nostorewhy);
+		cc_nostorewhy = NULL;
+	}
+	if (cc_entry) {
+		sfree (cc_entry);
+		cc_entry = NULL;
+	}
+	if (cc_dir) {
+		sfree (cc_dir);
+		cc_dir = NULL;
+	}
+	return 0;
+}
+/*}}}*/
+
@@ -1290,8 +1290,8 @@ static int icrypto_verifylibfile (const char *libfile, const char **pubkeys, int
 	}
 
 	/* read public keys */
-	pkeys = (gcry_sexp_t *)smalloc (npubkeys * sizeof (gcry_sexp_t));
-	pkcomments = (char **)smalloc (npubkeys * sizeof (char *));
+	pkeys = (gcry_sexp_t *)scalloc (npubkeys, sizeof (gcry_sexp_t));
+	pkcomments = (char **)scalloc (npubkeys, sizeof (char *));
 	for (i=0; i<npubkeys; i++) {
 		pkcomments[i] = NULL;
 		if (icrypto_loadkey (&(pkeys[i]), &(pkcomments[i]), pubkeys[i], 0)) {
@@ -1575,6 +1575,150 @@ char *crypto_readdigest (crypto_t *cry, int *issignedp)
 	return NULL;
 }
 /*}}}*/
+/*{{{  int crypto_havedigest (void)*/
+/*
+ *	tests whether this build can compute digests (i.e. crypto_newdigest() can succeed)
+ *	returns non-zero if so, zero otherwise
+ */
+int crypto_havedigest (void)
+{
+#if defined(USE_LIBGCRYPT)
+	return 1;
+#else
+	return 0;
+#endif
+}
+/*}}}*/
+/*{{{  void crypto_cdigestinit (cdigest_t *dg)*/
+/*
+ *	starts a content digest: gcrypt's (with the configured algorithm) if available, else a built-in 128-bit FNV-1a.
+ *	content digests are for telling whether things changed, not for signing.
+ */
+void crypto_cdigestinit (cdigest_t *dg)
+{
+	dg->cry = crypto_havedigest () ? crypto_newdigest () : NULL;
+	dg->hi = 0x6c62272e07bb0142ULL;
+	dg->lo = 0x62b821756295c58dULL;
+	return;
+}
+/*}}}*/
+/*{{{  void crypto_cdigestadd (cdigest_t *dg, const void *data, size_t len)*/
+/*
+ *	adds bytes to a content digest.  the FNV prime is 2^88 + 0x13b, so each multiply is a small one plus a shift.
+ */
+void crypto_cdigestadd (cdigest_t *dg, const void *data, size_t len)
+{
+	const unsigned char *ch = (const unsigned char *)data;
+	unsigned long long hi, lo;
+
+	if (dg->cry) {
+		while (len > 0) {
+			int n = (len > (1 << 20)) ? (1 << 20) : (int)len;
+
+			crypto_writedigest (dg->cry, (unsigned char *)ch, n);
+			ch += n;
+			len -= n;
+		}
+		return;
+	}
+
+	hi = dg->hi;
+	lo = dg->lo;
+	for (; len > 0; ch++, len--) {
+		unsigned long long p0, p1;
+
+		lo ^= (unsigned long long)*ch;
+		p0 = (lo & 0xffffffffULL) * 0x13b;
+		p1 = (lo >> 32) * 0x13b + (p0 >> 32);
+		hi = (hi * 0x13b) + (p1 >> 32) + (lo << 24);
+		lo = (p1 << 32) | (p0 & 0xffffffffULL);
+	}
+	dg->hi = hi;
+	dg->lo = lo;
+	return;
+}
+/*}}}*/
+/*{{{  void crypto_cdigeststr (cdigest_t *dg, const char *str)*/
+/*
+ *	adds a string to a content digest (including its terminator, so consecutive strings stay distinct)
+ */
+void crypto_cdigeststr (cdigest_t *dg, const char *str)
+{
+	crypto_cdigestadd (dg, str, strlen (str) + 1);
+	return;
+}
+/*}}}*/
+/*{{{  char *crypto_cdigestdone (cdigest_t *dg)*/
+/*
+ *	finishes a content digest
+ *	returns the digest as a new string, tagged with the method used
+ */
+char *crypto_cdigestdone (cdigest_t *dg)
+{
+	char *str = NULL;
+
+	if (dg->cry) {
+		int issigned = 0;
+		char *hex = crypto_readdigest (dg->cry, &issigned);
+
+		if (hex) {
+			str = string_fmt ("c:%s", hex);
+			sfree (hex);
+		}
+		crypto_freedigest (dg->cry);
+		dg->cry = NULL;
+	}
+	if (!str) {
+		str = string_fmt ("f:%016llx%016llx", dg->hi, dg->lo);
+	}
+	return str;
+}
+/*}}}*/
+/*{{{  char *crypto_cdigestdata (const void *data, size_t len)*/
+/*
+ *	computes the content digest of some bytes
+ *	returns the digest as a new string
+ */
+char *crypto_cdigestdata (const void *data, size_t len)
+{
+	cdigest_t dg;
+
+	crypto_cdigestinit (&dg);
+	crypto_cdigestadd (&dg, data, len);
+	return crypto_cdigestdone (&dg);
+}
+/*}}}*/
+/*{{{  char *crypto_cdigestfile (const char *path)*/
+/*
+ *	computes the content digest of a file
+ *	returns the digest as a new string, or NULL if the file cannot be read
+ */
+char *crypto_cdigestfile (const char *path)
+{
+	cdigest_t dg;
+	unsigned char buf[65536];
+	int fd = open (path, O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0) {
+		return NULL;
+	}
+	crypto_cdigestinit (&dg);
+	while ((n = read (fd, buf, sizeof (buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;		/* while() */
+			}
+			close (fd);
+			sfree (crypto_cdigestdone (&dg));
+			return NULL;
+		}
+		crypto_cdigestadd (&dg, buf, n);
+	}
+	close (fd);
+	return crypto_cdigestdone (&dg);
+}
+/*}}}*/
 /*{{{  int crypto_signdigest (crypto_t *cry, char *privfile)*/
 /*
  *	signs a digest with a private key.  if "privfile" is NULL, compopts.privkey is used
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -51,6 +52,12 @@ STATICDYNARRAY (fhscheme_t *, aschemes);
 
 static int last_error_code;
 
+static void (*fh_watch)(void *, const char *, fhwatch_e) = NULL;	/* sees host files opened or looked for */
+static void *fh_watcharg = NULL;
+
+#define FHANDLE_DEFBUFSIZE (64 * 1024)		/* default output buffer size */
+#define FHANDLE_MAPALIGN (64 * 1024)		/* mapped output windows are a multiple of this (and of the page size) */
+
 typedef enum ENUM_str_style {
 	SSTYLE_NONE = 0,
 	SSTYLE_XML = 1,
@@ -119,6 +126,9 @@ static fhscheme_t *fhandle_newfhscheme (void)
 	fhs->getsfcn = NULL;
 	fhs->flushfcn = NULL;
 	fhs->isattyfcn = NULL;
+	fhs->writevfcn = NULL;
+	fhs->outmapfcn = NULL;
+	fhs->truncfcn = NULL;
 
 	return fhs;
 }
@@ -161,6 +171,17 @@ static fhandle_t *fhandle_newfhandle (void)
 	fhan->spath = NULL;
 	fhan->err = 0;
 
+	fhan->wbufmode = FHB_NONE;
+	fhan->wbuf = NULL;
+	fhan->wbufsize = 0;
+	fhan->wbufused = 0;
+	fhan->wbufdone = 0;
+	fhan->wbufoffs = 0;
+	fhan->wsink = NULL;
+	fhan->wsinkarg = NULL;
+	fhan->wcalls = 0;
+	fhan->wbytes = 0;
+
 	return fhan;
 }
 /*}}}*/
@@ -313,6 +334,135 @@ static fhscheme_t *fhandle_lookupscheme (const char *path, int *poffs)
 /*}}}*/
 
 
+/*{{{  static int fhandle_writeiov (fhandle_t *fh, struct iovec *iov, int niov)*/
+/*
+ *	writes out a set of chunks to a file (all of them), passing each to the sink first.
+ *	uses the scheme's writev if it has one, otherwise one write per chunk.
+ *	returns 0 on success, < 0 on error.
+ */
+static int fhandle_writeiov (fhandle_t *fh, struct iovec *iov, int niov)
+{
+	fhscheme_t *scheme = fh->scheme;
+	int i;
+
+	if (fh->wsink) {
+		for (i=0; i<niov; i++) {
+			if (iov[i].iov_len) {
+				fh->wsink (fh->wsinkarg, (unsigned char *)iov[i].iov_base, (int)iov[i].iov_len);
+			}
+		}
+	}
+	while (niov > 0) {
+		int r;
+
+		if (!iov->iov_len) {
+			iov++, niov--;
+			continue;
+		}
+		fh->wcalls++;
+		if (scheme->writevfcn && (niov > 1)) {
+			r = scheme->writevfcn (fh, iov, niov);
+		} else {
+			r = scheme->writefcn (fh, (unsigned char *)iov->iov_base, (int)iov->iov_len);
+		}
+		if (r <= 0) {
+			return fhandle_seterr (fh, (r < 0) ? r : -EIO);
+		}
+		fh->wbytes += r;
+
+		/* skip over what went */
+		while ((niov > 0) && (r >= (int)iov->iov_len)) {
+			r -= (int)iov->iov_len;
+			iov++, niov--;
+		}
+		if (r) {
+			iov->iov_base = (char *)iov->iov_base + r;
+			iov->iov_len -= r;
+		}
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static void fhandle_mapsink (fhandle_t *fh)*/
+/*
+ *	accounts for output placed in the mapped window since last time, passing it to the sink
+ */
+static void fhandle_mapsink (fhandle_t *fh)
+{
+	if (fh->wbufused > fh->wbufdone) {
+		if (fh->wsink) {
+			fh->wsink (fh->wsinkarg, fh->wbuf + fh->wbufdone, fh->wbufused - fh->wbufdone);
+		}
+		fh->wbytes += (fh->wbufused - fh->wbufdone);
+		fh->wbufdone = fh->wbufused;
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static int fhandle_mapwindow (fhandle_t *fh)*/
+/*
+ *	finishes off the current mapped output window (if any) and maps the next one
+ *	returns 0 on success, < 0 on error.
+ */
+static int fhandle_mapwindow (fhandle_t *fh)
+{
+	int err;
+
+	if (fh->wbuf) {
+		fhandle_mapsink (fh);
+		fh->scheme->unmapfcn (fh, fh->wbuf, fh->wbufoffs, fh->wbufsize);
+		fh->wbufoffs += fh->wbufused;
+		fh->wbuf = NULL;
+	}
+	fh->wbufused = 0;
+	fh->wbufdone = 0;
+
+	fh->wcalls++;
+	err = fh->scheme->outmapfcn (fh, &fh->wbuf, fh->wbufoffs, fh->wbufsize);
+	if (err) {
+		fh->wbuf = NULL;
+		return fhandle_seterr (fh, (err < 0) ? err : -err);
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static int fhandle_unbuffer (fhandle_t *fh)*/
+/*
+ *	writes out anything buffered and releases the output buffer (or mapped window), leaving the handle unbuffered
+ *	returns 0 on success, < 0 on error.
+ */
+static int fhandle_unbuffer (fhandle_t *fh)
+{
+	int err = 0;
+
+	if (fh->wbufmode == FHB_MMAP) {
+		if (fh->wbuf) {
+			fhandle_mapsink (fh);
+			fh->scheme->unmapfcn (fh, fh->wbuf, fh->wbufoffs, fh->wbufsize);
+		}
+		/* trim back to what was actually written */
+		fh->wcalls++;
+		err = fh->scheme->truncfcn (fh, fh->wbufoffs + fh->wbufused);
+		if (err) {
+			fhandle_seterr (fh, (err < 0) ? err : -err);
+		}
+	} else if (fh->wbuf) {
+		err = fhandle_drain (fh);
+		sfree (fh->wbuf);
+	}
+
+	fh->wbufmode = FHB_NONE;
+	fh->wbuf = NULL;
+	fh->wbufsize = 0;
+	fh->wbufused = 0;
+	fh->wbufdone = 0;
+	fh->wbufoffs = 0;
+
+	return err;
+}
+/*}}}*/
+
+
 /*{{{  fhandle_t *fhandle_fopen (const char *path, const char *mode)*/
 /*
  *	opens a file.  'mode' should be fopen(3) style, "r", "w+", etc. with explicit text/binary suffix first if present
@@ -389,6 +539,13 @@ fhandle_t *fhandle_open (const char *path, const int mode, const int perm)
 
 	err = scheme->openfcn (fhan, mode, perm);
 	fhandle_seterr (fhan, err);
+	if (fh_watch && !strcmp (scheme->prefix, "file://")) {
+		if (!err) {
+			fh_watch (fh_watcharg, fhan->spath, ((mode & O_ACCMODE) == O_RDONLY) ? FHW_READ : FHW_WRITE);
+		} else if (!(mode & O_CREAT)) {
+			fh_watch (fh_watcharg, fhan->spath, FHW_ABSENT);
+		}
+	}
 	if (err) {
 		/* failed */
 		fhandle_freefhandle (fhan);
@@ -419,6 +576,9 @@ int fhandle_access (const char *path, const int amode)
 		err = -ENOSYS;
 	} else {
 		err = scheme->accessfcn (path + poffs, amode);
+		if (err && fh_watch && !strcmp (scheme->prefix, "file://")) {
+			fh_watch (fh_watcharg, path + poffs, FHW_ABSENT);
+		}
 	}
 	fhandle_seterr (NULL, err);
 
@@ -515,6 +675,9 @@ int fhandle_close (fhandle_t *fh)
 	} else if (!fh->scheme) {
 		return fhandle_seterr (fh, -ENOSYS);
 	}
+	if (fh->wbufmode != FHB_NONE) {
+		fhandle_unbuffer (fh);
+	}
 	err = fh->scheme->closefcn (fh);
 	fhandle_seterr (fh, err);
 
@@ -684,7 +847,36 @@ int fhandle_vprintf (fhandle_t *fh, const char *fmt, va_list ap)
 		return -1;
 	}
 
-	count = fh->scheme->printffcn (fh, fmt, ap);
+	if ((fh->wbufmode != FHB_NONE) || fh->wsink) {
+		/*{{{  format here and write, so it goes through the output buffer (and sink) in order*/
+		char sbuf[256];
+		char *tbuf = sbuf;
+		va_list ap2;
+
+		va_copy (ap2, ap);
+		count = vsnprintf (sbuf, sizeof (sbuf), fmt, ap2);
+		va_end (ap2);
+
+		if (count >= (int)sizeof (sbuf)) {
+			tbuf = (char *)smalloc_nz (count + 1);
+			vsnprintf (tbuf, count + 1, fmt, ap);
+		}
+		if (count > 0) {
+			int r = fhandle_write (fh, (unsigned char *)tbuf, count);
+
+			if (r < 0) {
+				count = r;
+			}
+		} else if (count < 0) {
+			count = -EINVAL;
+		}
+		if (tbuf != sbuf) {
+			sfree (tbuf);
+		}
+		/*}}}*/
+	} else {
+		count = fh->scheme->printffcn (fh, fmt, ap);
+	}
 
 	if (count < 0) {
 		fhandle_seterr (fh, count);
@@ -697,18 +889,70 @@ int fhandle_vprintf (fhandle_t *fh, const char *fmt, va_list ap)
 /*}}}*/
 /*{{{  int fhandle_write (fhandle_t *fh, unsigned char *buffer, int size)*/
 /*
- *	writes data to a file.
+ *	writes data to a file (or its output buffer).
  *	returns number of bytes written on success, <= 0 on error.
  */
 int fhandle_write (fhandle_t *fh, unsigned char *buffer, int size)
 {
+	int r;
+
 	if (!fh) {
 		return fhandle_seterr (fh, -EINVAL);
 	} else if (!fh->scheme) {
 		return fhandle_seterr (fh, -ENOSYS);
 	}
 
-	return fh->scheme->writefcn (fh, buffer, size);
+	switch (fh->wbufmode) {
+	case FHB_NONE:
+		if (fh->wsink && (size > 0)) {
+			fh->wsink (fh->wsinkarg, buffer, size);
+		}
+		fh->wcalls++;
+		r = fh->scheme->writefcn (fh, buffer, size);
+		if (r > 0) {
+			fh->wbytes += r;
+		}
+		return r;
+	case FHB_WRITE:
+		if (size <= (fh->wbufsize - fh->wbufused)) {
+			memcpy (fh->wbuf + fh->wbufused, buffer, size);
+			fh->wbufused += size;
+		} else {
+			/* doesn't fit: send what's buffered and this in one go */
+			struct iovec iov[2];
+
+			iov[0].iov_base = (void *)fh->wbuf;
+			iov[0].iov_len = fh->wbufused;
+			iov[1].iov_base = (void *)buffer;
+			iov[1].iov_len = size;
+			fh->wbufused = 0;
+			r = fhandle_writeiov (fh, iov, 2);
+			if (r) {
+				return r;
+			}
+		}
+		return size;
+	case FHB_MMAP:
+		for (r = 0; r < size;) {
+			int n = size - r;
+
+			if (!fh->wbuf || (fh->wbufused == fh->wbufsize)) {
+				int err = fhandle_mapwindow (fh);
+
+				if (err) {
+					return err;
+				}
+			}
+			if (n > (fh->wbufsize - fh->wbufused)) {
+				n = fh->wbufsize - fh->wbufused;
+			}
+			memcpy (fh->wbuf + fh->wbufused, buffer + r, n);
+			fh->wbufused += n;
+			r += n;
+		}
+		return size;
+	}
+	return fhandle_seterr (fh, -EINVAL);
 }
 /*}}}*/
 /*{{{  int fhandle_read (fhandle_t *fh, unsigned char *bufaddr, int max)*/
@@ -745,20 +989,127 @@ int fhandle_gets (fhandle_t *fh, char *bufaddr, int max)
 /*}}}*/
 /*{{{  int fhandle_flush (fhandle_t *fh)*/
 /*
- *	flushes a particular file.
+ *	flushes a particular file (any buffered output, then the underlying stream).
  *	returns 0 on success, non-zero on failure.
  */
 int fhandle_flush (fhandle_t *fh)
 {
+	int err;
+
 	if (!fh) {
 		return fhandle_seterr (fh, -EINVAL);
 	} else if (!fh->scheme) {
 		return fhandle_seterr (fh, -ENOSYS);
 	}
 
+	err = fhandle_drain (fh);
+	if (err) {
+		return err;
+	}
 	return fh->scheme->flushfcn (fh);
 }
 /*}}}*/
+/*{{{  int fhandle_setbuffer (fhandle_t *fh, fhbufmode_e mode, int size)*/
+/*
+ *	sets output buffering for a file-handle, 'size' is the buffer (or mapped window) size, <= 0 for a default.
+ *	anything already buffered is written out first.  mapped output is only available on files opened for
+ *	reading and writing, at the start of the file, and falls back to an in-memory buffer otherwise.
+ *	returns 0 on success, non-zero on failure.
+ */
+int fhandle_setbuffer (fhandle_t *fh, fhbufmode_e mode, int size)
+{
+	int err = 0;
+
+	if (!fh) {
+		return fhandle_seterr (fh, -EINVAL);
+	} else if (!fh->scheme) {
+		return fhandle_seterr (fh, -ENOSYS);
+	}
+
+	if (fh->wbufmode != FHB_NONE) {
+		err = fhandle_unbuffer (fh);
+	}
+	if (err || (mode == FHB_NONE)) {
+		return err;
+	}
+	if (size <= 0) {
+		size = FHANDLE_DEFBUFSIZE;
+	}
+
+	if ((mode == FHB_MMAP) && fh->scheme->outmapfcn && fh->scheme->unmapfcn && fh->scheme->truncfcn && !fh->wbytes) {
+		fh->wbufmode = FHB_MMAP;
+		fh->wbufsize = ((size + (FHANDLE_MAPALIGN - 1)) / FHANDLE_MAPALIGN) * FHANDLE_MAPALIGN;
+		fh->wbufoffs = 0;
+		if (!fhandle_mapwindow (fh)) {
+			return 0;
+		}
+		/* else cannot map it, buffer in memory instead */
+		fhandle_seterr (fh, 0);
+	}
+
+	fh->wbufmode = FHB_WRITE;
+	fh->wbufsize = size;
+	fh->wbufused = 0;
+	fh->wbuf = (unsigned char *)smalloc (size);
+
+	return 0;
+}
+/*}}}*/
+/*{{{  int fhandle_setsink (fhandle_t *fh, void (*sink)(void *, unsigned char *, int), void *arg)*/
+/*
+ *	sets a function that is given all subsequent output, in the chunks it leaves the buffer (e.g. for digests)
+ *	returns 0 on success, non-zero on failure.
+ */
+int fhandle_setsink (fhandle_t *fh, void (*sink)(void *, unsigned char *, int), void *arg)
+{
+	if (!fh) {
+		return fhandle_seterr (fh, -EINVAL);
+	}
+	fh->wsink = sink;
+	fh->wsinkarg = arg;
+
+	return 0;
+}
+/*}}}*/
+/*{{{  void fhandle_setwatch (void (*watch)(void *, const char *, fhwatch_e), void *arg)*/
+/*
+ *	sets a function that is told about host files as they are opened, or looked for and not found
+ *	(for the build cache).  may be called from worker threads.  NULL turns it off.
+ */
+void fhandle_setwatch (void (*watch)(void *, const char *, fhwatch_e), void *arg)
+{
+	fh_watch = watch;
+	fh_watcharg = arg;
+	return;
+}
+/*}}}*/
+/*{{{  int fhandle_drain (fhandle_t *fh)*/
+/*
+ *	writes out any buffered output to the file (without flushing the underlying stream)
+ *	returns 0 on success, non-zero on failure.
+ */
+int fhandle_drain (fhandle_t *fh)
+{
+	if (!fh) {
+		return fhandle_seterr (fh, -EINVAL);
+	} else if (!fh->scheme) {
+		return fhandle_seterr (fh, -ENOSYS);
+	}
+
+	if ((fh->wbufmode == FHB_WRITE) && fh->wbufused) {
+		struct iovec iov;
+
+		iov.iov_base = (void *)fh->wbuf;
+		iov.iov_len = fh->wbufused;
+		fh->wbufused = 0;
+		return fhandle_writeiov (fh, &iov, 1);
+	} else if ((fh->wbufmode == FHB_MMAP) && fh->wbuf) {
+		/* already in the file, but let the sink see it */
+		fhandle_mapsink (fh);
+	}
+	return 0;
+}
+/*}}}*/
 /*{{{  int fhandle_isatty (fhandle_t *fh)*/
 /*
  *	returns non-zero if the file handle is a TTY
@@ -832,8 +1183,6 @@ int fhandle_vppxml (fhandle_t *fh, const char *fmt, va_list ap)
 		sfree (tstr);
 
 		tsize = count + 1;
-		tstr = (char *)smalloc (tsize);
-
 		tstr = (char *)smalloc (tsize);
 		count = vsnprintf (tstr, tsize, fmt, ap2);
 
@@ -1025,7 +1374,9 @@ fprintf (stderr, "arp, looking for pointer in string starting: [%s]\n", ch);
 	/*}}}*/
 
 	/* and, finally, print it! */
-	fhandle_printf (fh, "%s", xstr);
+	if (fhandle_write (fh, (unsigned char *)xstr, xlen) < 0) {
+		xlen = -1;
+	}
 	sfree (xstr);
 
 	return xlen;
@@ -31,6 +31,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <errno.h>
 
@@ -352,6 +353,92 @@ static int unix_writefcn (fhandle_t *fhan, unsigned char *buffer, int size)
 	return gone;
 }
 /*}}}*/
+/*{{{  static int unix_writevfcn (fhandle_t *fhan, struct iovec *iov, int niov)*/
+/*
+ *	writes a set of chunks to a file in one go (may be partial).
+ *	returns number of bytes written on success, <= 0 on error.
+ */
+static int unix_writevfcn (fhandle_t *fhan, struct iovec *iov, int niov)
+{
+	unixfhandle_t *ufhan = (unixfhandle_t *)fhan->ipriv;
+	int w;
+
+	if (!ufhan) {
+		nocc_serious ("unix_writevfcn(): missing state! [%s]", fhan->path);
+		return -EINVAL;
+	} else if (ufhan->fd < 0) {
+		nocc_serious ("unix_writevfcn(): file not actually open [%s]", fhan->path);
+		return -EINVAL;
+	}
+
+	w = writev (ufhan->fd, iov, niov);
+	if (w < 0) {
+		return -errno;
+	}
+	return w;
+}
+/*}}}*/
+/*{{{  static int unix_outmapfcn (fhandle_t *fhan, unsigned char **pptr, size_t offset, size_t length)*/
+/*
+ *	extends a file to cover 'offset' + 'length' bytes and maps that part of it for writing
+ *	returns 0 on success, non-zero on error
+ */
+static int unix_outmapfcn (fhandle_t *fhan, unsigned char **pptr, size_t offset, size_t length)
+{
+	unixfhandle_t *ufhan = (unixfhandle_t *)fhan->ipriv;
+	unsigned char *ptr;
+
+	if (!ufhan) {
+		nocc_serious ("unix_outmapfcn(): missing state! [%s]", fhan->path);
+		return -1;
+	} else if (ufhan->fd < 0) {
+		nocc_serious ("unix_outmapfcn(): file not actually open [%s]", fhan->path);
+		return -1;
+	}
+
+	if (ftruncate (ufhan->fd, (off_t)(offset + length))) {
+		return errno;
+	}
+	ptr = (unsigned char *)mmap ((void *)0, length, PROT_READ | PROT_WRITE, MAP_SHARED, ufhan->fd, (off_t)offset);
+	if (ptr == ((unsigned char *)-1)) {
+		/* failed, put the length back */
+		int err = errno;
+
+		if (ftruncate (ufhan->fd, (off_t)offset)) {
+			/* ignore */
+		}
+		return err;
+	}
+	*pptr = ptr;
+	return 0;
+}
+/*}}}*/
+/*{{{  static int unix_truncfcn (fhandle_t *fhan, size_t length)*/
+/*
+ *	sets the length of a file, and moves the file position to its end
+ *	returns 0 on success, non-zero on error
+ */
+static int unix_truncfcn (fhandle_t *fhan, size_t length)
+{
+	unixfhandle_t *ufhan = (unixfhandle_t *)fhan->ipriv;
+
+	if (!ufhan) {
+		nocc_serious ("unix_truncfcn(): missing state! [%s]", fhan->path);
+		return -1;
+	} else if (ufhan->fd < 0) {
+		nocc_serious ("unix_truncfcn(): file not actually open [%s]", fhan->path);
+		return -1;
+	}
+
+	if (ftruncate (ufhan->fd, (off_t)length)) {
+		return errno;
+	}
+	if (lseek (ufhan->fd, (off_t)length, SEEK_SET) == (off_t)-1) {
+		return errno;
+	}
+	return 0;
+}
+/*}}}*/
 /*{{{  static int unix_readfcn (fhandle_t *fhan, unsigned char *bufaddr, int max)*/
 /*
  *	reads data from a file.
@@ -486,6 +573,9 @@ int file_unix_init (void)
 	unix_fhscheme->getsfcn = unix_getsfcn;
 	unix_fhscheme->flushfcn = unix_flushfcn;
 	unix_fhscheme->isattyfcn = unix_isattyfcn;
+	unix_fhscheme->writevfcn = unix_writevfcn;
+	unix_fhscheme->outmapfcn = unix_outmapfcn;
+	unix_fhscheme->truncfcn = unix_truncfcn;
 
 	if (fhandle_registerscheme (unix_fhscheme)) {
 		nocc_serious ("file_unix_init(): failed to register scheme!");
@@ -43,6 +43,7 @@
 #include "fhandlepriv.h"
 #include "crypto.h"
 #include "opts.h"
+#include "compcache.h"
 
 /*}}}*/
 /*{{{  local types/vars*/
@@ -343,6 +344,7 @@ static int url_openfcn (fhandle_t *fhan, const int mode, const int perm)
 	char *lpath = url_gethashedfilename (fhan->spath);
 	int err = 0;
 
+	compcache_nostore ("remote file");		/* could change without the local copy changing */
 	if (compopts.cache_pref && !fhandle_access (lpath, R_OK)) {
 		/* got local copy and preferred */
 	} else {
@@ -0,0 +1,423 @@
+/*
+ *	profile.c -- per-stage and per-pass compiler profiling
+ *	Copyright (C) 2016 Fred Barnes <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*{{{  includes*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "nocc.h"
+#include "support.h"
+#include "opts.h"
+#include "fhandle.h"
+#include "tnode.h"
+#include "profile.h"
+
+/*}}}*/
+/*{{{  private types/data*/
+
+/* counters sampled at the start and end of each profiled region */
+typedef struct TAG_profsample {
+	uint64_t wall;				/* microseconds */
+	uint64_t cpu;				/* microseconds, user + system */
+	unsigned long allocs;
+	unsigned long reallocs;
+	unsigned long frees;
+	unsigned long long bytes;
+	int nodes;				/* tree-nodes created */
+	int livenodes;				/* tree-nodes live */
+	long maxrss;				/* peak resident set size, KiB */
+} profsample_t;
+
+typedef struct TAG_profrec {
+	const char *kind;			/* "stage", "fe-pass" or "be-pass" */
+	char *name;
+	int depth;				/* nesting depth when started */
+	int done;
+	profsample_t start;
+	profsample_t delta;			/* counts over the region; 'livenodes' and 'maxrss' are end values */
+} profrec_t;
+
+static int prof_enabled = 0;			/* set by --profile or --profile-to */
+static int prof_print = 0;			/* set by --profile */
+static char *prof_outfile = NULL;		/* set by --profile-to, CSV if it ends ".csv", JSON otherwise */
+static int prof_depth = 0;
+static profsample_t prof_origin;		/* sampled at initialisation, for the totals */
+
+STATICDYNARRAY (profrec_t *, profrecs);
+
+/*}}}*/
+
+
+/*{{{  static void profile_sample (profsample_t *ps)*/
+/*
+ *	takes a snapshot of the various counters
+ */
+static void profile_sample (profsample_t *ps)
+{
+	struct timeval tv;
+	struct rusage ru;
+
+	gettimeofday (&tv, NULL);
+	ps->wall = ((uint64_t)tv.tv_sec * 1000000ULL) + (uint64_t)tv.tv_usec;
+
+	if (getrusage (RUSAGE_SELF, &ru)) {
+		ps->cpu = 0;
+		ps->maxrss = 0;
+	} else {
+		ps->cpu = ((uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL) + (uint64_t)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+		ps->maxrss = ru.ru_maxrss;
+	}
+	smem_counters (&ps->allocs, &ps->reallocs, &ps->frees, &ps->bytes);
+	tnode_nodecounts (&ps->nodes, &ps->livenodes);
+
+	return;
+}
+/*}}}*/
+/*{{{  static void profile_difference (profsample_t *start, profsample_t *end, profsample_t *delta)*/
+/*
+ *	works out what happened between two samples
+ */
+static void profile_difference (profsample_t *start, profsample_t *end, profsample_t *delta)
+{
+	delta->wall = end->wall - start->wall;
+	delta->cpu = end->cpu - start->cpu;
+	delta->allocs = end->allocs - start->allocs;
+	delta->reallocs = end->reallocs - start->reallocs;
+	delta->frees = end->frees - start->frees;
+	delta->bytes = end->bytes - start->bytes;
+	delta->nodes = end->nodes - start->nodes;
+	delta->livenodes = end->livenodes;
+	delta->maxrss = end->maxrss;
+
+	return;
+}
+/*}}}*/
+
+
+/*{{{  int profile_begin (const char *kind, const char *name)*/
+/*
+ *	starts profiling a compiler stage or pass
+ *	returns an index to give to profile_end(), or -1 if not profiling
+ */
+int profile_begin (const char *kind, const char *name)
+{
+	profrec_t *pr;
+
+	if (!prof_enabled) {
+		return -1;
+	}
+	pr = (profrec_t *)smalloc (sizeof (profrec_t));
+	pr->kind = kind;
+	pr->name = string_dup (name);
+	pr->depth = prof_depth++;
+	pr->done = 0;
+	dynarray_add (profrecs, pr);
+
+	/* sample last, so that the above isn't counted */
+	profile_sample (&pr->start);
+
+	return DA_CUR (profrecs) - 1;
+}
+/*}}}*/
+/*{{{  void profile_end (int idx)*/
+/*
+ *	finishes profiling a compiler stage or pass
+ */
+void profile_end (int idx)
+{
+	profrec_t *pr;
+	profsample_t now;
+
+	if ((idx < 0) || (idx >= DA_CUR (profrecs))) {
+		return;
+	}
+	profile_sample (&now);
+	pr = DA_NTHITEM (profrecs, idx);
+	profile_difference (&pr->start, &now, &pr->delta);
+	pr->done = 1;
+	prof_depth--;
+
+	return;
+}
+/*}}}*/
+
+
+/*{{{  static void profile_writejsonstr (fhandle_t *fh, const char *str)*/
+/*
+ *	writes a quoted JSON string
+ */
+static void profile_writejsonstr (fhandle_t *fh, const char *str)
+{
+	const char *ch;
+
+	fhandle_printf (fh, "\"");
+	for (ch=str; *ch != '\0'; ch++) {
+		if ((*ch == '"') || (*ch == '\\')) {
+			fhandle_printf (fh, "\\%c", *ch);
+		} else if ((unsigned char)*ch < 0x20) {
+			fhandle_printf (fh, "\\u%4.4x", (unsigned int)*ch);
+		} else {
+			fhandle_printf (fh, "%c", *ch);
+		}
+	}
+	fhandle_printf (fh, "\"");
+	return;
+}
+/*}}}*/
+/*{{{  static void profile_writerecord (fhandle_t *fh, int csv, const char *kind, const char *name, int depth, profsample_t *d)*/
+/*
+ *	writes a single record in CSV or JSON form
+ */
+static void profile_writerecord (fhandle_t *fh, int csv, const char *kind, const char *name, int depth, profsample_t *d)
+{
+	if (csv) {
+		fhandle_printf (fh, "%s,\"%s\",%d,", kind, name, depth);
+	} else {
+		fhandle_printf (fh, "{\"kind\": \"%s\", \"name\": ", kind);
+		profile_writejsonstr (fh, name);
+		fhandle_printf (fh, ", \"depth\": %d, \"wall_us\": ", depth);
+	}
+	fhandle_printf (fh, "%llu%s%llu%s%lu%s%lu%s%lu%s%llu%s%d%s%d%s%ld",
+			(unsigned long long)d->wall, csv ? "," : ", \"cpu_us\": ",
+			(unsigned long long)d->cpu, csv ? "," : ", \"allocs\": ",
+			d->allocs, csv ? "," : ", \"reallocs\": ",
+			d->reallocs, csv ? "," : ", \"frees\": ",
+			d->frees, csv ? "," : ", \"alloc_bytes\": ",
+			d->bytes, csv ? "," : ", \"nodes\": ",
+			d->nodes, csv ? "," : ", \"live_nodes\": ",
+			d->livenodes, csv ? "," : ", \"peak_rss_kb\": ",
+			d->maxrss);
+	fhandle_printf (fh, "%s", csv ? "\n" : "}");
+	return;
+}
+/*}}}*/
+/*{{{  static int profile_writefile (const char *fname, profsample_t *total)*/
+/*
+ *	writes the collected profile to a file, CSV if the name ends ".csv", JSON otherwise
+ *	returns 0 on success, non-zero on failure
+ */
+static int profile_writefile (const char *fname, profsample_t *total)
+{
+	fhandle_t *fh;
+	int csv, i, len, nrecs;
+
+	len = strlen (fname);
+	csv = ((len > 4) && !strcasecmp (fname + (len - 4), ".csv"));
+
+	fh = fhandle_fopen (fname, "w");
+	if (!fh) {
+		nocc_error ("failed to open %s for writing: %s", fname, strerror (fhandle_lasterr (fh)));
+		return -1;
+	}
+	if (csv) {
+		fhandle_printf (fh, "kind,name,depth,wall_us,cpu_us,allocs,reallocs,frees,alloc_bytes,nodes,live_nodes,peak_rss_kb\n");
+	} else {
+		fhandle_printf (fh, "{\n  \"total\": ");
+		profile_writerecord (fh, 0, "total", "total", 0, total);
+		fhandle_printf (fh, ",\n  \"records\": [");
+	}
+	for (i=nrecs=0; i<DA_CUR (profrecs); i++) {
+		profrec_t *pr = DA_NTHITEM (profrecs, i);
+
+		if (!pr->done) {
+			continue;
+		}
+		if (!csv) {
+			fhandle_printf (fh, "%s\n    ", nrecs ? "," : "");
+		}
+		nrecs++;
+		profile_writerecord (fh, csv, pr->kind, pr->name, pr->depth, &pr->delta);
+	}
+	if (csv) {
+		profile_writerecord (fh, 1, "total", "total", 0, total);
+	} else {
+		fhandle_printf (fh, "\n  ]\n}\n");
+	}
+	fhandle_close (fh);
+
+	return 0;
+}
+/*}}}*/
+/*{{{  static void profile_printrow (fhandle_t *fh, const char *name, int depth, profsample_t *d)*/
+/*
+ *	prints a single row of the profile table
+ */
+static void profile_printrow (fhandle_t *fh, const char *name, int depth, profsample_t *d)
+{
+	fhandle_printf (fh, "%*s%-*.*s %10.3f %10.3f %9lu %9lu %10llu %8d %8d %9ld\n", depth * 2, "", 36 - (depth * 2), 36 - (depth * 2), name,
+			(double)d->wall / 1000.0, (double)d->cpu / 1000.0, d->allocs + d->reallocs, d->frees,
+			(d->bytes + 1023) >> 10, d->nodes, d->livenodes, d->maxrss);
+	return;
+}
+/*}}}*/
+/*{{{  void profile_report (void)*/
+/*
+ *	prints the profile table (--profile) and writes the profile file (--profile-to), if requested
+ */
+void profile_report (void)
+{
+	profsample_t now, total;
+	int i;
+
+	if (!prof_enabled) {
+		return;
+	}
+	profile_sample (&now);
+	profile_difference (&prof_origin, &now, &total);
+
+	if (prof_print) {
+		fhandle_printf (FHAN_STDERR, "%-36s %10s %10s %9s %9s %10s %8s %8s %9s\n", "stage / pass", "wall (ms)", "cpu (ms)",
+				"allocs", "frees", "alloc KiB", "nodes", "live", "rss KiB");
+		for (i=0; i<DA_CUR (profrecs); i++) {
+			profrec_t *pr = DA_NTHITEM (profrecs, i);
+
+			if (pr->done) {
+				profile_printrow (FHAN_STDERR, pr->name, pr->depth, &pr->delta);
+			}
+		}
+		profile_printrow (FHAN_STDERR, "total", 0, &total);
+	}
+	if (prof_outfile) {
+		profile_writefile (prof_outfile, &total);
+	}
+
+	return;
+}
+/*}}}*/
+
+
+/*{{{  static int profile_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	option handler for profiling options
+ *	returns 0 on success, non-zero on failure
+ */
+static int profile_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	char *ch;
+
+	switch ((int)((uint64_t)opt->arg)) {
+	case 1:
+		/*{{{  --profile*/
+		prof_print = 1;
+		prof_enabled = 1;
+		break;
+		/*}}}*/
+	case 2:
+		/*{{{  --profile-to <file>*/
+		ch = strchr (**argwalk, '=');
+		if (ch) {
+			ch++;
+		} else {
+			(*argwalk)++;
+			(*argleft)--;
+			if (!**argwalk || !*argleft) {
+				nocc_error ("missing argument for option %s", (*argwalk)[-1]);
+				(*argwalk)--, (*argleft)++;
+				return -1;
+			}
+			ch = **argwalk;
+		}
+		if (prof_outfile) {
+			sfree (prof_outfile);
+		}
+		prof_outfile = string_dup (ch);
+		prof_enabled = 1;
+		break;
+		/*}}}*/
+	default:
+		nocc_error ("profile_opthandler(): unknown option [%s]", **argwalk);
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  void profile_restart (void)*/
+/*
+ *	discards anything profiled so far and restarts the totals (for compile server requests)
+ */
+void profile_restart (void)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (profrecs); i++) {
+		profrec_t *pr = DA_NTHITEM (profrecs, i);
+
+		sfree (pr->name);
+		sfree (pr);
+	}
+	dynarray_trash (profrecs);
+	dynarray_init (profrecs);
+	prof_depth = 0;
+	profile_sample (&prof_origin);
+
+	return;
+}
+/*}}}*/
+/*{{{  int profile_init (void)*/
+/*
+ *	initialises profiling, called early so that the totals cover (nearly) everything
+ *	returns 0 on success, non-zero on failure
+ */
+int profile_init (void)
+{
+	dynarray_init (profrecs);
+	profile_sample (&prof_origin);
+
+	opts_add ("profile", '\0', profile_opthandler, (void *)1, "1print time, allocation and tree-node counts for each compiler stage and pass");
+	opts_add ("profile-to", '\0', profile_opthandler, (void *)2, "1write the per-stage/pass profile to a file (CSV if it ends .csv, otherwise JSON)");
+
+	return 0;
+}
+/*}}}*/
+/*{{{  int profile_shutdown (void)*/
+/*
+ *	shuts-down profiling
+ *	returns 0 on success, non-zero on failure
+ */
+int profile_shutdown (void)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (profrecs); i++) {
+		profrec_t *pr = DA_NTHITEM (profrecs, i);
+
+		sfree (pr->name);
+		sfree (pr);
+	}
+	dynarray_trash (profrecs);
+	if (prof_outfile) {
+		sfree (prof_outfile);
+		prof_outfile = NULL;
+	}
+
+	return 0;
+}
+/*}}}*/
+
@@ -0,0 +1,705 @@
+/*
+ *	server.c -- compile server, keeps an initialised compiler around for repeated compiles
+ *	Copyright (C) 2016 Fred Barnes <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ *	a compile server (--server <socket>) does the usual start-up once: specs file, extensions, language
+ *	definitions and so on, then waits for requests on a Unix-domain socket.  a request carries the client's
+ *	arguments, working directory and environment, plus its standard input, output and error.  each request
+ *	is compiled in a child process forked from the warm server, so names, scopes, tree-nodes and anything
+ *	else a compile touches belong to that child and are gone when it exits.  only clients running as the
+ *	same user as the server are served.
+ *
+ *	the client is nocc itself: with NOCC_SERVER set to the socket, the arguments are handed to the server
+ *	and the compiler exits with the request's status.  if no server answers, it compiles as normal.
+ */
+
+/*{{{  includes*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+#include "nocc.h"
+#include "support.h"
+#include "opts.h"
+#include "server.h"
+
+/*}}}*/
+/*{{{  private types/data*/
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H) && defined(HAVE_SYS_WAIT_H)
+#define USE_COMPILESERVER
+#endif
+
+#define SERVER_MAGIC 0x6e6f6331			/* "noc1" */
+#define SERVER_NFDS 3				/* standard input, output and error */
+#define SERVER_MAXREQUEST (1 << 20)		/* limit on the strings in a request */
+#define SERVER_EXITDECLINE 125			/* exit status of a request the server declined, see server_decline() */
+
+/* sent first by the client, followed by the strings: arguments, working directory, environment */
+typedef struct TAG_srvheader {
+	uint32_t magic;
+	uint32_t argc;
+	uint32_t envc;
+	uint32_t length;			/* bytes of strings, each NUL terminated */
+} srvheader_t;
+
+extern char **environ;
+
+static char *srv_path = NULL;			/* set by --server */
+static int srv_fd = -1;				/* listening socket */
+static int srv_requests = 0;
+static volatile sig_atomic_t srv_stop = 0;	/* set on SIGTERM or SIGINT */
+
+/*}}}*/
+
+
+#ifdef USE_COMPILESERVER
+/*{{{  static int server_sockaddr (const char *path, struct sockaddr_un *sun)*/
+/*
+ *	fills in a socket address for the given path
+ *	returns 0 on success, non-zero if the path does not fit
+ */
+static int server_sockaddr (const char *path, struct sockaddr_un *sun)
+{
+	memset (sun, 0, sizeof (struct sockaddr_un));
+	sun->sun_family = AF_UNIX;
+	if (strlen (path) >= sizeof (sun->sun_path)) {
+		return -1;
+	}
+	strcpy (sun->sun_path, path);
+	return 0;
+}
+/*}}}*/
+/*{{{  static int server_writeall (int fd, const void *buf, size_t len)*/
+/*
+ *	writes a buffer to a socket
+ *	returns 0 on success, non-zero on failure
+ */
+static int server_writeall (int fd, const void *buf, size_t len)
+{
+	const char *ch = (const char *)buf;
+
+	while (len > 0) {
+		ssize_t n = write (fd, ch, len);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		ch += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static int server_readall (int fd, void *buf, size_t len)*/
+/*
+ *	reads a buffer from a socket
+ *	returns 0 on success, non-zero on failure (including end-of-file)
+ */
+static int server_readall (int fd, void *buf, size_t len)
+{
+	char *ch = (char *)buf;
+
+	while (len > 0) {
+		ssize_t n = read (fd, ch, len);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		} else if (!n) {
+			return -1;
+		}
+		ch += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static int server_sendheader (int fd, srvheader_t *hdr, int *fds)*/
+/*
+ *	sends a request header along with the client's standard descriptors
+ *	returns 0 on success, non-zero on failure
+ */
+static int server_sendheader (int fd, srvheader_t *hdr, int *fds)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE (SERVER_NFDS * sizeof (int))];
+	} ctl;
+	struct cmsghdr *cmsg;
+	ssize_t n;
+
+	memset (&msg, 0, sizeof (msg));
+	memset (&ctl, 0, sizeof (ctl));
+	iov.iov_base = (void *)hdr;
+	iov.iov_len = sizeof (srvheader_t);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof (ctl.buf);
+
+	cmsg = CMSG_FIRSTHDR (&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN (SERVER_NFDS * sizeof (int));
+	memcpy (CMSG_DATA (cmsg), fds, SERVER_NFDS * sizeof (int));
+
+	do {
+		n = sendmsg (fd, &msg, 0);
+	} while ((n < 0) && (errno == EINTR));
+	if (n < 0) {
+		return -1;
+	}
+	/* descriptors went with the first byte, send anything left over */
+	return server_writeall (fd, (char *)hdr + n, sizeof (srvheader_t) - (size_t)n);
+}
+/*}}}*/
+/*{{{  static int server_recvheader (int fd, srvheader_t *hdr, int *fds)*/
+/*
+ *	receives a request header and the client's standard descriptors
+ *	returns 0 on success, non-zero on failure
+ */
+static int server_recvheader (int fd, srvheader_t *hdr, int *fds)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE (SERVER_NFDS * sizeof (int))];
+	} ctl;
+	struct cmsghdr *cmsg;
+	ssize_t n;
+	int gotfds = 0;
+
+	memset (&msg, 0, sizeof (msg));
+	iov.iov_base = (void *)hdr;
+	iov.iov_len = sizeof (srvheader_t);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof (ctl.buf);
+
+	do {
+		n = recvmsg (fd, &msg, 0);
+	} while ((n < 0) && (errno == EINTR));
+	if (n <= 0) {
+		return -1;
+	}
+	for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS) &&
+				(cmsg->cmsg_len == CMSG_LEN (SERVER_NFDS * sizeof (int)))) {
+			memcpy (fds, CMSG_DATA (cmsg), SERVER_NFDS * sizeof (int));
+			gotfds = 1;
+		}
+	}
+	if (!gotfds || (msg.msg_flags & MSG_CTRUNC)) {
+		return -1;
+	}
+	return server_readall (fd, (char *)hdr + n, sizeof (srvheader_t) - (size_t)n);
+}
+/*}}}*/
+/*{{{  static int server_peerok (int fd)*/
+/*
+ *	checks that the client on a connected socket runs as the same user as the server: a request runs
+ *	with the server's privileges, in the client's directory and environment
+ *	returns non-zero if the peer is allowed
+ */
+static int server_peerok (int fd)
+{
+#if defined(SO_PEERCRED)
+	struct ucred cred;
+	socklen_t clen = sizeof (cred);
+
+	if (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &clen) || (clen != sizeof (cred))) {
+		return 0;
+	}
+	return (cred.uid == geteuid ());
+#elif defined(HAVE_GETPEEREID)
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid (fd, &uid, &gid)) {
+		return 0;
+	}
+	return (uid == geteuid ());
+#else
+	return 0;
+#endif
+}
+/*}}}*/
+/*{{{  static void server_sighandler (int sig)*/
+/*
+ *	stops the server loop on SIGTERM or SIGINT
+ */
+static void server_sighandler (int sig)
+{
+	srv_stop = 1;
+	return;
+}
+/*}}}*/
+/*{{{  static void server_setsignals (void (*handler)(int), void (*chldhandler)(int))*/
+/*
+ *	sets the handlers for SIGTERM/SIGINT and SIGCHLD
+ */
+static void server_setsignals (void (*handler)(int), void (*chldhandler)(int))
+{
+	struct sigaction sa;
+
+	memset (&sa, 0, sizeof (sa));
+	sigemptyset (&sa.sa_mask);
+	sa.sa_handler = handler;
+	sa.sa_flags = 0;			/* not SA_RESTART: accept() must see EINTR */
+	sigaction (SIGTERM, &sa, NULL);
+	sigaction (SIGINT, &sa, NULL);
+
+	sa.sa_handler = chldhandler;
+	sigaction (SIGCHLD, &sa, NULL);
+
+	return;
+}
+/*}}}*/
+/*{{{  static int server_request (int cfd, int *argcp, char ***argvp)*/
+/*
+ *	handles a request on a newly forked process: reads the request, then forks again for the compile itself,
+ *	waits for it, and sends the exit status back to the client.  only the compile returns from here.
+ *	returns 0 in the compile process
+ */
+static int server_request (int cfd, int *argcp, char ***argvp)
+{
+	srvheader_t hdr;
+	int fds[SERVER_NFDS];
+	char *buf, *ch, *cwd;
+	char **argv, **envv;
+	int i, status;
+	int32_t rstatus;
+	pid_t pid;
+
+	server_setsignals (SIG_DFL, SIG_DFL);
+
+	if (server_recvheader (cfd, &hdr, fds)) {
+		_exit (EXIT_FAILURE);
+	}
+	/* counts are bounded one at a time first, so their sum cannot wrap */
+	if ((hdr.magic != SERVER_MAGIC) || !hdr.argc || (hdr.length > SERVER_MAXREQUEST) ||
+			(hdr.argc > hdr.length) || (hdr.envc > hdr.length) || (hdr.argc + hdr.envc + 1 > hdr.length)) {
+		_exit (EXIT_FAILURE);
+	}
+	buf = (char *)smalloc (hdr.length + 1);
+	if (server_readall (cfd, buf, hdr.length)) {
+		_exit (EXIT_FAILURE);
+	}
+	buf[hdr.length] = '\0';
+	if (!server_peerok (cfd)) {
+		/* read all of it first, so the client is not cut off while sending, then tell it to compile itself */
+		nocc_warning ("compile server: declined a request from another user");
+		rstatus = -1;
+		server_writeall (cfd, &rstatus, sizeof (rstatus));
+		_exit (EXIT_FAILURE);
+	}
+
+	/*{{{  split into arguments, working directory and environment*/
+	argv = (char **)smalloc ((hdr.argc + 1) * sizeof (char *));
+	envv = (char **)smalloc ((hdr.envc + 1) * sizeof (char *));
+	ch = buf;
+	for (i=0; i<(int)hdr.argc; i++) {
+		if (ch > (buf + hdr.length)) {
+			_exit (EXIT_FAILURE);
+		}
+		argv[i] = ch;
+		ch += strlen (ch) + 1;
+	}
+	if (ch > (buf + hdr.length)) {
+		_exit (EXIT_FAILURE);
+	}
+	cwd = ch;
+	ch += strlen (ch) + 1;
+	for (i=0; i<(int)hdr.envc; i++) {
+		if (ch > (buf + hdr.length)) {
+			_exit (EXIT_FAILURE);
+		}
+		envv[i] = ch;
+		ch += strlen (ch) + 1;
+	}
+	if (ch > (buf + hdr.length + 1)) {
+		_exit (EXIT_FAILURE);
+	}
+
+	/*}}}*/
+
+	fflush (NULL);
+	pid = fork ();
+	if (!pid) {
+		/*{{{  the compile: take over the client's descriptors, directory and environment*/
+		close (cfd);
+		for (i=0; i<SERVER_NFDS; i++) {
+			if (fds[i] != i) {
+				dup2 (fds[i], i);
+				close (fds[i]);
+			}
+		}
+		environ = envv;
+		if (chdir (cwd)) {
+			nocc_error ("compile server: cannot change to %s: %s", cwd, strerror (errno));
+			_exit (EXIT_FAILURE);
+		}
+
+		*argcp = (int)hdr.argc;
+		*argvp = argv;
+		return 0;
+		/*}}}*/
+	}
+	for (i=0; i<SERVER_NFDS; i++) {
+		close (fds[i]);
+	}
+
+	if (pid < 0) {
+		rstatus = EXIT_FAILURE;
+	} else {
+		while ((waitpid (pid, &status, 0) < 0) && (errno == EINTR));
+		if (WIFEXITED (status) && (WEXITSTATUS (status) == SERVER_EXITDECLINE)) {
+			rstatus = -1;				/* client compiles it */
+		} else if (WIFEXITED (status)) {
+			rstatus = WEXITSTATUS (status);
+		} else if (WIFSIGNALED (status)) {
+			rstatus = 128 + WTERMSIG (status);
+		} else {
+			rstatus = EXIT_FAILURE;
+		}
+	}
+	server_writeall (cfd, &rstatus, sizeof (rstatus));
+	close (cfd);
+
+	_exit (EXIT_SUCCESS);
+	return -1;
+}
+/*}}}*/
+#endif	/* USE_COMPILESERVER */
+
+
+/*{{{  int server_client (int argc, char **argv)*/
+/*
+ *	called very early on: if NOCC_SERVER names a compile server's socket, hands the compile over to it.
+ *	this runs before most of the compiler is initialised, so only reports to stderr directly.
+ *	returns the exit status of the compile, or -1 if there is no server to use (compile locally)
+ */
+int server_client (int argc, char **argv)
+{
+#ifdef USE_COMPILESERVER
+	char *path = getenv ("NOCC_SERVER");
+	struct sockaddr_un sun;
+	srvheader_t hdr;
+	char cwd[FILENAME_MAX];
+	int fds[SERVER_NFDS];
+	size_t length;
+	char *buf, *ch;
+	int fd, i;
+	int32_t rstatus;
+
+	if (!path || !*path || server_sockaddr (path, &sun)) {
+		return -1;
+	}
+	for (i=1; i<argc; i++) {
+		if (!strcmp (argv[i], "--server") || !strncmp (argv[i], "--server=", 9)) {
+			/* starting a server, not using one */
+			return -1;
+		}
+	}
+	for (i=0; i<SERVER_NFDS; i++) {
+		if (fcntl (i, F_GETFD) < 0) {
+			return -1;
+		}
+		fds[i] = i;
+	}
+	if (!getcwd (cwd, FILENAME_MAX)) {
+		return -1;
+	}
+
+	/*{{{  flatten arguments, working directory and environment*/
+	hdr.magic = SERVER_MAGIC;
+	hdr.argc = (uint32_t)argc;
+	hdr.envc = 0;
+	length = strlen (cwd) + 1;
+	for (i=0; i<argc; i++) {
+		length += strlen (argv[i]) + 1;
+	}
+	for (i=0; environ && environ[i]; i++) {
+		length += strlen (environ[i]) + 1;
+		hdr.envc++;
+	}
+	if (length > SERVER_MAXREQUEST) {
+		return -1;
+	}
+	hdr.length = (uint32_t)length;
+
+	buf = (char *)smalloc (length);
+	ch = buf;
+	for (i=0; i<argc; i++) {
+		strcpy (ch, argv[i]);
+		ch += strlen (ch) + 1;
+	}
+	strcpy (ch, cwd);
+	ch += strlen (ch) + 1;
+	for (i=0; i<(int)hdr.envc; i++) {
+		strcpy (ch, environ[i]);
+		ch += strlen (ch) + 1;
+	}
+
+	/*}}}*/
+
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		sfree (buf);
+		return -1;
+	}
+	if (connect (fd, (struct sockaddr *)&sun, sizeof (sun)) || server_sendheader (fd, &hdr, fds) || server_writeall (fd, buf, length)) {
+		/* no server, or it went away before taking the request */
+		close (fd);
+		sfree (buf);
+		return -1;
+	}
+	sfree (buf);
+
+	if (server_readall (fd, &rstatus, sizeof (rstatus))) {
+		fprintf (stderr, "%s: lost connection to compile server on %s\n", progname, path);
+		close (fd);
+		return EXIT_FAILURE;
+	}
+	close (fd);
+
+	if (rstatus < 0) {
+		/* declined, compile locally */
+		return -1;
+	}
+	return (int)rstatus;
+#else	/* !USE_COMPILESERVER */
+	return -1;
+#endif	/* !USE_COMPILESERVER */
+}
+/*}}}*/
+/*{{{  int server_enabled (void)*/
+/*
+ *	returns non-zero if the compiler was asked to run as a compile server
+ */
+int server_enabled (void)
+{
+	return srv_path ? 1 : 0;
+}
+/*}}}*/
+/*{{{  void server_decline (void)*/
+/*
+ *	called while compiling a request that this server cannot handle (see nocc_runserver()): the client
+ *	is told to compile it itself.  does not return.
+ */
+void server_decline (void)
+{
+	fflush (NULL);
+	_exit (SERVER_EXITDECLINE);
+}
+/*}}}*/
+/*{{{  int server_run (int *argcp, char ***argvp)*/
+/*
+ *	runs the compile server, called once the compiler has been initialised.  waits for requests until
+ *	terminated (SIGTERM or SIGINT); each request is compiled in a child process, which returns from here
+ *	with the client's arguments.
+ *	returns 0 in a child compiling a request, 1 when the server has finished, -1 on error
+ */
+int server_run (int *argcp, char ***argvp)
+{
+#ifdef USE_COMPILESERVER
+	struct sockaddr_un sun;
+	int r;
+
+	if (server_sockaddr (srv_path, &sun)) {
+		nocc_error ("compile server socket path too long [%s]", srv_path);
+		return -1;
+	}
+	srv_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (srv_fd < 0) {
+		nocc_error ("compile server: failed to create socket: %s", strerror (errno));
+		return -1;
+	}
+	r = bind (srv_fd, (struct sockaddr *)&sun, sizeof (sun));
+	if (r && (errno == EADDRINUSE)) {
+		/*{{{  left over from an earlier server, or one still running?*/
+		int tfd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+		if ((tfd >= 0) && !connect (tfd, (struct sockaddr *)&sun, sizeof (sun))) {
+			close (tfd);
+			close (srv_fd);
+			srv_fd = -1;
+			nocc_error ("a compile server is already running on %s", srv_path);
+			return -1;
+		}
+		if (tfd >= 0) {
+			close (tfd);
+		}
+		unlink (srv_path);
+		r = bind (srv_fd, (struct sockaddr *)&sun, sizeof (sun));
+		/*}}}*/
+	}
+	if (r || listen (srv_fd, SOMAXCONN)) {
+		nocc_error ("compile server: failed to listen on %s: %s", srv_path, strerror (errno));
+		close (srv_fd);
+		srv_fd = -1;
+		return -1;
+	}
+
+	srv_stop = 0;
+	server_setsignals (server_sighandler, SIG_IGN);	/* request handlers are reaped automatically */
+	if (compopts.verbose) {
+		nocc_message ("compile server listening on %s", srv_path);
+	}
+
+	while (!srv_stop) {
+		int cfd = accept (srv_fd, NULL, NULL);
+		pid_t pid;
+
+		if (cfd < 0) {
+			if ((errno == EINTR) || (errno == ECONNABORTED)) {
+				continue;		/* while() */
+			}
+			nocc_error ("compile server: accept failed: %s", strerror (errno));
+			break;				/* while() */
+		}
+
+		srv_requests++;
+		fflush (NULL);
+		pid = fork ();
+		if (!pid) {
+			close (srv_fd);
+			srv_fd = -1;
+			return server_request (cfd, argcp, argvp);
+		} else if (pid < 0) {
+			nocc_warning ("compile server: failed to fork for request: %s", strerror (errno));
+		}
+		close (cfd);
+	}
+
+	close (srv_fd);
+	srv_fd = -1;
+	unlink (srv_path);
+	server_setsignals (SIG_DFL, SIG_DFL);
+
+	if (compopts.verbose) {
+		nocc_message ("compile server finished after %d request%s", srv_requests, (srv_requests == 1) ? "" : "s");
+	}
+	return 1;
+#else	/* !USE_COMPILESERVER */
+	nocc_error ("compiled without compile server support");
+	return -1;
+#endif	/* !USE_COMPILESERVER */
+}
+/*}}}*/
+
+
+/*{{{  static int server_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	option handler for compile server options
+ *	returns 0 on success, non-zero on failure
+ */
+static int server_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	char *ch;
+
+	switch ((int)((uint64_t)opt->arg)) {
+	case 1:
+		/*{{{  --server <socket>*/
+		ch = strchr (**argwalk, '=');
+		if (ch) {
+			ch++;
+		} else {
+			(*argwalk)++;
+			(*argleft)--;
+			if (!**argwalk || !*argleft) {
+				nocc_error ("missing argument for option %s", (*argwalk)[-1]);
+				(*argwalk)--, (*argleft)++;
+				return -1;
+			}
+			ch = **argwalk;
+		}
+#ifndef USE_COMPILESERVER
+		nocc_error ("compiled without compile server support");
+		return -1;
+#endif
+		if (srv_path) {
+			sfree (srv_path);
+		}
+		srv_path = string_dup (ch);
+		break;
+		/*}}}*/
+	default:
+		nocc_error ("server_opthandler(): unknown option [%s]", **argwalk);
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  int server_init (void)*/
+/*
+ *	initialises the compile server (just registers options)
+ *	returns 0 on success, non-zero on failure
+ */
+int server_init (void)
+{
+	opts_add ("server", '\0', server_opthandler, (void *)1, "1run as a compile server on a Unix-domain socket (compile with NOCC_SERVER set to use it)");
+
+	return 0;
+}
+/*}}}*/
+/*{{{  int server_shutdown (void)*/
+/*
+ *	shuts-down the compile server
+ *	returns 0 on success, non-zero on failure
+ */
+int server_shutdown (void)
+{
+	if (srv_path) {
+		sfree (srv_path);
+		srv_path = NULL;
+	}
+	return 0;
+}
+/*}}}*/
+
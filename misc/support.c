@@ -26,6 +26,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <limits.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -53,29 +54,41 @@
 
 /*
  *	NOTE: valgrind (for debugging memory) much prefers the sys-allocator.. :)
- *	but for performance, use the slab-allocator.
+ *	but for performance, use the slab-allocator.  setting NOCC_SYSALLOC in the
+ *	environment also gets the sys-allocator at run-time.  setting NOCC_POISONMEM fills
+ *	memory from smalloc_nz() with a pattern, to catch reads of it before it is set.
  */
 
+#define SLAB_ALLOCATOR
+#undef SYS_ALLOCATOR
+
+#if defined (SLAB_ALLOCATOR) && (!defined (HAVE_SYS_MMAN_H) || !defined (MAP_ANONYMOUS))
 #undef SLAB_ALLOCATOR
 #define SYS_ALLOCATOR
+#endif
+
 
 
 /*}}}*/
 /*{{{  memory pools*/
 /*
  *	this uses a Brinch-Hansen style half-power-of-two, address mapped allocator..
+ *	slabs are carved out of one large address-space reservation, so the pool (size-class)
+ *	of any block is found from its address without a header.  each pool has a free-list,
+ *	and new blocks are carved from the pool's current slab when that is empty.
  */
 
 #define POOL_COUNTERS
 
-#define FIRST_POOL 4
-#define N_POOLS 23
+#define FIRST_POOL_SHIFT 4		/* smallest blocks are 16 bytes */
+#define N_POOLS 17			/* 16, 24, 32, 48, 64, ... 4096 bytes */
 
 #if defined (SLAB_ALLOCATOR)
-#define MAX_SLAB_SIZE 65536
-#define MAX_SLAB_SHIFT 16
-#define SLAB_SHIFT 18
-#define CHUNK_SIZE (32 << SLAB_SHIFT)
+#define MAX_SLAB_SIZE 4096		/* larger than this comes from malloc() */
+#define SLAB_SHIFT 16
+#define SLAB_SIZE (1 << SLAB_SHIFT)
+#define CHUNK_SIZE (16 << SLAB_SHIFT)	/* address space is made usable a chunk at a time */
+#define POOL_RESERVE ((size_t)1 << 36)	/* address space reserved (not committed) for slabs */
 #endif	/* defined (SLAB_ALLOCATOR) */
 
 #ifdef POOL_COUNTERS
@@ -96,171 +109,107 @@ static uint64_t dmempools[N_POOLS];
 
 #endif	/* !POOL_COUNTERS */
 
-#define SlotToSize(N)	((2 << ((((N) + FIRST_POOL) >> 1) + 2)) + (((N) & 1) ? (2 << ((((N) + FIRST_POOL) >> 1) + 1)) : 0))
-#define SizeToSlot(X)	((((X) <= 32) ? 4 : (((bsr((X) - 1) - 2) << 1)) - (((X) < (3 << (bsr((X) - 1) - 1))) ? 1 : 0)) - FIRST_POOL)
+#define SlotToSize(N)	(((N) & 1) ? (3 << (((N) >> 1) + FIRST_POOL_SHIFT - 1)) : (1 << (((N) >> 1) + FIRST_POOL_SHIFT)))
 
 #if defined (SLAB_ALLOCATOR)
-static int pooladdrmap[32] = {
-	0, 1, 2, 3, 4, 5, 6, 7,
-	8, 9, 10, 11, 12, 13, 14, 15,
-	8, 8, 10, 10, 16, 17, 18, 19,
-	20, 20, 21, 21, 21, 22, 22, 22
-};
+static char *pool_baseaddr = NULL;	/* NULL if the pool is not in use */
+static char *pool_limit = NULL;
+static char *pool_nextslab = NULL;	/* next unused slab */
+static char *pool_nextchunkaddr = NULL;	/* end of the usable (read/write) part */
 
-/* things in the spareslabs are mapped, but not touched */
-static void **spareslabs[N_POOLS];
+static unsigned char *pool_slabslot = NULL;	/* pool of each slab, indexed by (addr - pool_baseaddr) >> SLAB_SHIFT */
+static char *pool_carve[N_POOLS];		/* part-used slab for each pool */
+static char *pool_carvelimit[N_POOLS];
 
-#define SlotOfAddr(A) pooladdrmap[(((unsigned int)(A)) >> SLAB_SHIFT) & 0x1f]
+#define SlotOfAddr(A) ((int)pool_slabslot[((char *)(A) - pool_baseaddr) >> SLAB_SHIFT])
 #define SizeOfAddr(A) SlotToSize(SlotOfAddr(A))
+#define InPool(A) (((char *)(A) >= pool_baseaddr) && ((char *)(A) < pool_limit))
 
-/* the pool can go up to 1 gig.. */
-static void *pool_baseaddr = (void *)0x80000000;
-static void *pool_limit = (void *)0xc0000000;
-
-static void *pool_nextchunkaddr;
-static int pool_mapfd = -1;		/* descriptor for /dev/zero */
+static int pool_nslabs = 0;
 
 #endif	/* defined (SLAB_ALLOCATOR) */
 
-static int pool_totalloc = 0;
 static void *zero_block;		/* return this for 0 sized allocations */
+
+#define POOL_POISON 0xa5		/* fills uninitialised allocations when poisoning */
+static int pool_poison = 0;		/* set from NOCC_POISONMEM in the environment */
 /*}}}*/
 
 
-#if defined (SLAB_ALLOCATOR)
-/*{{{  static void *chunk_getnextchunk (int fd)*/
+/*{{{  static inline int SizeToSlot (int bytes)*/
 /*
- *	allocates another chunk for the pool allocator
+ *	returns the pool that holds blocks of 'bytes' (which may be larger than the biggest pool)
  */
-static void *chunk_getnextchunk (int fd)
+static inline int SizeToSlot (int bytes)
 {
-	void *addr;
-
-	if (pool_nextchunkaddr >= pool_limit) {
-		nocc_fatal ("out of memory in chunk_getnextchunk()");
-		exit (EXIT_FAILURE);
-	}
-
-	addr = mmap (pool_nextchunkaddr, CHUNK_SIZE, PROT_READ | PROT_WRITE,
-			MAP_PRIVATE | MAP_ANONYMOUS, fd, 0);
+	int b;
 
-	if (addr == ((void *)-1)) {
-		nocc_fatal ("failed to map chunk: %s", strerror (errno));
-		exit (EXIT_FAILURE);
-	} else if (addr != pool_nextchunkaddr) {
-		nocc_fatal ("memory mapped in the wrong place! at: %8.8x\n", (unsigned int)addr);
-		exit (EXIT_FAILURE);
+	if (bytes <= (1 << FIRST_POOL_SHIFT)) {
+		return 0;
 	}
-
-	/* we've got a chunk.. */
-	pool_nextchunkaddr += CHUNK_SIZE;
-
-	return addr;
+	b = bsr (bytes - 1);		/* 2^b < bytes <= 2^(b+1) */
+	return ((b - FIRST_POOL_SHIFT) << 1) + ((bytes <= (3 << (b - 1))) ? 1 : 2);
 }
 /*}}}*/
-/*{{{  static void slab_addspare (int p, void *slab)*/
+#if defined (SLAB_ALLOCATOR)
+/*{{{  static int pool_newslab (int p)*/
 /*
- *	adds a spare slab to the spare-slabs list
+ *	starts a fresh slab for the specified pool
+ *	returns 0 on success, non-zero if the reservation is used up
  */
-static void slab_addspare (int p, void *slab)
+static int pool_newslab (int p)
 {
-	int mspares = (SizeOfAddr (spareslabs[p]) >> 2);
-	int nspares = (int)(spareslabs[p][0]);
-
-	if (nspares == mspares - 1) {
-		/* need to reallocate the list of spare slabs */
-		void **newspare = (void **)dmem_new (SizeToSlot (mspares << 3));
-		int j;
-
-		memcpy (newspare, spareslabs[p], mspares << 2);
-		dmem_release (spareslabs[p]);
-		spareslabs[p] = newspare;
-		mspares <<= 1;
-		for (j=nspares+1; j<mspares; j++) {
-			spareslabs[p][j] = NULL;
+	if (pool_nextslab >= pool_limit) {
+		return -1;
+	}
+	if (pool_nextslab >= pool_nextchunkaddr) {
+		/* make another chunk of the reservation usable */
+		if (mprotect (pool_nextchunkaddr, CHUNK_SIZE, PROT_READ | PROT_WRITE)) {
+			return -1;
 		}
+		pool_nextchunkaddr += CHUNK_SIZE;
 	}
-	spareslabs[p][nspares + 1] = slab;
-	spareslabs[p][0] = (void *)(nspares + 1);
-
-	return;
-}
-/*}}}*/
-/*{{{  static void *slab_getspare (int p)*/
-/*
- *	grabs a spare slab for the specified pool
- */
-static void *slab_getspare (int p)
-{
-	/* int mspares = (SizeOfAddr (spareslabs[p]) >> 2); */
-	int nspares = (int)(spareslabs[p][0]);
-	void *slab;
-
-	if (!nspares) {
-		/* need a new chunk */
-		void *addr = chunk_getnextchunk (pool_mapfd);
-		int i;
-
-#ifdef DEBUG
-		nocc_message ("DEBUG: slab_getspare(%d) got %d bytes at 0x%8.8x -> 0x%8.8x.\n", p, CHUNK_SIZE, (unsigned int)addr, (unsigned int)(addr + CHUNK_SIZE - 1));
-#endif
 
-		for (i=0; i<32; i++) {
-			int slotnum = SlotOfAddr (i << SLAB_SHIFT);
-			int slotsize = SlotToSize (slotnum);
-			void *qaddr = addr + (i << SLAB_SHIFT);
-			void *qlim = addr + ((i + 1) << SLAB_SHIFT) - (slotsize - 7);
+	pool_slabslot[(pool_nextslab - pool_baseaddr) >> SLAB_SHIFT] = (unsigned char)p;
+	pool_carve[p] = pool_nextslab;
+	pool_carvelimit[p] = pool_nextslab + ((SLAB_SIZE / SlotToSize (p)) * SlotToSize (p));
+	pool_nextslab += SLAB_SIZE;
+	pool_nslabs++;
 
-			for (; qaddr < qlim; qaddr += MAX_SLAB_SIZE) {
-				slab_addspare (slotnum, qaddr);
-			}
-		}
-		nspares = (int)(spareslabs[p][0]);
-	}
-	slab = spareslabs[p][nspares];
-	spareslabs[p][0] = (void *)(nspares - 1);
+#ifdef POOL_COUNTERS
+	DMCountSlot (p) = DMCountSlot (p) + (SLAB_SIZE / SlotToSize (p));
+#endif	/* POOL_COUNTERS */
 
-	return slab;
+	return 0;
 }
 /*}}}*/
-/*{{{  static void pool_smashslab (int p, void *slab)*/
+/*{{{  static void *pool_get (int p, int *fresh)*/
 /*
- *	breaks a fresh slab up and places on free-lists
+ *	takes a block for the specified pool from its free-list, else carves a new one from its slab.
+ *	sets *fresh if the block has never been used (so is still zero from the mapping).
+ *	returns NULL if the reservation is used up
  */
-static void pool_smashslab (int p, void *slab)
+static void *pool_get (int p, int *fresh)
 {
-	void *qaddr, *qlim;
-	int slotsize = SlotToSize (p);
-	int nblocks;
-
-	qaddr = slab;
-	qlim = qaddr + (MAX_SLAB_SIZE - (slotsize - 7));
-
-	for (nblocks = 0; qaddr < qlim; qaddr += slotsize, nblocks++) {
-		unsigned int *tblk = (unsigned int *)qaddr;
-
-		tblk[0] = (unsigned int)(qaddr + slotsize);
-		tblk[1] = (unsigned int)0xdeadbeef;
-	}
-
-	/* fixup last block addr */
-	if (!DMAddrSlot (p)) {
-		((unsigned int *)(qaddr - slotsize))[0] = (unsigned int)NULL;
-		((unsigned int *)(qaddr - slotsize))[1] = (unsigned int)0xfeedbeef;
-	} else {
-		((unsigned int *)(qaddr - slotsize))[0] = DMAddrSlot (p);
-		((unsigned int *)(qaddr - slotsize))[1] = (unsigned int)0xdeadbeef;
-	}
-
-	/* put this slab on the block list */
-	DMAddrSlot (p) = (unsigned int)slab;
+	void *blk;
 
+	if (DMAddrSlot (p)) {
+		blk = (void *)(uintptr_t)DMAddrSlot (p);
+		DMAddrSlot (p) = (uint64_t)(uintptr_t)(*(void **)blk);
 #ifdef POOL_COUNTERS
-	DMCountSlot (p) = DMCountSlot (p) + nblocks;
-	DMAvailSlot (p) = DMAvailSlot (p) + nblocks;
+		DMAvailSlot (p) = DMAvailSlot (p) - 1;
 #endif	/* POOL_COUNTERS */
+		*fresh = 0;
+		return blk;
+	}
+	if ((pool_carve[p] >= pool_carvelimit[p]) && pool_newslab (p)) {
+		return NULL;
+	}
+	blk = (void *)pool_carve[p];
+	pool_carve[p] += SlotToSize (p);
+	*fresh = 1;
 
-	return;
+	return blk;
 }
 /*}}}*/
 #endif	/* defined (SLAB_ALLOCATOR) */
@@ -272,47 +221,38 @@ static void pool_smashslab (int p, void *slab)
 void *dmem_new (int p)
 {
 	void *thisblk = NULL;
-	void *nextblk;
+#if defined (SLAB_ALLOCATOR)
+	int fresh;
+#endif
 
 	if ((p < 0) || (p >= N_POOLS)) {
 		return NULL;
 	}
-	if (!DMAddrSlot (p)) {
 #if defined (SLAB_ALLOCATOR)
-		/* need some more for this slot */
-		void *slab = slab_getspare (p);
-
-		pool_smashslab (p, slab);
-#elif defined (SYS_ALLOCATOR)
+	if (!pool_baseaddr) {
 		thisblk = malloc (SlotToSize (p));
 		if (!thisblk) {
 			nocc_fatal ("dmem_new(): unable to allocate %d bytes (system)\n", SlotToSize (p));
 			exit (EXIT_FAILURE);
 		}
-		DMAddrSlot (p) = (uint64_t)thisblk;
-		*(void **)thisblk = NULL;
-		((uint64_t *)thisblk)[1] = 0xdeadbeef;
-#ifdef POOL_COUNTERS
-		DMAvailSlot (p) = DMAvailSlot (p) + 1;
-#endif	/* POOL_COUNTERS */
-#endif	/* !defined (SLAB_ALLOCATOR) && defined (SYS_ALLOCATOR) */
+		return thisblk;
 	}
-
-	thisblk = (void *)(DMAddrSlot (p));
-	nextblk = *(void **)thisblk;
-
-	DMAddrSlot (p) = (uint64_t)nextblk;
-
-	if (nextblk && ((uint64_t *)thisblk)[1] != 0xdeadbeef) {
-		nocc_fatal ("dmem_new(): bad block magic %p for block at %p in pool %d", ((uint64_t **)thisblk)[1], thisblk, p);
+	thisblk = pool_get (p, &fresh);
+	if (!thisblk) {
+		/* reservation used up, carry on with malloc() */
+		thisblk = malloc (SlotToSize (p));
+		if (!thisblk) {
+			nocc_fatal ("dmem_new(): unable to allocate %d bytes (system)\n", SlotToSize (p));
+			exit (EXIT_FAILURE);
+		}
+	}
+#elif defined (SYS_ALLOCATOR)
+	thisblk = malloc (SlotToSize (p));
+	if (!thisblk) {
+		nocc_fatal ("dmem_new(): unable to allocate %d bytes (system)\n", SlotToSize (p));
 		exit (EXIT_FAILURE);
 	}
-
-#ifdef POOL_COUNTERS
-	DMAvailSlot (p) = DMAvailSlot (p) - 1;
-#endif	/* POOL_COUNTERS */
-
-	pool_totalloc++;
+#endif	/* !defined (SLAB_ALLOCATOR) && defined (SYS_ALLOCATOR) */
 
 	return thisblk;
 }
@@ -326,7 +266,7 @@ void *dmem_alloc (int bytes)
 	void *ptr;
 
 #if defined (SLAB_ALLOCATOR)
-	if (bytes > MAX_SLAB_SIZE) {
+	if ((bytes > MAX_SLAB_SIZE) || !pool_baseaddr) {
 		ptr = malloc (bytes);
 		if (!ptr) {
 			nocc_internal ("dmem_alloc(): out of memory! (wanted %d bytes)", bytes);
@@ -345,6 +285,36 @@ void *dmem_alloc (int bytes)
 	return ptr;	
 }
 /*}}}*/
+/*{{{  void *dmem_zalloc (int bytes)*/
+/*
+ *	allocates a specified amount of zeroed memory, only clearing it if it has been used before
+ */
+void *dmem_zalloc (int bytes)
+{
+	void *ptr;
+
+#if defined (SLAB_ALLOCATOR)
+	if ((bytes <= MAX_SLAB_SIZE) && pool_baseaddr) {
+		int fresh;
+
+		ptr = pool_get (SizeToSlot (bytes), &fresh);
+		if (ptr) {
+			if (!fresh) {
+				memset (ptr, 0, bytes);
+			}
+			return ptr;
+		}
+	}
+#endif	/* defined (SLAB_ALLOCATOR) */
+	/* calloc() can hand out fresh pages without touching them */
+	ptr = calloc (1, bytes);
+	if (!ptr) {
+		nocc_internal ("dmem_zalloc(): out of memory! (wanted %d bytes)", bytes);
+		exit (EXIT_FAILURE);
+	}
+	return ptr;
+}
+/*}}}*/
 /*{{{  void *dmem_realloc (void *ptr, int obytes, int nbytes)*/
 /*
  *	reallocates a block of memory
@@ -357,11 +327,11 @@ void *dmem_realloc (void *ptr, int obytes, int nbytes)
 	if ((obytes > MAX_SLAB_SIZE) || (nbytes > MAX_SLAB_SIZE)) {
 		nocc_internal ("dmem_realloc(): will not reallocate outside the pool (%d -> %d)", obytes, nbytes);
 	}
-	if (SizeToSlot (obytes) == SizeToSlot (nbytes)) {
+	if (InPool (ptr) && (SlotOfAddr (ptr) == SizeToSlot (nbytes))) {
 		/* same pool, easy :) */
 		nptr = ptr;
 	} else {
-		nptr = dmem_new (SizeToSlot (nbytes));
+		nptr = dmem_alloc (nbytes);
 		/* copy data */
 		memcpy (nptr, ptr, (nbytes < obytes) ? nbytes : obytes);
 		dmem_release (ptr);
@@ -373,9 +343,6 @@ void *dmem_realloc (void *ptr, int obytes, int nbytes)
 	dmem_release (ptr);
 #endif	/* !defined (SLAB_ALLOCATOR) && defined (SYS_ALLOCATOR) */
 
-#if 0
-fprintf (stderr, "dmem_realloc (0x%8.8x, %d) -> (0x%8.8x, %d)\n", (unsigned int)ptr, obytes, (unsigned int)nptr, nbytes);
-#endif
 	return nptr;
 }
 /*}}}*/
@@ -388,16 +355,15 @@ void dmem_release (void *ptr)
 #if defined (SLAB_ALLOCATOR)
 	int slot;
 
-	if ((ptr < (void *)pool_baseaddr) || (ptr >= (void *)pool_nextchunkaddr)) {
+	if (!InPool (ptr)) {
 		/* not memory from the pool allocator */
 		free (ptr);
 		return;
 	}
 	slot = SlotOfAddr (ptr);
 
-	((unsigned int *)ptr)[0] = DMAddrSlot (slot);
-	((unsigned int *)ptr)[1] = 0xdeadbeef;
-	DMAddrSlot (slot) = (unsigned int)ptr;
+	*(void **)ptr = (void *)(uintptr_t)DMAddrSlot (slot);
+	DMAddrSlot (slot) = (uint64_t)(uintptr_t)ptr;
 #ifdef POOL_COUNTERS
 	DMAvailSlot (slot) = DMAvailSlot (slot) + 1;
 #endif	/* POOL_COUNTERS */
@@ -408,6 +374,40 @@ void dmem_release (void *ptr)
 	return;
 }
 /*}}}*/
+/*{{{  int dmem_slot_to_size (int idx)*/
+/*
+ *	returns the block size of the specified pool
+ */
+int dmem_slot_to_size (int idx)
+{
+	return SlotToSize (idx);
+}
+/*}}}*/
+/*{{{  int dmem_size_to_slot (int bytes)*/
+/*
+ *	returns the pool for blocks of 'bytes', or -1 if too large for any
+ */
+int dmem_size_to_slot (int bytes)
+{
+	int slot = SizeToSlot (bytes);
+
+	return (slot < N_POOLS) ? slot : -1;
+}
+/*}}}*/
+/*{{{  int dmem_size_of_addr (void *ptr)*/
+/*
+ *	returns the block size of a pool allocated block, or -1 if not from the pool
+ */
+int dmem_size_of_addr (void *ptr)
+{
+#if defined (SLAB_ALLOCATOR)
+	if (InPool (ptr)) {
+		return SizeOfAddr (ptr);
+	}
+#endif	/* defined (SLAB_ALLOCATOR) */
+	return -1;
+}
+/*}}}*/
 /*{{{  void dmem_usagedump (void)*/
 /*
  *	shows a dump of the pool allocator
@@ -415,30 +415,22 @@ void dmem_release (void *ptr)
 void dmem_usagedump (void)
 {
 #if defined (SLAB_ALLOCATOR)
-	fprintf (stderr, "memory pool at 0x%8.8x -> 0x%8.8x (%d bytes, >= %d M), limit 0x%8.8x\n", (unsigned int)pool_baseaddr, (unsigned int)pool_nextchunkaddr - 1, ((unsigned int)pool_nextchunkaddr - (unsigned int)pool_baseaddr), ((unsigned int)pool_nextchunkaddr - (unsigned int)pool_baseaddr) >> 20, (unsigned int)pool_limit);
+	if (!pool_baseaddr) {
+		fprintf (stderr, "memory pool not in use (system allocator)\n");
+		return;
+	}
+	fprintf (stderr, "memory pool at %p -> %p (%lu bytes, >= %lu M), limit %p\n", pool_baseaddr, pool_nextslab - 1,
+			(unsigned long)(pool_nextslab - pool_baseaddr), (unsigned long)(pool_nextslab - pool_baseaddr) >> 20, pool_limit);
+	fprintf (stderr, "pool contents (%d slabs):\n", pool_nslabs);
+#else
+	fprintf (stderr, "pool contents:\n");
 #endif
-	fprintf (stderr, "pool contents (%d allocations):\n", pool_totalloc);
 	{
 		int i;
-#ifdef SHOW_SPARESLABS
-		int j, nspares;
-#endif
 
 		for (i=0; i<N_POOLS; i++) {
-			fprintf (stderr, "\t%d\t%-10lu\t%-18p\t%lu\t%lu\t", i, DMSizeSlot(i),
-					(void *)(DMAddrSlot (i)), DMAvailSlot(i), DMCountSlot(i));
-#if defined (SHOW_SPARESLABS) && defined (SLAB_ALLOCATOR)
-			fprintf (stderr, "[");
-			nspares = (int)(spareslabs[i][0]);
-			for (j=0; j < nspares; j++) {
-				fprintf (stderr, "%s0x%4.4x", ((!j) ? "" : ", "), (unsigned int)(spareslabs[i][j+1]) >> MAX_SLAB_SHIFT);
-			}
-			fprintf (stderr, "]\n");
-#elif defined (SLAB_ALLOCATOR)
-			fprintf (stderr, "%d\n", (int)(spareslabs[i][0]));
-#else
-			fprintf (stderr, "\n");
-#endif
+			fprintf (stderr, "\t%d\t%-10lu\t%-18p\t%lu\t%lu\n", i, (unsigned long)DMSizeSlot(i),
+					(void *)(uintptr_t)(DMAddrSlot (i)), (unsigned long)DMAvailSlot(i), (unsigned long)DMCountSlot(i));
 		}
 	}
 
@@ -452,99 +444,62 @@ void dmem_usagedump (void)
 void dmem_init (void)
 {
 	int i;
-#if defined (SLAB_ALLOCATOR)
-	void *qaddr, *qlim;
-	void *addr;
-	char *envstr;
-#endif
 
 	zero_block = (void *)&zero_block;
-#if defined (SLAB_ALLOCATOR)
-	/* environment might have a base-address set */
-	envstr = getenv ("NOCC_POOLBASE");
-	if (envstr) {
-		if (!strncmp (envstr, "0x", 2)) {
-			if (sscanf (envstr + 2, "%x", (unsigned int *)&pool_baseaddr) != 1) {
-				nocc_warning ("dmem_init(): mangled NOCC_POOLBASE environment ?: %s", envstr);
-				pool_baseaddr = (void *)0x80000000;
-			}
-			pool_limit = pool_baseaddr + 0x40000000;
-		}
-	}
-	envstr = getenv ("NOCC_POOLLIMIT");
-	if (envstr) {
-		if (!strncmp (envstr, "0x", 2)) {
-			if (sscanf (envstr + 2, "%x", (unsigned int *)&pool_limit) != 1) {
-				nocc_warning ("dmem_init(): mangled NOCC_POOLLIMIT environment ?: %s", envstr);
-				pool_limit = pool_baseaddr + 0x40000000;
-			}
-		}
-	}
-	if (pool_baseaddr >= pool_limit) {
-		nocc_fatal ("dmem_init(): memory pool base >= limit! (0x%8.8x, 0x%8.8x)", (unsigned int)pool_baseaddr, (unsigned int)pool_limit);
-		exit (EXIT_FAILURE);
-	}
-
-	pool_nextchunkaddr = pool_baseaddr;
-
-	pool_mapfd = open ("/dev/zero", O_RDWR);
-	if (pool_mapfd < 0) {
-		nocc_fatal ("dmem_init(): failed to open /dev/zero: %s", strerror (errno));
-		exit (1);
-	}
-
-#ifdef DEBUG
-	nocc_message ("DEBUG: dmem_init() allocating %d bytes at 0x%8.8x  (break at 0x%8.8x)", CHUNK_SIZE, pool_baseaddr, (unsigned int)sbrk (0));
-#endif
-	addr = chunk_getnextchunk (pool_mapfd);
-
-#ifdef DEBUG
-	nocc_message ("DEBUG: dmem_init() got %d bytes at 0x%8.8x -> 0x%8.8x", CHUNK_SIZE, (unsigned int)addr, (unsigned int)(addr + CHUNK_SIZE - 1));
-	nocc_message ("initialising pool allocator..");
-#endif
-#endif	/* defined (SLAB_ALLOCATOR) */
 
 	for (i=0; i<N_POOLS; i++) {
-		DMAddrSlot(i) = (uint64_t)NULL;
+		DMAddrSlot(i) = (uint64_t)0;
 #ifdef POOL_COUNTERS
 		DMSizeSlot(i) = SlotToSize (i);
 		DMAvailSlot(i) = 0;
 		DMCountSlot(i) = 0;
 #endif	/* POOL_COUNTERS */
 #if defined (SLAB_ALLOCATOR)
-		spareslabs[i] = NULL;
+		pool_carve[i] = NULL;
+		pool_carvelimit[i] = NULL;
 #endif	/* defined (SLAB_ALLOCATOR) */
 	}
+	pool_poison = (getenv ("NOCC_POISONMEM") != NULL);
 
 #if defined (SLAB_ALLOCATOR)
-	for (i=0; i<32; i++) {
-		int slotnum = SlotOfAddr (i << SLAB_SHIFT);
-		int slotsize = SlotToSize (slotnum);
-		int j;
-
-		/* pick up a single slab first, then queue the others on the spare slab-list */
-		qaddr = addr + (i << SLAB_SHIFT);
-		qlim = qaddr + (MAX_SLAB_SIZE - (slotsize - 7));
-
-		pool_smashslab (slotnum, qaddr);
-
-		/* if this is the first round, setup spareslabs */
-		if (!i) {
-			for (j=0; j<N_POOLS; j++) {
-				int k;
-
-				spareslabs[j] = (void **)dmem_new (0);
-				for (k=0; k<8; k++) {
-					spareslabs[j][k] = NULL;
-				}
+	if (getenv ("NOCC_SYSALLOC")) {
+		return;
+	}
+	{
+		void *addr;
+		size_t resv = POOL_RESERVE;
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_NORESERVE
+		flags |= MAP_NORESERVE;
+#endif
+		/* reserve address space (not memory), slab-aligned, halving the request if refused */
+		for (addr = MAP_FAILED; (addr == MAP_FAILED) && (resv >= (CHUNK_SIZE << 4)); ) {
+			addr = mmap (NULL, resv + SLAB_SIZE, PROT_NONE, flags, -1, 0);
+			if (addr == MAP_FAILED) {
+				resv >>= 1;
 			}
 		}
-
-		/* add remaining slabs to spare slabs list */
-		qaddr = addr + ((i << SLAB_SHIFT) + MAX_SLAB_SIZE);
-		qlim = addr + (((i + 1) << SLAB_SHIFT) - (slotsize - 7));
-		for (; qaddr < qlim; qaddr += MAX_SLAB_SIZE) {
-			slab_addspare (slotnum, qaddr);
+		if (addr == MAP_FAILED) {
+			nocc_warning ("dmem_init(): failed to reserve memory pool, using system allocator: %s", strerror (errno));
+			return;
+		}
+		pool_slabslot = (unsigned char *)calloc (resv >> SLAB_SHIFT, sizeof (unsigned char));
+		if (!pool_slabslot) {
+			munmap (addr, resv + SLAB_SIZE);
+			return;
+		}
+		pool_baseaddr = (char *)(((uintptr_t)addr + (SLAB_SIZE - 1)) & ~(uintptr_t)(SLAB_SIZE - 1));
+		pool_limit = pool_baseaddr + resv;
+		pool_nextslab = pool_baseaddr;
+		pool_nextchunkaddr = pool_baseaddr;
+
+		/* give back the unaligned ends */
+		if ((char *)addr < pool_baseaddr) {
+			munmap (addr, pool_baseaddr - (char *)addr);
+		}
+		if (pool_limit < (char *)addr + resv + SLAB_SIZE) {
+			munmap (pool_limit, ((char *)addr + resv + SLAB_SIZE) - pool_limit);
 		}
 	}
 #endif	/* defined (SLAB_ALLOCATOR) */
@@ -554,37 +509,11 @@ void dmem_init (void)
 /*}}}*/
 /*{{{  void dmem_shutdown (void)*/
 /*
- *	shuts down the pool allocator
+ *	shuts down the pool allocator.  the pool's memory is left mapped, anything still
+ *	holding pool blocks (late sfree()s) stays safe
  */
 void dmem_shutdown (void)
 {
-#if defined (SLAB_ALLOCATOR)
-	void *qaddr;
-#endif	/* defined (SLAB_ALLOCATOR) */
-	int i;
-
-#if defined (SLAB_ALLOCATOR)
-	if (pool_mapfd < 0) {
-		nocc_internal ("dmem_shutdown() already shut-down ?");
-	}
-	for (qaddr = (void *)pool_baseaddr; qaddr < pool_nextchunkaddr; qaddr += CHUNK_SIZE) {
-		munmap (qaddr, CHUNK_SIZE);
-	}
-	close (pool_mapfd);
-	pool_mapfd = -1;
-#endif	/* defined (SLAB_ALLOCATOR) */
-
-	for (i=0; i<N_POOLS; i++) {
-		DMAddrSlot(i) = (uint64_t)NULL;
-#ifdef POOL_COUNTERS
-		DMSizeSlot(i) = SlotToSize (i);
-		DMAvailSlot(i) = 0;
-		DMCountSlot(i) = 0;
-#endif	/* POOL_COUNTERS */
-#if defined (SLAB_ALLOCATOR)
-		spareslabs[i] = NULL;
-#endif	/* defined (SLAB_ALLOCATOR) */
-	}
 	return;
 }
 /*}}}*/
@@ -598,7 +527,7 @@ void dmem_shutdown (void)
 typedef struct TAG_ss_memblock {
 	struct TAG_ss_memblock *next, *prev;
 	void *ptr;
-	unsigned int vptr;
+	uintptr_t vptr;
 	size_t size;
 	int line;
 	char file[SS_FILE_SIZE];
@@ -626,7 +555,7 @@ void ss_cleanup (void)
 	fprintf (stderr, "%d blocks copied for re-allocation\n", ss_numhardrealloc);
 	fprintf (stderr, "left-over memory blocks:\n");
 	for (tmpblk = ss_head; tmpblk; tmpblk = tmpblk->next) {
-		fprintf (stderr, "0x%-8x  %-8d  %s:%d\n", tmpblk->vptr, tmpblk->size, tmpblk->file, tmpblk->line);
+		fprintf (stderr, "%-18p  %-8lu  %s:%d\n", tmpblk->ptr, (unsigned long)tmpblk->size, tmpblk->file, tmpblk->line);
 	}
 	return;
 }
@@ -691,9 +620,59 @@ void ss_remove_blk (ss_memblock *blk)
 /*}}}*/
 #endif	/* TRACE_MEMORY */
 
+/* always-on allocation counters, cheap enough to leave in (see smem_counters()) */
+static unsigned long smem_nallocs = 0;
+static unsigned long smem_nreallocs = 0;
+static unsigned long smem_nfrees = 0;
+static unsigned long long smem_nbytes = 0;		/* bytes requested, including growth by srealloc() */
+
+/*{{{  void smem_counters (unsigned long *nallocs, unsigned long *nreallocs, unsigned long *nfrees, unsigned long long *nbytes)*/
+/*
+ *	returns the running allocation counters (any of which may be NULL).
+ *	sfree() does not know block sizes, so bytes are only counted on the allocation side.
+ */
+void smem_counters (unsigned long *nallocs, unsigned long *nreallocs, unsigned long *nfrees, unsigned long long *nbytes)
+{
+	if (nallocs) {
+		*nallocs = smem_nallocs;
+	}
+	if (nreallocs) {
+		*nreallocs = smem_nreallocs;
+	}
+	if (nfrees) {
+		*nfrees = smem_nfrees;
+	}
+	if (nbytes) {
+		*nbytes = smem_nbytes;
+	}
+	return;
+}
+/*}}}*/
+#ifdef TRACE_MEMORY
+/*{{{  static void ss_track (const char *file, const int line, void *ptr, size_t length)*/
+/*
+ *	records a new allocation for the memory trace
+ */
+static void ss_track (const char *file, const int line, void *ptr, size_t length)
+{
+	ss_memblock *tmpblk;
+
+	ss_numalloc++;
+	tmpblk = (ss_memblock *)dmem_alloc (sizeof (ss_memblock));
+	tmpblk->prev = tmpblk->next = NULL;
+	tmpblk->ptr = ptr;
+	tmpblk->vptr = (uintptr_t)ptr;
+	tmpblk->size = length;
+	strncpy (tmpblk->file, file, SS_FILE_SIZE);
+	tmpblk->line = line;
+	ss_insert_blk (tmpblk);
+	return;
+}
+/*}}}*/
+#endif	/* TRACE_MEMORY */
 /*{{{  void *smalloc (size_t length)*/
 /*
- *	allocates some memory
+ *	allocates some zeroed memory
  */
 #ifdef TRACE_MEMORY
 void *ss_malloc (const char *file, const int line, size_t length)
@@ -703,26 +682,60 @@ void *smalloc (size_t length)
 {
 	void *tmp;
 
+	smem_nallocs++;
+	smem_nbytes += length;
+	tmp = dmem_zalloc (length);
+#ifdef TRACE_MEMORY
+	ss_track (file, line, tmp, length);
+#endif
+	return tmp;
+}
+/*}}}*/
+/*{{{  void *smalloc_nz (size_t length)*/
+/*
+ *	allocates some memory without clearing it, for callers that set every field themselves
+ */
+#ifdef TRACE_MEMORY
+void *ss_malloc_nz (const char *file, const int line, size_t length)
+#else
+void *smalloc_nz (size_t length)
+#endif
+{
+	void *tmp;
+
+	smem_nallocs++;
+	smem_nbytes += length;
 	tmp = dmem_alloc (length);
-	memset (tmp, 0, length);
-	#ifdef TRACE_MEMORY
-	{
-		ss_memblock *tmpblk;
-
-		ss_numalloc++;
-		tmpblk = (ss_memblock *)dmem_alloc (sizeof (ss_memblock));
-		tmpblk->prev = tmpblk->next = NULL;
-		tmpblk->ptr = tmp;
-		tmpblk->vptr = (unsigned int)tmp;
-		tmpblk->size = length;
-		strncpy (tmpblk->file, file, SS_FILE_SIZE);
-		tmpblk->line = line;
-		ss_insert_blk (tmpblk);
-	}
-	#endif	/* TRACE_MEMORY */
+	if (pool_poison) {
+		memset (tmp, POOL_POISON, length);
+	}
+#ifdef TRACE_MEMORY
+	ss_track (file, line, tmp, length);
+#endif
 	return tmp;
 }
 /*}}}*/
+/*{{{  void *scalloc (size_t count, size_t size)*/
+/*
+ *	allocates zeroed memory for an array of 'count' items of 'size' bytes
+ */
+#ifdef TRACE_MEMORY
+void *ss_calloc (const char *file, const int line, size_t count, size_t size)
+#else
+void *scalloc (size_t count, size_t size)
+#endif
+{
+	if (size && (count > (INT_MAX / size))) {
+		nocc_internal ("scalloc(): allocation too large! (%lu items of %lu bytes)", (unsigned long)count, (unsigned long)size);
+		exit (EXIT_FAILURE);
+	}
+#ifdef TRACE_MEMORY
+	return ss_malloc (file, line, count * size);
+#else
+	return smalloc (count * size);
+#endif
+}
+/*}}}*/
 /*{{{  void *srealloc (void *ptr, size_t old_size, size_t new_size)*/
 /*
  *	re-allocates a memory block, moving it entirely if necessary
@@ -735,11 +748,15 @@ void *srealloc (void *ptr, size_t old_size, size_t new_size)
 {
 	void *tmp;
 
+	smem_nreallocs++;
+	if (new_size > old_size) {
+		smem_nbytes += (new_size - old_size);
+	}
 	if (!ptr || !old_size) {
 #ifdef TRACE_MEMORY
 		tmp = ss_malloc (file, line, new_size);
 #else
-		tmp = dmem_alloc (new_size);
+		tmp = dmem_zalloc (new_size);
 #endif
 	} else {
 #if defined (SLAB_ALLOCATOR)
@@ -756,13 +773,17 @@ void *srealloc (void *ptr, size_t old_size, size_t new_size)
 			}
 #endif
 			tmp = dmem_realloc (ptr, old_size, new_size);
+			if (new_size > old_size) {
+				/* pool blocks are reused, any growth within the block is not clean */
+				memset (tmp + old_size, 0, new_size - old_size);
+			}
 #ifdef TRACE_MEMORY
 			ss_numrealloc++;
 			if (!tmpblk) {
 				fprintf (stderr, "%s: serious: attempt to srealloc() non-allocated memory in %s:%d\n", progname, file, line);
 			} else {
 				tmpblk->ptr = tmp;
-				tmpblk->vptr = (unsigned int)tmp;
+				tmpblk->vptr = (uintptr_t)tmp;
 			}
 #endif
 		} else if (old_size <= MAX_SLAB_SIZE) {
@@ -774,7 +795,8 @@ void *srealloc (void *ptr, size_t old_size, size_t new_size)
 #else
 			tmp = dmem_alloc (new_size);
 			memcpy (tmp, ptr, old_size);
-			sfree (ptr);
+			memset (tmp + old_size, 0, new_size - old_size);
+			dmem_release (ptr);
 #endif
 		} else if (new_size <= MAX_SLAB_SIZE) {
 			/* malloc-pool reallocation (shrinking) */
@@ -785,7 +807,7 @@ void *srealloc (void *ptr, size_t old_size, size_t new_size)
 #else
 			tmp = dmem_alloc (new_size);
 			memcpy (tmp, ptr, new_size);
-			sfree (ptr);
+			dmem_release (ptr);
 #endif
 		} else
 #endif /* SLAB_ALLOCATOR */
@@ -824,7 +846,7 @@ void *srealloc (void *ptr, size_t old_size, size_t new_size)
 					fprintf (stderr, "%s: serious: attempt to srealloc() non-allocated memory in %s:%d\n", progname, file, line);
 				} else {
 					tmpblk->ptr = tmp;
-					tmpblk->vptr = (unsigned int)tmp;
+					tmpblk->vptr = (uintptr_t)tmp;
 				}
 #endif
 				if (new_size > old_size) {
@@ -851,7 +873,10 @@ void sfree (void *ptr)
 	if (ptr) {
 		#ifdef TRACE_MEMORY
 			ss_memblock *tmpblk;
+		#endif
 
+		smem_nfrees++;
+		#ifdef TRACE_MEMORY
 			ss_numfree++;
 			for (tmpblk = ss_head; tmpblk; tmpblk = tmpblk->next) {
 				if (tmpblk->ptr == ptr) {
@@ -862,7 +887,7 @@ void sfree (void *ptr)
 				fprintf (stderr, "%s: serious: attempt to sfree() non-allocated memory (%p) in %s:%d\n", progname, ptr, file, line);
 			} else {
 				ss_remove_blk (tmpblk);
-				free (tmpblk);
+				dmem_release (tmpblk);
 			}
 		#endif
 		dmem_release (ptr);
@@ -915,7 +940,11 @@ char *string_dup (const char *str)
 /*
  *	duplicates a string, but takes care to fixup any characters before they are printed as XML (e.g. '&', '"').
  */
+#ifdef TRACE_MEMORY
+char *ss_string_xmlfixup (const char *file, const int line, const char *str, int cdata)
+#else
 char *string_xmlfixup (const char *str, int cdata)
+#endif
 {
 	int ich, i;
 	char *nstr;
@@ -932,9 +961,17 @@ char *string_xmlfixup (const char *str, int cdata)
 	}
 	if (ich == i) {
 		/* same length, assume nothing */
+#ifdef TRACE_MEMORY
+		return ss_string_dup (file, line, str);
+#else
 		return string_dup (str);
+#endif
 	}
+#ifdef TRACE_MEMORY
+	nstr = (char *)ss_malloc (file, line, ich+1);
+#else
 	nstr = (char *)smalloc (ich+1);
+#endif
 
 	for (i=0, ich=0; str[i]; i++) {
 		switch (str[i]) {
@@ -1286,9 +1323,9 @@ void da_setsize (int *cur, int *max, void ***array, int size)
 	} else {
 		if (*max == 0) {
 #ifdef TRACE_MEMORY
-			*array = (void **)ss_malloc (file, line, size * sizeof (void *));
+			*array = (void **)ss_calloc (file, line, size, sizeof (void *));
 #else
-			*array = (void **)smalloc (size * sizeof (void *));
+			*array = (void **)scalloc (size, sizeof (void *));
 #endif
 			*max = size;
 			*cur = size;
@@ -1329,9 +1366,9 @@ void da_setmax (int *cur, int *max, void ***array, int size)
 	} else {
 		if (*max == 0) {
 #ifdef TRACE_MEMORY
-			*array = (void **)ss_malloc (file, line, size * sizeof (void *));
+			*array = (void **)ss_calloc (file, line, size, sizeof (void *));
 #else
-			*array = (void **)smalloc (size * sizeof (void *));
+			*array = (void **)scalloc (size, sizeof (void *));
 #endif
 			*max = size;
 			*cur = 0;
@@ -1378,9 +1415,9 @@ void da_copy (int srccur, int srcmax, void **srcarray, int *dstcur, int *dstmax,
 	if (!(*dstmax)) {
 		/* empty destination, allocate it */
 #ifdef TRACE_MEMORY
-		*dstarray = (void **)ss_malloc (file, line, srcmax * sizeof (void *));
+		*dstarray = (void **)ss_calloc (file, line, srcmax, sizeof (void *));
 #else
-		*dstarray = (void **)smalloc (srcmax * sizeof (void *));
+		*dstarray = (void **)scalloc (srcmax, sizeof (void *));
 #endif
 		*dstmax = srcmax;
 		*dstcur = 0;
@@ -1420,599 +1457,715 @@ int da_hasitem (int *cur, int *max, void ***array, void *item)
 /*}}}*/
 
 
-/*{{{  void sh_init (int *bsizes, void ***table, char ***keys, int *szptr, int *bszptr, void **fnptr, int bitsize)*/
+/*{{{  hash-table internals*/
 /*
- *	initialises a string-hash
+ *	string-hashes and pointer-hashes share one open-addressed table (hashtable_t), using robin-hood
+ *	placement:  entries in a run of occupied slots are ordered by home slot, then by insertion order,
+ *	so a lookup can stop as soon as it passes where its key would have been, and deletion just shifts
+ *	the rest of the run back by one (no tombstones).  the full hash-code of each entry is cached, so
+ *	key comparisons (strcmp for string-hashes) only happen on a hash-code match.
+ */
+
+#define HT_MINSIZE 8			/* smallest number of slots allocated */
+#define HT_LOADNUM 3			/* grow when more than HT_LOADNUM/HT_LOADDEN full */
+#define HT_LOADDEN 4
+
+/*{{{  static unsigned int ht_strhash (const char *str)*/
+/*
+ *	returns a (non-zero) hash-code for a string key (FNV-1a)
  */
-void sh_init (int *bsizes, void ***table, char ***keys, int *szptr, int *bszptr, void **fnptr, int bitsize)
+static unsigned int ht_strhash (const char *str)
 {
-	int i;
-	int size = (1 << bitsize);
+	unsigned int hc = 0x811c9dc5;
 
-	*szptr = size;
-	*bszptr = bitsize;
-	*fnptr = (void *)sh_lookup;
-	for (i=0; i<size; i++) {
-		bsizes[i] = 0;
-		table[i] = NULL;
-		keys[i] = NULL;
+	for (; *str != '\0'; str++) {
+		hc ^= (unsigned int)(unsigned char)*str;
+		hc *= 0x01000193;
 	}
-	return;
+	return hc ? hc : 1;
 }
 /*}}}*/
-/*{{{  void sh_sinit (int *bsizes, void ***table, char ***keys, int size)*/
+/*{{{  static unsigned int ht_ptrhash (void *ptr)*/
 /*
- *	initialises a static string-hash
+ *	returns a (non-zero) hash-code for a pointer key
  */
-void sh_sinit (int *bsizes, void ***table, char ***keys, int size)
+static unsigned int ht_ptrhash (void *ptr)
 {
-	int i;
+	uint64_t x = (uint64_t)(uintptr_t)ptr;
+	unsigned int hc;
 
-	for (i=0; i<size; i++) {
-		bsizes[i] = 0;
-		table[i] = NULL;
-		keys[i] = NULL;
-	}
-	return;
+	x ^= (x >> 33);
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= (x >> 33);
+	hc = (unsigned int)x;
+
+	return hc ? hc : 1;
 }
 /*}}}*/
-/*{{{  static unsigned int sh_hashcode (char *str, int bitsize)*/
+/*{{{  static int ht_keyeq (int strkeys, void *k1, void *k2)*/
 /*
- *	returns a hash-code for some string
+ *	compares two keys (whose hash-codes already match), returns non-zero if equal
  */
-static unsigned int sh_hashcode (char *str, int bitsize)
+static int ht_keyeq (int strkeys, void *k1, void *k2)
 {
-	unsigned int hc = (0x55a55a55 << bitsize);
-
-	for (; *str != '\0'; str++) {
-		unsigned int chunk = (unsigned int)*str;
-		unsigned int top;
-
-		hc ^= chunk;
-		top = (hc >> ((sizeof(unsigned int) * 8) - bitsize));
-		hc <<= (bitsize >> 1);
-		hc ^= top;
+	if (k1 == k2) {
+		return 1;
 	}
-	return hc;
+	return (strkeys && !strcmp ((char *)k1, (char *)k2));
 }
 /*}}}*/
-/*{{{  void sh_insert (int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key)*/
+/*{{{  static int ht_dist (hashtable_t *ht, int slot)*/
 /*
- *	inserts an item into a string-hash
+ *	returns how far the entry in an occupied slot is from its home slot
  */
-#ifdef TRACE_MEMORY
-void ss_sh_insert (const char *file, const int line, int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key)
-#else
-void sh_insert (int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key)
-#endif
+static int ht_dist (hashtable_t *ht, int slot)
 {
-	unsigned int hcode = sh_hashcode (key, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
+	return (slot - (int)(ht->hashes[slot] & (unsigned int)(ht->size - 1))) & (ht->size - 1);
+}
+/*}}}*/
+/*{{{  static void ht_place (hashtable_t *ht, unsigned int hcode, void *item, void *key)*/
+/*
+ *	places an entry in a table that has room for it, after any entries already there with the same home slot
+ */
+static void ht_place (hashtable_t *ht, unsigned int hcode, void *item, void *key)
+{
+	int mask = ht->size - 1;
+	int slot = (int)(hcode & (unsigned int)mask);
+	int dist;
 
-#if 0 && defined(DEBUG)
-fprintf (stderr, "sh_insert: adding item [%s] (0x%8.8x)\n", key, (unsigned int)item);
-#endif
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
-#ifdef TRACE_MEMORY
-		table[bucket] = (void **)ss_malloc (file, line, sizeof (void *));
-#else
-		table[bucket] = (void **)smalloc (sizeof (void *));
-#endif
-		table[bucket][0] = item;
+	for (dist = 0; ht->hashes[slot] && (ht_dist (ht, slot) >= dist); dist++) {
+		slot = (slot + 1) & mask;
+	}
 
-#ifdef TRACE_MEMORY
-		keys[bucket] = (char **)ss_malloc (file, line, sizeof (char *));
-#else
-		keys[bucket] = (char **)smalloc (sizeof (char *));
-#endif
-		keys[bucket][0] = key;
+	if (ht->hashes[slot]) {
+		/*{{{  displace the rest of this run along by one*/
+		int last = slot;
 
-		bsizes[bucket] = 1;
-	} else {
-#ifdef TRACE_MEMORY
-		table[bucket] = (void **)ss_realloc (file, line, (void *)table[bucket],
-					bsizes[bucket] * sizeof(void *),
-					(bsizes[bucket] + 1) * sizeof(void *));
-#else
-		table[bucket] = (void **)srealloc ((void *)table[bucket],
-					bsizes[bucket] * sizeof(void *),
-					(bsizes[bucket] + 1) * sizeof(void *));
-#endif
-		table[bucket][bsizes[bucket]] = item;
-#ifdef TRACE_MEMORY
-		keys[bucket] = (char **)ss_realloc (file, line, (void *)keys[bucket],
-					bsizes[bucket] * sizeof(char *),
-					(bsizes[bucket] + 1) * sizeof(char *));
-#else
-		keys[bucket] = (char **)srealloc ((void *)keys[bucket],
-					bsizes[bucket] * sizeof(char *),
-					(bsizes[bucket] + 1) * sizeof(char *));
-#endif
-		keys[bucket][bsizes[bucket]] = key;
+		while (ht->hashes[last]) {
+			last = (last + 1) & mask;
+		}
+		while (last != slot) {
+			int prev = (last - 1) & mask;
 
-		bsizes[bucket]++;
+			ht->hashes[last] = ht->hashes[prev];
+			ht->keys[last] = ht->keys[prev];
+			ht->items[last] = ht->items[prev];
+			last = prev;
+		}
+		/*}}}*/
 	}
+	ht->hashes[slot] = hcode;
+	ht->keys[slot] = key;
+	ht->items[slot] = item;
+	ht->count++;
+
 	return;
 }
 /*}}}*/
-/*{{{  void sh_remove (int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key)*/
+/*{{{  static void ht_resize (const char *file, const int line, hashtable_t *ht, int size)*/
 /*
- *	removes an item from a string-hash
+ *	(re)allocates the slots of a hash-table, re-placing any existing entries
  */
+static void ht_resize (const char *file, const int line, hashtable_t *ht, int size)
+{
+	void **oitems = ht->items;
+	void **okeys = ht->keys;
+	unsigned int *ohashes = ht->hashes;
+	int osize = ht->size;
+	void *block;
+
 #ifdef TRACE_MEMORY
-void ss_sh_remove (const char *file, const int line, int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key)
+	block = ss_malloc (file, line, size * (2 * sizeof (void *) + sizeof (unsigned int)));
 #else
-void sh_remove (int *bsizes, void ***table, char ***keys, int bitsize, void *item, char *key)
+	block = smalloc (size * (2 * sizeof (void *) + sizeof (unsigned int)));
 #endif
-{
-	unsigned int hcode = sh_hashcode (key, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
+	ht->items = (void **)block;
+	ht->keys = ht->items + size;
+	ht->hashes = (unsigned int *)(ht->keys + size);
+	ht->size = size;
+	ht->count = 0;
 
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
-		return;
-	} else {
-		int i;
+	if (oitems) {
+		int start, i;
 
-		for (i=0; i<bsizes[bucket]; i++) {
-			if ((sh_hashcode (keys[bucket][i], bitsize) == hcode) && (item == table[bucket][i]) && (!strcmp (keys[bucket][i], key))) {
-				/* shuffle up others */
-				for (; i<(bsizes[bucket] - 1); i++) {
-					table[bucket][i] = table[bucket][i+1];
-					keys[bucket][i] = keys[bucket][i+1];
-				}
-
-				/* nullify the last entries */
-				table[bucket][i] = NULL;
-				keys[bucket][i] = NULL;
+		/* start just after an empty slot, so that runs (and duplicate keys) stay in order */
+		for (start = 0; ohashes[start]; start++);
+		for (i = 1; i <= osize; i++) {
+			int slot = (start + i) & (osize - 1);
 
-				/* now we have to make smaller */
-				if (bsizes[bucket] == 1) {
-#ifdef TRACE_MEMORY
-					ss_free (file, line, table[bucket]);
-					ss_free (file, line, keys[bucket]);
-#else
-					sfree (table[bucket]);
-					sfree (keys[bucket]);
-#endif
-					table[bucket] = NULL;
-					keys[bucket] = NULL;
-				} else {
+			if (ohashes[slot]) {
+				ht_place (ht, ohashes[slot], oitems[slot], okeys[slot]);
+			}
+		}
 #ifdef TRACE_MEMORY
-					table[bucket] = (void **)ss_realloc (file, line, (void *)table[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
-					keys[bucket] = (char **)ss_realloc (file, line, (void *)keys[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
+		ss_free (file, line, oitems);
 #else
-					table[bucket] = (void **)srealloc ((void *)table[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
-					keys[bucket] = (char **)srealloc ((void *)keys[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
+		sfree (oitems);
 #endif
-				}
-				bsizes[bucket] = bsizes[bucket] - 1;
-
-				return;
-			}
-		}
 	}
-	nocc_warning ("sh_remove(): item [%p:%s] not in stringhash", item, key);
 	return;
 }
 /*}}}*/
-/*{{{  void *sh_lookup (int *bsizes, void ***table, char ***keys, int bitsize, char *match)*/
+/*{{{  static void ht_insert (const char *file, const int line, hashtable_t *ht, unsigned int hcode, void *item, void *key)*/
 /*
- *	looks up an item in a string-hash
+ *	inserts an entry into a hash-table, growing it if needed
  */
-void *sh_lookup (int *bsizes, void ***table, char ***keys, int bitsize, char *match)
+static void ht_insert (const char *file, const int line, hashtable_t *ht, unsigned int hcode, void *item, void *key)
 {
-	unsigned int hcode = sh_hashcode (match, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
+	if (!ht->size) {
+		int size = ((ht->bitsize > 0) && (ht->bitsize < 24)) ? (1 << ht->bitsize) : HT_MINSIZE;
 
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
-		return NULL;
-	} else {
-		int i;
-
-		for (i=0; i<bsizes[bucket]; i++) {
-			if ((sh_hashcode (keys[bucket][i], bitsize) == hcode) && (!strcmp (keys[bucket][i], match))) {
-#if 0 && defined(DEBUG)
-fprintf (stderr, "sh_lookup: match for [%s] found item 0x%8.8x\n", match, (unsigned int)(table[bucket][i]));
-#endif
-				return table[bucket][i];
-			}
-		}
+		ht_resize (file, line, ht, (size < HT_MINSIZE) ? HT_MINSIZE : size);
+	} else if ((ht->count + 1) * HT_LOADDEN > ht->size * HT_LOADNUM) {
+		ht_resize (file, line, ht, ht->size << 1);
 	}
-	return NULL;
+	ht_place (ht, hcode, item, key);
+	return;
 }
 /*}}}*/
-/*{{{  void sh_dump (FILE *stream, int *bsizes, void ***table, char ***keys, int size)*/
+/*{{{  static int ht_find (hashtable_t *ht, int strkeys, unsigned int hcode, void *key, int anyitem, void *item)*/
 /*
- *	dumps the contents of a string-hash (debugging)
+ *	finds the earliest inserted entry for a key (and particular item if !anyitem)
+ *	returns slot index or -1 if not found
  */
-void sh_dump (FILE *stream, int *bsizes, void ***table, char ***keys, int size)
+static int ht_find (hashtable_t *ht, int strkeys, unsigned int hcode, void *key, int anyitem, void *item)
 {
-	int i;
-
-	fprintf (stream, "hash-table size: %d buckets\n", size);
-	for (i=0; i < size; i++) {
-		fprintf (stream, "bucket %d:\tsize %d:\t", i, bsizes[i]);
-		if (bsizes[i]) {
-			int j;
+	int mask = ht->size - 1;
+	int slot, dist;
 
-			for (j=0; j<bsizes[i]; j++) {
-				fprintf (stream, "%s%s (%p)", (!j ? "" : ", "), keys[i][j], table[i][j]);
-			}
+	if (!ht->count) {
+		return -1;
+	}
+	slot = (int)(hcode & (unsigned int)mask);
+	for (dist = 0; ht->hashes[slot] && (ht_dist (ht, slot) >= dist); dist++) {
+		if ((ht->hashes[slot] == hcode) && (anyitem || (ht->items[slot] == item)) && ht_keyeq (strkeys, ht->keys[slot], key)) {
+			return slot;
 		}
-		fprintf (stream, "\n");
+		slot = (slot + 1) & mask;
 	}
+	return -1;
 }
 /*}}}*/
-/*{{{  void sh_walk (int *bsizes, void ***table, char ***keys, int size, void (*func)(void *, char *, void *), void *p)*/
+/*{{{  static void ht_delete (hashtable_t *ht, int slot)*/
 /*
- *	walks the contents of a string-hash
+ *	removes the entry in a particular slot, shifting the rest of its run back
  */
-void sh_walk (int *bsizes, void ***table, char ***keys, int size, void (*func)(void *, char *, void *), void *p)
+static void ht_delete (hashtable_t *ht, int slot)
 {
-	int i, j;
+	int mask = ht->size - 1;
+	int next = (slot + 1) & mask;
 
-	for (i=0; i<size; i++) {
-		if (bsizes[i]) {
-			for (j=0; j<bsizes[i]; j++) {
-				func (table[i][j], keys[i][j], p);
-			}
-		}
+	while (ht->hashes[next] && ht_dist (ht, next)) {
+		ht->hashes[slot] = ht->hashes[next];
+		ht->keys[slot] = ht->keys[next];
+		ht->items[slot] = ht->items[next];
+		slot = next;
+		next = (next + 1) & mask;
 	}
+	ht->hashes[slot] = 0;
+	ht->keys[slot] = NULL;
+	ht->items[slot] = NULL;
+	ht->count--;
+
 	return;
 }
 /*}}}*/
-/*{{{  void sh_trash (int *bsizes, void ***table, char ***keys, int size)*/
+/*{{{  static void ht_trash (const char *file, const int line, hashtable_t *ht)*/
 /*
- *	destroys a string-hash
+ *	frees the slots of a hash-table, leaving it empty (but usable)
  */
-#ifdef TRACE_MEMORY
-void ss_sh_trash (const char *file, const int line, int *bsizes, void ***table, char ***keys, int size)
-#else
-void sh_trash (int *bsizes, void ***table, char ***keys, int size)
-#endif
+static void ht_trash (const char *file, const int line, hashtable_t *ht)
 {
-	int i;
-
-	for (i=0; i<size; i++) {
-		if (table[i]) {
-#ifdef TRACE_MEMORY
-			ss_free (file, line, table[i]);
-#else
-			sfree (table[i]);
-#endif
-		}
-		if (keys[i]) {
+	if (ht->items) {
 #ifdef TRACE_MEMORY
-			ss_free (file, line, keys[i]);
+		ss_free (file, line, ht->items);
 #else
-			sfree (keys[i]);
+		sfree (ht->items);
 #endif
-		}
 	}
+	ht->items = NULL;
+	ht->keys = NULL;
+	ht->hashes = NULL;
+	ht->size = 0;
+	ht->count = 0;
 
 	return;
 }
 /*}}}*/
-/*{{{  unsigned int sh_stringhash (const char *str, const int len)*/
+/*{{{  static void ht_dump (FILE *stream, hashtable_t *ht, int strkeys)*/
 /*
- *	returns a hash-code for an arbitrary string
+ *	dumps the contents of a hash-table (debugging)
  */
-unsigned int sh_stringhash (const char *str, const int len)
+static void ht_dump (FILE *stream, hashtable_t *ht, int strkeys)
 {
-	char *lstr = string_ndup (str, len);
-	unsigned int hcode;
-
-	hcode = sh_hashcode (lstr, 6);
-	sfree (lstr);
+	int i;
 
-	return hcode;
+	fprintf (stream, "hash-table size: %d slots, %d used\n", ht->size, ht->count);
+	for (i=0; i<ht->size; i++) {
+		if (ht->hashes[i]) {
+			fprintf (stream, "slot %d:\tdist %d:\t", i, ht_dist (ht, i));
+			if (strkeys) {
+				fprintf (stream, "%s (%p)\n", (char *)ht->keys[i], ht->items[i]);
+			} else {
+				fprintf (stream, "%p (%p)\n", ht->keys[i], ht->items[i]);
+			}
+		}
+	}
+	return;
 }
 /*}}}*/
 
-
-/*{{{  void ph_init (int *bsizes, void ***table, void ***keys, int *szptr, int *bszptr, void **fnptr, int bitsize)*/
+/*}}}*/
+/*{{{  void sh_init (hashtable_t *ht, void **fnptr, int bitsize)*/
 /*
- *	initialises a pointer-hash
+ *	initialises a string-hash
  */
-void ph_init (int *bsizes, void ***table, void ***keys, int *szptr, int *bszptr, void **fnptr, int bitsize)
+void sh_init (hashtable_t *ht, void **fnptr, int bitsize)
 {
-	int i;
-	int size = (1 << bitsize);
-
-	*szptr = size;
-	*bszptr = bitsize;
-	*fnptr = (void *)ph_lookup;
-	for (i=0; i<size; i++) {
-		bsizes[i] = 0;
-		table[i] = NULL;
-		keys[i] = NULL;
-	}
+	ht->items = NULL;
+	ht->keys = NULL;
+	ht->hashes = NULL;
+	ht->size = 0;
+	ht->count = 0;
+	ht->bitsize = bitsize;
+	*fnptr = (void *)sh_lookup;
 	return;
 }
 /*}}}*/
-/*{{{  void ph_sinit (int *bsizes, void ***table, void ***keys, int size)*/
+/*{{{  void sh_sinit (hashtable_t *ht)*/
 /*
- *	initialises a pointer-hash
+ *	initialises a static string-hash
  */
-void ph_sinit (int *bsizes, void ***table, void ***keys, int size)
+void sh_sinit (hashtable_t *ht)
 {
-	int i;
-
-	for (i=0; i<size; i++) {
-		bsizes[i] = 0;
-		table[i] = NULL;
-		keys[i] = NULL;
-	}
+	ht->items = NULL;
+	ht->keys = NULL;
+	ht->hashes = NULL;
+	ht->size = 0;
+	ht->count = 0;
 	return;
 }
 /*}}}*/
-/*{{{  static unsigned int ph_hashcode (void *ptr, int bitsize)*/
+/*{{{  static unsigned int sh_hashcode (const char *str, int len, int bitsize)*/
 /*
- *	returns a pointer-hash for some pointer
+ *	returns a hash-code for the first 'len' characters of some string
  */
-static unsigned int ph_hashcode (void *ptr, int bitsize)
+static unsigned int sh_hashcode (const char *str, int len, int bitsize)
 {
-	int i;
-	unsigned int hc = (0x56756789 << bitsize);
-	char *data = (char *)&ptr;				/* pointer to the actual pointer */
+	unsigned int hc = (0x55a55a55 << bitsize);
 
-	for (i=0; i<sizeof(void *); i++) {
-		unsigned int chunk = (unsigned int)data[i];
+	for (; len > 0; str++, len--) {
+		unsigned int chunk = (unsigned int)*str;
 		unsigned int top;
 
 		hc ^= chunk;
-		top = (hc >> ((sizeof (unsigned int) * 8) - bitsize));
+		top = (hc >> ((sizeof(unsigned int) * 8) - bitsize));
 		hc <<= (bitsize >> 1);
 		hc ^= top;
 	}
 	return hc;
 }
 /*}}}*/
-/*{{{  void ph_insert (int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key)*/
+/*{{{  void sh_insert (hashtable_t *ht, void *item, char *key)*/
 /*
- *	inserts an item into a pointer-hash
+ *	inserts an item into a string-hash
  */
 #ifdef TRACE_MEMORY
-void ss_ph_insert (const char *file, const int line, int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key)
+void ss_sh_insert (const char *file, const int line, hashtable_t *ht, void *item, char *key)
 #else
-void ph_insert (int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key)
+void sh_insert (hashtable_t *ht, void *item, char *key)
 #endif
 {
-	unsigned int hcode = ph_hashcode (key, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
-
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
-#ifdef TRACE_MEMORY
-		table[bucket] = (void **)ss_malloc (file, line, sizeof (void *));
-#else
-		table[bucket] = (void **)smalloc (sizeof (void *));
+#ifndef TRACE_MEMORY
+	const char *file = __FILE__;
+	const int line = __LINE__;
 #endif
-		table[bucket][0] = item;
 
+	ht_insert (file, line, ht, ht_strhash (key), item, (void *)key);
+	return;
+}
+/*}}}*/
+/*{{{  void sh_remove (hashtable_t *ht, void *item, char *key)*/
+/*
+ *	removes an item from a string-hash
+ */
 #ifdef TRACE_MEMORY
-		keys[bucket] = (void **)ss_malloc (file, line, sizeof (void *));
+void ss_sh_remove (const char *file, const int line, hashtable_t *ht, void *item, char *key)
 #else
-		keys[bucket] = (void **)smalloc (sizeof (void *));
+void sh_remove (hashtable_t *ht, void *item, char *key)
 #endif
-		keys[bucket][0] = key;
+{
+	int slot = ht_find (ht, 1, ht_strhash (key), (void *)key, 0, item);
 
-		bsizes[bucket] = 1;
-	} else {
-#ifdef TRACE_MEMORY
-		table[bucket] = (void **)ss_realloc (file, line, (void *)table[bucket],
-					bsizes[bucket] * sizeof(void *),
-					(bsizes[bucket] + 1) * sizeof(void *));
-#else
-		table[bucket] = (void **)srealloc ((void *)table[bucket],
-					bsizes[bucket] * sizeof(void *),
-					(bsizes[bucket] + 1) * sizeof(void *));
-#endif
-		table[bucket][bsizes[bucket]] = item;
-#ifdef TRACE_MEMORY
-		keys[bucket] = (void **)ss_realloc (file, line, (void *)keys[bucket],
-					bsizes[bucket] * sizeof(void *),
-					(bsizes[bucket] + 1) * sizeof(void *));
-#else
-		keys[bucket] = (void **)srealloc ((void *)keys[bucket],
-					bsizes[bucket] * sizeof(void *),
-					(bsizes[bucket] + 1) * sizeof(void *));
-#endif
-		keys[bucket][bsizes[bucket]] = key;
+	if (slot < 0) {
+		nocc_warning ("sh_remove(): item [%p:%s] not in stringhash", item, key);
+		return;
+	}
+	ht_delete (ht, slot);
+	return;
+}
+/*}}}*/
+/*{{{  void *sh_lookup (hashtable_t *ht, char *match)*/
+/*
+ *	looks up an item in a string-hash
+ */
+void *sh_lookup (hashtable_t *ht, char *match)
+{
+	int slot = ht_find (ht, 1, ht_strhash (match), (void *)match, 1, NULL);
 
-		bsizes[bucket]++;
+	return (slot < 0) ? NULL : ht->items[slot];
+}
+/*}}}*/
+/*{{{  void sh_dump (FILE *stream, hashtable_t *ht)*/
+/*
+ *	dumps the contents of a string-hash (debugging)
+ */
+void sh_dump (FILE *stream, hashtable_t *ht)
+{
+	ht_dump (stream, ht, 1);
+	return;
+}
+/*}}}*/
+/*{{{  void sh_walk (hashtable_t *ht, void (*func)(void *, char *, void *), void *p)*/
+/*
+ *	walks the contents of a string-hash
+ */
+void sh_walk (hashtable_t *ht, void (*func)(void *, char *, void *), void *p)
+{
+	int i;
+
+	for (i=0; i<ht->size; i++) {
+		if (ht->hashes[i]) {
+			func (ht->items[i], (char *)ht->keys[i], p);
+		}
 	}
 	return;
 }
 /*}}}*/
-/*{{{  void ph_remove (int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key)*/
+/*{{{  void sh_trash (hashtable_t *ht)*/
 /*
- *	removes an item from a pointer-hash
+ *	destroys a string-hash
  */
 #ifdef TRACE_MEMORY
-void ss_ph_remove (const char *file, const int line, int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key)
+void ss_sh_trash (const char *file, const int line, hashtable_t *ht)
 #else
-void ph_remove (int *bsizes, void ***table, void ***keys, int bitsize, void *item, void *key)
+void sh_trash (hashtable_t *ht)
 #endif
 {
-	unsigned int hcode = ph_hashcode (key, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
+#ifndef TRACE_MEMORY
+	const char *file = __FILE__;
+	const int line = __LINE__;
+#endif
 
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
-		return;
-	} else {
-		int i;
+	ht_trash (file, line, ht);
+	return;
+}
+/*}}}*/
+/*{{{  unsigned int sh_stringhash (const char *str, const int len)*/
+/*
+ *	returns a hash-code for an arbitrary string
+ */
+unsigned int sh_stringhash (const char *str, const int len)
+{
+	int slen;
 
-		for (i=0; i<bsizes[bucket]; i++) {
-			if ((ph_hashcode (keys[bucket][i], bitsize) == hcode) && (item == table[bucket][i]) && (keys[bucket][i] == key)) {
-				/* shuffle up others */
-				for (; i<(bsizes[bucket] - 1); i++) {
-					table[bucket][i] = table[bucket][i+1];
-					keys[bucket][i] = keys[bucket][i+1];
-				}
+	/* stop at any terminator inside 'len', as this always has */
+	for (slen = 0; (slen < len) && (str[slen] != '\0'); slen++);
+
+	return sh_hashcode (str, slen, 6);
+}
+/*}}}*/
 
-				/* nullify the last entries */
-				table[bucket][i] = NULL;
-				keys[bucket][i] = NULL;
 
-				/* now we have to make smaller */
-				if (bsizes[bucket] == 1) {
+/*{{{  void ph_init (hashtable_t *ht, void **fnptr, int bitsize)*/
+/*
+ *	initialises a pointer-hash
+ */
+void ph_init (hashtable_t *ht, void **fnptr, int bitsize)
+{
+	ht->items = NULL;
+	ht->keys = NULL;
+	ht->hashes = NULL;
+	ht->size = 0;
+	ht->count = 0;
+	ht->bitsize = bitsize;
+	*fnptr = (void *)ph_lookup;
+	return;
+}
+/*}}}*/
+/*{{{  void ph_sinit (hashtable_t *ht)*/
+/*
+ *	initialises a static pointer-hash
+ */
+void ph_sinit (hashtable_t *ht)
+{
+	ht->items = NULL;
+	ht->keys = NULL;
+	ht->hashes = NULL;
+	ht->size = 0;
+	ht->count = 0;
+	return;
+}
+/*}}}*/
+/*{{{  void ph_insert (hashtable_t *ht, void *item, void *key)*/
+/*
+ *	inserts an item into a pointer-hash
+ */
 #ifdef TRACE_MEMORY
-					ss_free (file, line, table[bucket]);
-					ss_free (file, line, keys[bucket]);
+void ss_ph_insert (const char *file, const int line, hashtable_t *ht, void *item, void *key)
 #else
-					sfree (table[bucket]);
-					sfree (keys[bucket]);
+void ph_insert (hashtable_t *ht, void *item, void *key)
 #endif
-					table[bucket] = NULL;
-					keys[bucket] = NULL;
-				} else {
+{
+#ifndef TRACE_MEMORY
+	const char *file = __FILE__;
+	const int line = __LINE__;
+#endif
+
+	ht_insert (file, line, ht, ht_ptrhash (key), item, key);
+	return;
+}
+/*}}}*/
+/*{{{  void ph_remove (hashtable_t *ht, void *item, void *key)*/
+/*
+ *	removes an item from a pointer-hash
+ */
 #ifdef TRACE_MEMORY
-					table[bucket] = (void **)ss_realloc (file, line, (void *)table[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
-					keys[bucket] = (void **)ss_realloc (file, line, (void *)keys[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
+void ss_ph_remove (const char *file, const int line, hashtable_t *ht, void *item, void *key)
 #else
-					table[bucket] = (void **)srealloc ((void *)table[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
-					keys[bucket] = (void **)srealloc ((void *)keys[bucket], bsizes[bucket] * sizeof (void *),
-							(bsizes[bucket] - 1) * sizeof (void *));
+void ph_remove (hashtable_t *ht, void *item, void *key)
 #endif
-				}
-				bsizes[bucket] = bsizes[bucket] - 1;
+{
+	int slot = ht_find (ht, 0, ht_ptrhash (key), key, 0, item);
 
-				return;
-			}
-		}
+	if (slot < 0) {
+		nocc_warning ("ph_remove(): item [%p:%p] not in pointerhash", item, key);
+		return;
 	}
-	nocc_warning ("ph_remove(): item [%p:%p] not in pointerhash", item, key);
+	ht_delete (ht, slot);
 	return;
 }
 /*}}}*/
-/*{{{  void *ph_lookup (int *bsizes, void ***table, void ***keys, int bitsize, void *match)*/
+/*{{{  void *ph_lookup (hashtable_t *ht, void *match)*/
 /*
  *	looks up an item in a pointer-hash
  */
-void *ph_lookup (int *bsizes, void ***table, void ***keys, int bitsize, void *match)
+void *ph_lookup (hashtable_t *ht, void *match)
 {
-	unsigned int hcode = ph_hashcode (match, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
-
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
-		return NULL;
-	} else {
-		int i;
+	int slot = ht_find (ht, 0, ht_ptrhash (match), match, 1, NULL);
 
-		for (i=0; i<bsizes[bucket]; i++) {
-			if ((ph_hashcode (keys[bucket][i], bitsize) == hcode) && (keys[bucket][i] == match)) {
-#if 0 && defined(DEBUG)
-fprintf (stderr, "ph_lookup: match for [%s] found item 0x%8.8x\n", match, (unsigned int)(table[bucket][i]));
-#endif
-				return table[bucket][i];
-			}
-		}
-	}
-	return NULL;
+	return (slot < 0) ? NULL : ht->items[slot];
 }
 /*}}}*/
-/*{{{  void ph_dump (FILE *stream, int *bsizes, void ***table, void ***keys, int size)*/
+/*{{{  void ph_dump (FILE *stream, hashtable_t *ht)*/
 /*
  *	dumps the contents of a pointer-hash (debugging)
  */
-void ph_dump (FILE *stream, int *bsizes, void ***table, void ***keys, int size)
+void ph_dump (FILE *stream, hashtable_t *ht)
 {
-	int i;
-
-	fprintf (stream, "hash-table size: %d buckets\n", size);
-	for (i=0; i < size; i++) {
-		fprintf (stream, "bucket %d:\tsize %d:\t", i, bsizes[i]);
-		if (bsizes[i]) {
-			int j;
-
-			for (j=0; j<bsizes[i]; j++) {
-				fprintf (stream, "%s%p (%p)", (!j ? "" : ", "), keys[i][j], table[i][j]);
-			}
-		}
-		fprintf (stream, "\n");
-	}
+	ht_dump (stream, ht, 0);
+	return;
 }
 /*}}}*/
-/*{{{  void ph_walk (int *bsizes, void ***table, void ***keys, int size, void (*func)(void *, void *, void *), void *p)*/
+/*{{{  void ph_walk (hashtable_t *ht, void (*func)(void *, void *, void *), void *p)*/
 /*
  *	walks the contents of a pointer-hash
  */
-void ph_walk (int *bsizes, void ***table, void ***keys, int size, void (*func)(void *, void *, void *), void *p)
+void ph_walk (hashtable_t *ht, void (*func)(void *, void *, void *), void *p)
 {
-	int i, j;
+	int i;
 
-	for (i=0; i<size; i++) {
-		if (bsizes[i]) {
-			for (j=0; j<bsizes[i]; j++) {
-				func (table[i][j], keys[i][j], p);
-			}
+	for (i=0; i<ht->size; i++) {
+		if (ht->hashes[i]) {
+			func (ht->items[i], ht->keys[i], p);
 		}
 	}
 	return;
 }
 /*}}}*/
-/*{{{  void ph_lwalk (int *bsizes, void ***table, void ***keys, int bitsize, void *match, void (*func)(void *, void *, void *), void *p)*/
+/*{{{  void ph_lwalk (hashtable_t *ht, void *match, void (*func)(void *, void *, void *), void *p)*/
 /*
- *	walks the contents of a pointer-hash for items that match
+ *	walks the contents of a pointer-hash for items that match (in insertion order)
  */
-void ph_lwalk (int *bsizes, void ***table, void ***keys, int bitsize, void *match, void (*func)(void *, void *, void *), void *p)
+void ph_lwalk (hashtable_t *ht, void *match, void (*func)(void *, void *, void *), void *p)
 {
-	unsigned int hcode = ph_hashcode (match, bitsize);
-	int bucket = hcode & ((1 << bitsize) - 1);
+	unsigned int hcode = ht_ptrhash (match);
+	int slot = ht_find (ht, 0, hcode, match, 1, NULL);
 
-	if (!bsizes[bucket] || !table[bucket] || !keys[bucket]) {
+	if (slot < 0) {
 		return;
-	} else {
-		int i;
-
-		for (i=0; i<bsizes[bucket]; i++) {
-			if ((ph_hashcode (keys[bucket][i], bitsize) == hcode) && (!strcmp (keys[bucket][i], match))) {
-				func (table[bucket][i], keys[bucket][i], p);
-			}
+	}
+	/* rest of the matching entries follow, amongst others with the same home slot */
+	for (; ht->hashes[slot] && ((ht->hashes[slot] ^ hcode) & (unsigned int)(ht->size - 1)) == 0; slot = (slot + 1) & (ht->size - 1)) {
+		if ((ht->hashes[slot] == hcode) && (ht->keys[slot] == match)) {
+			func (ht->items[slot], ht->keys[slot], p);
 		}
 	}
 	return;
 }
 /*}}}*/
-/*{{{  void ph_trash (int *bsizes, void ***table, void ***keys, int size)*/
+/*{{{  void ph_trash (hashtable_t *ht)*/
 /*
- *	destroys a string-hash
+ *	destroys a pointer-hash
  */
 #ifdef TRACE_MEMORY
-void ss_ph_trash (const char *file, const int line, int *bsizes, void ***table, void ***keys, int size)
+void ss_ph_trash (const char *file, const int line, hashtable_t *ht)
 #else
-void ph_trash (int *bsizes, void ***table, void ***keys, int size)
+void ph_trash (hashtable_t *ht)
+#endif
+{
+#ifndef TRACE_MEMORY
+	const char *file = __FILE__;
+	const int line = __LINE__;
 #endif
+
+	ht_trash (file, line, ht);
+	return;
+}
+/*}}}*/
+
+/*{{{  interned strings*/
+/*
+ *	interned strings are stored once, in large blocks that are never freed, each preceded by its hash-code
+ *	and length; interning the same string again returns the same pointer, so interned strings can be
+ *	compared for equality by pointer.  the hash-code is the same as string-hashes use.
+ */
+
+typedef struct TAG_istrhdr {
+	unsigned int hash;
+	int len;
+} istrhdr_t;
+
+#define ISTR_BLOCKSIZE 16384
+#define ISTR_HDR(S) ((istrhdr_t *)((char *)(S) - sizeof (istrhdr_t)))
+
+static char **istr_index = NULL;	/* open-addressed (linear probing) on the cached hash */
+static int istr_size = 0;
+static int istr_count = 0;
+
+static char *istr_next = NULL;
+static int istr_left = 0;
+
+static int istr_lookups = 0;
+static int istr_hits = 0;
+static int istr_bytes = 0;
+static int istr_saved = 0;
+
+/*{{{  static void istr_grow (void)*/
+/*
+ *	grows the interned-string index
+ */
+static void istr_grow (void)
 {
+	char **oindex = istr_index;
+	int osize = istr_size;
 	int i;
 
-	for (i=0; i<size; i++) {
-		if (table[i]) {
-#ifdef TRACE_MEMORY
-			ss_free (file, line, table[i]);
-#else
-			sfree (table[i]);
-#endif
+	istr_size = osize ? (osize << 1) : 1024;
+	istr_index = (char **)scalloc (istr_size, sizeof (char *));
+	for (i=0; i<osize; i++) {
+		if (oindex[i]) {
+			int slot = (int)(ISTR_HDR (oindex[i])->hash & (unsigned int)(istr_size - 1));
+
+			while (istr_index[slot]) {
+				slot = (slot + 1) & (istr_size - 1);
+			}
+			istr_index[slot] = oindex[i];
 		}
-		if (keys[i]) {
-#ifdef TRACE_MEMORY
-			ss_free (file, line, keys[i]);
-#else
-			sfree (keys[i]);
-#endif
+	}
+	if (oindex) {
+		sfree (oindex);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  char *string_nintern (const char *str, int len)*/
+/*
+ *	interns the first 'len' characters of a string
+ *	returns the interned copy (which must not be modified or freed)
+ */
+char *string_nintern (const char *str, int len)
+{
+	unsigned int hcode = 0x811c9dc5;
+	int slot, i, bytes;
+	char *istr;
+
+	for (i=0; i<len; i++) {
+		hcode ^= (unsigned int)(unsigned char)str[i];
+		hcode *= 0x01000193;
+	}
+	if (!hcode) {
+		hcode = 1;
+	}
+
+	istr_lookups++;
+	if ((istr_count + 1) * 4 > istr_size * 3) {
+		istr_grow ();
+	}
+	for (slot = (int)(hcode & (unsigned int)(istr_size - 1)); istr_index[slot]; slot = (slot + 1) & (istr_size - 1)) {
+		istrhdr_t *hdr = ISTR_HDR (istr_index[slot]);
+
+		if ((hdr->hash == hcode) && (hdr->len == len) && !memcmp (istr_index[slot], str, len)) {
+			istr_hits++;
+			istr_saved += len + 1;
+			return istr_index[slot];
+		}
+	}
+
+	/* new one: header, string and terminator, keeping headers aligned */
+	bytes = (sizeof (istrhdr_t) + len + 1 + (sizeof (istrhdr_t) - 1)) & ~(sizeof (istrhdr_t) - 1);
+	if (bytes > (ISTR_BLOCKSIZE >> 2)) {
+		istr = (char *)smalloc (bytes);
+	} else {
+		if (istr_left < bytes) {
+			istr_next = (char *)smalloc (ISTR_BLOCKSIZE);
+			istr_left = ISTR_BLOCKSIZE;
 		}
+		istr = istr_next;
+		istr_next += bytes;
+		istr_left -= bytes;
 	}
+	istr_bytes += bytes;
 
+	((istrhdr_t *)istr)->hash = hcode;
+	((istrhdr_t *)istr)->len = len;
+	istr += sizeof (istrhdr_t);
+	memcpy (istr, str, len);
+	istr[len] = '\0';
+
+	istr_index[slot] = istr;
+	istr_count++;
+
+	return istr;
+}
+/*}}}*/
+/*{{{  char *string_intern (const char *str)*/
+/*
+ *	interns a string
+ *	returns the interned copy (which must not be modified or freed)
+ */
+char *string_intern (const char *str)
+{
+	return string_nintern (str, strlen (str));
+}
+/*}}}*/
+/*{{{  void string_internstats (int *lookups, int *hits, int *nstrings, int *bytes, int *saved)*/
+/*
+ *	returns interned-string statistics: how many times strings were interned, how many of those were
+ *	already there, how many strings are held (and in how many bytes), and roughly how many bytes separate
+ *	copies would have taken
+ */
+void string_internstats (int *lookups, int *hits, int *nstrings, int *bytes, int *saved)
+{
+	*lookups = istr_lookups;
+	*hits = istr_hits;
+	*nstrings = istr_count;
+	*bytes = istr_bytes;
+	*saved = istr_saved;
 	return;
 }
 /*}}}*/
+/*}}}*/
 
 
 /*{{{  int decode_hex_byte (char b1, char b2, unsigned char *tptr)*/
@@ -2388,6 +2541,23 @@ void time_setin (struct timeval *t1, struct timeval *t2)
 }
 /*}}}*/
 #endif
+/*{{{  unsigned long long mem_hash64 (unsigned long long hval, const void *data, int len)*/
+/*
+ *	computes a 64-bit (FNV-1a) hash over a block of memory, continuing from "hval"
+ *	(MEM_HASH64_INIT to start afresh).  not cryptographic, used for cache keys and the like.
+ */
+unsigned long long mem_hash64 (unsigned long long hval, const void *data, int len)
+{
+	const unsigned char *ch = (const unsigned char *)data;
+	int i;
+
+	for (i=0; i<len; i++) {
+		hval ^= (unsigned long long)ch[i];
+		hval *= 0x100000001b3ULL;
+	}
+	return hval;
+}
+/*}}}*/
 /*{{{  char *strstrip (char *str)*/
 /*
  *	removes leading and trailing whitespace from the string.  returns the same pointer (moves contents)
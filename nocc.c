@@ -96,6 +96,9 @@
 #include "interact.h"
 #include "ihelp.h"
 #include "lexpriv.h"
+#include "profile.h"
+#include "server.h"
+#include "compcache.h"
 #include "cccsp.h"		/* needed for some help with subtarget options */
 
 #ifdef USE_LIBREADLINE
@@ -348,6 +351,12 @@ static int nocc_shutdownrun (void)
 	if (lexer_shutdown ()) {
 		v++;
 	}
+	if (server_shutdown ()) {
+		v++;
+	}
+	if (compcache_shutdown ()) {
+		v++;
+	}
 	if (symbols_shutdown ()) {
 		v++;
 	}
@@ -365,6 +374,9 @@ static int nocc_shutdownrun (void)
 	if (fcnlib_shutdown ()) {
 		v++;
 	}
+	if (profile_shutdown ()) {
+		v++;
+	}
 
 	return v;
 }
@@ -607,6 +619,45 @@ void nocc_cleanexit (void)
 /*{{{  specification file handling*/
 STATICDYNARRAY (xmlkey_t *, specfilekeys);
 STATICDYNARRAY (char *, specfiledata);
+STATICDYNARRAY (char *, specfileenvnames);		/* environment variables substituted in specs-file strings */
+STATICDYNARRAY (char *, specfileenvvals);		/* and their values at the time (NULL if not set) */
+
+/*{{{  static void specfile_noteenv (const char *name, const char *val)*/
+/*
+ *	remembers an environment variable used in a specs-file string, and its value then
+ */
+static void specfile_noteenv (const char *name, const char *val)
+{
+	int i;
+
+	for (i=0; (i<DA_CUR (specfileenvnames)) && strcmp (DA_NTHITEM (specfileenvnames, i), name); i++);
+	if (i == DA_CUR (specfileenvnames)) {
+		dynarray_add (specfileenvnames, string_dup (name));
+		dynarray_add (specfileenvvals, val ? string_dup (val) : NULL);
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static int specfile_envchanged (void)*/
+/*
+ *	returns non-zero if any environment variable used in a specs-file string has a different value now
+ *	(a compile server request's environment, say) from when the specs file was read
+ */
+static int specfile_envchanged (void)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (specfileenvnames); i++) {
+		char *val = getenv (DA_NTHITEM (specfileenvnames, i));
+		char *oval = DA_NTHITEM (specfileenvvals, i);
+
+		if ((!val != !oval) || (val && strcmp (val, oval))) {
+			return 1;
+		}
+	}
+	return 0;
+}
+/*}}}*/
 
 /*{{{  static char *specfile_stringdupenv (char *edata)*/
 /*
@@ -639,6 +690,7 @@ static char *specfile_stringdupenv (char *edata)
 
 				e_name = string_ndup (ch, (int)(dh - ch));
 				e_val = getenv (e_name);
+				specfile_noteenv (e_name, e_val);
 				if (!e_val) {
 					nocc_warning ("while reading specs file string, environment variable \"%s\" is not set", e_name);
 				} else {
@@ -701,6 +753,9 @@ static char *specfile_stringdupenv (char *edata)
 			}
 		}
 		*dh = '\0';
+
+		/* depends on the environment, so part of the build cache's key */
+		compcache_addkey (target);
 	}
 
 	return target;
@@ -1594,6 +1649,7 @@ typedef struct TAG_compcxt {
 
 	DYNARRAY (lexfile_t *, srclexers);
 	DYNARRAY (tnode_t *, srctrees);
+	struct TAG_tnoderegion *region;		/* where the tree-nodes for this compilation live */
 
 	/* below for interactive stuff only */
 	int imode;				/* index into ihandlers array for currently active "mode" */
@@ -1621,6 +1677,7 @@ static compcxt_t *nocc_newcompcxt (void)
 	ccx->atstage = 0;
 	dynarray_init (ccx->srclexers);
 	dynarray_init (ccx->srctrees);
+	ccx->region = tnode_newregion ();
 	ccx->imode = -1;
 	ccx->mhook = NULL;
 
@@ -1662,6 +1719,7 @@ static void nocc_freecompcxt (compcxt_t *ccx)
 	dynarray_trash (ccx->srclexers);
 
 	/* NOTE: deliberately don't kill srctrees inside the structure -- might be referenced elsewhere in the compiler */
+	/* NOTE: likewise the tree-node region, which main() frees after shutdown */
 
 	sfree (ccx);
 	return;
@@ -1705,6 +1763,7 @@ typedef struct TAG_cstage {
 #define CST_NONE	0x0000
 #define CST_NOINT	0x0001			/* do not run in interactive mode */
 #define CST_NOAUTO	0x0002			/* do not run in automatic mode */
+#define CST_WARM	0x0004			/* independent of the sources, a compile server runs it once up front */
 
 #define CSTR_OK		0
 #define CSTR_EXITCOMP	1			/* exit compiler */
@@ -1718,13 +1777,13 @@ typedef struct TAG_cstage {
 /*{{{  stagetable: compiler stage table*/
 static cstage_t stagetable[] = {
 /*	stagefcn			id		sname				flags			*/
-	{cstage_load_extensions,	"lext",		"load extensions",		CST_NONE},
+	{cstage_load_extensions,	"lext",		"load extensions",		CST_WARM},
 	{cstage_dump_extensions,	"dext",		"dump extensions",		CST_NONE},
 	{cstage_dump_regfcns,		"drfcn",	"dump registered functions",	CST_NONE},
 	{cstage_check_compile,		"cchk",		"check for compile",		CST_NONE},
-	{cstage_extn_init,		"iext",		"initialise extensions",	CST_NONE},
-	{cstage_trlang_init,		"itrw",		"initialise tree-rewriting",	CST_NONE},
-	{cstage_traces_init,		"itrace",	"initialise traces",		CST_NONE},
+	{cstage_extn_init,		"iext",		"initialise extensions",	CST_WARM},
+	{cstage_trlang_init,		"itrw",		"initialise tree-rewriting",	CST_WARM},
+	{cstage_traces_init,		"itrace",	"initialise traces",		CST_WARM},
 	{cstage_findtarget,		"ftarg",	"find target",			CST_NONE},
 	{cstage_dohelp_target,		"htarg",	"help with target",		CST_NONE},
 
@@ -1769,8 +1828,9 @@ int nocc_runfepasses (lexfile_t **lexers, tnode_t **trees, int count, int *exitm
 	for (i=0; i<DA_CUR (cfepasses); i++) {
 		compilerpass_t *cpass = DA_NTHITEM (cfepasses, i);
 		int passenabled = (!cpass->flagptr || (*(cpass->flagptr) == 1));
-		int j;
+		int j, pidx;
 		
+		pidx = passenabled ? profile_begin ("fe-pass", cpass->name) : -1;
 		for (j=0; j<count; j++) {
 			lexfile_t *lf = lexers[j];
 
@@ -1851,6 +1911,7 @@ int nocc_runfepasses (lexfile_t **lexers, tnode_t **trees, int count, int *exitm
 				}
 			}
 		}
+		profile_end (pidx);
 
 		/* can still stop even if pass not enabled */
 
@@ -1901,6 +1962,15 @@ static void cstage_maybestop1_dumptokens (lexfile_t *lf, void *arg)
 	return;
 }
 /*}}}*/
+/*{{{  static void cstage_doparse_initonly (lexfile_t *lf, void *arg)*/
+/*
+ *	called (indirectly by the parser) once it has been initialised, when warming up the server
+ */
+static void cstage_doparse_initonly (lexfile_t *lf, void *arg)
+{
+	return;
+}
+/*}}}*/
 
 /*{{{  static int cstage_load_extensions (compcxt_t *ccx)*/
 /*
@@ -2037,6 +2107,9 @@ static int cstage_openlexers (compcxt_t *ccx)
 {
 	int i;
 
+	/* tree-nodes from here on are allocated in this compilation's region */
+	tnode_setregion (ccx->region);
+
 	for (i=0; i<DA_CUR (ccx->srcfiles); i++) {
 		char *fname = DA_NTHITEM (ccx->srcfiles, i);
 		lexfile_t *tmp;
@@ -2401,8 +2474,9 @@ static int cstage_bepasses (compcxt_t *ccx)
 	for (i=0; i<DA_CUR (cbepasses); i++) {
 		compilerpass_t *cpass = DA_NTHITEM (cbepasses, i);
 		int passenabled = (!cpass->flagptr || (*(cpass->flagptr) == 1));
-		int j;
+		int j, pidx;
 
+		pidx = passenabled ? profile_begin ("be-pass", cpass->name) : -1;
 		for (j=0; j<DA_CUR (ccx->srctrees); j++) {
 			if (compopts.treecheck) {
 				/* do pre-pass checks */
@@ -2458,6 +2532,7 @@ static int cstage_bepasses (compcxt_t *ccx)
 				}
 			}
 		}
+		profile_end (pidx);
 		/* can still stop even if pass not enabled */
 
 		if (compopts.stoppoint == cpass->stoppoint) {
@@ -2486,10 +2561,12 @@ static int cstage_run (int stage, int iact, int iauto, compcxt_t *ccx)
 	} else if (iauto && (stagetable[stage].flags & CST_NOAUTO)) {
 		return CSTR_OK;
 	} else {
-		int r;
+		int r, pidx;
 		
 		ccx->atstage = stage;
+		pidx = profile_begin ("stage", stagetable[stage].sname);
 		r = stagetable[stage].stagefcn (ccx);
+		profile_end (pidx);
 
 		switch (r) {
 		case CSTR_OK:
@@ -3004,16 +3081,302 @@ static char *command_generator (const char *text, int state)
 /*}}}*/
 
 
+/*{{{  static void nocc_procargs (compcxt_t *ccx, char **argv, int argc)*/
+/*
+ *	processes command-line arguments: known options are handled, others are deferred for the
+ *	front-end and anything else is a source file.  errors are counted in ccx->errored.
+ */
+static void nocc_procargs (compcxt_t *ccx, char **argv, int argc)
+{
+	char **walk;
+	int i;
+
+	for (walk = argv + 1, i = argc - 1; *walk && i; walk++, i--) {
+		cmd_option_t *opt = NULL;
+
+		switch (**walk) {
+		case '-':
+			if ((*walk)[1] == '-') {
+				char *ch;
+
+				for (ch=(*walk + 2); ((*ch >= 'a') && (*ch <= 'z')) || ((*ch >= 'A') && (*ch <= 'Z')) || (*ch == '-'); ch++);
+				if (*ch == '=') {
+					/* long option split with an equals sign */
+					char *realopt = string_ndup (*walk + 2, (int)(ch - *walk) - 2);
+
+					opt = opts_getlongopt (realopt);
+					if (opt) {
+						/* yes, have this option */
+						if (nocc_dooption_arg (realopt, ch + 1) < 0) {
+							ccx->errored++;
+						}
+					} else {
+						/* defer for front-end */
+						dynarray_add (ccx->fe_def_opts, string_dup (*walk));
+					}
+					sfree (realopt);
+				} else {
+					opt = opts_getlongopt (*walk + 2);
+					if (opt) {
+						if (opts_process (opt, &walk, &i) < 0) {
+							ccx->errored++;
+						}
+					} else {
+						/* defer for front-end */
+						dynarray_add (ccx->fe_def_opts, string_dup (*walk));
+					}
+				}
+			} else {
+				char *ch;
+
+				for (ch = *walk + 1; *ch != '\0'; ch++) {
+					opt = opts_getshortopt (*ch);
+					if (opt) {
+						if (opts_process (opt, &walk, &i) < 0) {
+							ccx->errored++;
+						}
+					} else {
+						/* defer for front-end */
+						char *stropt = string_dup ("-X");
+
+						stropt[1] = *ch;
+						dynarray_add (ccx->fe_def_opts, stropt);
+					}
+				}
+			}
+			break;
+		default:
+			/* it's a source filename */
+			dynarray_add (ccx->srcfiles, string_dup (*walk));
+			break;
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void nocc_procfeargs (compcxt_t *ccx)*/
+/*
+ *	processes options deferred for the front-end (short options have been singularised by this point),
+ *	anything still unknown is deferred for the back-end.  errors are counted in ccx->errored.
+ */
+static void nocc_procfeargs (compcxt_t *ccx)
+{
+	char **walk;
+	int i;
+
+	for (walk = DA_PTR (ccx->fe_def_opts), i = DA_CUR (ccx->fe_def_opts); walk && *walk && i; walk++, i--) {
+		cmd_option_t *opt = NULL;
+
+		switch (**walk) {
+		case '-':
+			if ((*walk)[1] == '-') {
+				opt = opts_getlongopt (*walk + 2);
+				if (opt) {
+					if (opts_process (opt, &walk, &i) < 0) {
+						ccx->errored++;
+					}
+					sfree (*walk);
+					*walk = NULL;
+				} else {
+					/* defer for back-end */
+					dynarray_add (be_def_opts, *walk);
+					*walk = NULL;
+				}
+			} else {
+				char *ch = *walk + 1;
+
+				opt = opts_getshortopt (*ch);
+				if (opt) {
+					if (opts_process (opt, &walk, &i) < 0) {
+						ccx->errored++;
+					}
+					sfree (*walk);
+					*walk = NULL;
+				} else {
+					/* defer for back-end */
+					dynarray_add (be_def_opts, *walk);
+					*walk = NULL;
+				}
+			}
+			break;
+		}
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static void nocc_clearargs (compcxt_t *ccx)*/
+/*
+ *	forgets source files and deferred options, before a compile server takes a request
+ */
+static void nocc_clearargs (compcxt_t *ccx)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (ccx->srcfiles); i++) {
+		if (DA_NTHITEM (ccx->srcfiles, i)) {
+			sfree (DA_NTHITEM (ccx->srcfiles, i));
+		}
+	}
+	dynarray_trash (ccx->srcfiles);
+	dynarray_init (ccx->srcfiles);
+
+	for (i=0; i<DA_CUR (ccx->fe_def_opts); i++) {
+		if (DA_NTHITEM (ccx->fe_def_opts, i)) {
+			sfree (DA_NTHITEM (ccx->fe_def_opts, i));
+		}
+	}
+	dynarray_trash (ccx->fe_def_opts);
+	dynarray_init (ccx->fe_def_opts);
+
+	return;
+}
+/*}}}*/
+/*{{{  static int nocc_strchanged (const char *before, const char *after)*/
+/*
+ *	returns non-zero if an option string differs from its earlier setting
+ */
+static int nocc_strchanged (const char *before, const char *after)
+{
+	if (!before || !after) {
+		return (before != after);
+	}
+	return strcmp (before, after) ? 1 : 0;
+}
+/*}}}*/
+/*{{{  static int nocc_stradded (char **before, int nbefore, char **after, int nafter)*/
+/*
+ *	returns non-zero if a list option has an entry that was not in its earlier setting
+ */
+static int nocc_stradded (char **before, int nbefore, char **after, int nafter)
+{
+	int i, j;
+
+	for (i=0; i<nafter; i++) {
+		for (j=0; (j<nbefore) && strcmp (before[j], after[i]); j++);
+		if (j == nbefore) {
+			return 1;
+		}
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static int nocc_runserver (compcxt_t *ccx, int *argcp, char ***argvp)*/
+/*
+ *	runs the compiler as a compile server: stages that do not depend on the sources are run once, and
+ *	any source files given are used only to initialise their language's parser.  then waits for requests,
+ *	each compiled in a child process that returns from here with the request's arguments processed.
+ *	parsers register front-end passes for everything compiled afterwards, so once any are initialised,
+ *	requests with sources of other kinds (by file extension) are declined and compiled by the client, as are
+ *	requests whose options need the set-up main() did before the server started (specs file, paths, keys,
+ *	extensions, cache directory, --dump-specs), or whose environment changes a variable the specs file used.
+ *	returns 0 in a child compiling a request (with the request's arguments in argcp/argvp), non-zero when
+ *	the server has finished
+ */
+static int nocc_runserver (compcxt_t *ccx, int *argcp, char ***argvp)
+{
+	int i, sargc;
+	char **sargv;
+	DYNARRAY (char *, warmexts);
+	DYNARRAY (char *, wepath);
+	DYNARRAY (char *, wipath);
+	DYNARRAY (char *, wlpath);
+	DYNARRAY (char *, weload);
+	char *wspecsfile, *wcachedir;
+
+	dynarray_init (warmexts);
+	if (compopts.interactive) {
+		nocc_error ("cannot run a compile server in interactive mode");
+		ccx->errored++;
+		return 1;
+	}
+	for (i=0; stagetable[i].stagefcn; i++) {
+		if ((stagetable[i].flags & CST_WARM) && (cstage_run (i, 0, 1, ccx) != CSTR_OK)) {
+			ccx->errored++;
+			return 1;
+		}
+	}
+	for (i=0; i<DA_CUR (ccx->srcfiles); i++) {
+		char *fname = DA_NTHITEM (ccx->srcfiles, i);
+		lexfile_t *lf = lexer_open (fname);
+
+		if (!lf) {
+			nocc_error ("failed to open %s", fname);
+			ccx->errored++;
+			return 1;
+		}
+		if (compopts.verbose) {
+			nocc_message ("initialising %s parser for %s", parser_langname (lf) ?: "(unknown)", fname);
+		}
+		parser_initandfcn (lf, cstage_doparse_initonly, NULL);
+		lexer_close (lf);
+
+		dynarray_add (warmexts, string_dup (strrchr (fname, '.') ?: ""));
+	}
+	nocc_clearargs (ccx);
+
+	i = server_run (&sargc, &sargv);
+	if (i) {
+		if (i < 0) {
+			ccx->errored++;
+		}
+		return 1;
+	}
+
+	/* compiling a request from here on, options main() has already acted on must not change */
+	profile_restart ();
+	compopts.dumpspecs = 0;			/* printed when the server started */
+	dynarray_init (wepath);
+	dynarray_copy (wepath, compopts.epath);
+	dynarray_init (wipath);
+	dynarray_copy (wipath, compopts.ipath);
+	dynarray_init (wlpath);
+	dynarray_copy (wlpath, compopts.lpath);
+	dynarray_init (weload);
+	dynarray_copy (weload, compopts.eload);
+	wspecsfile = compopts.specsfile ? string_dup (compopts.specsfile) : NULL;
+	wcachedir = compopts.cachedir ? string_dup (compopts.cachedir) : NULL;
+
+	nocc_procargs (ccx, sargv, sargc);
+	if (compopts.dumpspecs || specfile_envchanged () || nocc_strchanged (wspecsfile, compopts.specsfile) || nocc_strchanged (wcachedir, compopts.cachedir) ||
+			nocc_stradded (DA_PTR (wepath), DA_CUR (wepath), DA_PTR (compopts.epath), DA_CUR (compopts.epath)) ||
+			nocc_stradded (DA_PTR (wipath), DA_CUR (wipath), DA_PTR (compopts.ipath), DA_CUR (compopts.ipath)) ||
+			nocc_stradded (DA_PTR (wlpath), DA_CUR (wlpath), DA_PTR (compopts.lpath), DA_CUR (compopts.lpath)) ||
+			nocc_stradded (DA_PTR (weload), DA_CUR (weload), DA_PTR (compopts.eload), DA_CUR (compopts.eload))) {
+		server_decline ();
+	}
+	nocc_procfeargs (ccx);
+	if (ccx->errored) {
+		nocc_fatal ("error processing command-line options (%d error%s)", ccx->errored, (ccx->errored == 1) ? "" : "s");
+		exit (EXIT_FAILURE);
+	}
+	for (i=0; DA_CUR (warmexts) && (i<DA_CUR (ccx->srcfiles)); i++) {
+		char *fextn = strrchr (DA_NTHITEM (ccx->srcfiles, i), '.') ?: "";
+		int j;
+
+		for (j=0; (j<DA_CUR (warmexts)) && strcmp (DA_NTHITEM (warmexts, j), fextn); j++);
+		if (j == DA_CUR (warmexts)) {
+			server_decline ();
+		}
+	}
+	*argcp = sargc;
+	*argvp = sargv;
+	return 0;
+}
+/*}}}*/
 /*{{{  int main (int argc, char **argv)*/
 /*
  *	start here
  */
 int main (int argc, char **argv)
 {
-	char **walk;
 	int i;
 	compcxt_t *ccx;
 	int xerrored;
+	struct TAG_tnoderegion *xregion;
+	int warmed = 0;
+	int completed = 0;
+	int cargc = argc;
+	char **cargv = argv;
 
 	/*{{{  readline initialisation */
 	dynarray_init(str_commands);
@@ -3026,6 +3389,13 @@ int main (int argc, char **argv)
 	compopts.progpath = *argv;
 
 	dmem_init ();
+
+	/* hand over to a compile server if there is one (see server.c) */
+	i = server_client (argc, argv);
+	if (i >= 0) {
+		return i;
+	}
+
 	compopts.maintainer = string_dup ("kroc-bugs@kent.ac.uk");
 #ifdef TARGET_CPU
 	compopts.target_cpu = string_dup (TARGET_CPU);
@@ -3073,6 +3443,9 @@ int main (int argc, char **argv)
 #endif
 	origin_init ();
 	opts_init ();
+	profile_init ();
+	server_init ();
+	compcache_init ();
 	fhandle_init ();
 	file_unix_init ();		/* early, incase anyone else needs */
 	fcnlib_init ();
@@ -3089,67 +3462,7 @@ int main (int argc, char **argv)
 	/*}}}*/
 	/*{{{  process command-line arguments*/
 	ccx->errored = 0;
-
-	for (walk = argv + 1, i = argc - 1; *walk && i; walk++, i--) {
-		cmd_option_t *opt = NULL;
-
-		switch (**walk) {
-		case '-':
-			if ((*walk)[1] == '-') {
-				char *ch;
-
-				for (ch=(*walk + 2); ((*ch >= 'a') && (*ch <= 'z')) || ((*ch >= 'A') && (*ch <= 'Z')) || (*ch == '-'); ch++);
-				if (*ch == '=') {
-					/* long option split with an equals sign */
-					char *realopt = string_ndup (*walk + 2, (int)(ch - *walk) - 2);
-
-					opt = opts_getlongopt (realopt);
-					if (opt) {
-						/* yes, have this option */
-						if (nocc_dooption_arg (realopt, ch + 1) < 0) {
-							ccx->errored++;
-						}
-					} else {
-						/* defer for front-end */
-						dynarray_add (ccx->fe_def_opts, string_dup (*walk));
-					}
-					sfree (realopt);
-				} else {
-					opt = opts_getlongopt (*walk + 2);
-					if (opt) {
-						if (opts_process (opt, &walk, &i) < 0) {
-							ccx->errored++;
-						}
-					} else {
-						/* defer for front-end */
-						dynarray_add (ccx->fe_def_opts, string_dup (*walk));
-					}
-				}
-			} else {
-				char *ch;
-
-				for (ch = *walk + 1; *ch != '\0'; ch++) {
-					opt = opts_getshortopt (*ch);
-					if (opt) {
-						if (opts_process (opt, &walk, &i) < 0) {
-							ccx->errored++;
-						}
-					} else {
-						/* defer for front-end */
-						char *stropt = string_dup ("-X");
-
-						stropt[1] = *ch;
-						dynarray_add (ccx->fe_def_opts, stropt);
-					}
-				}
-			}
-			break;
-		default:
-			/* it's a source filename */
-			dynarray_add (ccx->srcfiles, string_dup (*walk));
-			break;
-		}
-	}
+	nocc_procargs (ccx, argv, argc);
 	if (ccx->errored) {
 		nocc_fatal ("error processing command-line options");
 		exit (EXIT_FAILURE);
@@ -3465,43 +3778,7 @@ int main (int argc, char **argv)
 
 	/*}}}*/
 	/*{{{  process left-over arguments for front-end (short options have been singularised by this point)*/
-	for (walk = DA_PTR (ccx->fe_def_opts), i = DA_CUR (ccx->fe_def_opts); walk && *walk && i; walk++, i--) {
-		cmd_option_t *opt = NULL;
-
-		switch (**walk) {
-		case '-':
-			if ((*walk)[1] == '-') {
-				opt = opts_getlongopt (*walk + 2);
-				if (opt) {
-					if (opts_process (opt, &walk, &i) < 0) {
-						ccx->errored++;
-					}
-					sfree (*walk);
-					*walk = NULL;
-				} else {
-					/* defer for back-end */
-					dynarray_add (be_def_opts, *walk);
-					*walk = NULL;
-				}
-			} else {
-				char *ch = *walk + 1;
-
-				opt = opts_getshortopt (*ch);
-				if (opt) {
-					if (opts_process (opt, &walk, &i) < 0) {
-						ccx->errored++;
-					}
-					sfree (*walk);
-					*walk = NULL;
-				} else {
-					/* defer for back-end */
-					dynarray_add (be_def_opts, *walk);
-					*walk = NULL;
-				}
-			}
-			break;
-		}
-	}
+	nocc_procfeargs (ccx);
 
 	if (ccx->errored) {
 		nocc_fatal ("error processing command-line options (%d error%s)", ccx->errored, (ccx->errored == 1) ? "" : "s");
@@ -3576,6 +3853,14 @@ int main (int argc, char **argv)
 	/*{{{  make the compiler context globally available for compiler stages*/
 	global_ccx = ccx;
 	/*}}}*/
+	/*{{{  maybe run as a compile server, only requests come back from this*/
+	if (server_enabled ()) {
+		if (nocc_runserver (ccx, &cargc, &cargv)) {
+			goto main_out;
+		}
+		warmed = 1;
+	}
+	/*}}}*/
 
 	if (compopts.interactive) {
 		/*{{{  interactive mode*/
@@ -3666,10 +3951,16 @@ int main (int argc, char **argv)
 		}
 		/*}}}*/
 	} else {
-		/*{{{  auto-run compiler stages*/
+		/*{{{  auto-run compiler stages, unless the build cache has the result*/
+		if (compcache_enabled () && DA_CUR (ccx->srcfiles) && compcache_begin (cargc, cargv)) {
+			goto main_out;
+		}
 		for (i=0; stagetable[i].stagefcn; i++) {
 			int r;
 
+			if (warmed && (stagetable[i].flags & CST_WARM)) {
+				continue;		/* for() */
+			}
 			r = cstage_run (i, 0, 1, ccx);
 			switch (r) {
 			case CSTR_OK:
@@ -3686,6 +3977,7 @@ int main (int argc, char **argv)
 	}
 
 local_close_out:
+	completed = 1;
 	/*{{{  maybe dump trees*/
 	maybedumptrees (DA_PTR (ccx->srclexers), DA_CUR (ccx->srclexers), DA_PTR (ccx->srctrees), DA_CUR (ccx->srctrees));
 
@@ -3699,6 +3991,10 @@ local_close_out:
 	/*}}}*/
 
 main_out:
+	/*{{{  finish with the build cache*/
+	compcache_end (completed && !ccx->errored);
+
+	/*}}}*/
 	/*{{{  dump compiler hooks if requested*/
 	if (compopts.dumpchooks) {
 		tnode_dumpchooks (FHAN_STDERR);
@@ -3707,14 +4003,32 @@ main_out:
 	/*{{{  call any specific finalisers*/
 	treecheck_finalise ();
 
+	/*}}}*/
+	/*{{{  report profile if requested*/
+	profile_report ();
+
 	/*}}}*/
 	/*{{{  shutdown/etc.*/
 	xerrored = ccx->errored;
+	xregion = ccx->region;
 	nocc_freecompcxt (ccx);
 
 	/* shutdown compiler */
 	nocc_shutdownrun ();
 
+	/* trees are finished with now */
+	tnode_freeregion (xregion);
+
+	if (compopts.verbose) {
+		int lookups, hits, nstrings, bytes, saved;
+
+		string_internstats (&lookups, &hits, &nstrings, &bytes, &saved);
+		if (lookups) {
+			nocc_message ("interned strings: %d lookups, %d hits (%d%%), %d strings in %d bytes, %d bytes saved", lookups, hits,
+					(hits * 100) / lookups, nstrings, bytes, saved);
+		}
+	}
+
 	if (compopts.dmemdump) {
 		dmem_usagedump ();
 	}
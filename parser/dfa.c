@@ -44,6 +44,7 @@
 #include "names.h"
 #include "dfa.h"
 #include "dfaerror.h"
+#include "opts.h"
 
 /*}}}*/
 /*{{{  private stuff*/
@@ -70,10 +71,54 @@ typedef struct TAG_deferred_target {
 STATICDYNARRAY (deferred_match_t *, defmatches);
 STATICDYNARRAY (deferred_target_t *, deftargets);
 
+/* compiled transition index for a DFA node, mirrors the linear search through "match" */
+#define DFAINDEX_NTYPES (END + 1)
+#define DFAINDEX_FLATMAX 8		/* keyword/symbol matches held in a flat array up to this many */
+#define DFAINDEX_MINMATCH 6		/* nodes with fewer matches than this are just searched linearly */
+
+typedef struct TAG_dfaindex {
+	int bytype[DFAINDEX_NTYPES];	/* first match on token type alone, -1 if none */
+	int anyidx;			/* first match-any, -1 if none */
+	int hasiname;			/* non-zero if there are INAME matches (searched linearly) */
+	int nkeys;			/* number of distinct keyword/symbol matches */
+	int hsize;			/* hash-table size (power of 2), 0 if held flat */
+	void **keys;			/* keyword_t or symbol_t pointers */
+	int *kidx;			/* first match for each key, -1 for an empty hash slot */
+} dfaindex_t;
+
+static int dfa_useindex = 1;		/* cleared with --no-dfa-index */
+static uint64_t dfa_nsteps = 0;		/* number of dfa_advance() steps */
+static uint64_t dfa_ntests = 0;		/* number of match tests/lookups made */
+
 /* forward decls */
 static int dfa_idecode_rule (char **bits, int first, int last, dfanode_t *idfa, dfanode_t *edfa, void **fnptrtable, int *fnptr);
 static int dfa_idecode_totbl (char **bits, int first, int last, int istate, int estate, dfattbl_t *ttbl, void **fnptrtable, int *fnptr);
+static void dfa_dropindex (dfanode_t *dfa);
+
+/*}}}*/
+
+
+/*{{{  static int dfa_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	called to handle DFA command-line options
+ *	returns 0 on success, non-zero on failure
+ */
+static int dfa_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	int optv = (int)((uint64_t)opt->arg);
 
+	switch (optv) {
+		/*{{{  1 -- no transition indexes*/
+	case 1:
+		dfa_useindex = 0;
+		break;
+		/*}}}*/
+	default:
+		nocc_error ("dfa_opthandler(): unknown option [%s]", **argwalk);
+		return -1;
+	}
+	return 0;
+}
 /*}}}*/
 
 
@@ -87,6 +132,9 @@ int dfa_init (void)
 	stringhash_sinit (nameddfas);
 	dynarray_init (defmatches);
 	dynarray_init (deftargets);
+
+	opts_add ("no-dfa-index", '\0', dfa_opthandler, (void *)1, "1do not index DFA transitions (search them linearly)");
+
 	return 0;
 }
 /*}}}*/
@@ -196,13 +244,13 @@ void dfa_dumpdfas (fhandle_t *stream)
 /*}}}*/
 
 
-/*{{{  static dfattblent_t *dfa_newttblent (void)*/
+/*{{{  dfattblent_t *dfa_newttblent (void)*/
 /*
  *	creates a new transition table entry
  */
-static dfattblent_t *dfa_newttblent (void)
+dfattblent_t *dfa_newttblent (void)
 {
-	dfattblent_t *tblent = (dfattblent_t *)smalloc (sizeof (dfattblent_t));
+	dfattblent_t *tblent = (dfattblent_t *)smalloc_nz (sizeof (dfattblent_t));
 
 	tblent->s_state = -1;
 	tblent->e_state = -1;
@@ -263,13 +311,13 @@ static void dfa_freettblent (dfattblent_t *tblent)
 	return;
 }
 /*}}}*/
-/*{{{  static dfattbl_t *dfa_newttbl (void)*/
+/*{{{  dfattbl_t *dfa_newttbl (void)*/
 /*
  *	creates a new transition table node
  */
-static dfattbl_t *dfa_newttbl (void)
+dfattbl_t *dfa_newttbl (void)
 {
-	dfattbl_t *ttbl = (dfattbl_t *)smalloc (sizeof (dfattbl_t));
+	dfattbl_t *ttbl = (dfattbl_t *)smalloc_nz (sizeof (dfattbl_t));
 
 	ttbl->name = NULL;
 	ttbl->op = 0;
@@ -315,7 +363,7 @@ void dfa_freettbl (dfattbl_t *ttbl)
  */
 static deferred_match_t *dfa_newdefmatch (void)
 {
-	deferred_match_t *dmatch = (deferred_match_t *)smalloc (sizeof (deferred_match_t));
+	deferred_match_t *dmatch = (deferred_match_t *)smalloc_nz (sizeof (deferred_match_t));
 
 	dmatch->inode = NULL;
 	dmatch->enode = NULL;
@@ -360,7 +408,7 @@ fprintf (stderr, "dfa_deferred_match(): adding deferred match! iname contents [%
  */
 static deferred_target_t *dfa_newdeftarget (void)
 {
-	deferred_target_t *dtarget = (deferred_target_t *)smalloc (sizeof (deferred_target_t));
+	deferred_target_t *dtarget = (deferred_target_t *)smalloc_nz (sizeof (deferred_target_t));
 
 	dtarget->inode = NULL;
 	dtarget->match = NULL;
@@ -407,7 +455,7 @@ fprintf (stderr, "dfa_deferred_target(): adding deferred target 0x%8.8x in node
  */
 static dfacreep_t *dfa_newcreep (void)
 {
-	dfacreep_t *dfacr = (dfacreep_t *)smalloc (sizeof (dfacreep_t));
+	dfacreep_t *dfacr = (dfacreep_t *)smalloc_nz (sizeof (dfacreep_t));
 
 	dynarray_init (dfacr->tokenstack);
 
@@ -444,7 +492,7 @@ dfanode_t *dfa_newnode (void)
 {
 	dfanode_t *dfa;
 
-	dfa = (dfanode_t *)smalloc (sizeof (dfanode_t));
+	dfa = (dfanode_t *)smalloc_nz (sizeof (dfanode_t));
 	dynarray_init (dfa->match);
 	dynarray_init (dfa->target);
 	dynarray_init (dfa->pushto);
@@ -453,6 +501,7 @@ dfanode_t *dfa_newnode (void)
 	dfa->rarg = NULL;
 	dfa->dfainfo = NULL;
 	dfa->incoming = 0;
+	dfa->index = NULL;
 
 	return dfa;
 }
@@ -534,6 +583,7 @@ void dfa_addmatch (dfanode_t *dfa, token_t *tok, dfanode_t *target, uint64_t fla
 	if (target) {
 		target->incoming++;
 	}
+	dfa_dropindex (dfa);
 	return;
 }
 /*}}}*/
@@ -593,6 +643,7 @@ void dfa_addpush (dfanode_t *dfa, token_t *tok, dfanode_t *pushto, dfanode_t *ta
 	if (target) {
 		target->incoming++;
 	}
+	dfa_dropindex (dfa);
 	return;
 }
 /*}}}*/
@@ -773,7 +824,7 @@ int dfa_setname (dfanode_t *dfa, char *name)
 
 	ndfa = stringhash_lookup (nameddfas, name);
 	if (!ndfa) {
-		ndfa = (nameddfa_t *)smalloc (sizeof (nameddfa_t));
+		ndfa = (nameddfa_t *)smalloc_nz (sizeof (nameddfa_t));
 		ndfa->name = string_dup (name);
 		ndfa->inode = dfa;
 		ndfa->ehan = NULL;
@@ -840,32 +891,237 @@ dfaerrorhandler_t *dfa_geterrorhandler (char *name)
 	return NULL;
 }
 /*}}}*/
-/*{{{  int dfa_findmatch (dfanode_t *dfa, token_t *tok, dfanode_t **r_pushto, dfanode_t **r_target, uint64_t *r_flags)*/
+/*{{{  static void dfa_freeindex (dfaindex_t *idx)*/
 /*
- *	finds a match in the given DFA, populates arguments if/with valid pointers
- *	returns 1 if found, 0 if not found
+ *	frees a DFA node transition index
  */
-int dfa_findmatch (dfanode_t *dfa, token_t *tok, dfanode_t **r_pushto, dfanode_t **r_target, uint64_t *r_flags)
+static void dfa_freeindex (dfaindex_t *idx)
+{
+	if (!idx) {
+		nocc_warning ("dfa_freeindex(): NULL pointer!");
+		return;
+	}
+	if (idx->keys) {
+		sfree (idx->keys);
+	}
+	if (idx->kidx) {
+		sfree (idx->kidx);
+	}
+	sfree (idx);
+	return;
+}
+/*}}}*/
+/*{{{  static void dfa_dropindex (dfanode_t *dfa)*/
+/*
+ *	discards the transition index for a DFA node (called when its matches change)
+ */
+static void dfa_dropindex (dfanode_t *dfa)
+{
+	if (dfa->index) {
+		dfa_freeindex (dfa->index);
+		dfa->index = NULL;
+	}
+	return;
+}
+/*}}}*/
+/*{{{  static int dfa_indexslot (dfaindex_t *idx, void *key)*/
+/*
+ *	finds the slot for a keyword/symbol in a DFA node transition index
+ *	returns slot (existing or where it would go), -1 if not present in a flat index
+ */
+static int dfa_indexslot (dfaindex_t *idx, void *key)
 {
 	int i;
 
+	if (!idx->hsize) {
+		for (i=0; i<idx->nkeys; i++) {
+			if (idx->keys[i] == key) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	i = (int)(((((uint64_t)key) >> 3) * 0x9e3779b97f4a7c15ULL) >> 32) & (idx->hsize - 1);
+	while ((idx->kidx[i] >= 0) && (idx->keys[i] != key)) {
+		i = (i + 1) & (idx->hsize - 1);
+	}
+	return i;
+}
+/*}}}*/
+/*{{{  static dfaindex_t *dfa_buildindex (dfanode_t *dfa)*/
+/*
+ *	compiles the matches of a DFA node into a transition index: the first match for each token-type,
+ *	keyword and symbol, so that the search gives the same answer as lexer_tokmatch() in order.
+ *	returns the new index
+ */
+static dfaindex_t *dfa_buildindex (dfanode_t *dfa)
+{
+	dfaindex_t *idx = (dfaindex_t *)smalloc_nz (sizeof (dfaindex_t));
+	int i, nkeyed;
+
+	for (i=0; i<DFAINDEX_NTYPES; i++) {
+		idx->bytype[i] = -1;
+	}
+	idx->anyidx = -1;
+	idx->hasiname = 0;
+	idx->nkeys = 0;
+	idx->hsize = 0;
+	idx->keys = NULL;
+	idx->kidx = NULL;
+
+	for (i=0, nkeyed=0; i<DA_CUR (dfa->match); i++) {
+		token_t *thismatch = DA_NTHITEM (dfa->match, i);
+
+		if (thismatch && ((thismatch->type == KEYWORD) || (thismatch->type == SYMBOL))) {
+			nkeyed++;
+		}
+	}
+	if (nkeyed > DFAINDEX_FLATMAX) {
+		for (idx->hsize = 16; idx->hsize < (nkeyed << 1); idx->hsize <<= 1);
+		idx->keys = (void **)smalloc_nz (idx->hsize * sizeof (void *));
+		idx->kidx = (int *)smalloc_nz (idx->hsize * sizeof (int));
+		for (i=0; i<idx->hsize; i++) {
+			idx->kidx[i] = -1;
+		}
+	} else if (nkeyed) {
+		idx->keys = (void **)smalloc_nz (nkeyed * sizeof (void *));
+		idx->kidx = (int *)smalloc_nz (nkeyed * sizeof (int));
+	}
+
 	for (i=0; i<DA_CUR (dfa->match); i++) {
-		token_t *t_match = DA_NTHITEM (dfa->match, i);
+		token_t *thismatch = DA_NTHITEM (dfa->match, i);
+		void *key;
+		int slot;
 
-		if (lexer_tokmatch (t_match, tok)) {
-			if (r_pushto) {
-				*r_pushto = DA_NTHITEM (dfa->pushto, i);
+		if (!thismatch) {
+			continue;
+		}
+		switch (thismatch->type) {
+		case NOTOKEN:
+			if (idx->anyidx < 0) {
+				idx->anyidx = i;
 			}
-			if (r_target) {
-				*r_target = DA_NTHITEM (dfa->target, i);
+			break;
+		case KEYWORD:
+		case SYMBOL:
+			key = (thismatch->type == KEYWORD) ? (void *)thismatch->u.kw : (void *)thismatch->u.sym;
+			slot = dfa_indexslot (idx, key);
+			if (!idx->hsize && (slot < 0)) {
+				idx->keys[idx->nkeys] = key;
+				idx->kidx[idx->nkeys] = i;
+				idx->nkeys++;
+			} else if (idx->hsize && (idx->kidx[slot] < 0)) {
+				idx->keys[slot] = key;
+				idx->kidx[slot] = i;
+				idx->nkeys++;
 			}
-			if (r_flags) {
-				*r_flags = DA_NTHITEM (dfa->flags, i);
+			break;
+		case INAME:
+			idx->hasiname = 1;
+			break;
+		default:
+			if ((thismatch->type < DFAINDEX_NTYPES) && (idx->bytype[thismatch->type] < 0)) {
+				idx->bytype[thismatch->type] = i;
 			}
-			return 1;
+			break;
 		}
 	}
-	return 0;
+
+	return idx;
+}
+/*}}}*/
+/*{{{  static int dfa_linearmatch (dfanode_t *dfa, token_t *tok)*/
+/*
+ *	searches the matches of a DFA node in order for the given token
+ *	returns match index, or -1 if not found
+ */
+static int dfa_linearmatch (dfanode_t *dfa, token_t *tok)
+{
+	int i;
+
+	for (i=0; i<DA_CUR (dfa->match); i++) {
+		token_t *thismatch = DA_NTHITEM (dfa->match, i);
+
+		dfa_ntests++;
+		if (lexer_tokmatch (thismatch, tok)) {
+			return i;
+		}
+	}
+	return -1;
+}
+/*}}}*/
+/*{{{  static int dfa_indexmatch (dfanode_t *dfa, token_t *tok)*/
+/*
+ *	finds the first match for a token in a DFA node, using (and building if needed) its transition index.
+ *	small nodes and INAME tokens (deferred and named matches) fall back to the linear search.
+ *	returns match index, or -1 if not found
+ */
+static int dfa_indexmatch (dfanode_t *dfa, token_t *tok)
+{
+	dfaindex_t *idx;
+	int r = -1;
+
+	if (!dfa_useindex || (DA_CUR (dfa->match) < DFAINDEX_MINMATCH)) {
+		return dfa_linearmatch (dfa, tok);
+	}
+	if (!dfa->index) {
+		dfa->index = dfa_buildindex (dfa);
+	}
+	idx = dfa->index;
+
+	switch (tok->type) {
+	case KEYWORD:
+	case SYMBOL:
+		if (idx->nkeys) {
+			int slot = dfa_indexslot (idx, (tok->type == KEYWORD) ? (void *)tok->u.kw : (void *)tok->u.sym);
+
+			if (slot >= 0) {
+				r = idx->kidx[slot];
+			}
+		}
+		break;
+	case INAME:
+		if (idx->hasiname) {
+			return dfa_linearmatch (dfa, tok);
+		}
+		break;
+	default:
+		if ((tok->type >= 0) && (tok->type < DFAINDEX_NTYPES)) {
+			r = idx->bytype[tok->type];
+		}
+		break;
+	}
+	dfa_ntests++;
+
+	if ((idx->anyidx >= 0) && ((r < 0) || (idx->anyidx < r))) {
+		r = idx->anyidx;
+	}
+	return r;
+}
+/*}}}*/
+/*{{{  int dfa_findmatch (dfanode_t *dfa, token_t *tok, dfanode_t **r_pushto, dfanode_t **r_target, uint64_t *r_flags)*/
+/*
+ *	finds a match in the given DFA, populates arguments if/with valid pointers
+ *	returns 1 if found, 0 if not found
+ */
+int dfa_findmatch (dfanode_t *dfa, token_t *tok, dfanode_t **r_pushto, dfanode_t **r_target, uint64_t *r_flags)
+{
+	int i = dfa_indexmatch (dfa, tok);
+
+	if (i < 0) {
+		return 0;
+	}
+	if (r_pushto) {
+		*r_pushto = DA_NTHITEM (dfa->pushto, i);
+	}
+	if (r_target) {
+		*r_target = DA_NTHITEM (dfa->target, i);
+	}
+	if (r_flags) {
+		*r_flags = DA_NTHITEM (dfa->flags, i);
+	}
+	return 1;
 }
 /*}}}*/
 
@@ -2744,7 +3000,7 @@ dfanode_t *dfa_tbltodfa (dfattbl_t *ttbl)
 		return NULL;
 	}
 	idfa = NULL;
-	nodetable = (dfanode_t **)smalloc ((ttbl->nstates + 1) * sizeof (dfanode_t *));
+	nodetable = (dfanode_t **)smalloc_nz ((ttbl->nstates + 1) * sizeof (dfanode_t *));
 	for (i=0; i<=ttbl->nstates; i++) {
 		nodetable[i] = dfa_newnode ();
 	}
@@ -2808,7 +3064,7 @@ dfanode_t *dfa_decodetrans (const char *rule, ...)
 #if 0
 nocc_message ("dfa_idecodetrans(): for [%s], safe, adding = %d, nstates = %d", rule, adding, nstates);
 #endif
-		nodetable = (dfanode_t **)smalloc ((nstates + 1) * sizeof (dfanode_t *));
+		nodetable = (dfanode_t **)smalloc_nz ((nstates + 1) * sizeof (dfanode_t *));
 		for (i=0; i<=nstates; i++) {
 			nodetable[i] = NULL;
 		}
@@ -3144,6 +3400,7 @@ int dfa_match_deferred (void)
 		dynarray_delitem (inode->target, j);
 		dynarray_delitem (inode->pushto, j);
 		dynarray_delitem (inode->flags, j);
+		dfa_dropindex (inode);
 
 #if 0
 fprintf (stderr, "dfa_match_deferred(): resolving [%s] in [%s]\n", dmatch->match->u.str.ptr, inode->dfainfo ? ((nameddfa_t *)inode->dfainfo)->name : "?");
@@ -3256,15 +3513,9 @@ int dfa_advance (dfastate_t **dfast, parsepriv_t *pp, token_t *tok)
 				lexer_stokenstr (tok));
 	}
 	/* check for a matched exit transition */
-	for (i=0; i<DA_CUR (cnode->match); i++) {
-		token_t *thistok = DA_NTHITEM (cnode->match, i);
-
-		if (lexer_tokmatch (thistok, tok)) {
-			/* match */
-			break;
-		}
-	}
-	if (i == DA_CUR (cnode->match)) {
+	dfa_nsteps++;
+	i = dfa_indexmatch (cnode, tok);
+	if (i < 0) {
 		/* could not advance out of this state! */
 		nameddfa_t *ndfa = (cnode->dfainfo ? (nameddfa_t *)cnode->dfainfo : NULL);
 
@@ -3371,6 +3622,21 @@ int dfa_advance (dfastate_t **dfast, parsepriv_t *pp, token_t *tok)
 	return 1;
 }
 /*}}}*/
+/*{{{  void dfa_getstats (uint64_t *r_steps, uint64_t *r_tests)*/
+/*
+ *	returns the number of DFA steps taken and match tests made so far (for parser statistics)
+ */
+void dfa_getstats (uint64_t *r_steps, uint64_t *r_tests)
+{
+	if (r_steps) {
+		*r_steps = dfa_nsteps;
+	}
+	if (r_tests) {
+		*r_tests = dfa_ntests;
+	}
+	return;
+}
+/*}}}*/
 /*{{{  void dfa_pushnode (dfastate_t *dfast, tnode_t *node)*/
 /*
  *	pushes a node onto the nodestack
@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include "nocc.h"
 #include "support.h"
@@ -447,6 +448,8 @@ tnode_t *parser_parse (lexfile_t *lf)
 {
 	tnode_t *tree;
 	parsepriv_t *pp;
+	struct timeval t_start, t_end;
+	uint64_t steps0, tests0;
 
 	if (!lf->parser) {
 		return NULL;
@@ -456,8 +459,27 @@ tnode_t *parser_parse (lexfile_t *lf)
 	lf->ppriv = (void *)pp;
 	lf->parser->init (lf);
 
+	dfa_getstats (&steps0, &tests0);
+	gettimeofday (&t_start, NULL);
+
 	tree = lf->parser->parse (lf);
 
+	if (compopts.verbose) {
+		/*{{{  report parser throughput*/
+		uint64_t steps, tests;
+		int64_t usecs;
+
+		gettimeofday (&t_end, NULL);
+		dfa_getstats (&steps, &tests);
+		steps -= steps0;
+		tests -= tests0;
+		usecs = ((int64_t)(t_end.tv_sec - t_start.tv_sec) * 1000000) + (int64_t)(t_end.tv_usec - t_start.tv_usec);
+		nocc_message ("parsed %s: %llu DFA steps, %llu match tests in %d.%3.3d ms (%llu steps/sec)", lf->fnptr,
+				(unsigned long long)steps, (unsigned long long)tests, (int)(usecs / 1000), (int)(usecs % 1000),
+				usecs ? (unsigned long long)((steps * 1000000) / usecs) : 0ULL);
+		/*}}}*/
+	}
+
 	parser_freeparsepriv (pp);
 	lf->parser->shutdown (lf);
 
@@ -2049,7 +2071,7 @@ void *parser_decode_grule (const char *rule, ...)
 	/* if still here, good.  decode proper */
 	ilen++;			/* for _END */
 	uplen = 0;
-	icode = (uint64_t *)smalloc (ilen * sizeof (uint64_t));
+	icode = (uint64_t *)scalloc (ilen, sizeof (uint64_t));
 
 	for (i=0, xrule=(char *)rule; (*xrule != '\0') && (i < ilen); xrule++, i++) {
 		switch (*xrule) {
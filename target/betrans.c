@@ -377,7 +377,7 @@ if (*tptr) {
 }
 #endif
 	if (*tptr && (*tptr)->tag->ndef->ops && tnode_hascompop_i ((*tptr)->tag->ndef->ops, (int)COPS_BETRANS)) {
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_BETRANS, 2, tptr, (betrans_t *)arg);
+		i = tnode_callcompop_i2 ((*tptr)->tag->ndef->ops, (int)COPS_BETRANS, tptr, (betrans_t *)arg);
 	}
 	return i;
 }
@@ -44,17 +44,22 @@
 #include "target.h"
 #include "codegen.h"
 #include "crypto.h"
+#include "opts.h"
 
 
 /*}}}*/
 
 /*{{{  private types*/
 
+#define CODEGEN_OUTBUFSIZE (256 * 1024)		/* output buffer (or mapped window) size */
+
 /*}}}*/
 /*{{{  private data*/
 static chook_t *codegeninithook = NULL;
 static chook_t *codegenfinalhook = NULL;
 
+static fhbufmode_e codegen_bufmode = FHB_WRITE;	/* FHB_NONE with --no-output-buffer, FHB_MMAP with --output-mmap */
+
 /*}}}*/
 
 
@@ -335,6 +340,16 @@ void codegen_clearpostcall (codegen_t *cgen, void (*func)(codegen_t *, void *),
 /*}}}*/
 
 
+/*{{{  static void codegen_digestsink (void *arg, unsigned char *data, int bytes)*/
+/*
+ *	called with chunks of output as they leave the output buffer, feeds the digest
+ */
+static void codegen_digestsink (void *arg, unsigned char *data, int bytes)
+{
+	crypto_writedigest ((crypto_t *)arg, data, bytes);
+	return;
+}
+/*}}}*/
 /*{{{  int codegen_write_bytes (codegen_t *cgen, const char *ptr, int bytes)*/
 /*
  *	writes plain bytes to the output file -- this is, in fact, the only thing that writes bytes to the output file
@@ -349,10 +364,7 @@ int codegen_write_bytes (codegen_t *cgen, const char *ptr, int bytes)
 		nocc_internal ("codegen_write_bytes(): attempt to write to closed file!");
 		return -1;
 	}
-	if (bytes && cgen->digest) {
-		/* write into digest */
-		crypto_writedigest (cgen->digest, (unsigned char *)ptr, bytes);
-	}
+	/* note: the digest is fed from the output buffer as it goes out */
 	while (left) {
 		int r = fhandle_write (cgen->fhan, (unsigned char *)ptr + v, left);
 
@@ -389,16 +401,17 @@ int codegen_write_fmt (codegen_t *cgen, const char *fmt, ...)
 {
 	va_list ap;
 	int i, r;
-	char *buf = (char *)smalloc (1024);
+	char buf[1024];
 
 	va_start (ap, fmt);
 	i = vsnprintf (buf, 1023, fmt, ap);
 	va_end (ap);
 
+	if (i > 1022) {
+		i = 1022;
+	}
 	r = codegen_write_bytes (cgen, buf, i);
 
-	sfree (buf);
-
 	return r;
 }
 /*}}}*/
@@ -628,7 +641,7 @@ static int codegen_prewalktree_codegen (tnode_t *node, void *data)
 	/*}}}*/
 
 	if (node->tag->ndef->ops && tnode_hascompop_i (node->tag->ndef->ops, (int)COPS_CODEGEN)) {
-		i = tnode_callcompop_i (node->tag->ndef->ops, (int)COPS_CODEGEN, 2, node, cgen);
+		i = tnode_callcompop_i2 (node->tag->ndef->ops, (int)COPS_CODEGEN, node, cgen);
 	}
 
 	/*{{{  if finalisers, do subnodes then finalisers*/
@@ -684,7 +697,7 @@ fprintf (stderr, "codegen_modprewalk_precode(): pre-coding pc_chook vars.\n");
 		if (compopts.traceprecode) {
 			tnode_message (*tptr, "calling precode on [%s:%s]", (*tptr)->tag->ndef->name, (*tptr)->tag->name);
 		}
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_PRECODE, 2, tptr, cgen);
+		i = tnode_callcompop_i2 ((*tptr)->tag->ndef->ops, (int)COPS_PRECODE, tptr, cgen);
 	}
 	return i;
 }
@@ -770,7 +783,7 @@ int codegen_generate_code (tnode_t **tptr, lexfile_t *lf, target_t *target)
 
 	/*}}}*/
 	/*{{{  open output file*/
-	cgen->fhan = fhandle_open (cgen->fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	cgen->fhan = fhandle_open (cgen->fname, ((codegen_bufmode == FHB_MMAP) ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC, 0644);
 	if (!cgen->fhan) {
 		nocc_error ("failed to open %s for writing: %s", cgen->fname, strerror (fhandle_lasterr (NULL)));
 		sfree (cgen->fname);
@@ -782,7 +795,11 @@ int codegen_generate_code (tnode_t **tptr, lexfile_t *lf, target_t *target)
 	/*{{{  initialise cryptographic stuffs*/
 	if (compopts.hashalgo) {
 		cgen->digest = crypto_newdigest ();
+		if (cgen->digest) {
+			fhandle_setsink (cgen->fhan, codegen_digestsink, (void *)cgen->digest);
+		}
 	}
+	fhandle_setbuffer (cgen->fhan, codegen_bufmode, CODEGEN_OUTBUFSIZE);
 
 	/*}}}*/
 	/*{{{  initialise back-end code generation*/
@@ -819,6 +836,10 @@ int codegen_generate_code (tnode_t **tptr, lexfile_t *lf, target_t *target)
 	/*}}}*/
 	/*{{{  shutdown back-end code generation*/
 	target->be_codegen_final (cgen, lf);
+	fhandle_drain (cgen->fhan);
+	if (compopts.verbose) {
+		nocc_message ("wrote %lu bytes to %s in %d output calls", (unsigned long)cgen->fhan->wbytes, cgen->fname, cgen->fhan->wcalls);
+	}
 	fhandle_close (cgen->fhan);
 	cgen->fhan = NULL;
 
@@ -1058,6 +1079,33 @@ int codegen_shutdown (void)
 	return 0;
 }
 /*}}}*/
+/*{{{  static int codegen_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)*/
+/*
+ *	called to handle code-generator command-line options
+ *	returns 0 on success, non-zero on failure
+ */
+static int codegen_opthandler (cmd_option_t *opt, char ***argwalk, int *argleft)
+{
+	int optv = (int)((uint64_t)opt->arg);
+
+	switch (optv) {
+		/*{{{  1 -- unbuffered output*/
+	case 1:
+		codegen_bufmode = FHB_NONE;
+		break;
+		/*}}}*/
+		/*{{{  2 -- memory-mapped output*/
+	case 2:
+		codegen_bufmode = FHB_MMAP;
+		break;
+		/*}}}*/
+	default:
+		nocc_error ("codegen_opthandler(): unknown option [%s]", **argwalk);
+		return -1;
+	}
+	return 0;
+}
+/*}}}*/
 /*{{{  int codegen_init (void)*/
 /*
  *	initialises the code-generator
@@ -1074,6 +1122,9 @@ int codegen_init (void)
 	codegenfinalhook->chook_free = codegen_finalhook_free;
 	codegenfinalhook->chook_dumptree = codegen_finalhook_dumptree;
 
+	opts_add ("no-output-buffer", '\0', codegen_opthandler, (void *)1, "1write generated code unbuffered");
+	opts_add ("output-mmap", '\0', codegen_opthandler, (void *)2, "1write generated code through memory-mapped windows of the output file");
+
 	return 0;
 }
 /*}}}*/
@@ -98,7 +98,7 @@ static int map_modprewalk_mapnames (tnode_t **tptr, void *arg)
 #if 0
 fprintf (stderr, "map_modprewalk_mapnames(): calling on node [%s:%s]\n", (*tptr)->tag->ndef->name, (*tptr)->tag->name);
 #endif
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_NAMEMAP, 2, tptr, mdata);
+		i = tnode_callcompop_i2 ((*tptr)->tag->ndef->ops, (int)COPS_NAMEMAP, tptr, mdata);
 	}
 	return i;
 }
@@ -120,7 +120,7 @@ static int map_modprewalk_premap (tnode_t **tptr, void *arg)
 	}
 	i = 1;
 	if ((*tptr)->tag->ndef->ops && tnode_hascompop_i ((*tptr)->tag->ndef->ops, (int)COPS_PREMAP)) {
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_PREMAP, 2, tptr, mdata);
+		i = tnode_callcompop_i2 ((*tptr)->tag->ndef->ops, (int)COPS_PREMAP, tptr, mdata);
 	}
 	return i;
 }
@@ -141,7 +141,7 @@ static int map_modprewalk_bemap (tnode_t **tptr, void *arg)
 	}
 	i = 1;
 	if ((*tptr)->tag->ndef->ops && tnode_hascompop_i ((*tptr)->tag->ndef->ops, (int)COPS_BEMAP)) {
-		i = tnode_callcompop_i ((*tptr)->tag->ndef->ops, (int)COPS_BEMAP, 2, tptr, mdata);
+		i = tnode_callcompop_i2 ((*tptr)->tag->ndef->ops, (int)COPS_BEMAP, tptr, mdata);
 	}
 	return i;
 }